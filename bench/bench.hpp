@@ -0,0 +1,68 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace stockpile::bench {
+
+using Clock = std::chrono::steady_clock;
+
+[[nodiscard]] inline double seconds_since(Clock::time_point start) noexcept {
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+/// Keeps the compiler from discarding a computed value.
+template <typename T>
+inline void do_not_optimize(const T& value) noexcept {
+    asm volatile("" : : "r,m"(value) : "memory");
+}
+
+/// Value below which a fraction `q` of the samples fall. Reorders `samples`.
+[[nodiscard]] inline double percentile(std::vector<double>& samples, double q) {
+    if (samples.empty()) {
+        return 0;
+    }
+    const auto index = static_cast<std::size_t>(q * static_cast<double>(samples.size() - 1));
+    std::nth_element(samples.begin(), samples.begin() + static_cast<std::ptrdiff_t>(index), samples.end());
+    return samples[index];
+}
+
+/// Deterministic generator (splitmix64) so every run sees the same data.
+class Rng {
+public:
+    explicit Rng(std::uint64_t seed) noexcept : m_state(seed) {}
+
+    [[nodiscard]] std::uint64_t next() noexcept {
+        std::uint64_t z = (m_state += 0x9e3779b97f4a7c15);
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+        return z ^ (z >> 31);
+    }
+
+    /// Uniform in [0, bound).
+    [[nodiscard]] std::uint64_t below(std::uint64_t bound) noexcept { return next() % bound; }
+
+private:
+    std::uint64_t m_state;
+};
+
+/// Prints one aligned line per measurement.
+class Report {
+public:
+    void section(std::string_view name) {
+        std::printf("\n%.*s\n", static_cast<int>(name.size()), name.data());
+    }
+
+    void row(std::string_view metric, double value, std::string_view unit) {
+        std::printf("  %-36.*s %14.3f %.*s\n", static_cast<int>(metric.size()), metric.data(), value,
+                    static_cast<int>(unit.size()), unit.data());
+        std::fflush(stdout);
+    }
+};
+
+} // namespace stockpile::bench
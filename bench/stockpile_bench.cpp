@@ -0,0 +1,811 @@
+// Offline benchmark suite for stockpile.
+//
+// Builds synthetic archives of 10k to 1M entries in a scratch directory and
+// measures archive open time, path lookup latency, sequential and random
+// read throughput (warm page cache), path lookups against resolved handles,
+// directory listings against scans of every path, lookups through a VFS of
+// one layer and of many,
+// concurrent lookup-and-read scaling,
+// hash and CRC-32C cost per byte at each SIMD level, LZ4 ratio and speed,
+// a 256 MiB entry read whole against read in chunks,
+// column scans of a table against the same scans of row structs, and
+// save-game encode/decode throughput. Results go to stdout, e.g.
+//
+//     stockpile-bench | tee bench_output.txt
+//
+// Options:
+//     --entries N[,N...]   dataset sizes (default 10000,100000,1000000)
+//     --dir PATH           scratch directory (default: a fresh one under $TMPDIR)
+
+#include "bench.hpp"
+
+#include "stockpile/archive.hpp"
+#include "stockpile/archive_set.hpp"
+#include "stockpile/archive_writer.hpp"
+#include "stockpile/chunk_reader.hpp"
+#include "stockpile/compression.hpp"
+#include "stockpile/handle_table.hpp"
+#include "stockpile/hash.hpp"
+#include "stockpile/record.hpp"
+#include "stockpile/schema.hpp"
+#include "stockpile/serialize.hpp"
+#include "stockpile/table.hpp"
+#include "stockpile/vfs.hpp"
+
+#include <unistd.h>
+
+#include <array>
+#include <charconv>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <latch>
+#include <numeric>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace game {
+
+struct Vec3 {
+    float x, y, z;
+};
+STOCKPILE_SCHEMA(Vec3, x, y, z)
+
+struct Transform {
+    Vec3 position;
+    std::array<float, 4> rotation;
+    Vec3 scale;
+};
+STOCKPILE_SCHEMA(Transform, position, rotation, scale)
+
+struct Entity {
+    std::uint64_t id = 0;
+    std::string name;
+    Transform transform{};
+    std::vector<std::uint32_t> tags;
+    std::int32_t health = 0;
+    bool active = false;
+};
+STOCKPILE_SCHEMA(Entity, id, name, transform, tags, health, active)
+
+/// A designer-authored row, as wide as such rows tend to get.
+struct Item {
+    std::uint32_t id = 0;
+    std::string name;
+    std::string slot;
+    float damage = 0;
+    float weight = 0;
+    std::int32_t level = 0;
+    std::array<float, 16> modifiers{};
+    std::string description;
+};
+STOCKPILE_SCHEMA(Item, id, name, slot, damage, weight, level, modifiers, description)
+STOCKPILE_TABLE_INDEXES(Item, stockpile::hash_index<&Item::id>, stockpile::sorted_index<&Item::level>)
+
+} // namespace game
+
+namespace {
+
+namespace fs = std::filesystem;
+using namespace stockpile;
+using namespace stockpile::bench;
+
+constexpr double kMiB = 1024.0 * 1024.0;
+constexpr std::size_t kMinPayload = 32;
+constexpr std::size_t kMaxPayload = 512;
+
+struct Options {
+    std::vector<std::size_t> entries{10'000, 100'000, 1'000'000};
+    fs::path dir;
+};
+
+struct Dataset {
+    fs::path file;
+    std::vector<std::string> paths;
+    std::uint64_t payload_bytes = 0;
+};
+
+[[noreturn]] void die(std::string_view what, std::error_code error) {
+    std::fprintf(stderr, "stockpile-bench: %.*s: %s\n", static_cast<int>(what.size()), what.data(),
+                 error.message().c_str());
+    std::exit(1);
+}
+
+/// Text-like bytes built from a small vocabulary so LZ4 has matches to find,
+/// with some noise mixed in.
+void fill_payload(Rng& rng, std::vector<std::byte>& out, std::size_t size) {
+    static constexpr std::string_view kWords[] = {
+        "vertex ", "normal ", "texcoord ", "0.125 ", "-1.5 ", "material ", "shader ", "mesh ",
+        "{ ",      "} ",      "bone ",     "weight ", "1 ",   "0 ",       "lod ",    "\n",
+    };
+    out.clear();
+    while (out.size() < size) {
+        for (const char c : kWords[rng.below(std::size(kWords))]) {
+            out.push_back(static_cast<std::byte>(c));
+        }
+        if (rng.below(4) == 0) {
+            out.push_back(static_cast<std::byte>(rng.next()));
+        }
+    }
+    out.resize(size);
+}
+
+[[nodiscard]] std::string entry_path(std::size_t index) {
+    char path[64];
+    std::snprintf(path, sizeof(path), "assets/group%04zu/item%08zu.bin", index % 1024, index);
+    return path;
+}
+
+[[nodiscard]] Dataset build_dataset(Report& report, const fs::path& dir, std::size_t count) {
+    Dataset dataset;
+    dataset.file = dir / ("dataset-" + std::to_string(count) + ".stk");
+    dataset.paths.reserve(count);
+
+    Rng rng(count);
+    ArchiveWriter writer;
+    std::vector<std::byte> payload;
+    for (std::size_t i = 0; i < count; ++i) {
+        dataset.paths.push_back(entry_path(i));
+        fill_payload(rng, payload, kMinPayload + rng.below(kMaxPayload - kMinPayload + 1));
+        dataset.payload_bytes += payload.size();
+        if (auto added = writer.add(dataset.paths.back(), payload); !added) {
+            die("add", added.error());
+        }
+    }
+    const auto start = Clock::now();
+    if (auto written = writer.write(dataset.file); !written) {
+        die("write", written.error());
+    }
+    const double seconds = seconds_since(start);
+    report.row("archive write", seconds * 1e3, "ms");
+    report.row("archive write throughput", static_cast<double>(dataset.payload_bytes) / kMiB / seconds, "MiB/s");
+    report.row("archive size", static_cast<double>(fs::file_size(dataset.file)) / kMiB, "MiB");
+    return dataset;
+}
+
+void bench_open(Report& report, const Dataset& dataset) {
+    constexpr int kRuns = 10;
+    std::vector<double> samples;
+    for (int run = 0; run < kRuns; ++run) {
+        const auto start = Clock::now();
+        auto archive = Archive::open(dataset.file);
+        samples.push_back(seconds_since(start));
+        if (!archive) {
+            die("open", archive.error());
+        }
+        do_not_optimize(archive->entry_count());
+    }
+    report.row("open (median of 10)", percentile(samples, 0.5) * 1e3, "ms");
+}
+
+void bench_lookup(Report& report, const Archive& archive, const Dataset& dataset) {
+    // Single lookups are too short for the clock, so each sample is the mean
+    // over a small batch of random paths, and the percentiles are those of
+    // batch means: they hide the spread within a batch.
+    constexpr std::size_t kBatch = 16;
+    constexpr std::size_t kQueries = 1 << 20;
+    Rng rng(42);
+    std::vector<std::string_view> queries(kQueries);
+    for (auto& query : queries) {
+        query = dataset.paths[rng.below(dataset.paths.size())];
+    }
+
+    std::vector<double> samples;
+    samples.reserve(kQueries / kBatch);
+    std::size_t found = 0;
+    const auto total_start = Clock::now();
+    for (std::size_t i = 0; i < kQueries; i += kBatch) {
+        const auto start = Clock::now();
+        for (std::size_t j = i; j < i + kBatch; ++j) {
+            found += archive.find(queries[j]).has_value();
+        }
+        samples.push_back(seconds_since(start) / kBatch);
+    }
+    const double total = seconds_since(total_start);
+    if (found != kQueries) {
+        die("lookup", std::make_error_code(std::errc::no_such_file_or_directory));
+    }
+    report.row("lookup p50 (mean of 16)", percentile(samples, 0.50) * 1e9, "ns");
+    report.row("lookup p99 (mean of 16)", percentile(samples, 0.99) * 1e9, "ns");
+    report.row("lookup throughput", static_cast<double>(kQueries) / total / 1e6, "Mops/s");
+}
+
+void bench_directories(Report& report, const Archive& archive, const Dataset& dataset) {
+    // One of the dataset's 1024 directories, listed through the directory
+    // index and by filtering every path of the archive.
+    const std::string directory = dataset.paths[42].substr(0, dataset.paths[42].rfind('/') + 1);
+    const auto time = [&](std::string_view name, auto&& list) {
+        constexpr int kRuns = 5;
+        std::vector<double> samples;
+        std::size_t found = 0;
+        for (int run = 0; run < kRuns; ++run) {
+            found = 0;
+            const auto start = Clock::now();
+            list(found);
+            samples.push_back(seconds_since(start));
+        }
+        if (found == 0) {
+            die("list", std::make_error_code(std::errc::no_such_file_or_directory));
+        }
+        report.row(name, percentile(samples, 0.5) * 1e6, "us");
+    };
+    time("list one directory (glob)",
+         [&](std::size_t& found) { archive.glob(directory + "*", [&](EntryId) { ++found; }); });
+    time("list one directory (scan)", [&](std::size_t& found) {
+        std::string path;
+        for (EntryId id = 0; id < archive.entry_count(); ++id) {
+            path.clear();
+            archive.append_path(id, path);
+            found += path.starts_with(directory);
+        }
+    });
+}
+
+void bench_reads(Report& report, const Archive& archive) {
+    const auto count = archive.entry_count();
+    std::vector<EntryId> order(count);
+    std::iota(order.begin(), order.end(), EntryId{0});
+    std::vector<std::byte> buffer(kMaxPayload);
+
+    const auto run = [&](std::string_view name) {
+        std::uint64_t bytes = 0;
+        const auto start = Clock::now();
+        for (const EntryId id : order) {
+            const auto size = archive.size(id);
+            if (auto read = archive.read(id, std::span(buffer).first(size)); !read) {
+                die("read", read.error());
+            }
+            do_not_optimize(buffer.data());
+            bytes += size;
+        }
+        const double seconds = seconds_since(start);
+        report.row(name, static_cast<double>(bytes) / kMiB / seconds, "MiB/s");
+    };
+
+    run("sequential read");
+    Rng rng(7);
+    for (std::size_t i = count; i > 1; --i) {
+        std::swap(order[i - 1], order[rng.below(i)]);
+    }
+    run("random read");
+}
+
+void bench_handles(Report& report, const Dataset& dataset) {
+    // The same random entries, found by path through an ArchiveSet and
+    // through handles resolved from those paths up front.
+    constexpr std::size_t kQueries = 1 << 20;
+    ArchiveSet set;
+    if (auto mounted = set.mount(dataset.file); !mounted) {
+        die("mount", mounted.error());
+    }
+    HandleTable handles(set);
+    std::vector<Handle<>> resolved(dataset.paths.size());
+    const auto resolve_start = Clock::now();
+    for (std::size_t i = 0; i < resolved.size(); ++i) {
+        const auto handle = handles.resolve(dataset.paths[i]);
+        if (!handle) {
+            die("resolve", std::make_error_code(std::errc::no_such_file_or_directory));
+        }
+        resolved[i] = *handle;
+    }
+    report.row("handle resolve", seconds_since(resolve_start) / static_cast<double>(resolved.size()) * 1e9, "ns");
+
+    Rng rng(11);
+    std::vector<std::size_t> queries(kQueries);
+    for (auto& query : queries) {
+        query = rng.below(dataset.paths.size());
+    }
+    const auto run = [&](std::string_view name, auto&& find) {
+        std::uint64_t bytes = 0;
+        const auto start = Clock::now();
+        for (const std::size_t query : queries) {
+            const auto ref = find(query);
+            if (!ref) {
+                die("lookup", std::make_error_code(std::errc::no_such_file_or_directory));
+            }
+            bytes += set.size(*ref);
+        }
+        const double seconds = seconds_since(start);
+        do_not_optimize(bytes);
+        report.row(name, seconds / static_cast<double>(kQueries) * 1e9, "ns");
+    };
+    run("find by path + size", [&](std::size_t i) { return set.find(dataset.paths[i]); });
+    run("get by handle + size", [&](std::size_t i) { return handles.get(resolved[i]); });
+}
+
+void bench_vfs(Report& report, const Dataset& dataset) {
+    // Lookups of the same random paths with the dataset mounted alone and
+    // under 15 more layers, some of them overriding its paths.
+    constexpr std::size_t kQueries = 1 << 20;
+    constexpr int kLayers = 15;
+    Rng rng(13);
+    std::vector<std::string_view> queries(kQueries);
+    for (auto& query : queries) {
+        query = dataset.paths[rng.below(dataset.paths.size())];
+    }
+    Vfs vfs;
+    if (auto mounted = vfs.mount(dataset.file); !mounted) {
+        die("mount", mounted.error());
+    }
+    const auto run = [&](const std::string& name) {
+        std::uint64_t bytes = 0;
+        const auto start = Clock::now();
+        for (const auto query : queries) {
+            const auto ref = vfs.find(query);
+            if (!ref) {
+                die("lookup", std::make_error_code(std::errc::no_such_file_or_directory));
+            }
+            bytes += vfs.size(*ref);
+        }
+        const double seconds = seconds_since(start);
+        do_not_optimize(bytes);
+        report.row(name, seconds / static_cast<double>(kQueries) * 1e9, "ns");
+    };
+    run("vfs find + size, 1 layer");
+    for (int layer = 0; layer < kLayers; ++layer) {
+        std::vector<MemoryFile> files;
+        for (std::size_t i = 0; i < 64; ++i) {
+            const bool overrides = layer % 2 == 0;
+            files.push_back({overrides ? dataset.paths[rng.below(dataset.paths.size())]
+                                       : "generated/layer" + std::to_string(layer) + "/" + std::to_string(i),
+                             std::vector<std::byte>(16)});
+        }
+        std::ranges::sort(files, {}, &MemoryFile::path);
+        files.erase(std::ranges::unique(files, {}, &MemoryFile::path).begin(), files.end());
+        if (auto mounted = vfs.mount_memory(std::move(files), {"", layer + 1}); !mounted) {
+            die("mount", mounted.error());
+        }
+    }
+    run("vfs find + size, " + std::to_string(kLayers + 1) + " layers");
+}
+
+void bench_concurrent(Report& report, const Dataset& dataset) {
+    // Each thread looks up random paths through an ArchiveSet and reads the
+    // entries with positional reads; nothing is shared but the set itself.
+    constexpr std::size_t kOpsPerThread = 1 << 18;
+    ArchiveSet set;
+    if (auto mounted = set.mount(dataset.file); !mounted) {
+        die("mount", mounted.error());
+    }
+    for (const std::size_t threads : {1, 2, 4, 8}) {
+        std::latch ready(static_cast<std::ptrdiff_t>(threads) + 1);
+        std::vector<std::jthread> workers;
+        for (std::size_t t = 0; t < threads; ++t) {
+            workers.emplace_back([&, t] {
+                Rng rng(t + 1);
+                std::vector<std::byte> buffer(kMaxPayload);
+                ready.arrive_and_wait();
+                for (std::size_t i = 0; i < kOpsPerThread; ++i) {
+                    const auto ref = set.find(dataset.paths[rng.below(dataset.paths.size())]);
+                    if (!ref) {
+                        die("lookup", std::make_error_code(std::errc::no_such_file_or_directory));
+                    }
+                    if (auto read = set.read_direct(*ref, std::span(buffer).first(set.size(*ref))); !read) {
+                        die("read", read.error());
+                    }
+                    do_not_optimize(buffer.data());
+                }
+            });
+        }
+        ready.arrive_and_wait();
+        const auto start = Clock::now();
+        workers.clear();
+        const double seconds = seconds_since(start);
+        report.row("lookup+pread, " + std::to_string(threads) + " threads",
+                   static_cast<double>(threads * kOpsPerThread) / seconds / 1e6, "Mops/s");
+    }
+}
+
+void bench_hashing(Report& report) {
+    constexpr std::array<std::size_t, 2> kSizes{16, 1 << 20};
+    constexpr std::size_t kBytesPerRun = 256 << 20;
+    constexpr std::array<std::string_view, 4> kLevelNames{"scalar", "sse4.2", "avx2", "avx-512"};
+    Rng rng(2);
+    std::vector<std::byte> input;
+    fill_payload(rng, input, kSizes.back());
+
+    const SimdLevel best = simd_level();
+    for (const std::size_t size : kSizes) {
+        const auto data = std::span<const std::byte>(input).first(size);
+        const std::size_t runs = kBytesPerRun / size;
+        const auto per_byte = [&](auto&& kernel) {
+            const auto start = Clock::now();
+            for (std::size_t i = 0; i < runs; ++i) {
+                do_not_optimize(kernel());
+            }
+            return seconds_since(start) * 1e12 / static_cast<double>(kBytesPerRun);
+        };
+        const std::string suffix = size < 1024 ? " 16 B" : " 1 MiB";
+
+        // Every level must agree with the scalar code bit for bit.
+        set_simd_level(SimdLevel::scalar);
+        const auto expected_hash64 = hash64(data);
+        const auto expected_hash128 = hash128(data);
+        const auto expected_crc = crc32c(data);
+        for (auto index = std::size_t{0}; index <= std::to_underlying(best); ++index) {
+            const auto level = static_cast<SimdLevel>(index);
+            set_simd_level(level);
+            if (hash64(data) != expected_hash64 || hash128(data) != expected_hash128 || crc32c(data) != expected_crc) {
+                die("hash", make_error_code(Errc::checksum_mismatch));
+            }
+            const std::string name(kLevelNames[index]);
+            report.row("hash64" + suffix + " (" + name + ")", per_byte([&] { return hash64(data); }), "ps/byte");
+            report.row("hash128" + suffix + " (" + name + ")", per_byte([&] { return hash128(data).low; }), "ps/byte");
+            report.row("crc32c" + suffix + " (" + name + ")", per_byte([&] { return crc32c(data); }), "ps/byte");
+        }
+    }
+    set_simd_level(best);
+}
+
+void bench_large_entry(Report& report, const fs::path& dir) {
+    // A consumer checksums a 256 MiB LZ4 entry, first reading it whole and
+    // then through a ChunkReader, which overlaps reading with the checksum
+    // and never holds more than its ring of chunks.
+    constexpr std::size_t kTotal = 256 << 20;
+    const ChunkReaderOptions options{1 << 20, 4};
+    Rng rng(17);
+    std::vector<std::byte> input;
+    fill_payload(rng, input, kTotal);
+    const auto file = dir / "large.stk";
+    ArchiveWriter writer;
+    if (auto added = writer.add("world/tile.bin", input, {Codec::lz4}); !added) {
+        die("add", added.error());
+    }
+    if (auto written = writer.write(file); !written) {
+        die("write", written.error());
+    }
+    auto archive = Archive::open(file);
+    if (!archive) {
+        die("open", archive.error());
+    }
+    const std::uint32_t expected = crc32c(input);
+    input = {};
+
+    auto start = Clock::now();
+    std::vector<std::byte> whole(kTotal);
+    if (auto read = archive->read_direct(0, whole); !read) {
+        die("read", read.error());
+    }
+    const double whole_first = seconds_since(start);
+    if (crc32c(whole) != expected) {
+        die("read", make_error_code(Errc::corrupt_archive));
+    }
+    const double whole_seconds = seconds_since(start);
+    whole = {};
+
+    start = Clock::now();
+    auto reader = ChunkReader::open(*archive, 0, options);
+    if (!reader) {
+        die("open chunks", reader.error());
+    }
+    double chunked_first = 0;
+    std::uint32_t crc = 0;
+    for (;;) {
+        auto chunk = reader->next();
+        if (!chunk) {
+            die("read chunk", chunk.error());
+        }
+        if (!*chunk) {
+            break;
+        }
+        if ((*chunk)->offset == 0) {
+            chunked_first = seconds_since(start);
+        }
+        crc = crc32c((*chunk)->data, crc);
+    }
+    const double chunked_seconds = seconds_since(start);
+    if (crc != expected) {
+        die("read chunk", make_error_code(Errc::corrupt_archive));
+    }
+
+    report.row("whole read: first byte", whole_first * 1e3, "ms");
+    report.row("whole read + crc32c", kTotal / kMiB / whole_seconds, "MiB/s");
+    report.row("whole read buffer", kTotal / kMiB, "MiB");
+    report.row("chunked read: first chunk", chunked_first * 1e3, "ms");
+    report.row("chunked read + crc32c", kTotal / kMiB / chunked_seconds, "MiB/s");
+    report.row("chunked read buffer", static_cast<double>(options.chunk_size * options.depth) / kMiB, "MiB");
+    std::error_code error;
+    fs::remove(file, error);
+}
+
+void bench_tables(Report& report) {
+    constexpr std::size_t kRows = 100'000;
+    constexpr std::size_t kPasses = 50;
+    constexpr std::array<std::string_view, 8> kSlots{"head", "chest", "hands", "legs", "feet", "ring", "neck", "weapon"};
+    Rng rng(3);
+    std::vector<game::Item> rows(kRows);
+    for (std::size_t i = 0; i < kRows; ++i) {
+        auto& row = rows[i];
+        row.id = static_cast<std::uint32_t>(i);
+        row.name = "item_" + std::to_string(i);
+        row.slot = kSlots[rng.below(kSlots.size())];
+        row.damage = static_cast<float>(rng.below(1000)) / 10.0f;
+        row.weight = static_cast<float>(rng.below(100));
+        row.level = static_cast<std::int32_t>(rng.below(60));
+        row.description = "A fine item of level " + std::to_string(row.level) + ", fit for a hero.";
+    }
+
+    Arena arena;
+    SaveWriter writer(arena);
+    if (auto encoded = encode_table(writer, std::span<const game::Item>(rows)); !encoded) {
+        die("encode table", encoded.error());
+    }
+    auto table = TableView<game::Item>::open(writer.bytes());
+    if (!table) {
+        die("open table", table.error());
+    }
+    report.row("table size", static_cast<double>(writer.size()) / kMiB, "MiB");
+
+    const auto per_row = [&](auto&& scan) {
+        const auto start = Clock::now();
+        for (std::size_t pass = 0; pass < kPasses; ++pass) {
+            do_not_optimize(scan());
+        }
+        return seconds_since(start) * 1e9 / static_cast<double>(kRows * kPasses);
+    };
+
+    report.row("sum damage, row structs", per_row([&] {
+                   float total = 0;
+                   for (const auto& row : rows) {
+                       total += row.damage;
+                   }
+                   return total;
+               }),
+               "ns/row");
+    report.row("sum damage, column", per_row([&] {
+                   float total = 0;
+                   for (const float damage : table->column<&game::Item::damage>()) {
+                       total += damage;
+                   }
+                   return total;
+               }),
+               "ns/row");
+    report.row("count slot == weapon, row structs", per_row([&] {
+                   std::size_t count = 0;
+                   for (const auto& row : rows) {
+                       count += row.slot == "weapon";
+                   }
+                   return count;
+               }),
+               "ns/row");
+    report.row("count slot == weapon, column", per_row([&] {
+                   const auto slots = table->column<&game::Item::slot>();
+                   const std::uint32_t weapon = slots.find("weapon").value_or(~0u);
+                   std::size_t count = 0;
+                   for (const std::uint32_t code : slots.codes()) {
+                       count += code == weapon;
+                   }
+                   return count;
+               }),
+               "ns/row");
+
+    // Point and range queries, per query rather than per row.
+    constexpr std::size_t kQueries = 100'000;
+    std::vector<std::uint32_t> ids(kQueries);
+    for (auto& id : ids) {
+        id = static_cast<std::uint32_t>(rng.below(kRows));
+    }
+    auto start = Clock::now();
+    std::size_t found = 0;
+    for (const std::uint32_t id : ids) {
+        found += table->equal<&game::Item::id>(id).size();
+    }
+    report.row("find id, hash index", seconds_since(start) * 1e9 / kQueries, "ns/query");
+    if (found != kQueries) {
+        die("hash index", make_error_code(Errc::corrupt_archive));
+    }
+    start = Clock::now();
+    for (std::size_t i = 0; i < 100; ++i) {
+        const auto ids_column = table->column<&game::Item::id>();
+        do_not_optimize(std::ranges::find(ids_column, ids[i]) - ids_column.begin());
+    }
+    report.row("find id, column scan", seconds_since(start) * 1e9 / 100, "ns/query");
+
+    start = Clock::now();
+    std::size_t matched = 0;
+    for (std::size_t i = 0; i < kQueries; ++i) {
+        matched += table->at_least<&game::Item::level>(59).size();
+    }
+    report.row("level >= 59, sorted index", seconds_since(start) * 1e9 / kQueries, "ns/query");
+    start = Clock::now();
+    for (std::size_t i = 0; i < 100; ++i) {
+        const auto levels = table->column<&game::Item::level>();
+        do_not_optimize(std::ranges::count_if(levels, [](std::int32_t level) { return level >= 59; }));
+    }
+    report.row("level >= 59, column scan", seconds_since(start) * 1e9 / 100, "ns/query");
+    do_not_optimize(matched);
+}
+
+void bench_compression(Report& report) {
+    constexpr std::size_t kTotal = 64 << 20;
+    constexpr std::size_t kBlock = 64 << 10;
+    Rng rng(1);
+    std::vector<std::byte> input;
+    fill_payload(rng, input, kTotal);
+    std::vector<std::byte> compressed(compress_bound(kBlock) * (kTotal / kBlock));
+    std::vector<std::size_t> sizes;
+
+    auto start = Clock::now();
+    std::size_t stored = 0;
+    for (std::size_t offset = 0; offset < kTotal; offset += kBlock) {
+        const auto dst = std::span(compressed).subspan(stored, compress_bound(kBlock));
+        const std::size_t size = compress(Codec::lz4, std::span(input).subspan(offset, kBlock), dst);
+        if (size == 0) {
+            die("compress", std::make_error_code(std::errc::no_buffer_space));
+        }
+        sizes.push_back(size);
+        stored += size;
+    }
+    const double compress_seconds = seconds_since(start);
+
+    std::vector<std::byte> output(kTotal);
+    start = Clock::now();
+    std::size_t read = 0;
+    for (std::size_t i = 0; i < sizes.size(); ++i) {
+        if (!decompress(Codec::lz4, std::span(compressed).subspan(read, sizes[i]),
+                        std::span(output).subspan(i * kBlock, kBlock))) {
+            die("decompress", make_error_code(Errc::corrupt_archive));
+        }
+        read += sizes[i];
+    }
+    const double decompress_seconds = seconds_since(start);
+    if (output != input) {
+        die("decompress", make_error_code(Errc::corrupt_archive));
+    }
+
+    report.row("lz4 ratio (64 KiB blocks)", static_cast<double>(kTotal) / static_cast<double>(stored), "x");
+    report.row("lz4 compress", kTotal / kMiB / compress_seconds, "MiB/s");
+    report.row("lz4 decompress", kTotal / kMiB / decompress_seconds, "MiB/s");
+}
+
+[[nodiscard]] std::vector<game::Entity> make_entities(std::size_t count) {
+    Rng rng(count * 31);
+    std::vector<game::Entity> entities(count);
+    for (std::size_t i = 0; i < count; ++i) {
+        auto& entity = entities[i];
+        entity.id = rng.next();
+        entity.name = "entity_" + std::to_string(i);
+        entity.transform.position = {static_cast<float>(rng.below(1000)), 1.0f, static_cast<float>(i)};
+        entity.transform.rotation = {0, 0, 0, 1};
+        entity.transform.scale = {1, 1, 1};
+        entity.tags.resize(rng.below(6));
+        for (auto& tag : entity.tags) {
+            tag = static_cast<std::uint32_t>(rng.next());
+        }
+        entity.health = static_cast<std::int32_t>(rng.below(100));
+        entity.active = rng.below(2) == 0;
+    }
+    return entities;
+}
+
+void bench_save(Report& report, std::size_t count) {
+    constexpr int kRuns = 3;
+    const auto entities = make_entities(count);
+    std::vector<game::Entity> decoded(count);
+    Arena arena;
+
+    const auto measure = [&](std::string_view name, auto&& encode_one, auto&& decode_one) {
+        double best_encode = 1e30;
+        double best_decode = 1e30;
+        std::size_t bytes = 0;
+        for (int run = 0; run < kRuns; ++run) {
+            arena.reset();
+            SaveWriter writer(arena);
+            auto start = Clock::now();
+            for (const auto& entity : entities) {
+                encode_one(writer, entity);
+            }
+            best_encode = std::min(best_encode, seconds_since(start));
+            bytes = writer.size();
+
+            SaveReader reader(writer.bytes());
+            start = Clock::now();
+            for (auto& entity : decoded) {
+                if (auto ok = decode_one(reader, entity); !ok) {
+                    die("decode", ok.error());
+                }
+            }
+            best_decode = std::min(best_decode, seconds_since(start));
+        }
+        report.row(std::string(name) + " encode", static_cast<double>(bytes) / kMiB / best_encode, "MiB/s");
+        report.row(std::string(name) + " decode", static_cast<double>(bytes) / kMiB / best_decode, "MiB/s");
+        report.row(std::string(name) + " size", static_cast<double>(bytes) / kMiB, "MiB");
+    };
+
+    measure(
+        "save", [](SaveWriter& writer, const game::Entity& entity) { encode(writer, entity); },
+        [](SaveReader& reader, game::Entity& entity) { return decode(reader, entity); });
+    measure(
+        "save records",
+        [](SaveWriter& writer, const game::Entity& entity) {
+            if (auto ok = encode_record(writer, entity); !ok) {
+                die("encode", ok.error());
+            }
+        },
+        [](SaveReader& reader, game::Entity& entity) { return decode_record(reader, entity); });
+}
+
+[[nodiscard]] Options parse_options(int argc, char** argv) {
+    Options options;
+    for (int i = 1; i < argc; ++i) {
+        const std::string_view arg = argv[i];
+        if ((arg == "--entries" || arg == "--dir") && i + 1 < argc) {
+            const std::string_view value = argv[++i];
+            if (arg == "--dir") {
+                options.dir = value;
+                continue;
+            }
+            options.entries.clear();
+            for (std::size_t begin = 0; begin <= value.size();) {
+                const std::size_t end = std::min(value.find(',', begin), value.size());
+                std::size_t count = 0;
+                const auto parsed = std::from_chars(value.data() + begin, value.data() + end, count);
+                if (parsed.ec != std::errc() || parsed.ptr != value.data() + end || count == 0) {
+                    std::fprintf(stderr, "stockpile-bench: bad entry count list\n");
+                    std::exit(2);
+                }
+                options.entries.push_back(count);
+                begin = end + 1;
+            }
+        } else {
+            std::fprintf(stderr, "usage: stockpile-bench [--entries N[,N...]] [--dir PATH]\n");
+            std::exit(arg == "--help" ? 0 : 2);
+        }
+    }
+    return options;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    Options options = parse_options(argc, argv);
+    const bool own_dir = options.dir.empty();
+    if (own_dir) {
+        options.dir = fs::temp_directory_path() / ("stockpile-bench-" + std::to_string(::getpid()));
+    }
+    std::error_code error;
+    fs::create_directories(options.dir, error);
+    if (error) {
+        die("create scratch directory", error);
+    }
+
+    Report report;
+    report.section("hashing");
+    bench_hashing(report);
+
+    report.section("compression");
+    bench_compression(report);
+
+    report.section("large entry: 256 MiB, LZ4, 64 KiB blocks");
+    bench_large_entry(report, options.dir);
+
+    report.section("tables: 100000 item rows");
+    bench_tables(report);
+
+    for (const std::size_t count : options.entries) {
+        report.section("dataset: " + std::to_string(count) + " entries, " + std::to_string(kMinPayload) + "-" +
+                       std::to_string(kMaxPayload) + " bytes each");
+        const Dataset dataset = build_dataset(report, options.dir, count);
+        bench_open(report, dataset);
+        auto archive = Archive::open(dataset.file);
+        if (!archive) {
+            die("open", archive.error());
+        }
+        bench_lookup(report, *archive, dataset);
+        bench_directories(report, *archive, dataset);
+        bench_reads(report, *archive);
+        bench_handles(report, dataset);
+        bench_vfs(report, dataset);
+        bench_concurrent(report, dataset);
+        bench_save(report, count);
+        fs::remove(dataset.file, error);
+    }
+
+    if (own_dir) {
+        fs::remove_all(options.dir, error);
+    }
+    return 0;
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include "stockpile/archive.hpp"
+#include "stockpile/error.hpp"
+
+#include <cstddef>
+#include <filesystem>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_set>
+#include <vector>
+
+namespace stockpile {
+
+/// The archive paths a session touched, in order of first access.
+///
+/// Attach one to an Archive or ArchiveSet with set_trace() to record every
+/// successful lookup, save() it at the end of the session, and pass it to
+/// ArchiveWriter::apply_trace() (or `stockpile-pack --trace`) so the next
+/// pack stores those entries contiguously in the order they are loaded.
+///
+/// Trace files are text: a "stockpile-trace 1" line followed by one path
+/// per line. They can be edited by hand, and loading several of them into
+/// one trace merges the sessions.
+class AccessTrace {
+public:
+    AccessTrace() = default;
+    AccessTrace(const AccessTrace&) = delete;
+    AccessTrace& operator=(const AccessTrace&) = delete;
+
+    /// Appends `path` unless it was recorded before. Thread-safe. Paths
+    /// containing a line break cannot be stored in a trace file and are
+    /// ignored, as are all records once memory runs out.
+    void record(std::string_view path) noexcept;
+    /// Records the path of an entry of `archive`.
+    void record(const Archive& archive, EntryId id) noexcept;
+
+    /// Number of distinct paths recorded.
+    [[nodiscard]] std::size_t size() const;
+
+    /// Recorded paths in first-access order.
+    [[nodiscard]] std::vector<std::string> paths() const;
+
+    void clear();
+
+    /// Records the paths of a trace file after the ones already recorded.
+    [[nodiscard]] Result<void> load(const std::filesystem::path& file);
+
+    [[nodiscard]] Result<void> save(const std::filesystem::path& file) const;
+
+private:
+    struct PathHash {
+        using is_transparent = void;
+        [[nodiscard]] std::size_t operator()(std::string_view path) const noexcept;
+    };
+
+    mutable std::mutex m_mutex;
+    std::unordered_set<std::string, PathHash, std::equal_to<>> m_seen;
+    /// Points into m_seen, whose nodes never move.
+    std::vector<const std::string*> m_order;
+};
+
+} // namespace stockpile
@@ -0,0 +1,215 @@
+#pragma once
+
+#include "stockpile/error.hpp"
+#include "stockpile/format.hpp"
+#include "stockpile/mapped_file.hpp"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <optional>
+#include <ranges>
+#include <span>
+#include <string>
+#include <string_view>
+
+namespace stockpile {
+
+class AccessTrace;
+class ThreadPool;
+
+/// Index of an entry within one archive, in [0, Archive::entry_count()).
+using EntryId = std::uint32_t;
+
+/// Index of a directory within one archive, in [0, Archive::directory_count()).
+using DirectoryId = std::uint32_t;
+inline constexpr DirectoryId kRootDirectory = 0;
+
+using EntryRange = std::ranges::iota_view<EntryId, EntryId>;
+using DirectoryRange = std::ranges::iota_view<DirectoryId, DirectoryId>;
+
+/// Read-only view of a stockpile archive.
+///
+/// The archive is memory-mapped and validated once in open(); afterwards
+/// every accessor is a bounds-free read of the mapping. Returned spans and
+/// string views point straight into the mapping and stay valid for as long
+/// as the Archive is alive.
+///
+/// Paths are stored as a tree of directories, and each distinct file or
+/// directory name is stored once, so the path data of an archive is a
+/// fraction of the size of its paths written out. name() and
+/// directory_name() are views of those interned names; path() puts a full
+/// path together.
+class Archive {
+public:
+    Archive() noexcept = default;
+    Archive(Archive&& other) noexcept;
+    Archive& operator=(Archive&& other) noexcept;
+
+    [[nodiscard]] static Result<Archive> open(const std::filesystem::path& path);
+
+    [[nodiscard]] std::size_t entry_count() const noexcept { return m_entries.size(); }
+
+    /// Looks up an entry by its archive path, e.g. "textures/rock.dds".
+    ///
+    /// Costs one hash_path() and a probe of the path index, which is nearly
+    /// always a single cache line. Entries are identified by their 64-bit
+    /// path hash alone (the writer rejects colliding paths), so the path
+    /// string itself is never compared.
+    [[nodiscard]] std::optional<EntryId> find(std::string_view path) const noexcept;
+
+    /// Same as find(), for callers that already hold hash_path(path).
+    [[nodiscard]] std::optional<EntryId> find_hash(std::uint64_t path_hash) const noexcept;
+
+    /// Full path of an entry. Allocates; in loops, prefer append_path() with
+    /// a reused string, or name() and directory().
+    [[nodiscard]] std::string path(EntryId id) const;
+    void append_path(EntryId id, std::string& out) const;
+
+    /// Whether the path of an entry is `path`, without building it.
+    [[nodiscard]] bool has_path(EntryId id, std::string_view path) const noexcept;
+
+    /// Last component of an entry's path, e.g. "rock.dds".
+    [[nodiscard]] std::string_view name(EntryId id) const noexcept {
+        const auto& entry = record(id);
+        return {m_names.data() + entry.name_offset, entry.name_length};
+    }
+
+    /// Directory holding an entry, e.g. "textures" for "textures/rock.dds".
+    [[nodiscard]] DirectoryId directory(EntryId id) const noexcept { return record(id).directory; }
+
+    /// Number of directories, counting the root and every directory that
+    /// holds entries or other directories.
+    [[nodiscard]] std::size_t directory_count() const noexcept { return m_directories.size(); }
+
+    /// Last component of a directory's path; empty for the root.
+    [[nodiscard]] std::string_view directory_name(DirectoryId directory) const noexcept {
+        const auto& record = m_directories[directory];
+        return {m_names.data() + record.name_offset, record.name_length};
+    }
+
+    /// Full path of a directory without a trailing '/'; empty for the root.
+    void append_directory_path(DirectoryId directory, std::string& out) const;
+
+    /// Parent of a directory, or nullopt for the root.
+    [[nodiscard]] std::optional<DirectoryId> parent(DirectoryId directory) const noexcept {
+        const auto parent = m_directories[directory].parent;
+        return parent == format::kNoDirectory ? std::nullopt : std::optional(parent);
+    }
+
+    /// Directories directly inside `directory`, in name order.
+    [[nodiscard]] DirectoryRange subdirectories(DirectoryId directory) const noexcept {
+        const auto& record = m_directories[directory];
+        return {record.first_child, record.first_child + record.child_count};
+    }
+
+    /// Entries directly inside `directory`, in name order.
+    [[nodiscard]] EntryRange entries(DirectoryId directory) const noexcept {
+        const auto& record = m_directories[directory];
+        return {record.first_entry, record.first_entry + record.entry_count};
+    }
+
+    /// Directory at `path`, e.g. "sounds/ambient", with or without a
+    /// trailing '/'; "" is the root. Costs a binary search of the
+    /// subdirectories of each directory on the way.
+    [[nodiscard]] std::optional<DirectoryId> find_directory(std::string_view path) const noexcept;
+
+    /// Calls `fn` for every entry in `directory` and the directories below
+    /// it: the directory's own entries first, then each subdirectory in name
+    /// order. Only that subtree is visited.
+    void walk(DirectoryId directory, const std::function<void(EntryId)>& fn) const;
+
+    /// Calls `fn` once for every entry whose path matches `pattern`, in the
+    /// order of walk(). Components of the pattern are separated by '/'.
+    /// Within one, '*' matches any run of characters and '?' any single
+    /// character; a whole component "**" matches any number of directories,
+    /// e.g. "sounds/**/*.ogg". Only directories the pattern can reach are
+    /// visited, and components without wildcards are found by binary search.
+    void glob(std::string_view pattern, const std::function<void(EntryId)>& fn) const;
+
+    /// Decoded size of an entry.
+    [[nodiscard]] std::uint64_t size(EntryId id) const noexcept { return record(id).raw_size; }
+
+    [[nodiscard]] Codec codec(EntryId id) const noexcept { return record(id).codec; }
+
+    /// Raw bytes per independently decodable block of a compressed entry
+    /// (see format::EntryRecord); 0 for an uncompressed one.
+    [[nodiscard]] std::uint64_t block_size(EntryId id) const noexcept {
+        return record(id).codec == Codec::none ? 0 : std::uint64_t{1} << record(id).block_shift;
+    }
+
+    /// True for entries written with ArchiveWriter::add_tombstone(). They are
+    /// empty, and only mean something when the archive is mounted as a patch
+    /// in an ArchiveSet.
+    [[nodiscard]] bool is_tombstone(EntryId id) const noexcept {
+        return (record(id).flags & format::kEntryTombstone) != 0;
+    }
+
+    /// Stored bytes of an entry, which are its contents unless it is
+    /// compressed. No copy is made: the first access to each page is served
+    /// by a page fault on the mapping.
+    [[nodiscard]] std::span<const std::byte> data(EntryId id) const noexcept;
+
+    /// Position of the stored bytes within the archive file, for callers
+    /// that read them with their own I/O instead of through the mapping.
+    [[nodiscard]] std::uint64_t offset(EntryId id) const noexcept { return record(id).offset; }
+
+    /// Decodes a whole entry into `out`, which must be exactly size(id)
+    /// bytes. With a pool, the blocks of a compressed entry are decoded in
+    /// parallel.
+    [[nodiscard]] Result<void> read(EntryId id, std::span<std::byte> out, ThreadPool* pool = nullptr) const;
+
+    /// Same as read(), but fetches the stored bytes with positional reads
+    /// (pread()) instead of through the mapping. Page faults on a shared
+    /// mapping serialize on the process's address-space lock once many
+    /// threads miss at the same time; positional reads do not, and share no
+    /// file offset, so this is the read to use from many job threads.
+    [[nodiscard]] Result<void> read_direct(EntryId id, std::span<std::byte> out, ThreadPool* pool = nullptr) const;
+
+    /// Same as read(), decoding from a copy of the entry's stored bytes
+    /// (`stored` must equal data(id) in content) rather than the mapping.
+    [[nodiscard]] Result<void> decode(EntryId id, std::span<const std::byte> stored, std::span<std::byte> out,
+                                      ThreadPool* pool = nullptr) const;
+
+    /// Decodes `out.size()` bytes starting at `offset` within an entry. Only
+    /// the blocks overlapping that range are decompressed.
+    [[nodiscard]] Result<void> read_range(EntryId id, std::uint64_t offset, std::span<std::byte> out) const;
+
+    /// Asks the kernel to start reading an entry into the page cache.
+    void prefetch(EntryId id) const noexcept;
+
+    [[nodiscard]] const MappedFile& file() const noexcept { return m_file; }
+
+    /// Number of this opening of an archive file, never given to another
+    /// Archive opened by the process, even after this one is destroyed;
+    /// moving the Archive carries it along. 0 for one that was not opened.
+    [[nodiscard]] std::uint64_t serial() const noexcept { return m_serial; }
+
+    /// Slots of the path index, for callers merging the indexes of several
+    /// archives: occupied slots hold an entry and hash_path() of its path,
+    /// empty ones format::kEmptySlot.
+    [[nodiscard]] std::span<const format::HashSlot> path_index() const noexcept { return m_slots; }
+
+    /// Records the path of every entry found by find() or find_hash() into
+    /// `trace` from now on; nullptr stops recording. The trace must outlive
+    /// the archive or be detached first. May be called while other threads
+    /// look entries up.
+    void set_trace(AccessTrace* trace) noexcept { m_trace.store(trace, std::memory_order_relaxed); }
+
+private:
+    [[nodiscard]] Result<void> load();
+    [[nodiscard]] Result<void> load_directories() const;
+    [[nodiscard]] const format::EntryRecord& record(EntryId id) const noexcept { return m_entries[id]; }
+
+    MappedFile m_file;
+    std::span<const format::EntryRecord> m_entries;
+    std::span<const char> m_names;
+    std::span<const format::DirectoryRecord> m_directories;
+    std::span<const format::HashSlot> m_slots;
+    std::atomic<AccessTrace*> m_trace = nullptr;
+    std::uint64_t m_serial = 0;
+};
+
+} // namespace stockpile
@@ -0,0 +1,184 @@
+#pragma once
+
+#include "stockpile/archive.hpp"
+#include "stockpile/error.hpp"
+#include "stockpile/merged_index.hpp"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace stockpile {
+
+/// An entry of an ArchiveSet: which mounted archive holds it, and its id there.
+struct EntryRef {
+    std::uint32_t archive;
+    EntryId entry;
+
+    friend bool operator==(const EntryRef&, const EntryRef&) = default;
+};
+
+/// A base archive with patch archives mounted over it.
+///
+/// Archives are mounted bottom to top. An entry in a later archive shadows
+/// the entry of the same path in earlier ones, and a tombstone (see
+/// ArchiveWriter::add_tombstone()) hides it, so a patch only has to carry
+/// what changed. Lookups go through a merged open-addressing index that
+/// mount() keeps up to date, so a lookup costs one probe, or two while
+/// patches are mounted, no matter how many. The index is in two parts: a
+/// base covering the lower archives, shared by successive tables, and an
+/// overlay covering those mounted since, probed first. Mounting a patch
+/// copies only the overlay; once the overlay grows past a quarter of the
+/// base, the next mount folds it into a new base. Unmounting an archive
+/// rebuilds the part of the index it is in.
+///
+/// Lookups and reads are lock-free and may run on any number of threads,
+/// also while another thread mounts. Each mount() builds a new immutable
+/// table of mounted archives and merged index and publishes it with one
+/// atomic store; readers only ever load that pointer, so they never write
+/// shared memory and scale with the number of threads. Tables replaced by
+/// a mount, and archives unmounted, stay allocated until reclaim(), so an
+/// EntryRef found before an unmount or replacement can still be read until
+/// then.
+class ArchiveSet {
+public:
+    ArchiveSet();
+    ArchiveSet(const ArchiveSet&) = delete;
+    ArchiveSet& operator=(const ArchiveSet&) = delete;
+    ~ArchiveSet();
+
+    /// Mounts `archive` above the ones already mounted and returns its
+    /// index. Fails with Errc::hash_collision, leaving the set unchanged, if
+    /// one of its paths has the same hash as a different path already
+    /// mounted; the same holds for replace(). Concurrent mounts, unmounts
+    /// and replacements are serialized.
+    [[nodiscard]] Result<std::uint32_t> mount(Archive archive);
+    [[nodiscard]] Result<std::uint32_t> mount(const std::filesystem::path& path);
+
+    /// Removes archive `index`, uncovering the entries it shadowed. Fails
+    /// with std::errc::invalid_argument if it is not mounted. find() no
+    /// longer returns its entries, but EntryRefs into it stay readable until
+    /// reclaim(). Other archives keep their indexes, and the index is never
+    /// reused.
+    [[nodiscard]] Result<void> unmount(std::uint32_t index);
+
+    /// Mounts `archive` on top and unmounts archive `index` in one step, so
+    /// that no lookup sees both or neither, and returns the new index. Meant
+    /// for a patch rebuilt over and over, such as the overlay of a
+    /// HotReloader: while it is above the base of the index, replacing it
+    /// rebuilds only the overlay, and the result is never folded into the
+    /// base.
+    [[nodiscard]] Result<std::uint32_t> replace(std::uint32_t index, Archive archive);
+
+    /// Frees the tables replaced by earlier mounts and the archives
+    /// unmounted since the last call; EntryRefs into those archives must not
+    /// be used afterwards. Call it only while no other thread is
+    /// inside a member function of the set, e.g. between frames.
+    void reclaim();
+
+    /// Archives mounted so far, bottom first, counting unmounted ones.
+    [[nodiscard]] std::size_t archive_count() const noexcept { return table().archives.size(); }
+    [[nodiscard]] bool is_mounted(std::uint32_t index) const noexcept {
+        const Table& current = table();
+        return index < current.archives.size() && !current.unmounted[index];
+    }
+    /// A mounted archive. Each stays alive until it is unmounted and
+    /// reclaim() is called, or the set is destroyed.
+    [[nodiscard]] const Archive& archive(std::uint32_t index) const noexcept { return *table().archives[index]; }
+
+    /// Number of visible paths.
+    [[nodiscard]] std::size_t entry_count() const noexcept { return table().visible; }
+
+    /// Finds the topmost entry for `path`, unless a tombstone above it hides it.
+    [[nodiscard]] std::optional<EntryRef> find(std::string_view path) const noexcept;
+
+    /// Same as find(), for callers that already hold hash_path(path).
+    [[nodiscard]] std::optional<EntryRef> find_hash(std::uint64_t path_hash) const noexcept;
+
+    /// Calls `fn` for every visible entry in the directory at `directory`
+    /// (see Archive::find_directory()) and below it, as Archive::walk() does
+    /// for each mounted archive. Every path is reported once, as the entry
+    /// find() returns for it; hidden and shadowed entries are skipped.
+    void walk(std::string_view directory, const std::function<void(EntryRef)>& fn) const;
+
+    /// Calls `fn` once for every visible entry whose path matches `pattern`,
+    /// as Archive::glob() does for each mounted archive.
+    void glob(std::string_view pattern, const std::function<void(EntryRef)>& fn) const;
+
+    [[nodiscard]] std::string path(EntryRef ref) const { return archive(ref.archive).path(ref.entry); }
+    [[nodiscard]] std::string_view name(EntryRef ref) const noexcept { return archive(ref.archive).name(ref.entry); }
+    [[nodiscard]] std::uint64_t size(EntryRef ref) const noexcept { return archive(ref.archive).size(ref.entry); }
+    [[nodiscard]] std::span<const std::byte> data(EntryRef ref) const noexcept {
+        return archive(ref.archive).data(ref.entry);
+    }
+    [[nodiscard]] Result<void> read(EntryRef ref, std::span<std::byte> out, ThreadPool* pool = nullptr) const {
+        return archive(ref.archive).read(ref.entry, out, pool);
+    }
+    /// See Archive::read_direct().
+    [[nodiscard]] Result<void> read_direct(EntryRef ref, std::span<std::byte> out, ThreadPool* pool = nullptr) const {
+        return archive(ref.archive).read_direct(ref.entry, out, pool);
+    }
+
+    /// Records the path of every entry found by find() or find_hash() into
+    /// `trace`, as Archive::set_trace() does; nullptr stops recording.
+    void set_trace(AccessTrace* trace) noexcept { m_trace.store(trace, std::memory_order_relaxed); }
+
+private:
+    /// Everything lookups read. Never modified once published.
+    struct Table {
+        /// Unmounted archives stay here, out of the index, until reclaim()
+        /// nulls them.
+        std::vector<std::shared_ptr<const Archive>> archives;
+        std::vector<bool> unmounted;
+        /// Merged index of the archives below `base_count`; never null.
+        std::shared_ptr<const detail::MergedIndex> base = std::make_shared<const detail::MergedIndex>();
+        std::uint32_t base_count = 0;
+        /// Paths visible through the base alone.
+        std::size_t base_visible = 0;
+        /// Merged index of the archives from `base_count` up. Its slots
+        /// shadow those of the base.
+        detail::MergedIndex overlay;
+        std::size_t visible = 0;
+    };
+
+    [[nodiscard]] const Table& table() const noexcept { return *m_table.load(std::memory_order_acquire); }
+    /// The slot deciding what `hash` finds, or null if no archive has it.
+    [[nodiscard]] static const detail::MergedIndex::Slot* lookup(const Table& table, std::uint64_t hash) noexcept {
+        return detail::lookup(table.overlay, *table.base, hash);
+    }
+    /// Adds the entries of archive `index` of `table` to `target`, which
+    /// shadows `below` (null if nothing is below it), and counts the paths
+    /// that become visible or hidden in `visible`. `path` is scratch space.
+    [[nodiscard]] static Result<void> insert(const Table& table, detail::MergedIndex& target,
+                                             const detail::MergedIndex* below, std::uint32_t index,
+                                             std::size_t& visible, std::string& path);
+    /// Rebuilds the overlay from the archives mounted from `base_count` up.
+    /// If `from` is below `base_count`, the base is first rebuilt from the
+    /// archives below `from`, which becomes the new `base_count`.
+    [[nodiscard]] static Result<void> rebuild(Table& table, std::uint32_t from);
+    /// Merges the overlay into a new base once it grows past a quarter of
+    /// the current one.
+    static void fold(Table& table);
+    void publish(std::unique_ptr<Table> next);
+    /// Whether entry `id` of archive `index` is the one find() returns for
+    /// its path. `path` is scratch space.
+    [[nodiscard]] static bool is_visible(const Table& table, std::uint32_t index, EntryId id, std::string& path);
+
+    std::atomic<const Table*> m_table;
+    std::atomic<AccessTrace*> m_trace = nullptr;
+    /// Guards m_tables and serializes mount(), unmount() and replace().
+    std::mutex m_mount_mutex;
+    /// The current table last, preceded by the ones it replaced.
+    std::vector<std::unique_ptr<const Table>> m_tables;
+};
+
+} // namespace stockpile
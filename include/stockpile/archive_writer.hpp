@@ -0,0 +1,83 @@
+#pragma once
+
+#include "stockpile/compression.hpp"
+#include "stockpile/error.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <span>
+#include <string>
+#include <string_view>
+#include <variant>
+#include <vector>
+
+namespace stockpile {
+
+class AccessTrace;
+class ThreadPool;
+
+/// How an entry is stored.
+struct EntryOptions {
+    Codec codec = Codec::none;
+    /// Raw bytes per independently decodable block; a power of two between
+    /// 4 KiB and 16 MiB. Smaller blocks give finer random access and more
+    /// parallelism, larger ones compress better.
+    std::uint32_t block_size = 64 * 1024;
+};
+
+/// Builds a stockpile archive.
+///
+/// Entries are collected in memory (or as references to files on disk, read
+/// when the archive is written) and serialized by write().
+class ArchiveWriter {
+public:
+    /// Adds an entry whose payload is copied into the writer.
+    [[nodiscard]] Result<void> add(std::string_view path, std::span<const std::byte> data,
+                                   const EntryOptions& options = {});
+
+    /// Adds an entry whose payload is read from `source` during write().
+    [[nodiscard]] Result<void> add_file(std::string_view path, const std::filesystem::path& source,
+                                        const EntryOptions& options = {});
+
+    /// Adds a tombstone marking `path` as deleted. When the archive is
+    /// mounted as a patch in an ArchiveSet, it hides the entries of that path
+    /// in the archives mounted below it.
+    [[nodiscard]] Result<void> add_tombstone(std::string_view path);
+
+    [[nodiscard]] std::size_t entry_count() const noexcept { return m_entries.size(); }
+
+    /// Moves the entries whose paths appear in `trace` to the front, in
+    /// first-access order, and keeps the order of the rest. Payloads are
+    /// stored in entry order, so loading the traced entries again becomes a
+    /// mostly sequential read. Traced paths without an entry are ignored.
+    void apply_trace(const AccessTrace& trace);
+
+    /// Writes the archive to `destination`, replacing any existing file.
+    /// Compressed entries that would not shrink are stored raw. Entries with
+    /// identical contents and options, recognized by hash128(), share one
+    /// stored copy.
+    ///
+    /// With a pool, entries are read, hashed and compressed on its workers
+    /// while the calling thread writes finished ones in order. The file is
+    /// byte-for-byte the same with or without a pool, whatever its size.
+    [[nodiscard]] Result<void> write(const std::filesystem::path& destination, ThreadPool* pool = nullptr) const;
+
+    /// Archive paths are relative, '/'-separated and contain no empty, "."
+    /// or ".." components.
+    [[nodiscard]] static bool is_valid_path(std::string_view path) noexcept;
+
+private:
+    struct PendingEntry {
+        std::string path;
+        std::variant<std::vector<std::byte>, std::filesystem::path> source;
+        EntryOptions options;
+        std::uint16_t flags = 0;
+    };
+
+    [[nodiscard]] Result<void> check_new_entry(std::string_view path, const EntryOptions& options) const;
+
+    std::vector<PendingEntry> m_entries;
+};
+
+} // namespace stockpile
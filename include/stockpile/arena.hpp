@@ -0,0 +1,73 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <span>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+namespace stockpile {
+
+/// Monotonic allocator handing out memory from a few large chunks.
+///
+/// Allocations are never freed individually; reset() releases everything at
+/// once and keeps the memory, so a workload repeated after a reset (such as
+/// writing the next save) runs without touching the heap. Chunks grow
+/// geometrically, so a workload of N bytes costs O(log N) heap allocations
+/// the first time. Not thread-safe.
+class Arena {
+public:
+    static constexpr std::size_t kDefaultChunkSize = 64 * 1024;
+
+    explicit Arena(std::size_t chunk_size = kDefaultChunkSize) noexcept;
+    /// Takes over `other`'s memory; `other` is left empty.
+    Arena(Arena&& other) noexcept;
+    Arena& operator=(Arena&& other) noexcept;
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+
+    /// Returns `size` bytes aligned to `alignment`, which must be a power of two.
+    [[nodiscard]] void* allocate(std::size_t size, std::size_t alignment = alignof(std::max_align_t));
+
+    /// Uninitialized storage for `count` objects of a trivial type.
+    template <typename T>
+        requires std::is_trivially_copyable_v<T> && std::is_trivially_destructible_v<T>
+    [[nodiscard]] std::span<T> allocate_array(std::size_t count) {
+        return {static_cast<T*>(allocate(count * sizeof(T), alignof(T))), count};
+    }
+
+    /// Copies `text` into the arena.
+    [[nodiscard]] std::string_view copy(std::string_view text);
+
+    /// Grows the most recent allocation from `old_size` to `new_size` bytes
+    /// without moving it. Returns false, changing nothing, if `block` is not
+    /// the most recent allocation or its chunk has no room.
+    [[nodiscard]] bool try_extend(void* block, std::size_t old_size, std::size_t new_size) noexcept;
+
+    /// Releases every allocation. The memory is kept, merged into a single
+    /// chunk if it had grown to several.
+    void reset();
+
+    /// Bytes handed out since the last reset, including alignment padding.
+    [[nodiscard]] std::size_t used() const noexcept;
+    /// Bytes currently owned.
+    [[nodiscard]] std::size_t capacity() const noexcept;
+
+private:
+    struct Chunk {
+        std::unique_ptr<std::byte[]> data;
+        std::size_t size;
+    };
+
+    void add_chunk(std::size_t min_size);
+
+    std::vector<Chunk> m_chunks;
+    std::size_t m_chunk_size;
+    /// Bytes used in every chunk but the last.
+    std::size_t m_retired = 0;
+    std::byte* m_cursor = nullptr;
+    std::byte* m_end = nullptr;
+};
+
+} // namespace stockpile
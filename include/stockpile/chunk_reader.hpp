@@ -0,0 +1,90 @@
+#pragma once
+
+#include "stockpile/archive.hpp"
+#include "stockpile/error.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <span>
+
+namespace stockpile {
+
+class ArchiveSet;
+struct EntryRef;
+
+namespace detail {
+struct ChunkReaderState;
+} // namespace detail
+
+struct ChunkReaderOptions {
+    /// Decoded bytes per chunk. For compressed entries it is rounded down to
+    /// whole blocks, and up to one block, so that no block is decoded twice.
+    std::size_t chunk_size = 1 << 20;
+    /// Chunks decoded ahead of the consumer. The reader holds this many
+    /// chunks, plus the stored bytes of the one being read, however large the
+    /// entry is.
+    std::size_t depth = 4;
+};
+
+/// Decoded bytes of an entry starting at `offset`.
+struct Chunk {
+    std::uint64_t offset;
+    std::span<const std::byte> data;
+};
+
+/// Reads one entry front to back in fixed-size chunks, for entries too large
+/// to decode in one piece (world tiles, audio banks).
+///
+/// A background thread reads each chunk's stored bytes with positional reads
+/// and decodes them into a ring of `depth` buffers, while the consumer works
+/// on the chunks before it. When the ring is full the thread waits for the
+/// consumer to hand a buffer back, so memory stays bounded by the options
+/// rather than the entry's size, and the first chunk is available after one
+/// chunk has been read instead of the whole entry.
+///
+/// A reader is used by one consumer thread at a time. The archive must
+/// outlive it.
+class ChunkReader {
+public:
+    /// Starts reading entry `id` of `archive`. Fails with
+    /// std::errc::invalid_argument if the chunk size or depth is 0, and with
+    /// Errc::corrupt_archive if the entry's block table does not fit it.
+    [[nodiscard]] static Result<ChunkReader> open(const Archive& archive, EntryId id,
+                                                  const ChunkReaderOptions& options = {});
+    [[nodiscard]] static Result<ChunkReader> open(const ArchiveSet& set, EntryRef ref,
+                                                  const ChunkReaderOptions& options = {});
+
+    ChunkReader(ChunkReader&&) noexcept;
+    ChunkReader& operator=(ChunkReader&&) noexcept;
+    /// Stops the background thread; chunks not yet consumed are dropped.
+    ~ChunkReader();
+
+    /// Waits for the next chunk, in entry order, and returns it. Its bytes
+    /// stay valid until the next call to next() or read(), which hands its
+    /// buffer back to the reader. Returns nullopt after the last chunk, and
+    /// the error of a read or decode that failed once the chunks before it
+    /// have been returned.
+    [[nodiscard]] Result<std::optional<Chunk>> next();
+
+    /// Copies the next `out.size()` bytes into `out`, across chunk
+    /// boundaries, for parsers that need a header or record in one piece.
+    /// Returns the number of bytes copied, which is less than `out.size()`
+    /// only at the end of the entry. next() then continues after them, with
+    /// the rest of the chunk they ended in.
+    [[nodiscard]] Result<std::size_t> read(std::span<std::byte> out);
+
+    /// Decoded size of the entry.
+    [[nodiscard]] std::uint64_t size() const noexcept;
+
+    /// Decoded bytes per chunk; the last chunk may be shorter.
+    [[nodiscard]] std::size_t chunk_size() const noexcept;
+
+private:
+    explicit ChunkReader(std::unique_ptr<detail::ChunkReaderState> state) noexcept;
+
+    std::unique_ptr<detail::ChunkReaderState> m_state;
+};
+
+} // namespace stockpile
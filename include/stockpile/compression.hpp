@@ -0,0 +1,30 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+
+namespace stockpile {
+
+/// Compression applied to the blocks of an archive entry. Stored on disk.
+enum class Codec : std::uint8_t {
+    none = 0,
+    /// LZ4 block format (no frame), built in.
+    lz4 = 1,
+};
+
+/// Largest output compress() may produce for `size` input bytes.
+[[nodiscard]] constexpr std::size_t compress_bound(std::size_t size) noexcept {
+    return size + size / 255 + 16;
+}
+
+/// Compresses `src` into `dst`. Returns the compressed size, or 0 if the
+/// result does not fit in `dst` (callers then store the block raw).
+[[nodiscard]] std::size_t compress(Codec codec, std::span<const std::byte> src, std::span<std::byte> dst) noexcept;
+
+/// Decompresses `src` into exactly `dst.size()` bytes. Returns false if the
+/// input is malformed or does not decode to that size; never reads or writes
+/// out of bounds.
+[[nodiscard]] bool decompress(Codec codec, std::span<const std::byte> src, std::span<std::byte> dst) noexcept;
+
+} // namespace stockpile
@@ -0,0 +1,101 @@
+#pragma once
+
+#include "stockpile/archive.hpp"
+#include "stockpile/archive_set.hpp"
+#include "stockpile/error.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <utility>
+
+namespace stockpile {
+
+namespace detail {
+struct CacheShard;
+} // namespace detail
+
+/// Shared reference to the decoded contents of a cached entry. The bytes
+/// stay valid for as long as any handle to them is alive, even after the
+/// cache has evicted the entry.
+class CacheHandle {
+public:
+    CacheHandle() noexcept = default;
+
+    [[nodiscard]] explicit operator bool() const noexcept { return m_data != nullptr; }
+    [[nodiscard]] std::span<const std::byte> bytes() const noexcept { return {m_data.get(), m_size}; }
+    [[nodiscard]] const std::byte* data() const noexcept { return m_data.get(); }
+    [[nodiscard]] std::size_t size() const noexcept { return m_size; }
+
+private:
+    friend class EntryCache;
+
+    CacheHandle(std::shared_ptr<const std::byte[]> data, std::size_t size) noexcept
+        : m_data(std::move(data)), m_size(size) {}
+
+    std::shared_ptr<const std::byte[]> m_data;
+    std::size_t m_size = 0;
+};
+
+struct CacheStats {
+    std::uint64_t hits = 0;
+    std::uint64_t misses = 0;
+    std::uint64_t evictions = 0;
+    /// Entries and decoded bytes currently held.
+    std::size_t entries = 0;
+    std::size_t bytes = 0;
+};
+
+/// Thread-safe cache of decoded entries, bounded by a byte budget.
+///
+/// Meant for small compressed entries that are requested again and again
+/// (config tables, shader headers, localization), which would otherwise be
+/// decompressed on every request. Entries are spread over independently
+/// locked shards by key, and each shard evicts with 2Q: a new entry first
+/// goes to a small FIFO, and only one requested again after falling out of
+/// it is promoted to the main LRU list, so a single pass over many entries
+/// cannot flush the ones in steady use.
+///
+/// Entries are keyed by Archive::serial() and their id, so they follow an
+/// archive that is moved, and an archive opened later, even at the address
+/// of a destroyed one, never finds them. Entries of a destroyed archive stay
+/// until evicted; erase() drops them sooner.
+class EntryCache {
+public:
+    /// `shards` is rounded up to a power of two; each gets an equal part of
+    /// the budget. Entries larger than that part are returned but not kept.
+    explicit EntryCache(std::size_t byte_budget, std::size_t shards = 16);
+    EntryCache(const EntryCache&) = delete;
+    EntryCache& operator=(const EntryCache&) = delete;
+    ~EntryCache();
+
+    /// Returns the decoded contents of an entry, decoding it on a miss (in
+    /// parallel blocks with a pool). Concurrent misses on the same entry may
+    /// each decode it; all but one result are then dropped.
+    [[nodiscard]] Result<CacheHandle> get(const Archive& archive, EntryId id, ThreadPool* pool = nullptr);
+    [[nodiscard]] Result<CacheHandle> get(const ArchiveSet& set, EntryRef ref, ThreadPool* pool = nullptr) {
+        return get(set.archive(ref.archive), ref.entry, pool);
+    }
+
+    /// Returns the entry if it is cached, without decoding it on a miss.
+    [[nodiscard]] CacheHandle find(const Archive& archive, EntryId id);
+
+    /// Drops every entry of `archive`, e.g. before an ArchiveSet reclaims it.
+    void erase(const Archive& archive);
+
+    /// Drops every entry and resets the counters.
+    void clear();
+
+    [[nodiscard]] CacheStats stats() const;
+    [[nodiscard]] std::size_t byte_budget() const noexcept { return m_budget; }
+
+private:
+    [[nodiscard]] detail::CacheShard& shard(std::uint64_t key_hash) const noexcept;
+
+    std::size_t m_budget;
+    std::size_t m_shard_count;
+    std::unique_ptr<detail::CacheShard[]> m_shards;
+};
+
+} // namespace stockpile
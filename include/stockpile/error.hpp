@@ -0,0 +1,48 @@
+#pragma once
+
+#include <cerrno>
+#include <expected>
+#include <system_error>
+#include <type_traits>
+
+namespace stockpile {
+
+/// Failures detected by stockpile itself. Operating system failures are
+/// reported through std::generic_category() with the original errno.
+enum class Errc {
+    bad_magic = 1,
+    unsupported_version,
+    corrupt_archive,
+    invalid_path,
+    duplicate_path,
+    too_large,
+    hash_collision,
+    malformed_data,
+    missing_field,
+    checksum_mismatch,
+};
+
+[[nodiscard]] const std::error_category& error_category() noexcept;
+
+[[nodiscard]] inline std::error_code make_error_code(Errc e) noexcept {
+    return {static_cast<int>(e), error_category()};
+}
+
+/// Return type of every fallible stockpile operation.
+template <typename T>
+using Result = std::expected<T, std::error_code>;
+
+/// Shorthand for returning an error from a function producing Result<T>.
+[[nodiscard]] inline std::unexpected<std::error_code> fail(Errc e) noexcept {
+    return std::unexpected(make_error_code(e));
+}
+
+/// Shorthand for returning the current errno from a function producing Result<T>.
+[[nodiscard]] inline std::unexpected<std::error_code> fail_errno(int err = errno) noexcept {
+    return std::unexpected(std::error_code(err, std::generic_category()));
+}
+
+} // namespace stockpile
+
+template <>
+struct std::is_error_code_enum<stockpile::Errc> : std::true_type {};
@@ -0,0 +1,215 @@
+#pragma once
+
+#include "stockpile/compression.hpp"
+
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <type_traits>
+
+/// On-disk layout of stockpile archives.
+///
+/// Every structure here is read in place from the memory mapping, so they are
+/// fixed-size, naturally aligned and stored little-endian. An archive is laid
+/// out as:
+///
+///     Header | payloads... | sections... | section table
+///
+/// Payloads and sections start on kAlignment boundaries; the path index
+/// starts on a cache line.
+namespace stockpile::format {
+
+static_assert(std::endian::native == std::endian::little,
+              "stockpile archives are read in place and assume a little-endian host");
+
+inline constexpr std::array<char, 8> kMagic = {'S', 'T', 'K', 'P', 'I', 'L', 'E', '\x1a'};
+inline constexpr std::uint32_t kVersion = 5;
+inline constexpr std::uint64_t kAlignment = 16;
+inline constexpr std::uint64_t kCacheLine = 64;
+
+enum class SectionKind : std::uint32_t {
+    /// EntryRecord[entry_count], sorted by directory, then by name.
+    entries = 1,
+    /// Every distinct path component (file or directory name) once,
+    /// concatenated; referenced by EntryRecord and DirectoryRecord.
+    names = 2,
+    /// HashSlot[power of two], an open-addressing table keyed by hash_path().
+    path_index = 3,
+    /// DirectoryRecord[directory_count], the root first.
+    directories = 4,
+};
+
+struct Header {
+    std::array<char, 8> magic;
+    std::uint32_t version;
+    std::uint32_t section_count;
+    std::uint64_t file_size;
+    std::uint64_t section_table_offset;
+    std::uint64_t reserved[4];
+};
+
+struct Section {
+    SectionKind kind;
+    std::uint32_t reserved;
+    std::uint64_t offset;
+    std::uint64_t size;
+};
+
+/// Compressed entries are split into blocks of `1 << block_shift` raw bytes
+/// (the last one may be shorter) that decode independently. Their stored
+/// bytes start with `std::uint64_t block_end[block_count]`, the end of each
+/// block relative to the end of that table. A block whose stored size equals
+/// its raw size is kept uncompressed.
+///
+/// `flags` is a set of kEntry* bits.
+struct EntryRecord {
+    std::uint64_t offset;
+    std::uint64_t size;
+    std::uint64_t raw_size;
+    /// Last component of the path, in the names section.
+    std::uint32_t name_offset;
+    std::uint32_t name_length;
+    Codec codec;
+    std::uint8_t block_shift;
+    std::uint16_t flags;
+    /// DirectoryRecord holding the entry; the rest of its path.
+    std::uint32_t directory;
+};
+
+/// The entry has no contents and marks its path as deleted: mounted as a
+/// patch, the archive hides entries of that path in the archives below it.
+inline constexpr std::uint16_t kEntryTombstone = 1 << 0;
+inline constexpr std::uint16_t kKnownEntryFlags = kEntryTombstone;
+
+inline constexpr std::uint8_t kMinBlockShift = 12;
+inline constexpr std::uint8_t kMaxBlockShift = 24;
+
+[[nodiscard]] constexpr std::uint64_t block_count(const EntryRecord& entry) noexcept {
+    if (entry.codec == Codec::none) {
+        return 0;
+    }
+    const std::uint64_t block_size = std::uint64_t{1} << entry.block_shift;
+    return (entry.raw_size + block_size - 1) >> entry.block_shift;
+}
+
+/// Entry paths form a tree of directories, numbered breadth-first from the
+/// root (index 0, with an empty name) with the children of each directory in
+/// name order. The subdirectories of a directory, and its entries, are
+/// therefore contiguous ranges of their tables.
+struct DirectoryRecord {
+    /// kNoDirectory for the root; otherwise lower than the directory's index.
+    std::uint32_t parent;
+    std::uint32_t name_offset;
+    std::uint32_t name_length;
+    std::uint32_t first_child;
+    std::uint32_t child_count;
+    std::uint32_t first_entry;
+    std::uint32_t entry_count;
+    std::uint32_t reserved;
+};
+
+inline constexpr std::uint32_t kNoDirectory = 0xFFFFFFFF;
+
+/// One slot of the path index. A lookup starts at `hash & (slot_count - 1)`
+/// and probes linearly until it finds the hash or an empty slot; the table is
+/// kept at most half full so that is almost always the first cache line.
+struct HashSlot {
+    std::uint64_t hash;
+    std::uint32_t entry;
+    std::uint32_t reserved;
+};
+
+inline constexpr std::uint32_t kEmptySlot = 0xFFFFFFFF;
+
+static_assert(sizeof(Header) == 64 && std::is_trivially_copyable_v<Header>);
+static_assert(sizeof(Section) == 24 && std::is_trivially_copyable_v<Section>);
+static_assert(sizeof(EntryRecord) == 40 && std::is_trivially_copyable_v<EntryRecord>);
+static_assert(sizeof(DirectoryRecord) == 32 && std::is_trivially_copyable_v<DirectoryRecord>);
+static_assert(sizeof(HashSlot) == 16 && kCacheLine % sizeof(HashSlot) == 0);
+
+/// Columnar tables (see table.hpp) are stored as the contents of an entry:
+///
+///     TableHeader | ColumnHeader[column_count] | IndexHeader[index_count] |
+///     column and index data...
+///
+/// Each column's data starts on a kAlignment boundary from the start of the
+/// table, so an uncompressed entry can be read in place from the mapping.
+inline constexpr std::uint32_t kTableMagic = 0x42545053; // "SPTB"
+inline constexpr std::uint32_t kTableVersion = 2;
+
+struct TableHeader {
+    std::uint32_t magic;
+    std::uint32_t version;
+    /// STOCKPILE_SCHEMA_VERSION of the row type the table was built from.
+    std::uint32_t schema_version;
+    std::uint32_t column_count;
+    std::uint32_t index_count;
+    std::uint32_t reserved;
+    std::uint64_t row_count;
+    std::uint64_t size;
+};
+
+enum class ColumnKind : std::uint8_t {
+    signed_int = 1,
+    unsigned_int = 2,
+    floating = 3,
+    /// One byte per row, 0 or 1.
+    boolean = 4,
+    /// std::uint32_t codes into a sorted dictionary of distinct strings.
+    string = 5,
+    /// Any other flat type (see is_flat_v), stored as its bytes.
+    flat = 6,
+};
+
+/// `data_offset` and `dictionary_offset` count from the start of the table.
+/// A string dictionary is `std::uint32_t end[dictionary_count]`, the end of
+/// each string within the characters that follow it.
+struct ColumnHeader {
+    std::uint32_t key;
+    ColumnKind kind;
+    std::uint8_t reserved[3];
+    std::uint32_t element_size;
+    std::uint32_t dictionary_count;
+    std::uint64_t data_offset;
+    std::uint64_t dictionary_offset;
+};
+
+enum class IndexKind : std::uint8_t {
+    /// IndexSlot[slot_count] at data_offset, a power of two kept at most half
+    /// full, keyed by hash64() of a column value's bytes (a string's code).
+    /// Each distinct value has one slot naming its rows in `rows`.
+    hash = 1,
+    /// The column's values in ascending order at data_offset, `rows` giving
+    /// the row each came from. Equal values keep row order.
+    sorted = 2,
+};
+
+/// Secondary index over column `column`. `rows_offset` holds
+/// std::uint32_t[row_count]; both offsets count from the start of the table.
+struct IndexHeader {
+    std::uint32_t column;
+    IndexKind kind;
+    std::uint8_t reserved[3];
+    std::uint64_t slot_count;
+    std::uint64_t data_offset;
+    std::uint64_t rows_offset;
+};
+
+/// Rows `rows[begin, begin + count)` share one value; count 0 marks an
+/// empty slot.
+struct IndexSlot {
+    std::uint64_t hash;
+    std::uint32_t begin;
+    std::uint32_t count;
+};
+
+static_assert(sizeof(TableHeader) == 40 && std::is_trivially_copyable_v<TableHeader>);
+static_assert(sizeof(ColumnHeader) == 32 && std::is_trivially_copyable_v<ColumnHeader>);
+static_assert(sizeof(IndexHeader) == 32 && std::is_trivially_copyable_v<IndexHeader>);
+static_assert(sizeof(IndexSlot) == 16 && kCacheLine % sizeof(IndexSlot) == 0);
+
+[[nodiscard]] constexpr std::uint64_t align_up(std::uint64_t value, std::uint64_t alignment = kAlignment) noexcept {
+    return (value + alignment - 1) & ~(alignment - 1);
+}
+
+} // namespace stockpile::format
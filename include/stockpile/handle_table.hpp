@@ -0,0 +1,144 @@
+#pragma once
+
+#include "stockpile/archive_set.hpp"
+#include "stockpile/hash.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace stockpile {
+
+/// Compact reference to an entry resolved by a HandleTable: a slot index and
+/// the generation the slot had when the handle was issued. `T` only tags the
+/// handle with the kind of asset it names, so that a Handle<Texture> cannot
+/// be passed where a Handle<Mesh> is expected. A default-constructed handle
+/// is null and never valid.
+template <typename T = void>
+struct Handle {
+    std::uint32_t index = 0;
+    std::uint32_t generation = 0;
+
+    [[nodiscard]] explicit operator bool() const noexcept { return generation != 0; }
+    friend bool operator==(const Handle&, const Handle&) = default;
+};
+
+namespace detail {
+
+/// Generation of a slot released at `generation`. Skips 0 on wrap-around,
+/// which would make null handles valid.
+[[nodiscard]] constexpr std::uint32_t next_generation(std::uint32_t generation) noexcept {
+    return generation == std::numeric_limits<std::uint32_t>::max() ? 1 : generation + 1;
+}
+
+} // namespace detail
+
+/// Resolves paths of an ArchiveSet once into Handles, so that code which
+/// holds on to assets passes eight bytes around instead of a path string and
+/// reaches the entry without hashing.
+///
+/// Handles index a dense array of slots holding the entry each one resolved
+/// to. Releasing a handle bumps its slot's generation before the slot is
+/// reused, so get() recognizes a stale handle by comparing two integers. A
+/// path resolves to the same handle until it is released.
+///
+/// resolve(), release() and refresh() modify the table and must not run
+/// concurrently with any other member function; the const ones may run on
+/// any number of threads at once, like those of a standard container.
+class HandleTable {
+public:
+    /// `set` must outlive the table.
+    explicit HandleTable(const ArchiveSet& set) noexcept : m_set(&set) {}
+
+    /// Handle for `path`, or nullopt if the set has no visible entry for it.
+    template <typename T = void>
+    [[nodiscard]] std::optional<Handle<T>> resolve(std::string_view path) {
+        return resolve_hash<T>(hash_path(path));
+    }
+    /// Same as resolve(), for callers that already hold hash_path(path).
+    template <typename T = void>
+    [[nodiscard]] std::optional<Handle<T>> resolve_hash(std::uint64_t path_hash) {
+        const auto slot = resolve_slot(path_hash);
+        if (!slot) {
+            return std::nullopt;
+        }
+        return Handle<T>{*slot, m_slots[*slot].generation};
+    }
+
+    /// Invalidates `handle` and every copy of it. Does nothing for a handle
+    /// that is already stale.
+    template <typename T>
+    void release(Handle<T> handle) noexcept {
+        if (valid(handle)) {
+            release_slot(handle.index);
+        }
+    }
+
+    /// Re-resolves every live handle after archives were mounted, unmounted
+    /// or replaced on the set (by a HotReloader, say), so that they name the
+    /// entries now visible for their paths. Handles whose paths are no
+    /// longer visible are released. Until then, handles keep naming the
+    /// entries they resolved to, which stay readable until the set's next
+    /// reclaim(); call refresh() before it.
+    void refresh();
+
+    [[nodiscard]] const ArchiveSet& set() const noexcept { return *m_set; }
+
+    /// Number of live handles.
+    [[nodiscard]] std::size_t size() const noexcept { return m_by_hash.size(); }
+
+    template <typename T>
+    [[nodiscard]] bool valid(Handle<T> handle) const noexcept {
+        // Slot generations start at 1, so a null handle never matches.
+        return handle.index < m_slots.size() && m_slots[handle.index].generation == handle.generation;
+    }
+
+    /// The entry `handle` names, or nullopt if it is stale.
+    template <typename T>
+    [[nodiscard]] std::optional<EntryRef> get(Handle<T> handle) const noexcept {
+        if (!valid(handle)) {
+            return std::nullopt;
+        }
+        return m_slots[handle.index].ref;
+    }
+
+    /// Mapped bytes of the entry `handle` names (see Archive::data()), or an
+    /// empty span if it is stale.
+    template <typename T>
+    [[nodiscard]] std::span<const std::byte> data(Handle<T> handle) const noexcept {
+        const auto ref = get(handle);
+        return ref ? m_set->data(*ref) : std::span<const std::byte>{};
+    }
+
+    /// Path of the entry `handle` names, or "" if it is stale.
+    template <typename T>
+    [[nodiscard]] std::string path(Handle<T> handle) const {
+        const auto ref = get(handle);
+        return ref ? m_set->path(*ref) : std::string{};
+    }
+
+private:
+    struct Slot {
+        EntryRef ref;
+        std::uint32_t generation = 1;
+        std::uint64_t path_hash = 0;
+    };
+
+    [[nodiscard]] std::optional<std::uint32_t> resolve_slot(std::uint64_t path_hash);
+    void release_slot(std::uint32_t index) noexcept;
+
+    const ArchiveSet* m_set;
+    std::vector<Slot> m_slots;
+    /// Released slots, reused most recent first.
+    std::vector<std::uint32_t> m_free;
+    /// Live slot of every resolved path.
+    std::unordered_map<std::uint64_t, std::uint32_t> m_by_hash;
+};
+
+} // namespace stockpile
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string_view>
+
+namespace stockpile {
+
+/// 64-bit non-cryptographic hash of a byte range.
+///
+/// The algorithm is part of the archive format (path hashes are stored in
+/// the table of contents), so its output must never change for a given
+/// input and seed. Inputs over 128 bytes run through SSE, AVX2 or AVX-512
+/// kernels picked at runtime; shorter ones, which covers most paths, take a
+/// few scalar multiplies that vectors would not speed up.
+[[nodiscard]] std::uint64_t hash64(std::span<const std::byte> data, std::uint64_t seed = 0) noexcept;
+
+/// 128-bit hash for content addressing, where 64 bits would leave a real
+/// chance of two different payloads colliding across millions of entries.
+struct Hash128 {
+    std::uint64_t low;
+    std::uint64_t high;
+
+    friend bool operator==(const Hash128&, const Hash128&) = default;
+};
+
+/// Same construction as hash64(); long inputs share one pass over the data
+/// and are merged twice with different keys.
+[[nodiscard]] Hash128 hash128(std::span<const std::byte> data, std::uint64_t seed = 0) noexcept;
+
+/// CRC-32C (Castagnoli) of a byte range, continuing from `crc`, the result
+/// for the bytes before it (0 to start). Detects every burst error of up to
+/// 32 bits, which hash64() does not promise, so it guards stored data. Uses
+/// the SSE4.2 crc32 instruction, three streams at a time, when the CPU has it.
+[[nodiscard]] std::uint32_t crc32c(std::span<const std::byte> data, std::uint32_t crc = 0) noexcept;
+
+/// Instruction sets the hashing and checksum kernels may use, in order.
+enum class SimdLevel : std::uint8_t {
+    scalar,
+    sse42,
+    avx2,
+    avx512,
+};
+
+/// Level in use: the best the CPU supports, unless lowered by set_simd_level().
+[[nodiscard]] SimdLevel simd_level() noexcept;
+
+/// Caps the kernels at `level`, clamped to what the CPU supports, and
+/// returns the level now in use. Every level gives bit-identical results;
+/// this exists to benchmark the levels against each other and cross-check
+/// them.
+SimdLevel set_simd_level(SimdLevel level) noexcept;
+
+/// Hash used to key archive entries by path.
+[[nodiscard]] inline std::uint64_t hash_path(std::string_view path) noexcept {
+    return hash64(std::as_bytes(std::span(path.data(), path.size())));
+}
+
+} // namespace stockpile
@@ -0,0 +1,92 @@
+#pragma once
+
+#include "stockpile/error.hpp"
+
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <system_error>
+
+namespace stockpile {
+
+class ArchiveSet;
+
+namespace detail {
+struct HotReloadState;
+} // namespace detail
+
+struct HotReloadOptions {
+    /// Prepended to a file's path relative to the watched directory to form
+    /// its archive path, e.g. "textures/" when watching a textures folder.
+    std::string prefix;
+    /// Where patch archives are written before being mounted; a fresh
+    /// directory under the system temporary directory if empty.
+    std::filesystem::path scratch;
+    /// Quiet time after a change before the changes so far are mounted, so
+    /// that a tool writing several files, or one file in several steps,
+    /// causes one reload.
+    std::chrono::milliseconds debounce{50};
+    /// Called on the watcher thread when a batch of changes cannot be
+    /// mounted, e.g. because a new path collides with a mounted one. The
+    /// batch is dropped and the previous overlay stays mounted.
+    std::function<void(std::error_code)> on_error;
+};
+
+/// Called on the watcher thread with the archive path of an entry that was
+/// reloaded or deleted, once find() returns the new state.
+using ReloadCallback = std::function<void(std::string_view path)>;
+
+/// Watches a directory of loose files and mounts every change to it over an
+/// ArchiveSet while the game runs, for development builds.
+///
+/// Every file changed since start() lives in one overlay archive on top of
+/// the set: new contents as entries, deleted files as tombstones where they
+/// hide an entry below. Each batch of changes rewrites the overlay and swaps
+/// it in with ArchiveSet::replace(), one atomic store, so the set holds one
+/// extra archive however many reloads there are, and a reload rebuilds only
+/// the overlay's part of the lookup index. A file deleted again that the set
+/// did not have before drops out of the overlay, and once none is left the
+/// overlay is unmounted. Lookups and reads take exactly the path they take
+/// without a reloader, so there is no cost while no file changes.
+///
+/// EntryRefs into a replaced overlay, and spans into it, keep reading the
+/// old contents until ArchiveSet::reclaim(), which frees replaced overlays
+/// along with the old lookup tables; call it between frames. Subscribers
+/// find() their paths again to see the new contents.
+///
+/// Watching uses inotify and is compiled in when the library is built with
+/// STOCKPILE_HOT_RELOAD on Linux; otherwise start() fails with
+/// std::errc::not_supported.
+class HotReloader {
+public:
+    using SubscriptionId = std::uint64_t;
+
+    /// Starts watching `directory` and its subdirectories. `set` must
+    /// outlive the reloader.
+    [[nodiscard]] static Result<HotReloader> start(ArchiveSet& set, const std::filesystem::path& directory,
+                                                   const HotReloadOptions& options = {});
+
+    HotReloader(HotReloader&&) noexcept;
+    HotReloader& operator=(HotReloader&&) noexcept;
+    /// Stops watching; changes not yet mounted are dropped.
+    ~HotReloader();
+
+    /// Calls `callback` for every reloaded path starting with `prefix` ("" for
+    /// all of them). The callback must not subscribe or unsubscribe.
+    SubscriptionId subscribe(std::string prefix, ReloadCallback callback);
+    void unsubscribe(SubscriptionId id);
+
+    /// Number of batches of changes mounted so far.
+    [[nodiscard]] std::uint64_t reload_count() const noexcept;
+
+private:
+    explicit HotReloader(std::unique_ptr<detail::HotReloadState> state) noexcept;
+
+    std::unique_ptr<detail::HotReloadState> m_state;
+};
+
+} // namespace stockpile
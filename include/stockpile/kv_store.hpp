@@ -0,0 +1,109 @@
+#pragma once
+
+#include "stockpile/error.hpp"
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace stockpile {
+
+namespace detail {
+struct KvState;
+} // namespace detail
+
+/// Puts and erases applied to a KvStore as one atomic unit.
+class WriteBatch {
+public:
+    void put(std::string_view key, std::string_view value);
+    void erase(std::string_view key);
+
+    [[nodiscard]] bool empty() const noexcept { return m_ops.empty(); }
+    [[nodiscard]] std::size_t size() const noexcept { return m_ops.size(); }
+    void clear() noexcept { m_ops.clear(); }
+
+private:
+    friend struct detail::KvState;
+
+    struct Op {
+        std::string key;
+        /// nullopt erases the key.
+        std::optional<std::string> value;
+    };
+
+    std::vector<Op> m_ops;
+};
+
+struct KvOptions {
+    /// Longest a write waits before the background thread makes it durable.
+    /// Everything written within one interval shares a single fsync.
+    std::chrono::milliseconds sync_interval{10};
+    /// Size of the write-ahead log past which it is compacted into the table.
+    std::uint64_t compact_threshold = std::uint64_t{4} << 20;
+};
+
+/// Small embedded key-value store for mutable data such as profiles,
+/// settings and achievements.
+///
+/// A store is a directory holding a sorted table of every key as of the
+/// last compaction and a write-ahead log of the batches applied since. All
+/// keys are kept in memory, so reads never touch the disk. Writes update
+/// memory and queue a log record, then return without doing any I/O; a
+/// background thread appends the queued records and fsyncs them as a group
+/// every KvOptions::sync_interval, so frequent small writes cost one fsync
+/// per interval rather than one each. Call sync() where a write must be on
+/// disk before going on (say, before reporting a purchase as saved).
+///
+/// Once the log outgrows KvOptions::compact_threshold, the table is
+/// rewritten to a temporary file, fsynced and renamed over the old one, and
+/// the log is started afresh. On open, the table is loaded and the log
+/// replayed; a record torn by a crash is discarded along with everything
+/// after it, so each batch is either fully applied or not at all.
+///
+/// All member functions are thread-safe.
+class KvStore {
+public:
+    /// Opens the store in `directory`, creating it if needed.
+    [[nodiscard]] static Result<KvStore> open(const std::filesystem::path& directory, const KvOptions& options = {});
+
+    KvStore(KvStore&&) noexcept;
+    KvStore& operator=(KvStore&&) noexcept;
+    /// Makes every write durable, then stops the background thread.
+    ~KvStore();
+
+    [[nodiscard]] std::optional<std::string> get(std::string_view key) const;
+    [[nodiscard]] bool contains(std::string_view key) const;
+    [[nodiscard]] std::size_t size() const;
+
+    /// Calls `fn(key, value)` for every key starting with `prefix`, in key
+    /// order. The store is locked meanwhile, so `fn` must not use it.
+    void scan(std::string_view prefix, const std::function<void(std::string_view, std::string_view)>& fn) const;
+
+    /// Writes are visible to readers at once and durable after the next
+    /// background flush or sync(). They fail only if an earlier flush did,
+    /// after which the store refuses further writes.
+    [[nodiscard]] Result<void> put(std::string_view key, std::string_view value);
+    [[nodiscard]] Result<void> erase(std::string_view key);
+    [[nodiscard]] Result<void> apply(const WriteBatch& batch);
+
+    /// Blocks until every write made so far is durable.
+    [[nodiscard]] Result<void> sync();
+
+    /// Rewrites the table and starts a new log now rather than waiting for
+    /// the log to reach KvOptions::compact_threshold.
+    [[nodiscard]] Result<void> compact();
+
+private:
+    explicit KvStore(std::unique_ptr<detail::KvState> state) noexcept;
+
+    std::unique_ptr<detail::KvState> m_state;
+};
+
+} // namespace stockpile
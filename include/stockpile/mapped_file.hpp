@@ -0,0 +1,58 @@
+#pragma once
+
+#include "stockpile/error.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <span>
+
+namespace stockpile {
+
+/// Read-only memory mapping of a whole file.
+///
+/// The mapping stays valid for the lifetime of the object; spans returned by
+/// bytes() must not outlive it. The file descriptor is kept open so callers
+/// can issue positional reads against the same file.
+class MappedFile {
+public:
+    /// Access pattern hints forwarded to madvise().
+    enum class Advice {
+        normal,
+        sequential,
+        random,
+        will_need,
+        dont_need,
+    };
+
+    MappedFile() noexcept = default;
+    MappedFile(MappedFile&& other) noexcept;
+    MappedFile& operator=(MappedFile&& other) noexcept;
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    ~MappedFile();
+
+    [[nodiscard]] static Result<MappedFile> open(const std::filesystem::path& path);
+
+    [[nodiscard]] std::span<const std::byte> bytes() const noexcept { return {m_data, m_size}; }
+    [[nodiscard]] std::size_t size() const noexcept { return m_size; }
+    [[nodiscard]] int native_handle() const noexcept { return m_fd; }
+
+    /// Reads `out.size()` bytes at `offset` with positional reads on the
+    /// descriptor, bypassing the mapping. Safe to call from any number of
+    /// threads at once: there is no shared file position.
+    [[nodiscard]] Result<void> read_at(std::uint64_t offset, std::span<std::byte> out) const noexcept;
+
+    /// Hints the kernel about how [offset, offset + length) will be accessed.
+    /// The range is widened to page boundaries; failures are ignored.
+    void advise(Advice advice, std::size_t offset, std::size_t length) const noexcept;
+
+private:
+    void reset() noexcept;
+
+    const std::byte* m_data = nullptr;
+    std::size_t m_size = 0;
+    int m_fd = -1;
+};
+
+} // namespace stockpile
@@ -0,0 +1,117 @@
+#pragma once
+
+#include "stockpile/archive.hpp"
+#include "stockpile/error.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <vector>
+
+namespace stockpile::detail {
+
+/// Open-addressing index of the paths of stacked sources, the archives of an
+/// ArchiveSet or the layers of a Vfs, keyed by hash_path(). Each slot names
+/// the topmost source holding a path and its entry there. It stays at most
+/// half full, as an archive's own path index does.
+///
+/// Both keep a large base index shared by successive tables and a small
+/// overlay of the sources stacked above it, probed first, so that mounting
+/// one more source copies only the overlay.
+struct MergedIndex {
+    struct Slot {
+        std::uint64_t hash;
+        /// The source, with kHidden set if its entry is a tombstone hiding
+        /// the path; kEmpty in an empty slot.
+        std::uint32_t source;
+        std::uint32_t entry;
+    };
+
+    static constexpr std::uint32_t kEmpty = 0xFFFFFFFF;
+    static constexpr std::uint32_t kHidden = 0x80000000;
+
+    std::vector<Slot> slots;
+    std::size_t used = 0;
+
+    /// The slot holding `hash`, or null.
+    [[nodiscard]] const Slot* find(std::uint64_t hash) const noexcept;
+
+    /// The slot holding `hash`, or the empty one where it would go. The
+    /// index must not be empty.
+    [[nodiscard]] std::size_t probe(std::uint64_t hash) const noexcept;
+
+    /// Grows the index so that it stays at most half full with `count` more
+    /// paths.
+    void reserve(std::size_t count);
+
+    /// Adds entry i of `source` under `hashes[i]`, shadowing `below` (null
+    /// if nothing is below), and counts the paths that become visible or
+    /// hidden in `visible`. `is_tombstone(i)` tells whether entry i hides
+    /// its path; `same_path(slot, i)` whether the entry `slot` names has the
+    /// path of entry i. Fails with Errc::hash_collision if it does not.
+    template <typename IsTombstone, typename SamePath>
+    [[nodiscard]] Result<void> insert(const MergedIndex* below, std::uint32_t source,
+                                      std::span<const std::uint64_t> hashes, IsTombstone is_tombstone,
+                                      SamePath same_path, std::size_t& visible);
+
+    /// Replaces `base` with a copy that has the slots of `overlay` over its
+    /// own, and empties `overlay`, once the overlay has grown past a quarter
+    /// of the base. Returns whether it did.
+    static bool fold(std::shared_ptr<const MergedIndex>& base, MergedIndex& overlay);
+};
+
+/// The slot deciding what `hash` finds, from `overlay` or else `base`, or
+/// null if neither has it.
+[[nodiscard]] inline const MergedIndex::Slot* lookup(const MergedIndex& overlay, const MergedIndex& base,
+                                                     std::uint64_t hash) noexcept {
+    const auto* slot = overlay.find(hash);
+    return slot != nullptr ? slot : base.find(hash);
+}
+
+/// hash_path() of the path of every entry of `archive`, by EntryId, taken
+/// from its path index instead of hashing the paths again.
+[[nodiscard]] std::vector<std::uint64_t> entry_hashes(const Archive& archive);
+
+inline const MergedIndex::Slot* MergedIndex::find(std::uint64_t hash) const noexcept {
+    if (slots.empty()) {
+        return nullptr;
+    }
+    const auto& slot = slots[probe(hash)];
+    return slot.source == kEmpty ? nullptr : &slot;
+}
+
+inline std::size_t MergedIndex::probe(std::uint64_t hash) const noexcept {
+    const std::size_t mask = slots.size() - 1;
+    std::size_t i = hash & mask;
+    while (slots[i].source != kEmpty && slots[i].hash != hash) {
+        i = (i + 1) & mask;
+    }
+    return i;
+}
+
+template <typename IsTombstone, typename SamePath>
+Result<void> MergedIndex::insert(const MergedIndex* below, std::uint32_t source,
+                                 std::span<const std::uint64_t> hashes, IsTombstone is_tombstone, SamePath same_path,
+                                 std::size_t& visible) {
+    reserve(hashes.size());
+    for (std::uint32_t i = 0; i < hashes.size(); ++i) {
+        auto& slot = slots[probe(hashes[i])];
+        const Slot* previous = slot.source != kEmpty ? &slot : below != nullptr ? below->find(hashes[i]) : nullptr;
+        if (previous != nullptr) {
+            // Lookups compare hashes only, so a different path with the same
+            // hash would be mistaken for this one.
+            if (!same_path(*previous, i)) {
+                return fail(Errc::hash_collision);
+            }
+            visible -= (previous->source & kHidden) == 0 ? 1 : 0;
+        }
+        used += slot.source == kEmpty ? 1 : 0;
+        const bool hidden = is_tombstone(i);
+        slot = {hashes[i], hidden ? source | kHidden : source, i};
+        visible += hidden ? 0 : 1;
+    }
+    return {};
+}
+
+} // namespace stockpile::detail
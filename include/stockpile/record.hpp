@@ -0,0 +1,351 @@
+#pragma once
+
+#include "stockpile/error.hpp"
+#include "stockpile/schema.hpp"
+#include "stockpile/serialize.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <optional>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+namespace stockpile {
+
+/// Identifies a field inside a stored record: the 32-bit FNV-1a hash of its
+/// name, so fields keep their identity when others are added or removed.
+[[nodiscard]] constexpr std::uint32_t field_key(std::string_view name) noexcept {
+    std::uint32_t hash = 2166136261u;
+    for (const char c : name) {
+        hash ^= static_cast<unsigned char>(c);
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+/// Current schema version of T, set with STOCKPILE_SCHEMA_VERSION; 1 if unset.
+template <typename T>
+[[nodiscard]] consteval std::uint32_t schema_version() noexcept {
+    if constexpr (requires { stockpile_schema_version(static_cast<const T*>(nullptr)); }) {
+        return stockpile_schema_version(static_cast<const T*>(nullptr));
+    } else {
+        return 1;
+    }
+}
+
+/// Produces the current value of `Member` from a record written before
+/// schema version `version`. `fn` is called with the record's RecordView
+/// and returns the value or a Result holding it.
+template <auto Member, typename Fn>
+struct Migration {
+    static constexpr auto member = Member;
+
+    std::uint32_t version;
+    Fn fn;
+};
+
+template <auto Member, typename Fn>
+[[nodiscard]] constexpr Migration<Member, Fn> migrate(std::uint32_t version, Fn fn) noexcept {
+    return {version, fn};
+}
+
+template <typename... Migrations>
+[[nodiscard]] constexpr std::tuple<Migrations...> make_migrations(Migrations... migrations) noexcept {
+    return {migrations...};
+}
+
+namespace detail {
+
+template <typename T>
+struct member_pointer_traits;
+template <typename Class, typename Member>
+struct member_pointer_traits<Member Class::*> {
+    using class_type = Class;
+    using member_type = Member;
+};
+
+template <auto Member, typename F>
+[[nodiscard]] constexpr bool same_member(const F& field) noexcept {
+    if constexpr (std::is_same_v<decltype(field.member), decltype(Member)>) {
+        return field.member == Member;
+    } else {
+        return false;
+    }
+}
+
+template <typename T, auto Member>
+[[nodiscard]] consteval std::size_t field_index() noexcept {
+    return std::apply(
+        [](const auto&... fields) {
+            std::size_t index = 0;
+            std::size_t found = sizeof...(fields);
+            ((same_member<Member>(fields) ? found = index : 0, ++index), ...);
+            return found;
+        },
+        schema_fields<T>);
+}
+
+template <typename T>
+[[nodiscard]] consteval bool unique_keys() noexcept {
+    return std::apply(
+        [](const auto&... fields) {
+            const std::uint32_t keys[] = {field_key(fields.name)..., 0};
+            for (std::size_t i = 0; i < sizeof...(fields); ++i) {
+                for (std::size_t j = i + 1; j < sizeof...(fields); ++j) {
+                    if (keys[i] == keys[j]) {
+                        return false;
+                    }
+                }
+            }
+            return true;
+        },
+        schema_fields<T>);
+}
+
+template <typename T>
+[[nodiscard]] constexpr auto migrations_of() noexcept {
+    if constexpr (requires { stockpile_migrations(static_cast<const T*>(nullptr)); }) {
+        return stockpile_migrations(static_cast<const T*>(nullptr));
+    } else {
+        return std::tuple<>{};
+    }
+}
+
+/// Bytes of one field table entry: key, then offset from the start of the body.
+inline constexpr std::size_t kFieldEntrySize = 2 * sizeof(std::uint32_t);
+
+} // namespace detail
+
+/// Migrations declared for T with STOCKPILE_MIGRATIONS.
+template <typename T>
+inline constexpr auto schema_migrations = detail::migrations_of<T>();
+
+/// Appends `value` as a versioned record: the schema version, a table of
+/// (field key, offset) pairs and the fields encoded one after another.
+/// Fails with Errc::too_large if the fields exceed 4 GiB.
+template <Reflected T>
+[[nodiscard]] Result<void> encode_record(SaveWriter& writer, const T& value) {
+    static_assert(detail::unique_keys<T>(), "two field names of this schema have the same key");
+    constexpr std::size_t count = std::tuple_size_v<std::remove_cvref_t<decltype(schema_fields<T>)>>;
+
+    writer.write_varint(schema_version<T>());
+    writer.write_varint(count);
+    writer.align(alignof(std::uint32_t));
+    const std::size_t size_at = writer.size();
+    writer.write<std::uint32_t>(0);
+    const std::size_t table_at = writer.size();
+    std::apply(
+        [&](const auto&... fields) {
+            ((writer.write<std::uint32_t>(field_key(fields.name)), writer.write<std::uint32_t>(0)), ...);
+        },
+        schema_fields<T>);
+
+    const std::size_t body = writer.size();
+    [&]<std::size_t... I>(std::index_sequence<I...>) {
+        ((writer.overwrite(table_at + I * detail::kFieldEntrySize + sizeof(std::uint32_t),
+                           static_cast<std::uint32_t>(writer.size() - body)),
+          encode(writer, value.*(std::get<I>(schema_fields<T>).member))),
+         ...);
+    }(std::make_index_sequence<count>{});
+
+    const std::size_t body_size = writer.size() - body;
+    if (body_size > std::numeric_limits<std::uint32_t>::max()) {
+        return fail(Errc::too_large);
+    }
+    writer.overwrite(size_at, static_cast<std::uint32_t>(body_size));
+    return {};
+}
+
+/// Lazily decoded record written by encode_record().
+///
+/// Opening a record only reads its header; each field is located through
+/// the field table and decoded when it is asked for. Records written by an
+/// older schema version pay for migration only on the fields that have a
+/// migration and are actually read; unchanged fields decode as fast as in a
+/// current record. The view refers to the reader's buffer.
+template <Reflected T>
+class RecordView {
+public:
+    /// Reads the record header at the reader's position and moves the
+    /// reader past the whole record.
+    [[nodiscard]] static Result<RecordView> open(SaveReader& reader) noexcept {
+        auto version = reader.read_varint();
+        if (!version) {
+            return std::unexpected(version.error());
+        }
+        auto count = reader.read_varint();
+        if (!count) {
+            return std::unexpected(count.error());
+        }
+        if (auto aligned = reader.align(alignof(std::uint32_t)); !aligned) {
+            return std::unexpected(aligned.error());
+        }
+        auto body_size = reader.read<std::uint32_t>();
+        if (!body_size) {
+            return std::unexpected(body_size.error());
+        }
+        if (*version > std::numeric_limits<std::uint32_t>::max() ||
+            *count > reader.remaining() / detail::kFieldEntrySize) {
+            return fail(Errc::malformed_data);
+        }
+        RecordView view;
+        view.m_version = static_cast<std::uint32_t>(*version);
+        view.m_count = static_cast<std::size_t>(*count);
+        view.m_table = reader.position();
+        view.m_body = view.m_table + view.m_count * detail::kFieldEntrySize;
+        if (auto skipped = reader.seek(view.m_body); !skipped || *body_size > reader.remaining()) {
+            return fail(Errc::malformed_data);
+        }
+        const std::size_t end = view.m_body + *body_size;
+        view.m_bytes = reader.bytes().first(end);
+        (void)reader.seek(end);
+        return view;
+    }
+
+    /// Schema version the record was written with.
+    [[nodiscard]] std::uint32_t version() const noexcept { return m_version; }
+
+    /// True if the record stores a field named `name`.
+    [[nodiscard]] bool has(std::string_view name) const noexcept { return find(field_key(name)).has_value(); }
+
+    /// Current value of schema field `Member`. If the record predates a
+    /// migration for the field, the first such migration in declaration
+    /// order computes it. Otherwise the stored field is decoded, and a field
+    /// the record does not have takes its value from a default-constructed T.
+    template <auto Member>
+    [[nodiscard]] Result<typename detail::member_pointer_traits<decltype(Member)>::member_type> get() const {
+        using V = typename detail::member_pointer_traits<decltype(Member)>::member_type;
+        constexpr std::size_t index = detail::field_index<T, Member>();
+        static_assert(index < std::tuple_size_v<std::remove_cvref_t<decltype(schema_fields<T>)>>,
+                      "member is not part of the schema");
+
+        if (m_version < schema_version<T>()) {
+            std::optional<Result<V>> migrated;
+            std::apply(
+                [&](const auto&... migrations) {
+                    static_cast<void>((run_migration<Member>(migrations, migrated) || ...));
+                },
+                schema_migrations<T>);
+            if (migrated) {
+                return std::move(*migrated);
+            }
+        }
+
+        constexpr std::uint32_t key = field_key(std::get<index>(schema_fields<T>).name);
+        const auto at = find(key, index);
+        if (!at) {
+            return V(T{}.*Member);
+        }
+        return read_at<V>(*at);
+    }
+
+    /// Decodes the stored field `name` as a V, without migration. Meant for
+    /// migrations reading fields as an older schema wrote them.
+    template <typename V>
+    [[nodiscard]] Result<V> read(std::string_view name) const {
+        const auto at = find(field_key(name));
+        if (!at) {
+            return fail(Errc::missing_field);
+        }
+        return read_at<V>(*at);
+    }
+
+private:
+    RecordView() noexcept = default;
+
+    [[nodiscard]] std::uint32_t table_word(std::size_t index, std::size_t word) const noexcept {
+        std::uint32_t value;
+        std::memcpy(&value, m_bytes.data() + m_table + index * detail::kFieldEntrySize + word * sizeof(value),
+                    sizeof(value));
+        return value;
+    }
+
+    /// Position of the table entry for `key`. Records of the current version
+    /// list their fields in schema order, so `hint` is checked first.
+    [[nodiscard]] std::optional<std::size_t> find(std::uint32_t key,
+                                                  std::size_t hint = std::numeric_limits<std::size_t>::max()) const noexcept {
+        if (hint < m_count && table_word(hint, 0) == key) {
+            return hint;
+        }
+        for (std::size_t i = 0; i < m_count; ++i) {
+            if (table_word(i, 0) == key) {
+                return i;
+            }
+        }
+        return std::nullopt;
+    }
+
+    template <typename V>
+    [[nodiscard]] Result<V> read_at(std::size_t index) const {
+        SaveReader reader(m_bytes);
+        if (auto moved = reader.seek(m_body + table_word(index, 1)); !moved) {
+            return std::unexpected(moved.error());
+        }
+        V value{};
+        if (auto decoded = decode(reader, value); !decoded) {
+            return std::unexpected(decoded.error());
+        }
+        return value;
+    }
+
+    template <auto Member, typename M, typename V>
+    bool run_migration(const M& migration, std::optional<Result<V>>& out) const {
+        if constexpr (std::is_same_v<std::remove_cv_t<decltype(M::member)>, decltype(Member)>) {
+            if constexpr (M::member == Member) {
+                if (m_version < migration.version) {
+                    out.emplace(migration.fn(*this));
+                    return true;
+                }
+            }
+        }
+        return false;
+    }
+
+    std::span<const std::byte> m_bytes;
+    std::size_t m_table = 0;
+    std::size_t m_body = 0;
+    std::size_t m_count = 0;
+    std::uint32_t m_version = 0;
+};
+
+/// Decodes every schema field of a record into `value`, migrating the ones
+/// an older schema version stored differently.
+template <Reflected T>
+[[nodiscard]] Result<void> decode_record(SaveReader& reader, T& value) {
+    auto view = RecordView<T>::open(reader);
+    if (!view) {
+        return std::unexpected(view.error());
+    }
+    Result<void> result;
+    [&]<std::size_t... I>(std::index_sequence<I...>) {
+        ((result = [&]() -> Result<void> {
+              constexpr auto member = std::get<I>(schema_fields<T>).member;
+              auto field = view->template get<member>();
+              if (!field) {
+                  return std::unexpected(field.error());
+              }
+              value.*member = std::move(*field);
+              return {};
+          }()) &&
+         ...);
+    }(std::make_index_sequence<std::tuple_size_v<std::remove_cvref_t<decltype(schema_fields<T>)>>>{});
+    return result;
+}
+
+} // namespace stockpile
+
+/// Sets the schema version written into records of `Type`.
+#define STOCKPILE_SCHEMA_VERSION(Type, version)                                                  \
+    [[maybe_unused]] constexpr std::uint32_t stockpile_schema_version(const Type*) noexcept { \
+        return version;                                                                          \
+    }
+
+/// Declares the migrations of `Type`, each made with stockpile::migrate().
+#define STOCKPILE_MIGRATIONS(Type, ...)                                            \
+    [[maybe_unused]] constexpr auto stockpile_migrations(const Type*) noexcept { \
+        return ::stockpile::make_migrations(__VA_ARGS__);                         \
+    }
@@ -0,0 +1,55 @@
+#pragma once
+
+#include "stockpile/error.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <span>
+#include <utility>
+#include <vector>
+
+namespace stockpile {
+
+class ThreadPool;
+
+/// One save game, written so that no crash or power loss can destroy it.
+///
+/// A slot keeps two copies, `<path>.0` and `<path>.1`, each tagged with a
+/// generation number. write() always replaces the older copy: the new one
+/// goes to a temporary file, which is fsynced and then renamed over it, so
+/// the newest intact save survives a crash at any point. Every 64 KiB block
+/// of a copy carries a CRC-32C, checked by read() on every load. If the
+/// newest copy is damaged, read() falls back to the other one.
+class SaveSlot {
+public:
+    explicit SaveSlot(std::filesystem::path path) : m_path(std::move(path)) {}
+
+    [[nodiscard]] const std::filesystem::path& path() const noexcept { return m_path; }
+
+    /// Stores `data` as the newest save. With a pool, blocks are checksummed
+    /// in parallel.
+    [[nodiscard]] Result<void> write(std::span<const std::byte> data, ThreadPool* pool = nullptr) const;
+
+    /// Loads the newest copy whose checksums all match. Fails with
+    /// std::errc::no_such_file_or_directory if the slot was never written.
+    /// If no copy loads, fails with why an existing copy did not:
+    /// Errc::checksum_mismatch if it is damaged or truncated,
+    /// Errc::unsupported_version if a newer format wrote it, or
+    /// Errc::bad_magic if it is not a save at all. With a pool, blocks are
+    /// verified in parallel.
+    [[nodiscard]] Result<std::vector<std::byte>> read(ThreadPool* pool = nullptr) const;
+
+    /// True if either copy exists, intact or not.
+    [[nodiscard]] bool exists() const;
+
+    /// Deletes both copies.
+    [[nodiscard]] Result<void> remove() const;
+
+private:
+    [[nodiscard]] std::filesystem::path copy_path(int copy) const;
+
+    std::filesystem::path m_path;
+};
+
+} // namespace stockpile
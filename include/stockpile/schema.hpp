@@ -0,0 +1,244 @@
+#pragma once
+
+#include "stockpile/error.hpp"
+#include "stockpile/serialize.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstring>
+#include <span>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <vector>
+
+namespace stockpile {
+
+/// One serialized member of a reflected struct.
+template <typename Class, typename Member>
+struct Field {
+    using class_type = Class;
+    using member_type = Member;
+
+    std::string_view name;
+    Member Class::*member;
+};
+
+template <typename Class, typename Member>
+[[nodiscard]] constexpr Field<Class, Member> field(std::string_view name, Member Class::*member) noexcept {
+    return {name, member};
+}
+
+template <typename... Fields>
+[[nodiscard]] constexpr std::tuple<Fields...> make_fields(Fields... fields) noexcept {
+    return {fields...};
+}
+
+/// Types with a field list, declared with STOCKPILE_SCHEMA or by hand as a
+/// constexpr `stockpile_schema(const T*)` function found by argument-dependent
+/// lookup that returns make_fields(...).
+template <typename T>
+concept Reflected = requires { stockpile_schema(static_cast<const T*>(nullptr)); };
+
+template <Reflected T>
+inline constexpr auto schema_fields = stockpile_schema(static_cast<const T*>(nullptr));
+
+namespace detail {
+
+template <typename T>
+struct is_std_array : std::false_type {};
+template <typename T, std::size_t N>
+struct is_std_array<std::array<T, N>> : std::true_type {};
+
+template <typename T>
+struct is_std_vector : std::false_type {};
+template <typename T, typename Allocator>
+struct is_std_vector<std::vector<T, Allocator>> : std::true_type {};
+
+template <typename T>
+struct is_const_span : std::false_type {};
+template <typename T>
+struct is_const_span<std::span<const T>> : std::true_type {};
+
+template <typename T>
+inline constexpr bool always_false = false;
+
+template <typename T>
+[[nodiscard]] consteval bool flat() noexcept;
+
+template <typename T>
+[[nodiscard]] consteval bool flat_fields() noexcept {
+    return std::apply(
+        [](auto... fields) {
+            using Members = std::tuple<typename decltype(fields)::member_type...>;
+            return []<std::size_t... I>(std::index_sequence<I...>) {
+                return (flat<std::tuple_element_t<I, Members>>() && ...) &&
+                       (sizeof(std::tuple_element_t<I, Members>) + ... + 0) == sizeof(T);
+            }(std::make_index_sequence<std::tuple_size_v<Members>>{});
+        },
+        schema_fields<T>);
+}
+
+template <typename T>
+[[nodiscard]] consteval bool flat() noexcept {
+    if constexpr (std::is_same_v<T, bool>) {
+        // Not every byte is a valid bool, so bools are checked field by field.
+        return false;
+    } else if constexpr (Scalar<T>) {
+        return true;
+    } else if constexpr (is_std_array<T>::value) {
+        return flat<typename T::value_type>();
+    } else if constexpr (Reflected<T>) {
+        if constexpr (std::is_trivially_copyable_v<T> && std::is_standard_layout_v<T>) {
+            return flat_fields<T>();
+        } else {
+            return false;
+        }
+    } else {
+        return false;
+    }
+}
+
+} // namespace detail
+
+/// True for types whose serialized form is exactly their object
+/// representation: non-bool scalars, and trivially-copyable standard-layout
+/// structs whose listed fields are all flat and cover every byte, so there is
+/// no padding and no unlisted member. These are encoded and decoded with one
+/// memcpy, and arrays of them are read back in place.
+template <typename T>
+inline constexpr bool is_flat_v = detail::flat<T>();
+
+/// Appends `value` to `writer`. Supported types are scalars, std::string,
+/// std::string_view, std::vector, std::span<const T>, std::array and
+/// reflected structs made of those. Reflected structs are written field by
+/// field in schema order unless they are flat.
+template <typename T>
+void encode(SaveWriter& writer, const T& value) {
+    if constexpr (is_flat_v<T>) {
+        writer.write_bytes(std::as_bytes(std::span(&value, 1)));
+    } else if constexpr (Scalar<T>) {
+        writer.write(value);
+    } else if constexpr (std::is_same_v<T, std::string> || std::is_same_v<T, std::string_view>) {
+        writer.write_string(value);
+    } else if constexpr (detail::is_std_vector<T>::value || detail::is_const_span<T>::value) {
+        if constexpr (is_flat_v<typename T::value_type>) {
+            writer.write_array(value);
+        } else {
+            writer.write_varint(value.size());
+            for (const auto& element : value) {
+                encode(writer, element);
+            }
+        }
+    } else if constexpr (detail::is_std_array<T>::value) {
+        for (const auto& element : value) {
+            encode(writer, element);
+        }
+    } else if constexpr (Reflected<T>) {
+        std::apply([&](const auto&... fields) { (encode(writer, value.*(fields.member)), ...); }, schema_fields<T>);
+    } else {
+        static_assert(detail::always_false<T>, "type has no serialized form; declare a STOCKPILE_SCHEMA for it");
+    }
+}
+
+/// Reads a value written by encode() into `value`. std::string_view and
+/// std::span<const T> members are decoded as views into the reader's buffer.
+template <typename T>
+[[nodiscard]] Result<void> decode(SaveReader& reader, T& value) {
+    if constexpr (is_flat_v<T>) {
+        auto bytes = reader.read_bytes(sizeof(T));
+        if (!bytes) {
+            return std::unexpected(bytes.error());
+        }
+        std::memcpy(&value, bytes->data(), sizeof(T));
+        return {};
+    } else if constexpr (Scalar<T>) {
+        auto read = reader.read<T>();
+        if (!read) {
+            return std::unexpected(read.error());
+        }
+        value = *read;
+        return {};
+    } else if constexpr (std::is_same_v<T, std::string> || std::is_same_v<T, std::string_view>) {
+        auto text = reader.read_string();
+        if (!text) {
+            return std::unexpected(text.error());
+        }
+        value = T(*text);
+        return {};
+    } else if constexpr (detail::is_const_span<T>::value) {
+        static_assert(is_flat_v<typename T::element_type>, "only spans of flat types can be decoded in place");
+        auto elements = reader.read_array<typename T::element_type>();
+        if (!elements) {
+            return std::unexpected(elements.error());
+        }
+        value = *elements;
+        return {};
+    } else if constexpr (detail::is_std_vector<T>::value) {
+        using Element = typename T::value_type;
+        if constexpr (is_flat_v<Element>) {
+            auto elements = reader.read_array<Element>();
+            if (!elements) {
+                return std::unexpected(elements.error());
+            }
+            value.assign(elements->begin(), elements->end());
+            return {};
+        } else {
+            auto count = reader.read_varint();
+            if (!count) {
+                return std::unexpected(count.error());
+            }
+            value.clear();
+            // The count is untrusted: only reserve what the input could hold.
+            value.reserve(std::min<std::uint64_t>(*count, reader.remaining()));
+            for (std::uint64_t i = 0; i < *count; ++i) {
+                if (auto decoded = decode(reader, value.emplace_back()); !decoded) {
+                    return decoded;
+                }
+            }
+            return {};
+        }
+    } else if constexpr (detail::is_std_array<T>::value) {
+        for (auto& element : value) {
+            if (auto decoded = decode(reader, element); !decoded) {
+                return decoded;
+            }
+        }
+        return {};
+    } else if constexpr (Reflected<T>) {
+        Result<void> result;
+        std::apply([&](const auto&... fields) { ((result = decode(reader, value.*(fields.member))) && ...); },
+                   schema_fields<T>);
+        return result;
+    } else {
+        static_assert(detail::always_false<T>, "type has no serialized form; declare a STOCKPILE_SCHEMA for it");
+    }
+}
+
+} // namespace stockpile
+
+// Applies `macro(type, field)` to every field (up to 256), separated by commas.
+#define STOCKPILE_DETAIL_PARENS ()
+#define STOCKPILE_DETAIL_EXPAND(...) STOCKPILE_DETAIL_EXPAND4(STOCKPILE_DETAIL_EXPAND4(STOCKPILE_DETAIL_EXPAND4(STOCKPILE_DETAIL_EXPAND4(__VA_ARGS__))))
+#define STOCKPILE_DETAIL_EXPAND4(...) STOCKPILE_DETAIL_EXPAND3(STOCKPILE_DETAIL_EXPAND3(STOCKPILE_DETAIL_EXPAND3(STOCKPILE_DETAIL_EXPAND3(__VA_ARGS__))))
+#define STOCKPILE_DETAIL_EXPAND3(...) STOCKPILE_DETAIL_EXPAND2(STOCKPILE_DETAIL_EXPAND2(STOCKPILE_DETAIL_EXPAND2(STOCKPILE_DETAIL_EXPAND2(__VA_ARGS__))))
+#define STOCKPILE_DETAIL_EXPAND2(...) STOCKPILE_DETAIL_EXPAND1(STOCKPILE_DETAIL_EXPAND1(STOCKPILE_DETAIL_EXPAND1(STOCKPILE_DETAIL_EXPAND1(__VA_ARGS__))))
+#define STOCKPILE_DETAIL_EXPAND1(...) __VA_ARGS__
+#define STOCKPILE_DETAIL_FOR_EACH(macro, type, ...) \
+    __VA_OPT__(STOCKPILE_DETAIL_EXPAND(STOCKPILE_DETAIL_FOR_EACH_STEP(macro, type, __VA_ARGS__)))
+#define STOCKPILE_DETAIL_FOR_EACH_STEP(macro, type, first, ...) \
+    macro(type, first) __VA_OPT__(, STOCKPILE_DETAIL_FOR_EACH_AGAIN STOCKPILE_DETAIL_PARENS(macro, type, __VA_ARGS__))
+#define STOCKPILE_DETAIL_FOR_EACH_AGAIN() STOCKPILE_DETAIL_FOR_EACH_STEP
+#define STOCKPILE_DETAIL_FIELD(type, member) ::stockpile::field(#member, &type::member)
+
+/// Declares the serialized fields of `Type`, in order. Use it in the
+/// namespace that declares `Type`; the listed members must be public.
+///
+///     struct Transform { Vec3 position; Quat rotation; float scale; };
+///     STOCKPILE_SCHEMA(Transform, position, rotation, scale)
+#define STOCKPILE_SCHEMA(Type, ...)                                                                         \
+    [[maybe_unused]] constexpr auto stockpile_schema(const Type*) noexcept {                                \
+        return ::stockpile::make_fields(STOCKPILE_DETAIL_FOR_EACH(STOCKPILE_DETAIL_FIELD, Type, __VA_ARGS__)); \
+    }
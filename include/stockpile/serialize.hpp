@@ -0,0 +1,168 @@
+#pragma once
+
+#include "stockpile/arena.hpp"
+#include "stockpile/error.hpp"
+
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <ranges>
+#include <span>
+#include <string_view>
+#include <type_traits>
+
+namespace stockpile {
+
+static_assert(std::endian::native == std::endian::little, "serialized data is little-endian");
+
+/// Types written as their object representation.
+template <typename T>
+concept Scalar = std::is_arithmetic_v<T> || std::is_enum_v<T>;
+
+/// Types whose arrays are written with one copy and read back in place.
+template <typename T>
+concept TriviallySerializable = std::is_trivially_copyable_v<T> && alignof(T) <= alignof(std::max_align_t);
+
+/// Appends a binary encoding to one contiguous buffer taken from an Arena.
+///
+/// Scalars are stored as their little-endian object representation, lengths
+/// as LEB128 varints, and arrays of trivially-copyable types as one aligned
+/// copy so SaveReader can hand them back as spans. The buffer grows in place
+/// while it is the arena's most recent allocation and is moved otherwise, so
+/// nothing is allocated per field. The data stays valid until the arena is
+/// reset.
+class SaveWriter {
+public:
+    explicit SaveWriter(Arena& arena, std::size_t initial_capacity = 4096);
+
+    template <Scalar T>
+    void write(T value) {
+        std::memcpy(claim(sizeof(T)), &value, sizeof(T));
+    }
+
+    void write_varint(std::uint64_t value);
+    void write_bytes(std::span<const std::byte> bytes);
+    /// Length-prefixed bytes of `text`.
+    void write_string(std::string_view text);
+
+    /// Element count, padding up to alignof(T), then the elements' bytes.
+    /// Padding inside T is copied as it is.
+    template <std::ranges::contiguous_range R>
+        requires TriviallySerializable<std::ranges::range_value_t<R>>
+    void write_array(const R& values) {
+        using T = std::ranges::range_value_t<R>;
+        const auto count = static_cast<std::size_t>(std::ranges::size(values));
+        write_varint(count);
+        align(alignof(T));
+        write_bytes({reinterpret_cast<const std::byte*>(std::ranges::data(values)), count * sizeof(T)});
+    }
+
+    /// Replaces the bytes of a scalar written earlier at `position`.
+    template <Scalar T>
+    void overwrite(std::size_t position, T value) noexcept {
+        std::memcpy(m_data + position, &value, sizeof(T));
+    }
+
+    /// Pads with zero bytes up to a multiple of `alignment` from the start.
+    void align(std::size_t alignment);
+
+    [[nodiscard]] std::span<const std::byte> bytes() const noexcept { return {m_data, m_size}; }
+    [[nodiscard]] std::size_t size() const noexcept { return m_size; }
+
+    /// Discards the contents and keeps the buffer.
+    void clear() noexcept { m_size = 0; }
+
+private:
+    [[nodiscard]] std::byte* claim(std::size_t count) {
+        if (m_capacity - m_size < count) {
+            grow(count);
+        }
+        std::byte* p = m_data + m_size;
+        m_size += count;
+        return p;
+    }
+
+    void grow(std::size_t count);
+
+    Arena* m_arena;
+    std::byte* m_data = nullptr;
+    std::size_t m_size = 0;
+    std::size_t m_capacity = 0;
+};
+
+/// Decodes what SaveWriter produced, straight from a contiguous buffer.
+///
+/// Strings, byte runs and arrays are returned as views into the buffer, which
+/// must outlive them and, for arrays, start at an address aligned to
+/// alignof(std::max_align_t). Every read is bounds-checked and fails with
+/// Errc::malformed_data instead of running past the end.
+class SaveReader {
+public:
+    explicit SaveReader(std::span<const std::byte> bytes) noexcept : m_bytes(bytes) {}
+
+    template <Scalar T>
+    [[nodiscard]] Result<T> read() noexcept {
+        if (remaining() < sizeof(T)) {
+            return fail(Errc::malformed_data);
+        }
+        const std::byte* p = m_bytes.data() + m_position;
+        m_position += sizeof(T);
+        if constexpr (std::is_same_v<T, bool>) {
+            // Any other byte would be an invalid bool.
+            if (std::to_integer<unsigned>(*p) > 1) {
+                return fail(Errc::malformed_data);
+            }
+        }
+        T value;
+        std::memcpy(&value, p, sizeof(T));
+        return value;
+    }
+
+    [[nodiscard]] Result<std::uint64_t> read_varint() noexcept;
+    [[nodiscard]] Result<std::span<const std::byte>> read_bytes(std::size_t count) noexcept;
+    [[nodiscard]] Result<std::string_view> read_string() noexcept;
+
+    template <TriviallySerializable T>
+    [[nodiscard]] Result<std::span<const T>> read_array() noexcept {
+        auto count = read_varint();
+        if (!count) {
+            return std::unexpected(count.error());
+        }
+        if (auto aligned = align(alignof(T)); !aligned) {
+            return std::unexpected(aligned.error());
+        }
+        if (*count > remaining() / sizeof(T)) {
+            return fail(Errc::malformed_data);
+        }
+        const std::byte* p = m_bytes.data() + m_position;
+        if (reinterpret_cast<std::uintptr_t>(p) % alignof(T) != 0) {
+            return std::unexpected(std::make_error_code(std::errc::invalid_argument));
+        }
+        m_position += *count * sizeof(T);
+        return std::span<const T>(reinterpret_cast<const T*>(p), *count);
+    }
+
+    /// Skips the padding SaveWriter::align() wrote.
+    [[nodiscard]] Result<void> align(std::size_t alignment) noexcept;
+
+    /// Moves to `position`, counted from the start of the buffer.
+    [[nodiscard]] Result<void> seek(std::size_t position) noexcept {
+        if (position > m_bytes.size()) {
+            return fail(Errc::malformed_data);
+        }
+        m_position = position;
+        return {};
+    }
+
+    [[nodiscard]] std::span<const std::byte> bytes() const noexcept { return m_bytes; }
+    [[nodiscard]] std::size_t position() const noexcept { return m_position; }
+    [[nodiscard]] std::size_t remaining() const noexcept { return m_bytes.size() - m_position; }
+    [[nodiscard]] bool at_end() const noexcept { return m_position == m_bytes.size(); }
+
+private:
+    std::span<const std::byte> m_bytes;
+    std::size_t m_position = 0;
+};
+
+} // namespace stockpile
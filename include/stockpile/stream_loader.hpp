@@ -0,0 +1,117 @@
+#pragma once
+
+#include "stockpile/archive.hpp"
+#include "stockpile/error.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <span>
+
+namespace stockpile {
+
+namespace detail {
+struct StreamRequest;
+struct StreamLoaderState;
+} // namespace detail
+
+enum class RequestStatus : std::uint8_t {
+    pending,
+    in_flight,
+    completed,
+    failed,
+    cancelled,
+};
+
+/// Decoded contents of a finished request, or why it failed. The span stays
+/// valid for as long as any ReadHandle to the request is alive.
+using ReadResult = Result<std::span<const std::byte>>;
+
+/// Called on a loader thread when a request completes or fails; never for
+/// cancelled requests. Must not throw.
+using ReadCallback = std::move_only_function<void(const ReadResult&)>;
+
+/// Caller's side of one submitted read.
+class ReadHandle {
+public:
+    ReadHandle() noexcept = default;
+
+    [[nodiscard]] bool valid() const noexcept { return m_request != nullptr; }
+    [[nodiscard]] RequestStatus status() const noexcept;
+
+    /// Withdraws the request if it has not started yet. Returns true if it
+    /// will not run; its callback is then never called.
+    bool cancel() noexcept;
+
+    /// Reorders the request among those still pending; higher runs first.
+    void set_priority(int priority);
+
+    /// Blocks until the request has completed, failed or been cancelled.
+    void wait() const noexcept;
+
+    /// Waits, then returns the request's result; cancelled requests report
+    /// std::errc::operation_canceled.
+    [[nodiscard]] ReadResult result() const;
+
+private:
+    friend class StreamLoader;
+
+    ReadHandle(std::shared_ptr<detail::StreamRequest> request,
+               std::weak_ptr<detail::StreamLoaderState> loader) noexcept;
+
+    std::shared_ptr<detail::StreamRequest> m_request;
+    std::weak_ptr<detail::StreamLoaderState> m_loader;
+};
+
+/// Asynchronous, prioritized entry reads for streaming.
+///
+/// Requests are queued by priority and served by background threads. When
+/// one is picked, other pending requests whose stored bytes lie next to it
+/// in the same archive are folded into a single read. Compressed entries are
+/// decoded on the loader threads before the callback runs.
+///
+/// On Linux the reads are issued through io_uring when the kernel allows it;
+/// otherwise, or when asked to, a pool of threads issues pread() calls.
+class StreamLoader {
+public:
+    enum class Backend {
+        automatic,
+        io_uring,
+        pread,
+    };
+
+    struct Options {
+        Backend backend = Backend::automatic;
+        /// Threads issuing reads (pread) or decoding and running callbacks
+        /// (io_uring); 0 means one per hardware thread.
+        std::size_t threads = 0;
+        /// Reads kept in flight by the io_uring backend.
+        unsigned queue_depth = 64;
+        /// Upper bound on the bytes fetched by one merged read.
+        std::uint64_t max_batch_bytes = std::uint64_t{1} << 20;
+        /// Bytes nobody asked for that a merged read may span between two
+        /// requests to avoid splitting it.
+        std::uint64_t max_batch_gap = 4096;
+    };
+
+    StreamLoader();
+    explicit StreamLoader(const Options& options);
+    StreamLoader(const StreamLoader&) = delete;
+    StreamLoader& operator=(const StreamLoader&) = delete;
+    /// Cancels pending requests and waits for in-flight ones to finish.
+    ~StreamLoader();
+
+    /// Backend actually in use: pread if io_uring is unavailable, or once the
+    /// ring fails while reads are in flight, after which the io_uring thread
+    /// issues the reads itself.
+    [[nodiscard]] Backend backend() const noexcept;
+
+    /// Queues a read of a whole entry. `archive` must outlive the request.
+    ReadHandle submit(const Archive& archive, EntryId entry, int priority = 0, ReadCallback callback = {});
+
+private:
+    std::shared_ptr<detail::StreamLoaderState> m_state;
+};
+
+} // namespace stockpile
@@ -0,0 +1,565 @@
+#pragma once
+
+#include "stockpile/error.hpp"
+#include "stockpile/format.hpp"
+#include "stockpile/record.hpp"
+#include "stockpile/schema.hpp"
+#include "stockpile/serialize.hpp"
+
+#include <algorithm>
+#include <array>
+#include <compare>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace stockpile {
+
+template <Reflected T>
+class TableView;
+
+/// A column of strings stored as codes into a dictionary of its distinct
+/// values.
+///
+/// The dictionary is sorted, so codes order rows the same way their strings
+/// would: an equality filter compares each row's code with the one find()
+/// returned, and a range filter compares it with lower_bound() results, both
+/// plain integer scans.
+class StringColumn {
+public:
+    StringColumn() noexcept = default;
+
+    [[nodiscard]] std::size_t size() const noexcept { return m_codes.size(); }
+
+    /// Dictionary code of every row.
+    [[nodiscard]] std::span<const std::uint32_t> codes() const noexcept { return m_codes; }
+
+    [[nodiscard]] std::size_t dictionary_size() const noexcept { return m_ends.size(); }
+
+    /// String with dictionary code `code`, which must be below dictionary_size().
+    [[nodiscard]] std::string_view value(std::uint32_t code) const noexcept {
+        const std::uint32_t begin = code == 0 ? 0 : m_ends[code - 1];
+        return {m_chars + begin, m_ends[code] - begin};
+    }
+
+    [[nodiscard]] std::string_view operator[](std::size_t row) const noexcept { return value(m_codes[row]); }
+
+    /// Code of `text` if some row holds it.
+    [[nodiscard]] std::optional<std::uint32_t> find(std::string_view text) const noexcept;
+
+    /// First code whose string is not less than `text`, or dictionary_size().
+    [[nodiscard]] std::uint32_t lower_bound(std::string_view text) const noexcept;
+
+private:
+    friend class Table;
+
+    std::span<const std::uint32_t> m_codes;
+    std::span<const std::uint32_t> m_ends;
+    const char* m_chars = nullptr;
+};
+
+/// Secondary index on a table field, declared with STOCKPILE_TABLE_INDEXES
+/// and built by encode_table().
+template <auto Member, format::IndexKind Kind>
+struct TableIndex {
+    static constexpr auto member = Member;
+    static constexpr format::IndexKind kind = Kind;
+};
+
+/// Answers TableView::equal() on `Member` with one probe of a hash table.
+/// Floating-point fields cannot have one, since equal floats may differ in
+/// their bytes.
+template <auto Member>
+inline constexpr TableIndex<Member, format::IndexKind::hash> hash_index{};
+
+/// Answers TableView::range(), at_least(), below() and equal() on `Member`
+/// by binary search, returning the matching rows in ascending field order.
+template <auto Member>
+inline constexpr TableIndex<Member, format::IndexKind::sorted> sorted_index{};
+
+template <typename... Indexes>
+[[nodiscard]] constexpr std::tuple<Indexes...> make_indexes(Indexes... indexes) noexcept {
+    return {indexes...};
+}
+
+namespace detail {
+
+template <typename T>
+[[nodiscard]] constexpr auto table_indexes_of() noexcept {
+    if constexpr (requires { stockpile_table_indexes(static_cast<const T*>(nullptr)); }) {
+        return stockpile_table_indexes(static_cast<const T*>(nullptr));
+    } else {
+        return std::tuple<>{};
+    }
+}
+
+/// Order of sorted index keys: `<`, except that floating-point keys follow
+/// std::strong_order so that NaNs have a place too.
+struct KeyLess {
+    template <typename K>
+    [[nodiscard]] constexpr bool operator()(const K& a, const K& b) const noexcept {
+        if constexpr (std::is_floating_point_v<K>) {
+            return std::strong_order(a, b) < 0;
+        } else {
+            return a < b;
+        }
+    }
+};
+
+template <typename V>
+inline constexpr bool is_string_column_v = std::is_same_v<V, std::string> || std::is_same_v<V, std::string_view>;
+
+/// How a non-string column of V is stored.
+template <typename V>
+[[nodiscard]] consteval format::ColumnKind column_kind() noexcept {
+    if constexpr (std::is_same_v<V, bool>) {
+        return format::ColumnKind::boolean;
+    } else if constexpr (std::is_enum_v<V>) {
+        return column_kind<std::underlying_type_t<V>>();
+    } else if constexpr (std::is_integral_v<V> && std::is_signed_v<V>) {
+        return format::ColumnKind::signed_int;
+    } else if constexpr (std::is_integral_v<V>) {
+        return format::ColumnKind::unsigned_int;
+    } else if constexpr (std::is_floating_point_v<V>) {
+        return format::ColumnKind::floating;
+    } else if constexpr (is_flat_v<V> && alignof(V) <= format::kAlignment) {
+        return format::ColumnKind::flat;
+    } else {
+        static_assert(always_false<V>, "table columns must be scalars, flat types or strings");
+    }
+}
+
+/// Writes the table header and column data that encode_table() produces.
+class TableEncoder {
+public:
+    TableEncoder(SaveWriter& writer, std::uint32_t schema_version, std::size_t column_count,
+                 std::size_t index_count, std::uint64_t row_count);
+
+    /// Starts the next column; the caller then writes its row_count elements.
+    void begin_column(std::uint32_t key, format::ColumnKind kind, std::uint32_t element_size);
+
+    /// Writes the next column as dictionary codes and the dictionary.
+    [[nodiscard]] Result<void> add_strings(std::uint32_t key, std::span<const std::string_view> values);
+
+    /// Builds the next index over column `column`, once every column is written.
+    [[nodiscard]] Result<void> add_index(std::size_t column, format::IndexKind kind);
+
+    /// Fills in the table size once every column and index is written.
+    void finish();
+
+private:
+    [[nodiscard]] std::size_t next_header(std::uint32_t key, format::ColumnKind kind, std::uint32_t element_size);
+
+    SaveWriter* m_writer;
+    std::size_t m_start;
+    std::size_t m_column_count;
+    std::uint64_t m_row_count;
+    std::size_t m_column = 0;
+    std::size_t m_index = 0;
+};
+
+template <Reflected T, typename F>
+[[nodiscard]] Result<void> encode_column(TableEncoder& encoder, SaveWriter& writer, const F& field,
+                                         std::span<const T> rows) {
+    using V = typename F::member_type;
+    const std::uint32_t key = field_key(field.name);
+    if constexpr (is_string_column_v<V>) {
+        std::vector<std::string_view> values;
+        values.reserve(rows.size());
+        for (const T& row : rows) {
+            values.emplace_back(row.*(field.member));
+        }
+        return encoder.add_strings(key, values);
+    } else {
+        encoder.begin_column(key, column_kind<V>(), sizeof(V));
+        for (const T& row : rows) {
+            if constexpr (Scalar<V>) {
+                writer.write(row.*(field.member));
+            } else {
+                writer.write_bytes(std::as_bytes(std::span(&(row.*(field.member)), 1)));
+            }
+        }
+        return {};
+    }
+}
+
+} // namespace detail
+
+/// Indexes declared for T with STOCKPILE_TABLE_INDEXES.
+template <typename T>
+inline constexpr auto table_indexes = detail::table_indexes_of<T>();
+
+namespace detail {
+
+template <typename T, typename Index>
+[[nodiscard]] consteval bool valid_index() noexcept {
+    using V = typename member_pointer_traits<std::remove_cv_t<decltype(Index::member)>>::member_type;
+    if constexpr (field_index<T, Index::member>() ==
+                  std::tuple_size_v<std::remove_cvref_t<decltype(schema_fields<T>)>>) {
+        return false;
+    } else if constexpr (is_string_column_v<V>) {
+        return true;
+    } else if constexpr (Index::kind == format::IndexKind::hash) {
+        return column_kind<V>() != format::ColumnKind::floating && column_kind<V>() != format::ColumnKind::flat;
+    } else {
+        return column_kind<V>() != format::ColumnKind::flat;
+    }
+}
+
+} // namespace detail
+
+/// Appends `rows` to `writer` as a columnar table: for every schema field
+/// of T, the field's value in each row, stored contiguously. Fields must be
+/// scalars, flat types or strings (std::string or std::string_view);
+/// strings are dictionary-encoded. The indexes declared for T with
+/// STOCKPILE_TABLE_INDEXES are built and stored along with the columns.
+/// Fails with Errc::too_large if a string column's dictionary exceeds 4 GiB
+/// or an indexed table has 2^32 rows or more.
+///
+/// Store the result as an uncompressed archive entry so Table::open() can
+/// read it in place from the mapping.
+template <Reflected T>
+[[nodiscard]] Result<void> encode_table(SaveWriter& writer, std::span<const T> rows) {
+    static_assert(detail::unique_keys<T>(), "two field names of this schema have the same key");
+    constexpr std::size_t count = std::tuple_size_v<std::remove_cvref_t<decltype(schema_fields<T>)>>;
+    constexpr std::size_t index_count = std::tuple_size_v<std::remove_cvref_t<decltype(table_indexes<T>)>>;
+
+    detail::TableEncoder encoder(writer, schema_version<T>(), count, index_count, rows.size());
+    Result<void> result;
+    std::apply([&](const auto&... fields) { ((result = detail::encode_column(encoder, writer, fields, rows)) && ...); },
+               schema_fields<T>);
+    std::apply(
+        [&]<typename... Indexes>(const Indexes&...) {
+            static_assert((detail::valid_index<T, Indexes>() && ...),
+                          "indexes need a schema field; hash indexes cannot be on floating-point fields");
+            static_cast<void>((result && ... &&
+                               (result = encoder.add_index(detail::field_index<T, Indexes::member>(), Indexes::kind))));
+        },
+        table_indexes<T>);
+    if (!result) {
+        return result;
+    }
+    encoder.finish();
+    return {};
+}
+
+/// Read-only view of a table written by encode_table().
+///
+/// The table is validated once in open(); afterwards columns are spans
+/// straight into the bytes it was opened on, which must outlive it. A pass
+/// over one column touches only that column's memory, so filters and
+/// aggregates over it stream through the cache and vectorize like a loop over
+/// a plain array.
+class Table {
+public:
+    Table() noexcept = default;
+
+    /// Validates the table in `bytes`, which must start on a 16-byte
+    /// boundary, as the data of an archive entry does.
+    [[nodiscard]] static Result<Table> open(std::span<const std::byte> bytes) noexcept;
+
+    [[nodiscard]] std::size_t row_count() const noexcept { return static_cast<std::size_t>(m_rows); }
+    [[nodiscard]] std::size_t column_count() const noexcept { return m_columns.size(); }
+
+    /// STOCKPILE_SCHEMA_VERSION of the row type the table was built from.
+    [[nodiscard]] std::uint32_t schema_version() const noexcept { return m_schema_version; }
+
+    [[nodiscard]] bool has(std::string_view name) const noexcept { return find(field_key(name)).has_value(); }
+
+    /// Column `name` as values of V. Fails with Errc::missing_field if the
+    /// table has no such column and Errc::malformed_data if it holds
+    /// another type.
+    template <typename V>
+        requires(!detail::is_string_column_v<V>)
+    [[nodiscard]] Result<std::span<const V>> column(std::string_view name) const noexcept {
+        const auto index = find(field_key(name));
+        if (!index) {
+            return fail(Errc::missing_field);
+        }
+        if (!holds<V>(*index)) {
+            return fail(Errc::malformed_data);
+        }
+        return column_at<V>(*index);
+    }
+
+    /// String column `name`. Fails like column().
+    [[nodiscard]] Result<StringColumn> strings(std::string_view name) const noexcept;
+
+private:
+    template <Reflected T>
+    friend class TableView;
+
+    /// Index of the column with `key`. Tables list their columns in schema
+    /// order, so `hint` is checked first.
+    [[nodiscard]] std::optional<std::size_t>
+    find(std::uint32_t key, std::size_t hint = std::numeric_limits<std::size_t>::max()) const noexcept;
+
+    template <typename V>
+    [[nodiscard]] bool holds(std::size_t index) const noexcept {
+        if constexpr (detail::is_string_column_v<V>) {
+            return m_columns[index].kind == format::ColumnKind::string;
+        } else {
+            return m_columns[index].kind == detail::column_kind<V>() && m_columns[index].element_size == sizeof(V);
+        }
+    }
+
+    template <typename V>
+    [[nodiscard]] std::span<const V> column_at(std::size_t index) const noexcept {
+        return {reinterpret_cast<const V*>(m_bytes.data() + m_columns[index].data_offset), row_count()};
+    }
+
+    [[nodiscard]] StringColumn strings_at(std::size_t index) const noexcept;
+
+    /// Position of the index of `kind` over column `column`.
+    [[nodiscard]] std::optional<std::size_t> find_index(std::size_t column, format::IndexKind kind) const noexcept;
+
+    [[nodiscard]] std::span<const std::uint32_t> index_rows(std::size_t index) const noexcept {
+        return {reinterpret_cast<const std::uint32_t*>(m_bytes.data() + m_indexes[index].rows_offset), row_count()};
+    }
+
+    /// Rows of hash index `index` whose value has the bytes `key`.
+    [[nodiscard]] std::span<const std::uint32_t> hash_lookup(std::size_t index,
+                                                             std::span<const std::byte> key) const noexcept;
+
+    /// Keys of sorted index `index`, in ascending order.
+    template <typename K>
+    [[nodiscard]] std::span<const K> sorted_keys(std::size_t index) const noexcept {
+        return {reinterpret_cast<const K*>(m_bytes.data() + m_indexes[index].data_offset), row_count()};
+    }
+
+    std::span<const std::byte> m_bytes;
+    std::span<const format::ColumnHeader> m_columns;
+    std::span<const format::IndexHeader> m_indexes;
+    std::uint64_t m_rows = 0;
+    std::uint32_t m_schema_version = 0;
+};
+
+/// Table whose columns are the schema fields of T, resolved once in open().
+///
+///     auto items = TableView<Item>::open(archive.data(*id));
+///     float total = 0;
+///     for (const float weight : items->column<&Item::weight>()) {
+///         total += weight;
+///     }
+///
+/// column() returns a std::span of the field's type, or a StringColumn for
+/// string fields. Fields with an index declared by STOCKPILE_TABLE_INDEXES
+/// can also be queried without a scan:
+///
+///     for (const std::uint32_t row : items->at_least<&Item::rarity>(Rarity::epic)) { ... }
+///     auto owner = entities->equal<&Entity::guid>(guid);  // span of matching rows
+template <Reflected T>
+class TableView {
+public:
+    TableView() noexcept = default;
+
+    /// Type the index queries on `Member` take: std::string_view for string
+    /// fields, the field's own type otherwise.
+    template <auto Member>
+    using key_type = std::conditional_t<
+        detail::is_string_column_v<typename detail::member_pointer_traits<decltype(Member)>::member_type>,
+        std::string_view, typename detail::member_pointer_traits<decltype(Member)>::member_type>;
+
+    /// Opens the table in `bytes` and checks that it has a column of the
+    /// right type for every schema field of T, and every declared index.
+    [[nodiscard]] static Result<TableView> open(std::span<const std::byte> bytes) noexcept {
+        auto table = Table::open(bytes);
+        if (!table) {
+            return std::unexpected(table.error());
+        }
+        TableView view;
+        view.m_table = *table;
+        Result<void> result;
+        [&]<std::size_t... I>(std::index_sequence<I...>) {
+            ((result = view.template resolve<I>()) && ...);
+        }(std::make_index_sequence<kFieldCount>{});
+        [&]<std::size_t... I>(std::index_sequence<I...>) {
+            static_cast<void>((result && ... && (result = view.template resolve_index<I>())));
+        }(std::make_index_sequence<kIndexCount>{});
+        if (!result) {
+            return std::unexpected(result.error());
+        }
+        return view;
+    }
+
+    [[nodiscard]] std::size_t size() const noexcept { return m_table.row_count(); }
+    [[nodiscard]] const Table& table() const noexcept { return m_table; }
+
+    template <auto Member>
+    [[nodiscard]] auto column() const noexcept {
+        using V = typename detail::member_pointer_traits<decltype(Member)>::member_type;
+        constexpr std::size_t index = detail::field_index<T, Member>();
+        static_assert(index < kFieldCount, "member is not part of the schema");
+        if constexpr (detail::is_string_column_v<V>) {
+            return m_table.strings_at(m_columns[index]);
+        } else {
+            return m_table.column_at<V>(m_columns[index]);
+        }
+    }
+
+    /// Gathers row `index` back into a T. String fields of type
+    /// std::string_view point into the table.
+    [[nodiscard]] T row(std::size_t index) const {
+        T value{};
+        [&]<std::size_t... I>(std::index_sequence<I...>) {
+            ((value.*(std::get<I>(schema_fields<T>).member) =
+                  typename std::tuple_element_t<I, Fields>::member_type(
+                      column<std::get<I>(schema_fields<T>).member>()[index])),
+             ...);
+        }(std::make_index_sequence<kFieldCount>{});
+        return value;
+    }
+
+    /// Rows whose `Member` equals `value`: in row order through a hash index
+    /// if the field has one, otherwise in field order through a sorted index.
+    template <auto Member>
+    [[nodiscard]] std::span<const std::uint32_t> equal(const key_type<Member>& value) const noexcept {
+        constexpr std::size_t index = declared_index<Member, format::IndexKind::hash>();
+        if constexpr (index < kIndexCount) {
+            if constexpr (detail::is_string_column_v<field_type<Member>>) {
+                const auto code = column<Member>().find(value);
+                if (!code) {
+                    return {};
+                }
+                return m_table.hash_lookup(m_indexes[index], std::as_bytes(std::span(&*code, 1)));
+            } else {
+                return m_table.hash_lookup(m_indexes[index], std::as_bytes(std::span(&value, 1)));
+            }
+        } else {
+            return sorted_rows<Member>(&value, &value, true);
+        }
+    }
+
+    /// Rows whose `Member` lies in [low, high), in field order.
+    template <auto Member>
+    [[nodiscard]] std::span<const std::uint32_t> range(const key_type<Member>& low,
+                                                       const key_type<Member>& high) const noexcept {
+        return sorted_rows<Member>(&low, &high, false);
+    }
+
+    /// Rows whose `Member` is at least `low`, in field order.
+    template <auto Member>
+    [[nodiscard]] std::span<const std::uint32_t> at_least(const key_type<Member>& low) const noexcept {
+        return sorted_rows<Member>(&low, nullptr, false);
+    }
+
+    /// Rows whose `Member` is below `high`, in field order.
+    template <auto Member>
+    [[nodiscard]] std::span<const std::uint32_t> below(const key_type<Member>& high) const noexcept {
+        return sorted_rows<Member>(nullptr, &high, false);
+    }
+
+private:
+    using Fields = std::remove_cvref_t<decltype(schema_fields<T>)>;
+    using Indexes = std::remove_cvref_t<decltype(table_indexes<T>)>;
+    static constexpr std::size_t kFieldCount = std::tuple_size_v<Fields>;
+    static constexpr std::size_t kIndexCount = std::tuple_size_v<Indexes>;
+
+    template <auto Member>
+    using field_type = typename detail::member_pointer_traits<decltype(Member)>::member_type;
+
+    template <auto Member, format::IndexKind Kind, typename Index>
+    [[nodiscard]] static consteval bool indexes() noexcept {
+        if constexpr (std::is_same_v<std::remove_cv_t<decltype(Index::member)>, decltype(Member)>) {
+            return Index::kind == Kind && Index::member == Member;
+        } else {
+            return false;
+        }
+    }
+
+    /// Position of the declared index of `Kind` on `Member`, or kIndexCount.
+    template <auto Member, format::IndexKind Kind>
+    [[nodiscard]] static consteval std::size_t declared_index() noexcept {
+        return []<std::size_t... I>(std::index_sequence<I...>) {
+            std::size_t found = kIndexCount;
+            ((found = found == kIndexCount && indexes<Member, Kind, std::tuple_element_t<I, Indexes>>() ? I : found),
+             ...);
+            return found;
+        }(std::make_index_sequence<kIndexCount>{});
+    }
+
+    /// Rows of the sorted index on `Member` from `low` (inclusive) up to
+    /// `high`, inclusive or not as flagged. A null bound is open.
+    template <auto Member>
+    [[nodiscard]] std::span<const std::uint32_t> sorted_rows(const key_type<Member>* low, const key_type<Member>* high,
+                                                             bool high_inclusive) const noexcept {
+        constexpr std::size_t index = declared_index<Member, format::IndexKind::sorted>();
+        static_assert(index < kIndexCount, "declare an index on this field with STOCKPILE_TABLE_INDEXES");
+        const auto rows = m_table.index_rows(m_indexes[index]);
+        if constexpr (detail::is_string_column_v<field_type<Member>>) {
+            // The dictionary is sorted, so string bounds become code bounds.
+            const StringColumn strings = column<Member>();
+            const auto keys = m_table.sorted_keys<std::uint32_t>(m_indexes[index]);
+            const std::size_t begin =
+                low == nullptr ? 0 : std::ranges::lower_bound(keys, strings.lower_bound(*low)) - keys.begin();
+            std::size_t end = keys.size();
+            if (high != nullptr) {
+                std::uint32_t code = strings.lower_bound(*high);
+                if (high_inclusive && code < strings.dictionary_size() && strings.value(code) == *high) {
+                    ++code;
+                }
+                end = std::ranges::lower_bound(keys, code) - keys.begin();
+            }
+            return begin < end ? rows.subspan(begin, end - begin) : std::span<const std::uint32_t>{};
+        } else {
+            const auto keys = m_table.sorted_keys<field_type<Member>>(m_indexes[index]);
+            const std::size_t begin =
+                low == nullptr ? 0 : std::ranges::lower_bound(keys, *low, detail::KeyLess{}) - keys.begin();
+            std::size_t end = keys.size();
+            if (high != nullptr) {
+                end = (high_inclusive ? std::ranges::upper_bound(keys, *high, detail::KeyLess{})
+                                      : std::ranges::lower_bound(keys, *high, detail::KeyLess{})) -
+                      keys.begin();
+            }
+            return begin < end ? rows.subspan(begin, end - begin) : std::span<const std::uint32_t>{};
+        }
+    }
+
+    template <std::size_t I>
+    [[nodiscard]] Result<void> resolve() noexcept {
+        using V = typename std::tuple_element_t<I, Fields>::member_type;
+        const auto index = m_table.find(field_key(std::get<I>(schema_fields<T>).name), I);
+        if (!index) {
+            return fail(Errc::missing_field);
+        }
+        if (!m_table.holds<V>(*index)) {
+            return fail(Errc::malformed_data);
+        }
+        m_columns[I] = *index;
+        return {};
+    }
+
+    template <std::size_t I>
+    [[nodiscard]] Result<void> resolve_index() noexcept {
+        using Index = std::tuple_element_t<I, Indexes>;
+        const auto index = m_table.find_index(m_columns[detail::field_index<T, Index::member>()], Index::kind);
+        if (!index) {
+            return fail(Errc::missing_field);
+        }
+        m_indexes[I] = *index;
+        return {};
+    }
+
+    Table m_table;
+    std::array<std::size_t, kFieldCount> m_columns{};
+    std::array<std::size_t, kIndexCount> m_indexes{};
+};
+
+} // namespace stockpile
+
+/// Declares the secondary indexes of table rows of `Type`, each a
+/// stockpile::hash_index or stockpile::sorted_index of one of its fields.
+///
+///     STOCKPILE_TABLE_INDEXES(Item, stockpile::hash_index<&Item::id>, stockpile::sorted_index<&Item::rarity>)
+#define STOCKPILE_TABLE_INDEXES(Type, ...)                                            \
+    [[maybe_unused]] constexpr auto stockpile_table_indexes(const Type*) noexcept { \
+        return ::stockpile::make_indexes(__VA_ARGS__);                               \
+    }
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace stockpile {
+
+/// Fixed set of worker threads draining a FIFO task queue.
+class ThreadPool {
+public:
+    /// Starts `threads` workers; 0 means one per hardware thread.
+    explicit ThreadPool(std::size_t threads = 0);
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+    /// Finishes queued tasks, then joins the workers.
+    ~ThreadPool();
+
+    [[nodiscard]] std::size_t size() const noexcept { return m_workers.size(); }
+
+    void submit(std::move_only_function<void()> task);
+
+    /// Calls `fn(i)` for every i in [0, count) and returns once all calls
+    /// have finished. The calling thread takes part, so this is safe to use
+    /// from inside a pool task.
+    void parallel_for(std::size_t count, const std::function<void(std::size_t)>& fn);
+
+private:
+    void run();
+
+    std::mutex m_mutex;
+    std::condition_variable m_wake;
+    std::deque<std::move_only_function<void()>> m_tasks;
+    bool m_stopping = false;
+    std::vector<std::thread> m_workers;
+};
+
+} // namespace stockpile
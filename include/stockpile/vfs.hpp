@@ -0,0 +1,167 @@
+#pragma once
+
+#include "stockpile/archive.hpp"
+#include "stockpile/error.hpp"
+#include "stockpile/merged_index.hpp"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace stockpile {
+
+class ThreadPool;
+
+namespace detail {
+struct VfsLayer;
+} // namespace detail
+
+/// Identifies a mounted layer of a Vfs; never reused.
+using LayerId = std::uint32_t;
+
+/// A file of a Vfs, valid until its layer is unmounted.
+struct VfsRef {
+    LayerId layer;
+    std::uint32_t entry;
+
+    friend bool operator==(const VfsRef&, const VfsRef&) = default;
+};
+
+struct MountOptions {
+    /// Directory of the Vfs under which the layer's paths appear, e.g.
+    /// "dlc/winter" makes an archive's "maps/town.bin" "dlc/winter/maps/town.bin".
+    /// Empty for the root.
+    std::string mount_point;
+    /// Where a path is in several layers, the one with the highest priority
+    /// wins, and among equals the one mounted last.
+    int priority = 0;
+};
+
+/// A file held in memory by a layer of a Vfs.
+struct MemoryFile {
+    std::string path;
+    std::vector<std::byte> data;
+};
+
+/// One namespace over archives, loose directories and files in memory.
+///
+/// Each mount adds a layer at a mount point with a priority, so shipped
+/// packs, DLC packs, a developer's loose asset folder and generated data
+/// can override one another as ArchiveSet patches do; tombstones in an
+/// archive hide the path in lower layers. Lookups go through one merged
+/// index of all visible paths, split into a base and an overlay as in
+/// ArchiveSet, so find() costs one probe, or two, however many layers there
+/// are. Mounting a layer above the base copies only the overlay, and an
+/// archive mounted at the root adds the hashes of its own path index
+/// instead of hashing its paths again. Loose directories are listed when
+/// they are mounted: files added later are not seen until the directory is
+/// mounted again.
+///
+/// Lookups and reads are lock-free and safe from any number of threads, as
+/// with ArchiveSet: mounts publish a new immutable index with one atomic
+/// store. Indexes and unmounted layers stay allocated until reclaim().
+class Vfs {
+public:
+    Vfs();
+    Vfs(const Vfs&) = delete;
+    Vfs& operator=(const Vfs&) = delete;
+    ~Vfs();
+
+    /// Mounts an archive. Fails with Errc::hash_collision, leaving the Vfs
+    /// unchanged, if one of its paths has the same hash as a different path
+    /// already mounted; the same holds for the other mounts.
+    [[nodiscard]] Result<LayerId> mount(Archive archive, const MountOptions& options = {});
+    [[nodiscard]] Result<LayerId> mount(const std::filesystem::path& archive, const MountOptions& options = {});
+
+    /// Mounts the regular files below `directory`, keyed by their paths
+    /// relative to it. Files whose paths are not valid archive paths are
+    /// skipped. They are read from disk on every read().
+    [[nodiscard]] Result<LayerId> mount_directory(const std::filesystem::path& directory,
+                                                  const MountOptions& options = {});
+
+    /// Mounts files held in memory, e.g. generated at startup.
+    [[nodiscard]] Result<LayerId> mount_memory(std::vector<MemoryFile> files, const MountOptions& options = {});
+
+    /// Removes a layer. References into it must not be used afterwards.
+    [[nodiscard]] Result<void> unmount(LayerId layer);
+
+    /// Frees the indexes replaced by mounts and the layers unmounted since
+    /// the last call. Call it only while no other thread is inside a member
+    /// function of the Vfs.
+    void reclaim();
+
+    /// Number of visible paths.
+    [[nodiscard]] std::size_t entry_count() const noexcept { return table().visible; }
+
+    /// Finds the file for `path` in the highest layer that has it.
+    [[nodiscard]] std::optional<VfsRef> find(std::string_view path) const noexcept;
+
+    /// Same as find(), for callers that already hold hash_path(path).
+    [[nodiscard]] std::optional<VfsRef> find_hash(std::uint64_t path_hash) const noexcept;
+
+    [[nodiscard]] std::string path(VfsRef ref) const;
+
+    /// Decoded size; for loose files, the size when the directory was mounted.
+    [[nodiscard]] std::uint64_t size(VfsRef ref) const noexcept;
+
+    /// Bytes of a file that are already in memory: the stored bytes of an
+    /// archive entry (see Archive::data()) or a memory file. Empty for loose
+    /// files, which have to be read().
+    [[nodiscard]] std::span<const std::byte> data(VfsRef ref) const noexcept;
+
+    /// Reads a whole file into `out`, which must be exactly size(ref) bytes.
+    [[nodiscard]] Result<void> read(VfsRef ref, std::span<std::byte> out, ThreadPool* pool = nullptr) const;
+
+private:
+    /// Everything lookups read. Never modified once published.
+    struct Table {
+        /// Indexed by LayerId; null once unmounted.
+        std::vector<std::shared_ptr<const detail::VfsLayer>> layers;
+        /// Mounted layers, lowest first: by priority, then mount order.
+        std::vector<LayerId> order;
+        /// Merged index of the first `base_count` layers of `order`; never
+        /// null.
+        std::shared_ptr<const detail::MergedIndex> base = std::make_shared<const detail::MergedIndex>();
+        std::size_t base_count = 0;
+        /// Paths visible through the base alone.
+        std::size_t base_visible = 0;
+        /// Merged index of the layers of `order` from `base_count` up. Its
+        /// slots shadow those of the base.
+        detail::MergedIndex overlay;
+        std::size_t visible = 0;
+    };
+
+    [[nodiscard]] const Table& table() const noexcept { return *m_table.load(std::memory_order_acquire); }
+    [[nodiscard]] const detail::VfsLayer& layer(VfsRef ref) const noexcept { return *table().layers[ref.layer]; }
+    [[nodiscard]] Result<LayerId> add(std::shared_ptr<detail::VfsLayer> layer, const MountOptions& options);
+    /// Adds the layer at `order[position]` of `table` to `target`, which
+    /// shadows `below` (null if nothing is below it). `path` is scratch space.
+    [[nodiscard]] static Result<void> insert(const Table& table, detail::MergedIndex& target,
+                                             const detail::MergedIndex* below, std::size_t position,
+                                             std::size_t& visible, std::string& path);
+    /// Rebuilds the overlay from the layers of `order` from `base_count` up.
+    /// If `from` is below `base_count`, the base is first rebuilt from the
+    /// layers below `from`, which becomes the new `base_count`.
+    [[nodiscard]] static Result<void> rebuild(Table& table, std::size_t from);
+    /// Merges the overlay into a new base once it grows past a quarter of
+    /// the current one.
+    static void fold(Table& table);
+    void publish(std::unique_ptr<Table> next);
+
+    std::atomic<const Table*> m_table;
+    /// Guards m_tables and serializes mounts.
+    std::mutex m_mount_mutex;
+    /// The current table last, preceded by the ones it replaced.
+    std::vector<std::unique_ptr<const Table>> m_tables;
+    std::uint64_t m_sequence = 0;
+};
+
+} // namespace stockpile
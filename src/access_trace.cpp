@@ -0,0 +1,109 @@
+#include "stockpile/access_trace.hpp"
+
+#include "stockpile/hash.hpp"
+
+#include <fstream>
+#include <new>
+
+namespace stockpile {
+
+namespace {
+
+constexpr std::string_view kHeader = "stockpile-trace 1";
+
+} // namespace
+
+std::size_t AccessTrace::PathHash::operator()(std::string_view path) const noexcept {
+    return static_cast<std::size_t>(hash_path(path));
+}
+
+void AccessTrace::record(std::string_view path) noexcept {
+    if (path.find_first_of("\r\n") != std::string_view::npos) {
+        return;
+    }
+    std::lock_guard lock(m_mutex);
+    if (m_seen.find(path) != m_seen.end()) {
+        return;
+    }
+    try {
+        m_order.reserve(m_order.size() + 1);
+        m_order.push_back(&*m_seen.emplace(path).first);
+    } catch (const std::bad_alloc&) {
+        // A trace only guides layout, so losing records is harmless.
+    }
+}
+
+void AccessTrace::record(const Archive& archive, EntryId id) noexcept {
+    // Paths are stored as directory trees; reuse one buffer per thread to
+    // put them together.
+    thread_local std::string path;
+    try {
+        path.clear();
+        archive.append_path(id, path);
+    } catch (const std::bad_alloc&) {
+        return;
+    }
+    record(path);
+}
+
+std::size_t AccessTrace::size() const {
+    std::lock_guard lock(m_mutex);
+    return m_order.size();
+}
+
+std::vector<std::string> AccessTrace::paths() const {
+    std::lock_guard lock(m_mutex);
+    std::vector<std::string> paths;
+    paths.reserve(m_order.size());
+    for (const auto* path : m_order) {
+        paths.push_back(*path);
+    }
+    return paths;
+}
+
+void AccessTrace::clear() {
+    std::lock_guard lock(m_mutex);
+    m_order.clear();
+    m_seen.clear();
+}
+
+Result<void> AccessTrace::load(const std::filesystem::path& file) {
+    std::ifstream in(file, std::ios::binary);
+    if (!in) {
+        return std::unexpected(std::make_error_code(std::errc::no_such_file_or_directory));
+    }
+    std::string line;
+    if (!std::getline(in, line) || line != kHeader) {
+        return fail(Errc::bad_magic);
+    }
+    while (std::getline(in, line)) {
+        if (line.ends_with('\r')) {
+            line.pop_back();
+        }
+        if (!line.empty()) {
+            record(line);
+        }
+    }
+    if (in.bad()) {
+        return std::unexpected(std::make_error_code(std::errc::io_error));
+    }
+    return {};
+}
+
+Result<void> AccessTrace::save(const std::filesystem::path& file) const {
+    std::ofstream out(file, std::ios::binary | std::ios::trunc);
+    out << kHeader << '\n';
+    {
+        std::lock_guard lock(m_mutex);
+        for (const auto* path : m_order) {
+            out << *path << '\n';
+        }
+    }
+    out.close();
+    if (out.fail()) {
+        return std::unexpected(std::make_error_code(std::errc::io_error));
+    }
+    return {};
+}
+
+} // namespace stockpile
@@ -0,0 +1,663 @@
+#include "stockpile/archive.hpp"
+
+#include "stockpile/access_trace.hpp"
+#include "stockpile/hash.hpp"
+#include "stockpile/thread_pool.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cstring>
+#include <limits>
+#include <utility>
+#include <vector>
+
+namespace stockpile {
+
+namespace {
+
+/// Next Archive::serial(); 0 is left for archives that were not opened.
+std::atomic<std::uint64_t> g_next_serial = 1;
+
+template <typename T>
+[[nodiscard]] const T* view_at(std::span<const std::byte> bytes, std::uint64_t offset) noexcept {
+    return reinterpret_cast<const T*>(bytes.data() + offset);
+}
+
+[[nodiscard]] bool in_bounds(std::uint64_t offset, std::uint64_t size, std::uint64_t limit) noexcept {
+    return offset <= limit && size <= limit - offset;
+}
+
+/// Returns the typed contents of a section, or an empty span if it is
+/// misaligned, out of bounds or not a whole number of records.
+template <typename T>
+[[nodiscard]] std::optional<std::span<const T>> section_span(std::span<const std::byte> bytes,
+                                                             const format::Section& section) noexcept {
+    if (!in_bounds(section.offset, section.size, bytes.size()) ||
+        section.offset % alignof(T) != 0 || section.size % sizeof(T) != 0) {
+        return std::nullopt;
+    }
+    return std::span<const T>(view_at<T>(bytes, section.offset), section.size / sizeof(T));
+}
+
+[[nodiscard]] bool valid_encoding(const format::EntryRecord& entry) noexcept {
+    if ((entry.flags & ~format::kKnownEntryFlags) != 0) {
+        return false;
+    }
+    if ((entry.flags & format::kEntryTombstone) != 0) {
+        return entry.codec == Codec::none && entry.size == 0 && entry.raw_size == 0;
+    }
+    switch (entry.codec) {
+    case Codec::none:
+        return entry.raw_size == entry.size;
+    case Codec::lz4:
+        return entry.block_shift >= format::kMinBlockShift && entry.block_shift <= format::kMaxBlockShift;
+    }
+    return false;
+}
+
+/// Block table and stored blocks of a compressed entry.
+class BlockReader {
+public:
+    BlockReader(const format::EntryRecord& entry, std::span<const std::byte> stored) noexcept
+        : m_codec(entry.codec), m_shift(entry.block_shift), m_raw_size(entry.raw_size) {
+        const std::uint64_t count = format::block_count(entry);
+        if (count <= stored.size() / sizeof(std::uint64_t)) {
+            m_table = stored.first(count * sizeof(std::uint64_t));
+            m_blocks = stored.subspan(m_table.size());
+            m_valid = true;
+        }
+    }
+
+    /// False if the block table does not fit in the stored bytes.
+    [[nodiscard]] bool valid() const noexcept { return m_valid; }
+
+    [[nodiscard]] std::uint64_t block_count() const noexcept {
+        return (m_raw_size + block_size() - 1) >> m_shift;
+    }
+    [[nodiscard]] std::uint64_t block_size() const noexcept { return std::uint64_t{1} << m_shift; }
+    [[nodiscard]] std::uint64_t block_start(std::uint64_t index) const noexcept { return index << m_shift; }
+    [[nodiscard]] std::uint64_t raw_block_size(std::uint64_t index) const noexcept {
+        return std::min(block_size(), m_raw_size - block_start(index));
+    }
+
+    /// Decodes block `index` into `out`, which must be raw_block_size(index) bytes.
+    [[nodiscard]] bool decode(std::uint64_t index, std::span<std::byte> out) const noexcept {
+        const std::uint64_t begin = index == 0 ? 0 : block_end(index - 1);
+        const std::uint64_t end = block_end(index);
+        if (begin > end || end > m_blocks.size()) {
+            return false;
+        }
+        const auto stored = m_blocks.subspan(begin, end - begin);
+        return decompress(stored.size() == out.size() ? Codec::none : m_codec, stored, out);
+    }
+
+private:
+    // The table is read with memcpy because `stored` may be a copy at any alignment.
+    [[nodiscard]] std::uint64_t block_end(std::uint64_t index) const noexcept {
+        std::uint64_t end;
+        std::memcpy(&end, m_table.data() + index * sizeof(end), sizeof(end));
+        return end;
+    }
+
+    Codec m_codec;
+    std::uint8_t m_shift;
+    std::uint64_t m_raw_size;
+    std::span<const std::byte> m_table;
+    std::span<const std::byte> m_blocks;
+    bool m_valid = false;
+};
+
+/// Whether `name` matches one glob component, in which '*' matches any run
+/// of characters and '?' any single character.
+[[nodiscard]] bool match_component(std::string_view pattern, std::string_view name) noexcept {
+    std::size_t p = 0;
+    std::size_t n = 0;
+    // On a mismatch after a '*', let that '*' take one more character.
+    std::size_t star = std::string_view::npos;
+    std::size_t resume = 0;
+    while (n < name.size()) {
+        if (p < pattern.size() && (pattern[p] == '?' || pattern[p] == name[n])) {
+            ++p;
+            ++n;
+        } else if (p < pattern.size() && pattern[p] == '*') {
+            star = p++;
+            resume = n;
+        } else if (star != std::string_view::npos) {
+            p = star + 1;
+            n = ++resume;
+        } else {
+            return false;
+        }
+    }
+    while (p < pattern.size() && pattern[p] == '*') {
+        ++p;
+    }
+    return p == pattern.size();
+}
+
+[[nodiscard]] bool has_wildcard(std::string_view component) noexcept {
+    return component.find_first_of("*?") != std::string_view::npos;
+}
+
+/// Directory traversal for Archive::glob(). Each directory is visited with
+/// the set of pattern components that the path so far can continue with,
+/// so no entry is visited twice however many ways "**" lets it match.
+class GlobWalk {
+public:
+    GlobWalk(const Archive& archive, std::vector<std::string_view> parts,
+             const std::function<void(EntryId)>& fn) noexcept
+        : m_archive(archive), m_parts(std::move(parts)), m_fn(fn) {}
+
+    void visit(DirectoryId directory, std::vector<std::uint32_t> states) const {
+        // "**" may also match no directory at all.
+        for (std::size_t i = 0; i < states.size(); ++i) {
+            if (is_any(states[i]) && states[i] != last()) {
+                states.push_back(states[i] + 1);
+            }
+        }
+        std::sort(states.begin(), states.end());
+        states.erase(std::unique(states.begin(), states.end()), states.end());
+
+        visit_entries(directory, states);
+
+        const bool scan = std::any_of(states.begin(), states.end(), [&](std::uint32_t state) {
+            return is_any(state) || (state != last() && has_wildcard(m_parts[state]));
+        });
+        if (scan) {
+            for (const DirectoryId child : m_archive.subdirectories(directory)) {
+                std::vector<std::uint32_t> next;
+                for (const auto state : states) {
+                    if (is_any(state)) {
+                        next.push_back(state);
+                    } else if (state != last() && match_component(m_parts[state], m_archive.directory_name(child))) {
+                        next.push_back(state + 1);
+                    }
+                }
+                if (!next.empty()) {
+                    visit(child, std::move(next));
+                }
+            }
+            return;
+        }
+        // Only literal names: look the children up. Several states may
+        // name the same child, which is then visited once with all of them.
+        std::vector<std::pair<DirectoryId, std::uint32_t>> found;
+        for (const auto state : states) {
+            if (state == last()) {
+                continue;
+            }
+            const auto children = m_archive.subdirectories(directory);
+            const auto it = std::ranges::lower_bound(children, m_parts[state], {}, [&](DirectoryId child) {
+                return m_archive.directory_name(child);
+            });
+            if (it != children.end() && m_archive.directory_name(*it) == m_parts[state]) {
+                found.emplace_back(*it, state + 1);
+            }
+        }
+        std::sort(found.begin(), found.end());
+        for (std::size_t i = 0; i < found.size();) {
+            std::vector<std::uint32_t> next;
+            std::size_t j = i;
+            for (; j < found.size() && found[j].first == found[i].first; ++j) {
+                next.push_back(found[j].second);
+            }
+            visit(found[i].first, std::move(next));
+            i = j;
+        }
+    }
+
+private:
+    [[nodiscard]] std::uint32_t last() const noexcept { return static_cast<std::uint32_t>(m_parts.size() - 1); }
+    [[nodiscard]] bool is_any(std::uint32_t state) const noexcept { return m_parts[state] == "**"; }
+
+    void visit_entries(DirectoryId directory, std::span<const std::uint32_t> states) const {
+        if (states.empty() || states.back() != last()) {
+            return;
+        }
+        const auto part = m_parts[last()];
+        const auto entries = m_archive.entries(directory);
+        if (is_any(last()) || has_wildcard(part)) {
+            for (const EntryId id : entries) {
+                if (is_any(last()) || match_component(part, m_archive.name(id))) {
+                    m_fn(id);
+                }
+            }
+            return;
+        }
+        const auto it = std::ranges::lower_bound(entries, part, {}, [&](EntryId id) { return m_archive.name(id); });
+        if (it != entries.end() && m_archive.name(*it) == part) {
+            m_fn(*it);
+        }
+    }
+
+    const Archive& m_archive;
+    std::vector<std::string_view> m_parts;
+    const std::function<void(EntryId)>& m_fn;
+};
+
+} // namespace
+
+Archive::Archive(Archive&& other) noexcept
+    : m_file(std::move(other.m_file)),
+      m_entries(std::exchange(other.m_entries, {})),
+      m_names(std::exchange(other.m_names, {})),
+      m_directories(std::exchange(other.m_directories, {})),
+      m_slots(std::exchange(other.m_slots, {})),
+      m_trace(other.m_trace.exchange(nullptr, std::memory_order_relaxed)),
+      m_serial(std::exchange(other.m_serial, 0)) {}
+
+Archive& Archive::operator=(Archive&& other) noexcept {
+    if (this != &other) {
+        m_file = std::move(other.m_file);
+        m_entries = std::exchange(other.m_entries, {});
+        m_names = std::exchange(other.m_names, {});
+        m_directories = std::exchange(other.m_directories, {});
+        m_slots = std::exchange(other.m_slots, {});
+        m_trace.store(other.m_trace.exchange(nullptr, std::memory_order_relaxed), std::memory_order_relaxed);
+        m_serial = std::exchange(other.m_serial, 0);
+    }
+    return *this;
+}
+
+Result<Archive> Archive::open(const std::filesystem::path& path) {
+    Archive archive;
+    auto file = MappedFile::open(path);
+    if (!file) {
+        return std::unexpected(file.error());
+    }
+    archive.m_file = std::move(*file);
+    if (auto loaded = archive.load(); !loaded) {
+        return std::unexpected(loaded.error());
+    }
+    archive.m_serial = g_next_serial.fetch_add(1, std::memory_order_relaxed);
+    return archive;
+}
+
+Result<void> Archive::load() {
+    const auto bytes = m_file.bytes();
+    if (bytes.size() < sizeof(format::Header)) {
+        return fail(Errc::bad_magic);
+    }
+
+    format::Header header;
+    std::memcpy(&header, bytes.data(), sizeof(header));
+    if (header.magic != format::kMagic) {
+        return fail(Errc::bad_magic);
+    }
+    if (header.version != format::kVersion) {
+        return fail(Errc::unsupported_version);
+    }
+    if (header.file_size != bytes.size() ||
+        header.section_table_offset % alignof(format::Section) != 0 ||
+        !in_bounds(header.section_table_offset,
+                   std::uint64_t{header.section_count} * sizeof(format::Section), bytes.size())) {
+        return fail(Errc::corrupt_archive);
+    }
+
+    const std::span sections(view_at<format::Section>(bytes, header.section_table_offset),
+                             header.section_count);
+    bool have_entries = false;
+    for (const auto& section : sections) {
+        switch (section.kind) {
+        case format::SectionKind::entries: {
+            auto entries = section_span<format::EntryRecord>(bytes, section);
+            if (!entries) {
+                return fail(Errc::corrupt_archive);
+            }
+            m_entries = *entries;
+            have_entries = true;
+            break;
+        }
+        case format::SectionKind::names: {
+            auto names = section_span<char>(bytes, section);
+            if (!names) {
+                return fail(Errc::corrupt_archive);
+            }
+            m_names = *names;
+            break;
+        }
+        case format::SectionKind::directories: {
+            auto directories = section_span<format::DirectoryRecord>(bytes, section);
+            if (!directories) {
+                return fail(Errc::corrupt_archive);
+            }
+            m_directories = *directories;
+            break;
+        }
+        case format::SectionKind::path_index: {
+            auto slots = section_span<format::HashSlot>(bytes, section);
+            if (!slots) {
+                return fail(Errc::corrupt_archive);
+            }
+            m_slots = *slots;
+            break;
+        }
+        default:
+            // Unknown sections are skipped so newer writers stay readable.
+            break;
+        }
+    }
+    if (!have_entries || m_entries.size() > std::numeric_limits<EntryId>::max()) {
+        return fail(Errc::corrupt_archive);
+    }
+
+    // A power-of-two table with at least one empty slot guarantees probing
+    // terminates. Every entry must be in exactly one slot, which leaves
+    // m_slots.size() - m_entries.size() of them empty.
+    if (!std::has_single_bit(m_slots.size()) || m_slots.size() <= m_entries.size()) {
+        return fail(Errc::corrupt_archive);
+    }
+    std::vector<bool> indexed(m_entries.size());
+    for (const auto& slot : m_slots) {
+        if (slot.entry == format::kEmptySlot) {
+            continue;
+        }
+        if (slot.entry >= m_entries.size() || indexed[slot.entry]) {
+            return fail(Errc::corrupt_archive);
+        }
+        indexed[slot.entry] = true;
+    }
+    if (std::ranges::find(indexed, false) != indexed.end()) {
+        return fail(Errc::corrupt_archive);
+    }
+
+    // Validate every record once so the accessors can index without checks.
+    for (std::size_t i = 0; i < m_entries.size(); ++i) {
+        const auto& entry = m_entries[i];
+        if (!in_bounds(entry.offset, entry.size, bytes.size()) ||
+            !in_bounds(entry.name_offset, entry.name_length, m_names.size()) ||
+            entry.directory >= m_directories.size()) {
+            return fail(Errc::corrupt_archive);
+        }
+        if (!valid_encoding(entry)) {
+            return fail(Errc::corrupt_archive);
+        }
+        if (i > 0) {
+            const auto previous = static_cast<EntryId>(i - 1);
+            const auto current = static_cast<EntryId>(i);
+            if (directory(previous) > directory(current) ||
+                (directory(previous) == directory(current) && !(name(previous) < name(current)))) {
+                return fail(Errc::corrupt_archive);
+            }
+        }
+    }
+    return load_directories();
+}
+
+/// Checks that the directory records form the tree described for
+/// format::DirectoryRecord and agree with the entries' directories.
+Result<void> Archive::load_directories() const {
+    if (m_directories.empty() || m_directories.size() > std::numeric_limits<DirectoryId>::max() ||
+        m_directories[0].parent != format::kNoDirectory || m_directories[0].name_length != 0) {
+        return fail(Errc::corrupt_archive);
+    }
+    std::uint64_t children = 0;
+    std::uint64_t entries = 0;
+    for (std::size_t i = 0; i < m_directories.size(); ++i) {
+        const auto& directory = m_directories[i];
+        if (!in_bounds(directory.name_offset, directory.name_length, m_names.size()) ||
+            !in_bounds(directory.first_child, directory.child_count, m_directories.size()) ||
+            (i > 0 && directory.parent >= i)) {
+            return fail(Errc::corrupt_archive);
+        }
+        for (std::uint32_t child = 0; child < directory.child_count; ++child) {
+            if (m_directories[directory.first_child + child].parent != i) {
+                return fail(Errc::corrupt_archive);
+            }
+        }
+        // Entries are sorted by directory, so the ranges must follow each
+        // other, and checking the ends of a range covers all of it.
+        if (directory.first_entry != entries || !in_bounds(entries, directory.entry_count, m_entries.size())) {
+            return fail(Errc::corrupt_archive);
+        }
+        entries += directory.entry_count;
+        if (directory.entry_count > 0 &&
+            (m_entries[directory.first_entry].directory != i || m_entries[entries - 1].directory != i)) {
+            return fail(Errc::corrupt_archive);
+        }
+        children += directory.child_count;
+    }
+    // Every directory but the root is someone's child, every entry in a
+    // directory's range.
+    if (children != m_directories.size() - 1 || entries != m_entries.size()) {
+        return fail(Errc::corrupt_archive);
+    }
+    return {};
+}
+
+std::optional<EntryId> Archive::find(std::string_view path) const noexcept {
+    return find_hash(hash_path(path));
+}
+
+std::optional<EntryId> Archive::find_hash(std::uint64_t path_hash) const noexcept {
+    const std::size_t mask = m_slots.size() - 1;
+    for (std::size_t i = path_hash & mask;; i = (i + 1) & mask) {
+        const auto& slot = m_slots[i];
+        if (slot.entry == format::kEmptySlot) {
+            return std::nullopt;
+        }
+        if (slot.hash == path_hash) {
+            if (auto* trace = m_trace.load(std::memory_order_relaxed)) {
+                trace->record(*this, slot.entry);
+            }
+            return slot.entry;
+        }
+    }
+}
+
+std::string Archive::path(EntryId id) const {
+    std::string path;
+    append_path(id, path);
+    return path;
+}
+
+void Archive::append_path(EntryId id, std::string& out) const {
+    if (directory(id) != kRootDirectory) {
+        append_directory_path(directory(id), out);
+        out += '/';
+    }
+    out += name(id);
+}
+
+void Archive::append_directory_path(DirectoryId directory, std::string& out) const {
+    // Directory names are collected leaf first, then appended in reverse.
+    std::size_t length = 0;
+    std::size_t depth = 0;
+    for (DirectoryId d = directory; d != kRootDirectory; d = m_directories[d].parent) {
+        length += m_directories[d].name_length + (depth++ == 0 ? 0 : 1);
+    }
+    const std::size_t start = out.size();
+    out.resize(start + length);
+    std::size_t end = out.size();
+    for (DirectoryId d = directory; d != kRootDirectory; d = m_directories[d].parent) {
+        const auto name = directory_name(d);
+        if (end != out.size()) {
+            out[--end] = '/';
+        }
+        end -= name.size();
+        name.copy(out.data() + end, name.size());
+    }
+}
+
+std::optional<DirectoryId> Archive::find_directory(std::string_view path) const noexcept {
+    if (path.ends_with('/')) {
+        path.remove_suffix(1);
+    }
+    DirectoryId directory = kRootDirectory;
+    if (path.empty()) {
+        return directory;
+    }
+    for (std::size_t start = 0; start <= path.size();) {
+        const auto slash = std::min(path.find('/', start), path.size());
+        const auto component = path.substr(start, slash - start);
+        const auto children = subdirectories(directory);
+        const auto it = std::ranges::lower_bound(children, component, {},
+                                                 [this](DirectoryId child) { return directory_name(child); });
+        if (it == children.end() || directory_name(*it) != component) {
+            return std::nullopt;
+        }
+        directory = *it;
+        start = slash + 1;
+    }
+    return directory;
+}
+
+void Archive::walk(DirectoryId directory, const std::function<void(EntryId)>& fn) const {
+    for (const EntryId id : entries(directory)) {
+        fn(id);
+    }
+    for (const DirectoryId child : subdirectories(directory)) {
+        walk(child, fn);
+    }
+}
+
+void Archive::glob(std::string_view pattern, const std::function<void(EntryId)>& fn) const {
+    std::vector<std::string_view> parts;
+    for (std::size_t start = 0; start <= pattern.size();) {
+        const auto slash = std::min(pattern.find('/', start), pattern.size());
+        const auto part = pattern.substr(start, slash - start);
+        if (part.empty()) {
+            return;
+        }
+        // Consecutive "**" match the same paths as one.
+        if (part != "**" || parts.empty() || parts.back() != "**") {
+            parts.push_back(part);
+        }
+        start = slash + 1;
+    }
+    GlobWalk(*this, std::move(parts), fn).visit(kRootDirectory, {0});
+}
+
+bool Archive::has_path(EntryId id, std::string_view path) const noexcept {
+    if (!path.ends_with(name(id))) {
+        return false;
+    }
+    path.remove_suffix(name(id).size());
+    for (DirectoryId d = directory(id); d != kRootDirectory; d = m_directories[d].parent) {
+        if (!path.ends_with('/')) {
+            return false;
+        }
+        path.remove_suffix(1);
+        if (!path.ends_with(directory_name(d))) {
+            return false;
+        }
+        path.remove_suffix(directory_name(d).size());
+    }
+    return path.empty();
+}
+
+std::span<const std::byte> Archive::data(EntryId id) const noexcept {
+    const auto& entry = record(id);
+    return m_file.bytes().subspan(entry.offset, entry.size);
+}
+
+Result<void> Archive::read(EntryId id, std::span<std::byte> out, ThreadPool* pool) const {
+    return decode(id, data(id), out, pool);
+}
+
+Result<void> Archive::read_direct(EntryId id, std::span<std::byte> out, ThreadPool* pool) const {
+    const auto& entry = record(id);
+    if (out.size() != entry.raw_size) {
+        return std::unexpected(std::make_error_code(std::errc::invalid_argument));
+    }
+    if (entry.codec == Codec::none) {
+        return m_file.read_at(entry.offset, out);
+    }
+    // Stored bytes of compressed entries go through a per-thread buffer
+    // that is reused across calls, unless they are too large to keep.
+    constexpr std::uint64_t kMaxKept = 1 << 20;
+    thread_local std::vector<std::byte> kept;
+    std::vector<std::byte> large;
+    auto& stored = entry.size <= kMaxKept ? kept : large;
+    stored.resize(entry.size);
+    if (auto read = m_file.read_at(entry.offset, stored); !read) {
+        return read;
+    }
+    return decode(id, stored, out, pool);
+}
+
+Result<void> Archive::decode(EntryId id, std::span<const std::byte> stored, std::span<std::byte> out,
+                             ThreadPool* pool) const {
+    const auto& entry = record(id);
+    if (out.size() != entry.raw_size || stored.size() != entry.size) {
+        return std::unexpected(std::make_error_code(std::errc::invalid_argument));
+    }
+    if (entry.codec == Codec::none) {
+        if (!out.empty()) {
+            std::memcpy(out.data(), stored.data(), out.size());
+        }
+        return {};
+    }
+
+    const BlockReader blocks(entry, stored);
+    if (!blocks.valid()) {
+        return fail(Errc::corrupt_archive);
+    }
+    std::atomic<bool> ok = true;
+    const auto decode = [&](std::size_t index) {
+        const auto slice = out.subspan(blocks.block_start(index), blocks.raw_block_size(index));
+        if (!blocks.decode(index, slice)) {
+            ok.store(false, std::memory_order_relaxed);
+        }
+    };
+    if (pool != nullptr && blocks.block_count() > 1) {
+        pool->parallel_for(blocks.block_count(), decode);
+    } else {
+        for (std::size_t i = 0; i < blocks.block_count(); ++i) {
+            decode(i);
+        }
+    }
+    if (!ok) {
+        return fail(Errc::corrupt_archive);
+    }
+    return {};
+}
+
+Result<void> Archive::read_range(EntryId id, std::uint64_t offset, std::span<std::byte> out) const {
+    const auto& entry = record(id);
+    if (!in_bounds(offset, out.size(), entry.raw_size)) {
+        return std::unexpected(std::make_error_code(std::errc::invalid_argument));
+    }
+    if (out.empty()) {
+        return {};
+    }
+    if (entry.codec == Codec::none) {
+        std::memcpy(out.data(), data(id).data() + offset, out.size());
+        return {};
+    }
+
+    const BlockReader blocks(entry, data(id));
+    if (!blocks.valid()) {
+        return fail(Errc::corrupt_archive);
+    }
+    const std::uint64_t end = offset + out.size();
+    std::vector<std::byte> scratch;
+    for (std::uint64_t index = offset >> entry.block_shift; index <= (end - 1) >> entry.block_shift; ++index) {
+        const std::uint64_t block_begin = blocks.block_start(index);
+        const std::uint64_t block_size = blocks.raw_block_size(index);
+        const std::uint64_t from = std::max(offset, block_begin);
+        const std::uint64_t to = std::min(end, block_begin + block_size);
+        auto target = out.subspan(from - offset, to - from);
+        if (to - from == block_size) {
+            if (!blocks.decode(index, target)) {
+                return fail(Errc::corrupt_archive);
+            }
+            continue;
+        }
+        // Partially covered blocks are decoded aside and trimmed.
+        scratch.resize(block_size);
+        if (!blocks.decode(index, scratch)) {
+            return fail(Errc::corrupt_archive);
+        }
+        std::memcpy(target.data(), scratch.data() + (from - block_begin), target.size());
+    }
+    return {};
+}
+
+void Archive::prefetch(EntryId id) const noexcept {
+    const auto& entry = record(id);
+    m_file.advise(MappedFile::Advice::will_need, entry.offset, entry.size);
+}
+
+} // namespace stockpile
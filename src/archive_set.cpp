@@ -0,0 +1,217 @@
+#include "stockpile/archive_set.hpp"
+
+#include "stockpile/access_trace.hpp"
+#include "stockpile/hash.hpp"
+
+#include <string>
+
+namespace stockpile {
+
+ArchiveSet::ArchiveSet() {
+    m_tables.push_back(std::make_unique<const Table>());
+    m_table.store(m_tables.back().get(), std::memory_order_release);
+}
+
+ArchiveSet::~ArchiveSet() = default;
+
+Result<void> ArchiveSet::insert(const Table& table, detail::MergedIndex& target, const detail::MergedIndex* below,
+                                std::uint32_t index, std::size_t& visible, std::string& path) {
+    const Archive& archive = *table.archives[index];
+    return target.insert(
+        below, index, detail::entry_hashes(archive), [&](EntryId id) { return archive.is_tombstone(id); },
+        [&](const detail::MergedIndex::Slot& previous, EntryId id) {
+            path.clear();
+            archive.append_path(id, path);
+            return table.archives[previous.source & ~detail::MergedIndex::kHidden]->has_path(previous.entry, path);
+        },
+        visible);
+}
+
+Result<void> ArchiveSet::rebuild(Table& table, std::uint32_t from) {
+    std::string path;
+    if (from < table.base_count) {
+        auto base = std::make_shared<detail::MergedIndex>();
+        std::size_t visible = 0;
+        for (std::uint32_t index = 0; index < from; ++index) {
+            if (!table.unmounted[index]) {
+                if (auto inserted = insert(table, *base, nullptr, index, visible, path); !inserted) {
+                    return inserted;
+                }
+            }
+        }
+        table.base = std::move(base);
+        table.base_count = from;
+        table.base_visible = visible;
+    }
+    table.overlay = {};
+    table.visible = table.base_visible;
+    for (auto index = table.base_count; index < table.archives.size(); ++index) {
+        if (!table.unmounted[index]) {
+            if (auto inserted = insert(table, table.overlay, table.base.get(), index, table.visible, path);
+                !inserted) {
+                return inserted;
+            }
+        }
+    }
+    return {};
+}
+
+void ArchiveSet::fold(Table& table) {
+    if (detail::MergedIndex::fold(table.base, table.overlay)) {
+        table.base_count = static_cast<std::uint32_t>(table.archives.size());
+        table.base_visible = table.visible;
+    }
+}
+
+void ArchiveSet::publish(std::unique_ptr<Table> next) {
+    m_tables.push_back(std::move(next));
+    m_table.store(m_tables.back().get(), std::memory_order_release);
+}
+
+Result<std::uint32_t> ArchiveSet::mount(Archive archive) {
+    std::lock_guard lock(m_mount_mutex);
+    const Table& current = table();
+    if (current.archives.size() >= detail::MergedIndex::kHidden) {
+        return fail(Errc::too_large);
+    }
+    const auto index = static_cast<std::uint32_t>(current.archives.size());
+
+    // Only the overlay is copied; the base is shared with the current table.
+    auto next = std::make_unique<Table>(current);
+    next->archives.push_back(std::make_shared<const Archive>(std::move(archive)));
+    next->unmounted.push_back(false);
+    std::string path;
+    if (auto inserted = insert(*next, next->overlay, next->base.get(), index, next->visible, path); !inserted) {
+        return std::unexpected(inserted.error());
+    }
+    fold(*next);
+    publish(std::move(next));
+    return index;
+}
+
+Result<std::uint32_t> ArchiveSet::mount(const std::filesystem::path& path) {
+    auto archive = Archive::open(path);
+    if (!archive) {
+        return std::unexpected(archive.error());
+    }
+    return mount(std::move(*archive));
+}
+
+Result<void> ArchiveSet::unmount(std::uint32_t index) {
+    std::lock_guard lock(m_mount_mutex);
+    const Table& current = table();
+    if (index >= current.archives.size() || current.unmounted[index]) {
+        return std::unexpected(std::make_error_code(std::errc::invalid_argument));
+    }
+    // The archive stays in the table, so that references found before now
+    // can still be read.
+    auto next = std::make_unique<Table>(current);
+    next->unmounted[index] = true;
+    // Removing an archive cannot make two different paths meet in a slot.
+    static_cast<void>(rebuild(*next, index));
+    publish(std::move(next));
+    return {};
+}
+
+Result<std::uint32_t> ArchiveSet::replace(std::uint32_t index, Archive archive) {
+    std::lock_guard lock(m_mount_mutex);
+    const Table& current = table();
+    if (index >= current.archives.size() || current.unmounted[index]) {
+        return std::unexpected(std::make_error_code(std::errc::invalid_argument));
+    }
+    if (current.archives.size() >= detail::MergedIndex::kHidden) {
+        return fail(Errc::too_large);
+    }
+    const auto replacement = static_cast<std::uint32_t>(current.archives.size());
+
+    auto next = std::make_unique<Table>(current);
+    next->unmounted[index] = true;
+    next->archives.push_back(std::make_shared<const Archive>(std::move(archive)));
+    next->unmounted.push_back(false);
+    // Not folded, so that replacing the archive again stays as cheap.
+    if (auto rebuilt = rebuild(*next, index); !rebuilt) {
+        return std::unexpected(rebuilt.error());
+    }
+    publish(std::move(next));
+    return replacement;
+}
+
+void ArchiveSet::reclaim() {
+    std::lock_guard lock(m_mount_mutex);
+    const Table& current = table();
+    bool retired = false;
+    for (std::size_t index = 0; index < current.archives.size(); ++index) {
+        retired = retired || (current.unmounted[index] && current.archives[index] != nullptr);
+    }
+    if (retired) {
+        // No other thread is inside the set, so none is reading from the
+        // unmounted archives.
+        auto next = std::make_unique<Table>(current);
+        for (std::size_t index = 0; index < next->archives.size(); ++index) {
+            if (next->unmounted[index]) {
+                next->archives[index] = nullptr;
+            }
+        }
+        publish(std::move(next));
+    }
+    m_tables.erase(m_tables.begin(), m_tables.end() - 1);
+}
+
+std::optional<EntryRef> ArchiveSet::find(std::string_view path) const noexcept {
+    return find_hash(hash_path(path));
+}
+
+std::optional<EntryRef> ArchiveSet::find_hash(std::uint64_t path_hash) const noexcept {
+    const Table& current = table();
+    const auto* slot = lookup(current, path_hash);
+    if (slot == nullptr || (slot->source & detail::MergedIndex::kHidden) != 0) {
+        return std::nullopt;
+    }
+    const EntryRef ref{slot->source, slot->entry};
+    if (auto* trace = m_trace.load(std::memory_order_relaxed)) {
+        trace->record(*current.archives[ref.archive], ref.entry);
+    }
+    return ref;
+}
+
+bool ArchiveSet::is_visible(const Table& table, std::uint32_t index, EntryId id, std::string& path) {
+    path.clear();
+    table.archives[index]->append_path(id, path);
+    const auto* slot = lookup(table, hash_path(path));
+    return slot != nullptr && slot->source == index && slot->entry == id;
+}
+
+void ArchiveSet::walk(std::string_view directory, const std::function<void(EntryRef)>& fn) const {
+    const Table& current = table();
+    std::string path;
+    for (std::uint32_t index = 0; index < current.archives.size(); ++index) {
+        if (current.unmounted[index]) {
+            continue;
+        }
+        const auto& archive = *current.archives[index];
+        if (const auto found = archive.find_directory(directory)) {
+            archive.walk(*found, [&](EntryId id) {
+                if (is_visible(current, index, id, path)) {
+                    fn({index, id});
+                }
+            });
+        }
+    }
+}
+
+void ArchiveSet::glob(std::string_view pattern, const std::function<void(EntryRef)>& fn) const {
+    const Table& current = table();
+    std::string path;
+    for (std::uint32_t index = 0; index < current.archives.size(); ++index) {
+        if (current.unmounted[index]) {
+            continue;
+        }
+        current.archives[index]->glob(pattern, [&](EntryId id) {
+            if (is_visible(current, index, id, path)) {
+                fn({index, id});
+            }
+        });
+    }
+}
+
+} // namespace stockpile
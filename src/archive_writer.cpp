@@ -0,0 +1,592 @@
+#include "stockpile/archive_writer.hpp"
+
+#include "stockpile/access_trace.hpp"
+#include "stockpile/format.hpp"
+#include "stockpile/hash.hpp"
+#include "stockpile/thread_pool.hpp"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <condition_variable>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <unordered_map>
+#include <utility>
+
+namespace stockpile {
+
+namespace {
+
+[[nodiscard]] Result<std::vector<std::byte>> read_file(const std::filesystem::path& path) {
+    std::ifstream in(path, std::ios::binary | std::ios::ate);
+    if (!in) {
+        return std::unexpected(std::make_error_code(std::errc::no_such_file_or_directory));
+    }
+    std::vector<std::byte> bytes(static_cast<std::size_t>(in.tellg()));
+    in.seekg(0);
+    if (!in.read(reinterpret_cast<char*>(bytes.data()), static_cast<std::streamsize>(bytes.size()))) {
+        return std::unexpected(std::make_error_code(std::errc::io_error));
+    }
+    return bytes;
+}
+
+/// Sequential binary output that tracks its position for offset bookkeeping.
+class Output {
+public:
+    explicit Output(const std::filesystem::path& path)
+        : m_stream(path, std::ios::binary | std::ios::trunc) {}
+
+    [[nodiscard]] bool ok() const noexcept { return static_cast<bool>(m_stream); }
+    [[nodiscard]] std::uint64_t position() const noexcept { return m_position; }
+
+    void write(const void* data, std::size_t size) {
+        m_stream.write(static_cast<const char*>(data), static_cast<std::streamsize>(size));
+        m_position += size;
+    }
+
+    template <typename T>
+    void write_records(std::span<const T> records) {
+        write(records.data(), records.size_bytes());
+    }
+
+    void pad_to(std::uint64_t alignment) {
+        static constexpr std::array<char, format::kCacheLine> zeros{};
+        const auto padding = format::align_up(m_position, alignment) - m_position;
+        write(zeros.data(), static_cast<std::size_t>(padding));
+    }
+
+    /// Rewrites already emitted bytes without moving the write position.
+    void overwrite(std::uint64_t offset, const void* data, std::size_t size) {
+        m_stream.seekp(static_cast<std::streamoff>(offset));
+        m_stream.write(static_cast<const char*>(data), static_cast<std::streamsize>(size));
+        m_stream.seekp(static_cast<std::streamoff>(m_position));
+    }
+
+    /// Flushes and closes the file, reporting whether every write succeeded.
+    [[nodiscard]] bool close() {
+        m_stream.close();
+        return !m_stream.fail();
+    }
+
+private:
+    std::ofstream m_stream;
+    std::uint64_t m_position = 0;
+};
+
+/// Identity of a stored payload: its contents and how they are encoded.
+struct BlobKey {
+    Hash128 hash;
+    Codec codec;
+    std::uint32_t block_size;
+
+    friend bool operator==(const BlobKey&, const BlobKey&) = default;
+};
+
+struct BlobKeyHash {
+    [[nodiscard]] std::size_t operator()(const BlobKey& key) const noexcept {
+        return static_cast<std::size_t>(key.hash.low);
+    }
+};
+
+/// Builds the open-addressing path index for entries whose path hashes are
+/// `hashes[entry]`. Fails if two paths hash to the same value, since readers
+/// identify entries by hash alone.
+[[nodiscard]] Result<std::vector<format::HashSlot>> build_path_index(std::span<const std::uint64_t> hashes) {
+    std::vector<std::uint64_t> sorted(hashes.begin(), hashes.end());
+    std::sort(sorted.begin(), sorted.end());
+    if (std::adjacent_find(sorted.begin(), sorted.end()) != sorted.end()) {
+        return fail(Errc::hash_collision);
+    }
+
+    constexpr std::size_t kSlotsPerLine = format::kCacheLine / sizeof(format::HashSlot);
+    const std::size_t slot_count = std::max(kSlotsPerLine, std::bit_ceil(hashes.size() * 2));
+    const std::size_t mask = slot_count - 1;
+    std::vector<format::HashSlot> slots(slot_count, format::HashSlot{0, format::kEmptySlot, 0});
+    for (std::size_t entry = 0; entry < hashes.size(); ++entry) {
+        std::size_t i = hashes[entry] & mask;
+        while (slots[i].entry != format::kEmptySlot) {
+            i = (i + 1) & mask;
+        }
+        slots[i] = {hashes[entry], static_cast<std::uint32_t>(entry), 0};
+    }
+    return slots;
+}
+
+/// Entry paths split into a tree of directories, laid out as described for
+/// format::DirectoryRecord.
+struct PathTree {
+    std::vector<format::DirectoryRecord> directories;
+    /// The names section: every distinct component once, in order of first
+    /// use by the directory and entry records, so that reading the records
+    /// in order reads the names in order.
+    std::string names;
+    /// Entry indices in record order, by directory and then by name.
+    std::vector<std::uint32_t> order;
+    /// Per entry index: its directory and the position of its name.
+    std::vector<std::uint32_t> directory;
+    std::vector<std::uint32_t> name_offset;
+};
+
+/// Builds the directory tree of `paths`, which must be valid archive paths.
+/// Fails on duplicate paths.
+[[nodiscard]] Result<PathTree> build_path_tree(std::span<const std::string_view> paths) {
+    struct Node {
+        std::uint32_t parent;
+        std::string_view name;
+        std::map<std::string_view, std::uint32_t> children;
+        std::vector<std::uint32_t> entries;
+    };
+    std::vector<Node> nodes(1, Node{format::kNoDirectory, {}, {}, {}});
+    std::vector<std::string_view> entry_names(paths.size());
+    for (std::size_t i = 0; i < paths.size(); ++i) {
+        const auto path = paths[i];
+        std::uint32_t node = 0;
+        std::size_t start = 0;
+        for (auto slash = path.find('/'); slash != std::string_view::npos; slash = path.find('/', start)) {
+            const auto name = path.substr(start, slash - start);
+            const auto [child, inserted] =
+                nodes[node].children.try_emplace(name, static_cast<std::uint32_t>(nodes.size()));
+            const auto index = child->second;
+            if (inserted) {
+                nodes.push_back({node, name, {}, {}});
+            }
+            node = index;
+            start = slash + 1;
+        }
+        entry_names[i] = path.substr(start);
+        nodes[node].entries.push_back(static_cast<std::uint32_t>(i));
+    }
+    if (nodes.size() > std::numeric_limits<std::uint32_t>::max()) {
+        return fail(Errc::too_large);
+    }
+
+    // Number the directories breadth-first, so that the children of each
+    // one get consecutive indices in name order.
+    std::vector<std::uint32_t> queue{0};
+    std::vector<std::uint32_t> number(nodes.size(), 0);
+    for (std::size_t i = 0; i < queue.size(); ++i) {
+        for (const auto& [name, child] : nodes[queue[i]].children) {
+            number[child] = static_cast<std::uint32_t>(queue.size());
+            queue.push_back(child);
+        }
+    }
+
+    PathTree tree;
+    std::unordered_map<std::string_view, std::uint32_t> interned;
+    const auto intern = [&](std::string_view name) -> std::optional<std::uint32_t> {
+        const auto [it, inserted] = interned.try_emplace(name, static_cast<std::uint32_t>(tree.names.size()));
+        if (inserted) {
+            if (tree.names.size() + name.size() > std::numeric_limits<std::uint32_t>::max()) {
+                return std::nullopt;
+            }
+            tree.names += name;
+        }
+        return it->second;
+    };
+
+    tree.directory.resize(paths.size());
+    tree.name_offset.resize(paths.size());
+    tree.order.reserve(paths.size());
+    for (const auto index : queue) {
+        auto& node = nodes[index];
+        auto& record = tree.directories.emplace_back();
+        const auto name = intern(node.name);
+        if (!name) {
+            return fail(Errc::too_large);
+        }
+        record.parent = index == 0 ? format::kNoDirectory : number[node.parent];
+        record.name_offset = *name;
+        record.name_length = static_cast<std::uint32_t>(node.name.size());
+        record.first_child = node.children.empty() ? 0 : number[node.children.begin()->second];
+        record.child_count = static_cast<std::uint32_t>(node.children.size());
+        record.first_entry = static_cast<std::uint32_t>(tree.order.size());
+        record.entry_count = static_cast<std::uint32_t>(node.entries.size());
+
+        std::sort(node.entries.begin(), node.entries.end(),
+                  [&](std::uint32_t a, std::uint32_t b) { return entry_names[a] < entry_names[b]; });
+        for (std::size_t i = 0; i < node.entries.size(); ++i) {
+            const auto entry = node.entries[i];
+            if (i > 0 && entry_names[node.entries[i - 1]] == entry_names[entry]) {
+                return fail(Errc::duplicate_path);
+            }
+            const auto offset = intern(entry_names[entry]);
+            if (!offset) {
+                return fail(Errc::too_large);
+            }
+            tree.directory[entry] = number[index];
+            tree.name_offset[entry] = *offset;
+            tree.order.push_back(entry);
+        }
+    }
+    return tree;
+}
+
+/// Splits `raw` into blocks of `1 << shift` bytes and compresses each one
+/// independently, laid out as described for format::EntryRecord. Returns
+/// nullopt if the result would not be smaller than `raw`. With a pool, the
+/// blocks are compressed in parallel.
+[[nodiscard]] std::optional<std::vector<std::byte>> compress_blocks(std::span<const std::byte> raw, Codec codec,
+                                                                    std::uint8_t shift, ThreadPool* pool) {
+    const std::size_t block_size = std::size_t{1} << shift;
+    const std::size_t count = (raw.size() + block_size - 1) >> shift;
+    const std::size_t table_size = count * sizeof(std::uint64_t);
+    if (table_size >= raw.size()) {
+        return std::nullopt;
+    }
+
+    std::vector<std::vector<std::byte>> packed(count);
+    const auto compress_block = [&](std::size_t i) {
+        const auto block = raw.subspan(i * block_size, std::min(block_size, raw.size() - i * block_size));
+        // Capping the output one byte short of the input makes "stored size
+        // equals raw size" an unambiguous marker for raw blocks.
+        auto& out = packed[i];
+        out.resize(block.size() - 1);
+        const std::size_t size = compress(codec, block, out);
+        if (size == 0) {
+            out.assign(block.begin(), block.end());
+        } else {
+            out.resize(size);
+        }
+    };
+
+    std::size_t stored_size = table_size;
+    if (pool != nullptr && count > 1) {
+        pool->parallel_for(count, compress_block);
+        for (const auto& block : packed) {
+            stored_size += block.size();
+        }
+    } else {
+        for (std::size_t i = 0; i < count; ++i) {
+            compress_block(i);
+            stored_size += packed[i].size();
+            if (stored_size >= raw.size()) {
+                return std::nullopt;
+            }
+        }
+    }
+    if (stored_size >= raw.size()) {
+        return std::nullopt;
+    }
+
+    std::vector<std::byte> stored(table_size);
+    stored.reserve(stored_size);
+    for (std::size_t i = 0; i < count; ++i) {
+        stored.insert(stored.end(), packed[i].begin(), packed[i].end());
+        const std::uint64_t end = stored.size() - table_size;
+        std::memcpy(stored.data() + i * sizeof(std::uint64_t), &end, sizeof(end));
+    }
+    return stored;
+}
+
+/// Upper bound on payload bytes held by the write pipeline between being
+/// read and being written, unless a single entry is larger.
+constexpr std::uint64_t kMaxBytesInFlight = 256ull << 20;
+
+/// An entry after the read, hash and compress stages of ArchiveWriter::write().
+struct PreparedEntry {
+    std::vector<std::byte> owned;
+    std::span<const std::byte> payload;
+    BlobKey key{};
+    std::uint64_t raw_size = 0;
+    Codec codec = Codec::none;
+    std::uint8_t block_shift = 0;
+    /// Bytes counted against kMaxBytesInFlight.
+    std::uint64_t budget = 0;
+    std::error_code error;
+    bool ready = false;
+};
+
+} // namespace
+
+bool ArchiveWriter::is_valid_path(std::string_view path) noexcept {
+    if (path.empty() || path.size() > std::numeric_limits<std::uint32_t>::max()) {
+        return false;
+    }
+    std::size_t start = 0;
+    while (start <= path.size()) {
+        const auto slash = std::min(path.find('/', start), path.size());
+        const auto component = path.substr(start, slash - start);
+        if (component.empty() || component == "." || component == ".." ||
+            component.find_first_of(std::string_view("\\\0", 2)) != std::string_view::npos) {
+            return false;
+        }
+        start = slash + 1;
+    }
+    return true;
+}
+
+Result<void> ArchiveWriter::check_new_entry(std::string_view path, const EntryOptions& options) const {
+    if (!is_valid_path(path)) {
+        return fail(Errc::invalid_path);
+    }
+    if (options.codec != Codec::none &&
+        (!std::has_single_bit(options.block_size) ||
+         options.block_size < (1u << format::kMinBlockShift) ||
+         options.block_size > (1u << format::kMaxBlockShift))) {
+        return std::unexpected(std::make_error_code(std::errc::invalid_argument));
+    }
+    if (m_entries.size() >= std::numeric_limits<std::uint32_t>::max()) {
+        return fail(Errc::too_large);
+    }
+    return {};
+}
+
+Result<void> ArchiveWriter::add(std::string_view path, std::span<const std::byte> data,
+                                const EntryOptions& options) {
+    if (auto valid = check_new_entry(path, options); !valid) {
+        return valid;
+    }
+    m_entries.push_back({std::string(path), std::vector<std::byte>(data.begin(), data.end()), options});
+    return {};
+}
+
+Result<void> ArchiveWriter::add_file(std::string_view path, const std::filesystem::path& source,
+                                     const EntryOptions& options) {
+    if (auto valid = check_new_entry(path, options); !valid) {
+        return valid;
+    }
+    m_entries.push_back({std::string(path), source, options});
+    return {};
+}
+
+Result<void> ArchiveWriter::add_tombstone(std::string_view path) {
+    if (auto valid = check_new_entry(path, {}); !valid) {
+        return valid;
+    }
+    m_entries.push_back({std::string(path), std::vector<std::byte>(), {}, format::kEntryTombstone});
+    return {};
+}
+
+void ArchiveWriter::apply_trace(const AccessTrace& trace) {
+    std::unordered_map<std::string, std::size_t> ranks;
+    for (auto& path : trace.paths()) {
+        ranks.try_emplace(std::move(path), ranks.size());
+    }
+    // Sorting (rank, index) pairs keeps untraced entries in their order.
+    std::vector<std::pair<std::size_t, std::size_t>> order(m_entries.size());
+    for (std::size_t i = 0; i < m_entries.size(); ++i) {
+        const auto it = ranks.find(m_entries[i].path);
+        order[i] = {it == ranks.end() ? ranks.size() : it->second, i};
+    }
+    std::sort(order.begin(), order.end());
+    std::vector<PendingEntry> entries;
+    entries.reserve(m_entries.size());
+    for (const auto& [rank, index] : order) {
+        entries.push_back(std::move(m_entries[index]));
+    }
+    m_entries = std::move(entries);
+}
+
+Result<void> ArchiveWriter::write(const std::filesystem::path& destination, ThreadPool* pool) const {
+    // Records are grouped by directory and sorted by name within each, so
+    // readers can list and binary search a directory in place.
+    std::vector<std::string_view> paths(m_entries.size());
+    std::transform(m_entries.begin(), m_entries.end(), paths.begin(),
+                   [](const PendingEntry& entry) { return std::string_view(entry.path); });
+    auto tree = build_path_tree(paths);
+    if (!tree) {
+        return std::unexpected(tree.error());
+    }
+
+    Output out(destination);
+    if (!out.ok()) {
+        return std::unexpected(std::make_error_code(std::errc::io_error));
+    }
+    format::Header header{};
+    out.write(&header, sizeof(header));
+
+    // Payloads pass through three stages: read and hash, compress, write.
+    // With a pool, the first two run on its workers for several entries
+    // ahead of this thread, which writes finished entries strictly in
+    // insertion order. The layout of the file depends on nothing else, so
+    // the output is the same for any number of threads.
+    //
+    // Identical payloads stored with identical options are written once and
+    // shared by their records. The stored copy is always the first in
+    // insertion order; `claims` lets the later ones skip compression once
+    // an earlier one is known.
+    std::mutex claims_mutex;
+    std::unordered_map<BlobKey, std::size_t, BlobKeyHash> claims;
+    const auto prepare = [&](std::size_t i, PreparedEntry& prepared) {
+        const auto& entry = m_entries[i];
+        if (const auto* bytes = std::get_if<std::vector<std::byte>>(&entry.source)) {
+            prepared.payload = *bytes;
+        } else {
+            auto read = read_file(std::get<std::filesystem::path>(entry.source));
+            if (!read) {
+                prepared.error = read.error();
+                return;
+            }
+            prepared.owned = std::move(*read);
+            prepared.payload = prepared.owned;
+        }
+        prepared.raw_size = prepared.payload.size();
+        prepared.key = {hash128(prepared.payload), entry.options.codec,
+                        entry.options.codec == Codec::none ? 0 : entry.options.block_size};
+        {
+            std::lock_guard lock(claims_mutex);
+            const auto [claim, inserted] = claims.try_emplace(prepared.key, i);
+            if (!inserted && claim->second < i) {
+                prepared.owned = {};
+                prepared.payload = {};
+                return;
+            }
+            claim->second = i;
+        }
+        if (entry.options.codec != Codec::none) {
+            const auto shift = static_cast<std::uint8_t>(std::countr_zero(entry.options.block_size));
+            if (auto compressed = compress_blocks(prepared.payload, entry.options.codec, shift, pool)) {
+                prepared.owned = std::move(*compressed);
+                prepared.payload = prepared.owned;
+                prepared.codec = entry.options.codec;
+                prepared.block_shift = shift;
+            }
+        }
+    };
+    const auto budget = [this](std::size_t i) -> std::uint64_t {
+        const auto& source = m_entries[i].source;
+        if (const auto* bytes = std::get_if<std::vector<std::byte>>(&source)) {
+            return bytes->size();
+        }
+        std::error_code ec;
+        const auto size = std::filesystem::file_size(std::get<std::filesystem::path>(source), ec);
+        return ec ? 0 : size;
+    };
+
+    std::mutex ready_mutex;
+    std::condition_variable ready_changed;
+    std::vector<std::unique_ptr<PreparedEntry>> pending(m_entries.size());
+    const std::size_t window = pool == nullptr ? 1 : pool->size() * 4;
+    std::size_t next = 0;
+    std::uint64_t bytes_in_flight = 0;
+
+    std::vector<format::EntryRecord> records(m_entries.size());
+    std::unordered_map<BlobKey, std::size_t, BlobKeyHash> blobs;
+    std::error_code failure;
+    std::size_t i = 0;
+    for (; i < m_entries.size(); ++i) {
+        for (; next < m_entries.size() && next - i < window; ++next) {
+            const auto bytes = budget(next);
+            if (next != i && bytes_in_flight + bytes > kMaxBytesInFlight) {
+                break;
+            }
+            bytes_in_flight += bytes;
+            auto& prepared = *(pending[next] = std::make_unique<PreparedEntry>());
+            prepared.budget = bytes;
+            if (pool == nullptr) {
+                prepare(next, prepared);
+                prepared.ready = true;
+                continue;
+            }
+            pool->submit([&, index = next] {
+                prepare(index, prepared);
+                // Notifying under the lock keeps the condition variable alive
+                // until the waiter has seen the flag.
+                std::lock_guard lock(ready_mutex);
+                prepared.ready = true;
+                ready_changed.notify_one();
+            });
+        }
+
+        auto& prepared = *pending[i];
+        {
+            std::unique_lock lock(ready_mutex);
+            ready_changed.wait(lock, [&] { return prepared.ready; });
+        }
+        bytes_in_flight -= prepared.budget;
+        if (prepared.error) {
+            failure = prepared.error;
+            break;
+        }
+
+        records[i].flags = m_entries[i].flags;
+        const auto [blob, inserted] = blobs.try_emplace(prepared.key, i);
+        if (inserted) {
+            records[i].raw_size = prepared.raw_size;
+            records[i].codec = prepared.codec;
+            records[i].block_shift = prepared.block_shift;
+            out.pad_to(format::kAlignment);
+            records[i].offset = out.position();
+            records[i].size = prepared.payload.size();
+            out.write(prepared.payload.data(), prepared.payload.size());
+        } else {
+            const auto& first = records[blob->second];
+            records[i].offset = first.offset;
+            records[i].size = first.size;
+            records[i].raw_size = first.raw_size;
+            records[i].codec = first.codec;
+            records[i].block_shift = first.block_shift;
+        }
+        pending[i].reset();
+    }
+    if (failure) {
+        // Entries still being prepared refer to this frame.
+        std::unique_lock lock(ready_mutex);
+        ready_changed.wait(lock, [&] {
+            return std::all_of(pending.begin() + static_cast<std::ptrdiff_t>(i),
+                               pending.begin() + static_cast<std::ptrdiff_t>(next),
+                               [](const auto& p) { return p->ready; });
+        });
+        return std::unexpected(failure);
+    }
+
+    std::vector<format::EntryRecord> sorted;
+    std::vector<std::uint64_t> hashes;
+    sorted.reserve(records.size());
+    hashes.reserve(records.size());
+    for (const auto index : tree->order) {
+        auto record = records[index];
+        const auto& path = m_entries[index].path;
+        record.directory = tree->directory[index];
+        record.name_offset = tree->name_offset[index];
+        record.name_length = static_cast<std::uint32_t>(path.size() - (path.rfind('/') + 1));
+        sorted.push_back(record);
+        hashes.push_back(hash_path(path));
+    }
+    auto slots = build_path_index(hashes);
+    if (!slots) {
+        return std::unexpected(slots.error());
+    }
+
+    std::vector<format::Section> sections;
+    out.pad_to(format::kAlignment);
+    sections.push_back({format::SectionKind::entries, 0, out.position(),
+                        sorted.size() * sizeof(format::EntryRecord)});
+    out.write_records(std::span<const format::EntryRecord>(sorted));
+
+    out.pad_to(format::kAlignment);
+    sections.push_back({format::SectionKind::directories, 0, out.position(),
+                        tree->directories.size() * sizeof(format::DirectoryRecord)});
+    out.write_records(std::span<const format::DirectoryRecord>(tree->directories));
+
+    out.pad_to(format::kAlignment);
+    sections.push_back({format::SectionKind::names, 0, out.position(), tree->names.size()});
+    out.write(tree->names.data(), tree->names.size());
+
+    out.pad_to(format::kCacheLine);
+    sections.push_back({format::SectionKind::path_index, 0, out.position(),
+                        slots->size() * sizeof(format::HashSlot)});
+    out.write_records(std::span<const format::HashSlot>(*slots));
+
+    out.pad_to(format::kAlignment);
+    header.magic = format::kMagic;
+    header.version = format::kVersion;
+    header.section_count = static_cast<std::uint32_t>(sections.size());
+    header.section_table_offset = out.position();
+    out.write_records(std::span<const format::Section>(sections));
+    header.file_size = out.position();
+
+    out.overwrite(0, &header, sizeof(header));
+    if (!out.close()) {
+        return std::unexpected(std::make_error_code(std::errc::io_error));
+    }
+    return {};
+}
+
+} // namespace stockpile
@@ -0,0 +1,109 @@
+#include "stockpile/arena.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <utility>
+
+namespace stockpile {
+
+namespace {
+
+[[nodiscard]] std::byte* align_pointer(std::byte* p, std::size_t alignment) noexcept {
+    const auto address = reinterpret_cast<std::uintptr_t>(p);
+    return p + ((alignment - address % alignment) % alignment);
+}
+
+} // namespace
+
+Arena::Arena(std::size_t chunk_size) noexcept : m_chunk_size(std::max<std::size_t>(chunk_size, 64)) {}
+
+Arena::Arena(Arena&& other) noexcept
+    : m_chunks(std::exchange(other.m_chunks, {})),
+      m_chunk_size(other.m_chunk_size),
+      m_retired(std::exchange(other.m_retired, 0)),
+      m_cursor(std::exchange(other.m_cursor, nullptr)),
+      m_end(std::exchange(other.m_end, nullptr)) {}
+
+Arena& Arena::operator=(Arena&& other) noexcept {
+    if (this != &other) {
+        m_chunks = std::exchange(other.m_chunks, {});
+        m_chunk_size = other.m_chunk_size;
+        m_retired = std::exchange(other.m_retired, 0);
+        m_cursor = std::exchange(other.m_cursor, nullptr);
+        m_end = std::exchange(other.m_end, nullptr);
+    }
+    return *this;
+}
+
+void* Arena::allocate(std::size_t size, std::size_t alignment) {
+    if (m_cursor != nullptr) {
+        std::byte* p = align_pointer(m_cursor, alignment);
+        if (p <= m_end && size <= static_cast<std::size_t>(m_end - p)) {
+            m_cursor = p + size;
+            return p;
+        }
+    }
+    add_chunk(size + alignment - 1);
+    std::byte* p = align_pointer(m_cursor, alignment);
+    m_cursor = p + size;
+    return p;
+}
+
+std::string_view Arena::copy(std::string_view text) {
+    auto* p = static_cast<char*>(allocate(text.size(), 1));
+    if (!text.empty()) {
+        std::memcpy(p, text.data(), text.size());
+    }
+    return {p, text.size()};
+}
+
+bool Arena::try_extend(void* block, std::size_t old_size, std::size_t new_size) noexcept {
+    auto* p = static_cast<std::byte*>(block);
+    if (p == nullptr || p + old_size != m_cursor || new_size < old_size ||
+        new_size - old_size > static_cast<std::size_t>(m_end - m_cursor)) {
+        return false;
+    }
+    m_cursor = p + new_size;
+    return true;
+}
+
+void Arena::reset() {
+    if (m_chunks.size() > 1) {
+        const std::size_t total = capacity();
+        m_chunks.clear();
+        m_chunks.push_back({std::make_unique_for_overwrite<std::byte[]>(total), total});
+    }
+    m_retired = 0;
+    if (m_chunks.empty()) {
+        m_cursor = m_end = nullptr;
+    } else {
+        m_cursor = m_chunks.back().data.get();
+        m_end = m_cursor + m_chunks.back().size;
+    }
+}
+
+std::size_t Arena::used() const noexcept {
+    return m_chunks.empty() ? 0 : m_retired + static_cast<std::size_t>(m_cursor - m_chunks.back().data.get());
+}
+
+std::size_t Arena::capacity() const noexcept {
+    std::size_t total = 0;
+    for (const auto& chunk : m_chunks) {
+        total += chunk.size;
+    }
+    return total;
+}
+
+void Arena::add_chunk(std::size_t min_size) {
+    if (!m_chunks.empty()) {
+        m_retired += static_cast<std::size_t>(m_cursor - m_chunks.back().data.get());
+    }
+    // Doubling keeps the number of chunks logarithmic in the total size.
+    const std::size_t size = std::max({min_size, m_chunk_size, m_chunks.empty() ? 0 : m_chunks.back().size * 2});
+    m_chunks.push_back({std::make_unique_for_overwrite<std::byte[]>(size), size});
+    m_cursor = m_chunks.back().data.get();
+    m_end = m_cursor + size;
+}
+
+} // namespace stockpile
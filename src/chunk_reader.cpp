@@ -0,0 +1,271 @@
+#include "stockpile/chunk_reader.hpp"
+
+#include "stockpile/archive_set.hpp"
+#include "stockpile/compression.hpp"
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstring>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace stockpile {
+
+namespace detail {
+
+struct ChunkReaderState {
+    const Archive* archive = nullptr;
+    EntryId id = 0;
+    std::uint64_t size = 0;
+    std::size_t chunk_size = 0;
+    std::uint64_t chunk_count = 0;
+    /// Raw bytes per block; 0 for uncompressed entries.
+    std::uint64_t block_size = 0;
+    /// Size of the block table at the start of the stored bytes, and of the
+    /// blocks after it.
+    std::uint64_t table_size = 0;
+    std::uint64_t blocks_size = 0;
+
+    /// `slots` buffers of `slot_size` bytes; chunk i is decoded into buffer
+    /// i % slots.
+    std::vector<std::byte> ring;
+    std::size_t slot_size = 0;
+    std::size_t slots = 0;
+    /// Stored bytes and block ends of the chunk being read, reused.
+    std::vector<std::byte> stored;
+    std::vector<std::uint64_t> ends;
+
+    std::mutex mutex;
+    /// Signalled when a chunk is decoded or reading failed.
+    std::condition_variable ready;
+    /// Signalled when the consumer hands a buffer back, or on stop.
+    std::condition_variable space;
+    std::uint64_t produced = 0;
+    std::uint64_t released = 0;
+    std::error_code error;
+    bool stop = false;
+    std::thread reader;
+
+    // Consumer side, only touched by the thread calling next() and read().
+    std::uint64_t taken = 0;
+    /// Part of chunk `taken - 1` not returned yet, starting at `position`.
+    std::span<const std::byte> current;
+    std::uint64_t position = 0;
+
+    ~ChunkReaderState();
+    [[nodiscard]] Result<void> fill(std::uint64_t offset, std::span<std::byte> out);
+    void run();
+    [[nodiscard]] Result<bool> fetch();
+};
+
+ChunkReaderState::~ChunkReaderState() {
+    if (reader.joinable()) {
+        {
+            const std::lock_guard lock(mutex);
+            stop = true;
+        }
+        space.notify_one();
+        reader.join();
+    }
+}
+
+/// Reads and decodes the `out.size()` bytes of the entry at `offset`, which
+/// starts a block of a compressed entry.
+Result<void> ChunkReaderState::fill(std::uint64_t offset, std::span<std::byte> out) {
+    const std::uint64_t base = archive->offset(id);
+    if (block_size == 0) {
+        return archive->file().read_at(base + offset, out);
+    }
+
+    // ends[0] is where the chunk's first block starts, ends[i + 1] where its
+    // block i ends, both relative to the end of the table.
+    const std::uint64_t first = offset / block_size;
+    const std::uint64_t count = (out.size() + block_size - 1) / block_size;
+    ends.resize(count + 1);
+    auto table = std::as_writable_bytes(std::span(ends));
+    Result<void> read;
+    if (first == 0) {
+        ends[0] = 0;
+        read = archive->file().read_at(base, table.subspan(sizeof(std::uint64_t)));
+    } else {
+        read = archive->file().read_at(base + (first - 1) * sizeof(std::uint64_t), table);
+    }
+    if (!read) {
+        return read;
+    }
+    for (std::uint64_t i = 0; i < count; ++i) {
+        const std::uint64_t raw = std::min<std::uint64_t>(block_size, out.size() - i * block_size);
+        if (ends[i] > ends[i + 1] || ends[i + 1] > blocks_size || ends[i + 1] - ends[i] > raw) {
+            return fail(Errc::corrupt_archive);
+        }
+    }
+
+    // Blocks are never stored larger than they decode, so this stays within
+    // the capacity reserved by open().
+    stored.resize(ends[count] - ends[0]);
+    if (read = archive->file().read_at(base + table_size + ends[0], stored); !read) {
+        return read;
+    }
+    const Codec codec = archive->codec(id);
+    for (std::uint64_t i = 0; i < count; ++i) {
+        const auto raw = out.subspan(i * block_size, std::min<std::uint64_t>(block_size, out.size() - i * block_size));
+        const auto src = std::span(stored).subspan(ends[i] - ends[0], ends[i + 1] - ends[i]);
+        if (!decompress(src.size() == raw.size() ? Codec::none : codec, src, raw)) {
+            return fail(Errc::corrupt_archive);
+        }
+    }
+    return {};
+}
+
+void ChunkReaderState::run() {
+    for (std::uint64_t index = 0; index < chunk_count; ++index) {
+        {
+            std::unique_lock lock(mutex);
+            space.wait(lock, [&] { return stop || index - released < slots; });
+            if (stop) {
+                return;
+            }
+        }
+        // The buffer is neither read by the consumer nor written by anyone
+        // else until this chunk is published.
+        const std::uint64_t offset = index * chunk_size;
+        const auto buffer = std::span(ring).subspan((index % slots) * slot_size,
+                                                    std::min<std::uint64_t>(chunk_size, size - offset));
+        const auto filled = fill(offset, buffer);
+        {
+            const std::lock_guard lock(mutex);
+            if (!filled) {
+                error = filled.error();
+            } else {
+                ++produced;
+            }
+        }
+        ready.notify_one();
+        if (!filled) {
+            return;
+        }
+    }
+}
+
+/// Hands the current chunk's buffer back and waits for the next chunk.
+/// Returns false at the end of the entry.
+Result<bool> ChunkReaderState::fetch() {
+    current = {};
+    std::unique_lock lock(mutex);
+    if (released < taken) {
+        released = taken;
+        space.notify_one();
+    }
+    if (taken == chunk_count) {
+        return false;
+    }
+    ready.wait(lock, [&] { return produced > taken || error; });
+    if (produced == taken) {
+        return std::unexpected(error);
+    }
+    position = taken * chunk_size;
+    current = std::span(ring).subspan((taken % slots) * slot_size,
+                                      std::min<std::uint64_t>(chunk_size, size - position));
+    ++taken;
+    return true;
+}
+
+} // namespace detail
+
+Result<ChunkReader> ChunkReader::open(const Archive& archive, EntryId id, const ChunkReaderOptions& options) {
+    if (options.chunk_size == 0 || options.depth == 0) {
+        return std::unexpected(std::make_error_code(std::errc::invalid_argument));
+    }
+    auto state = std::make_unique<detail::ChunkReaderState>();
+    state->archive = &archive;
+    state->id = id;
+    state->size = archive.size(id);
+    state->block_size = archive.block_size(id);
+    state->chunk_size = options.chunk_size;
+    if (state->block_size != 0) {
+        // Whole blocks per chunk, so that no block straddles two chunks.
+        const auto blocks = std::max<std::uint64_t>(options.chunk_size / state->block_size, 1);
+        state->chunk_size = static_cast<std::size_t>(blocks * state->block_size);
+        const std::uint64_t block_count = (state->size + state->block_size - 1) / state->block_size;
+        state->table_size = block_count * sizeof(std::uint64_t);
+        const std::uint64_t stored_size = archive.data(id).size();
+        if (state->table_size > stored_size) {
+            return fail(Errc::corrupt_archive);
+        }
+        state->blocks_size = stored_size - state->table_size;
+    }
+    state->chunk_count = (state->size + state->chunk_size - 1) / state->chunk_size;
+
+    // Entries smaller than the ring get buffers no larger than themselves.
+    state->slot_size = static_cast<std::size_t>(std::min<std::uint64_t>(state->chunk_size, state->size));
+    state->slots = static_cast<std::size_t>(std::min<std::uint64_t>(options.depth, state->chunk_count));
+    state->ring.resize(state->slot_size * state->slots);
+    if (state->block_size != 0) {
+        state->stored.reserve(state->slot_size);
+    }
+    if (state->chunk_count != 0) {
+        auto* raw = state.get();
+        state->reader = std::thread([raw] { raw->run(); });
+    }
+    return ChunkReader(std::move(state));
+}
+
+Result<ChunkReader> ChunkReader::open(const ArchiveSet& set, EntryRef ref, const ChunkReaderOptions& options) {
+    return open(set.archive(ref.archive), ref.entry, options);
+}
+
+ChunkReader::ChunkReader(std::unique_ptr<detail::ChunkReaderState> state) noexcept : m_state(std::move(state)) {}
+
+ChunkReader::ChunkReader(ChunkReader&&) noexcept = default;
+ChunkReader& ChunkReader::operator=(ChunkReader&&) noexcept = default;
+ChunkReader::~ChunkReader() = default;
+
+Result<std::optional<Chunk>> ChunkReader::next() {
+    auto& state = *m_state;
+    if (state.current.empty()) {
+        const auto fetched = state.fetch();
+        if (!fetched) {
+            return std::unexpected(fetched.error());
+        }
+        if (!*fetched) {
+            return std::nullopt;
+        }
+    }
+    const Chunk chunk{state.position, state.current};
+    state.position += state.current.size();
+    state.current = {};
+    return chunk;
+}
+
+Result<std::size_t> ChunkReader::read(std::span<std::byte> out) {
+    auto& state = *m_state;
+    std::size_t copied = 0;
+    while (copied < out.size()) {
+        if (state.current.empty()) {
+            const auto fetched = state.fetch();
+            if (!fetched) {
+                return std::unexpected(fetched.error());
+            }
+            if (!*fetched) {
+                break;
+            }
+        }
+        const std::size_t count = std::min(state.current.size(), out.size() - copied);
+        std::memcpy(out.data() + copied, state.current.data(), count);
+        state.current = state.current.subspan(count);
+        state.position += count;
+        copied += count;
+    }
+    return copied;
+}
+
+std::uint64_t ChunkReader::size() const noexcept {
+    return m_state->size;
+}
+
+std::size_t ChunkReader::chunk_size() const noexcept {
+    return m_state->chunk_size;
+}
+
+} // namespace stockpile
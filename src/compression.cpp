@@ -0,0 +1,241 @@
+#include "stockpile/compression.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+
+namespace stockpile {
+
+namespace {
+
+// LZ4 block format: a sequence is a token (literal length << 4 | match
+// length - 4), optional length extension bytes, the literals, a 16-bit
+// little-endian offset and optional match length extension bytes. The last
+// sequence carries literals only.
+
+constexpr std::size_t kMinMatch = 4;
+constexpr std::size_t kLastLiterals = 5;
+constexpr std::size_t kMatchFindLimit = 12;
+constexpr std::size_t kMaxOffset = 65535;
+constexpr std::size_t kMaxInput = 0x7E000000;
+constexpr unsigned kHashLog = 14;
+
+[[nodiscard]] inline std::uint32_t read32(const std::byte* p) noexcept {
+    std::uint32_t value;
+    std::memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+[[nodiscard]] inline std::uint32_t hash_sequence(std::uint32_t sequence) noexcept {
+    return (sequence * 2654435761U) >> (32 - kHashLog);
+}
+
+class SequenceWriter {
+public:
+    explicit SequenceWriter(std::span<std::byte> dst) noexcept : m_dst(dst) {}
+
+    [[nodiscard]] std::size_t size() const noexcept { return m_pos; }
+
+    /// Emits literals followed by an optional match; false if out of space.
+    [[nodiscard]] bool emit(std::span<const std::byte> literals, std::size_t offset, std::size_t match) noexcept {
+        const std::size_t worst = 1 + literals.size() / 255 + 1 + literals.size() + 2 + match / 255 + 1;
+        if (worst > m_dst.size() - m_pos) {
+            return false;
+        }
+        std::byte& token = m_dst[m_pos++];
+        std::uint8_t token_value = 0;
+        token_value |= static_cast<std::uint8_t>(std::min<std::size_t>(literals.size(), 15) << 4);
+        if (literals.size() >= 15) {
+            put_length(literals.size() - 15);
+        }
+        if (!literals.empty()) {
+            std::memcpy(m_dst.data() + m_pos, literals.data(), literals.size());
+            m_pos += literals.size();
+        }
+
+        if (match != 0) {
+            m_dst[m_pos++] = static_cast<std::byte>(offset & 0xFF);
+            m_dst[m_pos++] = static_cast<std::byte>(offset >> 8);
+            const std::size_t extra = match - kMinMatch;
+            token_value |= static_cast<std::uint8_t>(std::min<std::size_t>(extra, 15));
+            if (extra >= 15) {
+                put_length(extra - 15);
+            }
+        }
+        token = static_cast<std::byte>(token_value);
+        return true;
+    }
+
+private:
+    void put_length(std::size_t length) noexcept {
+        while (length >= 255) {
+            m_dst[m_pos++] = std::byte{255};
+            length -= 255;
+        }
+        m_dst[m_pos++] = static_cast<std::byte>(length);
+    }
+
+    std::span<std::byte> m_dst;
+    std::size_t m_pos = 0;
+};
+
+[[nodiscard]] std::size_t lz4_compress(std::span<const std::byte> src, std::span<std::byte> dst) noexcept {
+    if (src.size() > kMaxInput) {
+        return 0;
+    }
+    const std::byte* base = src.data();
+    const std::size_t n = src.size();
+    SequenceWriter out(dst);
+    std::size_t anchor = 0;
+
+    if (n >= kMatchFindLimit + 1) {
+        std::array<std::uint32_t, std::size_t{1} << kHashLog> table{};
+        const std::size_t match_limit = n - kLastLiterals;
+        std::size_t ip = 1;
+        while (ip + kMatchFindLimit <= n) {
+            const std::uint32_t sequence = read32(base + ip);
+            const std::uint32_t h = hash_sequence(sequence);
+            std::size_t candidate = table[h];
+            table[h] = static_cast<std::uint32_t>(ip);
+            if (candidate >= ip || ip - candidate > kMaxOffset || read32(base + candidate) != sequence) {
+                // Step faster through data that does not compress.
+                ip += 1 + ((ip - anchor) >> 6);
+                continue;
+            }
+
+            while (ip > anchor && candidate > 0 && base[ip - 1] == base[candidate - 1]) {
+                --ip;
+                --candidate;
+            }
+            std::size_t length = kMinMatch;
+            while (ip + length < match_limit && base[candidate + length] == base[ip + length]) {
+                ++length;
+            }
+
+            if (!out.emit(src.subspan(anchor, ip - anchor), ip - candidate, length)) {
+                return 0;
+            }
+            ip += length;
+            anchor = ip;
+            if (ip + kMatchFindLimit <= n) {
+                table[hash_sequence(read32(base + ip - 2))] = static_cast<std::uint32_t>(ip - 2);
+            }
+        }
+    }
+
+    if (!out.emit(src.subspan(anchor), 0, 0)) {
+        return 0;
+    }
+    return out.size();
+}
+
+[[nodiscard]] bool lz4_decompress(std::span<const std::byte> src, std::span<std::byte> dst) noexcept {
+    const std::byte* in = src.data();
+    const std::size_t in_size = src.size();
+    std::byte* out = dst.data();
+    const std::size_t out_size = dst.size();
+    std::size_t ip = 0;
+    std::size_t op = 0;
+
+    const auto read_length = [&](std::size_t& length) noexcept {
+        std::uint8_t byte = 0;
+        do {
+            if (ip >= in_size) {
+                return false;
+            }
+            byte = std::to_integer<std::uint8_t>(in[ip++]);
+            length += byte;
+        } while (byte == 255);
+        return true;
+    };
+
+    for (;;) {
+        if (ip >= in_size) {
+            return false;
+        }
+        const auto token = std::to_integer<std::uint8_t>(in[ip++]);
+
+        std::size_t literals = token >> 4;
+        if (literals == 15 && !read_length(literals)) {
+            return false;
+        }
+        if (literals > in_size - ip || literals > out_size - op) {
+            return false;
+        }
+        if (literals != 0) {
+            std::memcpy(out + op, in + ip, literals);
+        }
+        ip += literals;
+        op += literals;
+        if (ip == in_size) {
+            break;
+        }
+
+        if (in_size - ip < 2) {
+            return false;
+        }
+        const std::size_t offset = std::to_integer<std::size_t>(in[ip]) |
+                                   std::to_integer<std::size_t>(in[ip + 1]) << 8;
+        ip += 2;
+        if (offset == 0 || offset > op) {
+            return false;
+        }
+
+        std::size_t match = token & 15;
+        if (match == 15 && !read_length(match)) {
+            return false;
+        }
+        match += kMinMatch;
+        if (match > out_size - op) {
+            return false;
+        }
+
+        const std::byte* from = out + op - offset;
+        if (offset >= match) {
+            std::memcpy(out + op, from, match);
+        } else {
+            // Overlapping copy replicates the last `offset` bytes.
+            for (std::size_t i = 0; i < match; ++i) {
+                out[op + i] = from[i];
+            }
+        }
+        op += match;
+    }
+    return op == out_size;
+}
+
+} // namespace
+
+std::size_t compress(Codec codec, std::span<const std::byte> src, std::span<std::byte> dst) noexcept {
+    switch (codec) {
+    case Codec::none:
+        if (src.size() > dst.size()) {
+            return 0;
+        }
+        if (!src.empty()) {
+            std::memcpy(dst.data(), src.data(), src.size());
+        }
+        return src.size();
+    case Codec::lz4:
+        return lz4_compress(src, dst);
+    }
+    return 0;
+}
+
+bool decompress(Codec codec, std::span<const std::byte> src, std::span<std::byte> dst) noexcept {
+    switch (codec) {
+    case Codec::none:
+        if (src.size() != dst.size()) {
+            return false;
+        }
+        if (!src.empty()) {
+            std::memcpy(dst.data(), src.data(), src.size());
+        }
+        return true;
+    case Codec::lz4:
+        return lz4_decompress(src, dst);
+    }
+    return false;
+}
+
+} // namespace stockpile
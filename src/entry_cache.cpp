@@ -0,0 +1,255 @@
+#include "stockpile/entry_cache.hpp"
+
+#include "stockpile/hash.hpp"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <list>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace stockpile {
+
+namespace detail {
+
+struct CacheKey {
+    /// Archive::serial() of the archive.
+    std::uint64_t archive;
+    EntryId entry;
+
+    friend bool operator==(const CacheKey&, const CacheKey&) = default;
+};
+
+[[nodiscard]] std::uint64_t key_hash(const CacheKey& key) noexcept {
+    const std::array<std::uint64_t, 2> words{key.archive, key.entry};
+    return hash64(std::as_bytes(std::span(words)));
+}
+
+struct CacheKeyHash {
+    [[nodiscard]] std::size_t operator()(const CacheKey& key) const noexcept {
+        return static_cast<std::size_t>(key_hash(key));
+    }
+};
+
+/// One independently locked part of an EntryCache, evicting with 2Q.
+///
+/// `recent` (A1in) is a FIFO of entries seen once, limited to a quarter of
+/// the budget. Entries falling out of it leave their key in `ghosts`
+/// (A1out); a miss on a ghost key means the entry is in repeated use, so it
+/// goes straight to `frequent` (Am), an LRU list holding the rest of the
+/// budget. Ghosts cost only their key, so as many are remembered as would
+/// fill the whole budget.
+struct CacheShard {
+    enum class Queue : std::uint8_t { recent, frequent, ghost };
+
+    struct Item {
+        Queue queue;
+        std::list<CacheKey>::iterator position;
+        CacheHandle value;
+        std::size_t size;
+    };
+
+    std::mutex mutex;
+    std::unordered_map<CacheKey, Item, CacheKeyHash> items;
+    /// Front is newest in every list.
+    std::list<CacheKey> recent;
+    std::list<CacheKey> frequent;
+    std::list<CacheKey> ghosts;
+    std::size_t recent_bytes = 0;
+    std::size_t frequent_bytes = 0;
+    std::size_t ghost_bytes = 0;
+    std::size_t budget = 0;
+    std::uint64_t hits = 0;
+    std::uint64_t misses = 0;
+    std::uint64_t evictions = 0;
+
+    [[nodiscard]] std::list<CacheKey>& list(Queue queue) noexcept {
+        switch (queue) {
+        case Queue::recent:
+            return recent;
+        case Queue::frequent:
+            return frequent;
+        case Queue::ghost:
+            break;
+        }
+        return ghosts;
+    }
+
+    [[nodiscard]] std::size_t& bytes(Queue queue) noexcept {
+        switch (queue) {
+        case Queue::recent:
+            return recent_bytes;
+        case Queue::frequent:
+            return frequent_bytes;
+        case Queue::ghost:
+            break;
+        }
+        return ghost_bytes;
+    }
+
+    /// Moves `item` of `key` to the front of `queue`.
+    void place(const CacheKey& key, Item& item, Queue queue) {
+        list(item.queue).erase(item.position);
+        bytes(item.queue) -= item.size;
+        auto& target = list(queue);
+        target.push_front(key);
+        item.queue = queue;
+        item.position = target.begin();
+        bytes(queue) += item.size;
+    }
+
+    void remove(std::unordered_map<CacheKey, Item, CacheKeyHash>::iterator it) {
+        list(it->second.queue).erase(it->second.position);
+        bytes(it->second.queue) -= it->second.size;
+        items.erase(it);
+    }
+
+    [[nodiscard]] CacheHandle find(const CacheKey& key) {
+        const auto it = items.find(key);
+        if (it == items.end() || it->second.queue == Queue::ghost) {
+            ++misses;
+            return {};
+        }
+        ++hits;
+        if (it->second.queue == Queue::frequent) {
+            frequent.splice(frequent.begin(), frequent, it->second.position);
+        }
+        return it->second.value;
+    }
+
+    /// Caches `value` unless the entry was cached meanwhile, and returns
+    /// the cached handle.
+    [[nodiscard]] CacheHandle insert(const CacheKey& key, CacheHandle value) {
+        if (value.size() > budget) {
+            return value;
+        }
+        auto it = items.find(key);
+        if (it == items.end()) {
+            recent.push_front(key);
+            items.emplace(key, Item{Queue::recent, recent.begin(), value, value.size()});
+            recent_bytes += value.size();
+        } else if (it->second.queue == Queue::ghost) {
+            // Evicted from `recent` and wanted again.
+            auto& item = it->second;
+            ghost_bytes -= item.size;
+            item.size = value.size();
+            ghost_bytes += item.size;
+            item.value = value;
+            place(key, item, Queue::frequent);
+        } else {
+            return it->second.value;
+        }
+        evict();
+        return value;
+    }
+
+    void evict() {
+        while (recent_bytes + frequent_bytes > budget) {
+            // Keep the entry just added unless nothing else is left.
+            if ((recent_bytes > budget / 4 && recent.size() > 1) || frequent.empty()) {
+                const CacheKey key = recent.back();
+                auto& item = items.find(key)->second;
+                item.value = {};
+                place(key, item, Queue::ghost);
+            } else {
+                remove(items.find(frequent.back()));
+            }
+            ++evictions;
+        }
+        while (ghost_bytes > budget) {
+            remove(items.find(ghosts.back()));
+        }
+    }
+
+    void clear() {
+        items.clear();
+        recent.clear();
+        frequent.clear();
+        ghosts.clear();
+        recent_bytes = frequent_bytes = ghost_bytes = 0;
+        hits = misses = evictions = 0;
+    }
+};
+
+} // namespace detail
+
+EntryCache::EntryCache(std::size_t byte_budget, std::size_t shards)
+    : m_budget(byte_budget),
+      m_shard_count(std::bit_ceil(std::max<std::size_t>(shards, 1))),
+      m_shards(std::make_unique<detail::CacheShard[]>(m_shard_count)) {
+    for (std::size_t i = 0; i < m_shard_count; ++i) {
+        m_shards[i].budget = byte_budget / m_shard_count;
+    }
+}
+
+EntryCache::~EntryCache() = default;
+
+detail::CacheShard& EntryCache::shard(std::uint64_t key_hash) const noexcept {
+    // The maps index by the low bits, so pick shards by the high ones.
+    return m_shards[(key_hash >> 40) & (m_shard_count - 1)];
+}
+
+Result<CacheHandle> EntryCache::get(const Archive& archive, EntryId id, ThreadPool* pool) {
+    const detail::CacheKey key{archive.serial(), id};
+    auto& part = shard(detail::key_hash(key));
+    {
+        std::lock_guard lock(part.mutex);
+        if (auto hit = part.find(key)) {
+            return hit;
+        }
+    }
+
+    const auto size = static_cast<std::size_t>(archive.size(id));
+    auto data = std::make_shared_for_overwrite<std::byte[]>(size);
+    if (auto read = archive.read(id, std::span(data.get(), size), pool); !read) {
+        return std::unexpected(read.error());
+    }
+    std::lock_guard lock(part.mutex);
+    return part.insert(key, CacheHandle(std::move(data), size));
+}
+
+CacheHandle EntryCache::find(const Archive& archive, EntryId id) {
+    const detail::CacheKey key{archive.serial(), id};
+    auto& part = shard(detail::key_hash(key));
+    std::lock_guard lock(part.mutex);
+    return part.find(key);
+}
+
+void EntryCache::erase(const Archive& archive) {
+    for (std::size_t i = 0; i < m_shard_count; ++i) {
+        auto& part = m_shards[i];
+        std::lock_guard lock(part.mutex);
+        for (auto it = part.items.begin(); it != part.items.end();) {
+            if (it->first.archive == archive.serial()) {
+                part.remove(it++);
+            } else {
+                ++it;
+            }
+        }
+    }
+}
+
+void EntryCache::clear() {
+    for (std::size_t i = 0; i < m_shard_count; ++i) {
+        std::lock_guard lock(m_shards[i].mutex);
+        m_shards[i].clear();
+    }
+}
+
+CacheStats EntryCache::stats() const {
+    CacheStats stats;
+    for (std::size_t i = 0; i < m_shard_count; ++i) {
+        auto& part = m_shards[i];
+        std::lock_guard lock(part.mutex);
+        stats.hits += part.hits;
+        stats.misses += part.misses;
+        stats.evictions += part.evictions;
+        stats.entries += part.recent.size() + part.frequent.size();
+        stats.bytes += part.recent_bytes + part.frequent_bytes;
+    }
+    return stats;
+}
+
+} // namespace stockpile
@@ -0,0 +1,37 @@
+#include "stockpile/error.hpp"
+
+#include <string>
+
+namespace stockpile {
+
+namespace {
+
+class ErrorCategory final : public std::error_category {
+public:
+    const char* name() const noexcept override { return "stockpile"; }
+
+    std::string message(int value) const override {
+        switch (static_cast<Errc>(value)) {
+        case Errc::bad_magic:           return "not a stockpile archive";
+        case Errc::unsupported_version: return "unsupported archive version";
+        case Errc::corrupt_archive:     return "archive is corrupt or truncated";
+        case Errc::invalid_path:        return "invalid entry path";
+        case Errc::duplicate_path:      return "duplicate entry path";
+        case Errc::too_large:           return "archive exceeds format limits";
+        case Errc::hash_collision:      return "two entry paths have the same hash";
+        case Errc::malformed_data:      return "serialized data is malformed or truncated";
+        case Errc::missing_field:       return "record has no such field";
+        case Errc::checksum_mismatch:   return "checksum mismatch: data is corrupt";
+        }
+        return "unknown stockpile error";
+    }
+};
+
+} // namespace
+
+const std::error_category& error_category() noexcept {
+    static const ErrorCategory category;
+    return category;
+}
+
+} // namespace stockpile
@@ -0,0 +1,49 @@
+#include "stockpile/handle_table.hpp"
+
+namespace stockpile {
+
+std::optional<std::uint32_t> HandleTable::resolve_slot(std::uint64_t path_hash) {
+    if (const auto it = m_by_hash.find(path_hash); it != m_by_hash.end()) {
+        return it->second;
+    }
+    const auto ref = m_set->find_hash(path_hash);
+    if (!ref) {
+        return std::nullopt;
+    }
+
+    std::uint32_t index;
+    if (!m_free.empty()) {
+        index = m_free.back();
+        m_free.pop_back();
+    } else {
+        index = static_cast<std::uint32_t>(m_slots.size());
+        m_slots.emplace_back();
+    }
+    m_slots[index].ref = *ref;
+    m_slots[index].path_hash = path_hash;
+    m_by_hash.emplace(path_hash, index);
+    return index;
+}
+
+void HandleTable::release_slot(std::uint32_t index) noexcept {
+    auto& slot = m_slots[index];
+    m_by_hash.erase(slot.path_hash);
+    slot.generation = detail::next_generation(slot.generation);
+    m_free.push_back(index);
+}
+
+void HandleTable::refresh() {
+    std::vector<std::uint32_t> gone;
+    for (const auto& [path_hash, index] : m_by_hash) {
+        if (const auto ref = m_set->find_hash(path_hash)) {
+            m_slots[index].ref = *ref;
+        } else {
+            gone.push_back(index);
+        }
+    }
+    for (const auto index : gone) {
+        release_slot(index);
+    }
+}
+
+} // namespace stockpile
@@ -0,0 +1,405 @@
+#include "stockpile/hash.hpp"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstring>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#include <immintrin.h>
+#define STOCKPILE_HAVE_X86_KERNELS 1
+#endif
+
+namespace stockpile {
+
+namespace {
+
+// The construction follows XXH3: short inputs are hashed by a couple of
+// folded 128-bit multiplies, long inputs by eight 64-bit lanes that each
+// accumulate 32x32->64 products of keyed input, so the long path maps
+// directly onto SIMD registers.
+
+constexpr std::uint64_t kPrime1 = 0x9E3779B185EBCA87ULL;
+constexpr std::uint64_t kPrime2 = 0xC2B2AE3D27D4EB4FULL;
+constexpr std::uint64_t kPrime3 = 0x165667B19E3779F9ULL;
+constexpr std::uint64_t kPrime4 = 0x85EBCA77C2B2AE63ULL;
+constexpr std::uint64_t kPrime5 = 0x27D4EB2F165667C5ULL;
+constexpr std::uint64_t kPrime32 = 0x9E3779B1ULL;
+
+constexpr std::size_t kStripeSize = 64;
+constexpr std::size_t kLanes = kStripeSize / sizeof(std::uint64_t);
+constexpr std::size_t kStripesPerBlock = 8;
+constexpr std::size_t kBlockSize = kStripeSize * kStripesPerBlock;
+
+constexpr std::array<std::uint64_t, 16> make_secret() noexcept {
+    // splitmix64 seeded with "STKPILE1".
+    std::array<std::uint64_t, 16> secret{};
+    std::uint64_t state = 0x53544B50494C4531ULL;
+    for (auto& word : secret) {
+        state += 0x9E3779B97F4A7C15ULL;
+        std::uint64_t z = state;
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+        word = z ^ (z >> 31);
+    }
+    return secret;
+}
+
+constexpr auto kSecret = make_secret();
+
+constexpr std::array<std::uint64_t, kLanes> kInitialLanes = {
+    kPrime32, kPrime1, kPrime2, kPrime3, kPrime4, kPrime5, ~kPrime1, ~kPrime2,
+};
+
+[[nodiscard]] inline std::uint64_t read64(const std::byte* p) noexcept {
+    std::uint64_t value;
+    std::memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+[[nodiscard]] inline std::uint64_t read32(const std::byte* p) noexcept {
+    std::uint32_t value;
+    std::memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+/// Full 64x64->128 multiply folded back to 64 bits.
+[[nodiscard]] inline std::uint64_t mix64(std::uint64_t a, std::uint64_t b) noexcept {
+#if defined(__SIZEOF_INT128__)
+    __extension__ using uint128 = unsigned __int128;
+    const auto product = static_cast<uint128>(a) * b;
+    return static_cast<std::uint64_t>(product) ^ static_cast<std::uint64_t>(product >> 64);
+#else
+    const std::uint64_t a_lo = a & 0xFFFFFFFF, a_hi = a >> 32;
+    const std::uint64_t b_lo = b & 0xFFFFFFFF, b_hi = b >> 32;
+    const std::uint64_t lo_lo = a_lo * b_lo;
+    const std::uint64_t hi_lo = a_hi * b_lo;
+    const std::uint64_t lo_hi = a_lo * b_hi;
+    const std::uint64_t hi_hi = a_hi * b_hi;
+    const std::uint64_t cross = (lo_lo >> 32) + (hi_lo & 0xFFFFFFFF) + lo_hi;
+    const std::uint64_t upper = (hi_lo >> 32) + (cross >> 32) + hi_hi;
+    const std::uint64_t lower = (cross << 32) | (lo_lo & 0xFFFFFFFF);
+    return lower ^ upper;
+#endif
+}
+
+[[nodiscard]] inline std::uint64_t avalanche(std::uint64_t h) noexcept {
+    h ^= h >> 37;
+    h *= 0x165667919E3779F9ULL;
+    h ^= h >> 32;
+    return h;
+}
+
+[[nodiscard]] inline std::uint64_t mix16(const std::byte* p, std::size_t key, std::uint64_t seed) noexcept {
+    return mix64(read64(p) ^ (kSecret[key] + seed), read64(p + 8) ^ (kSecret[key + 1] - seed));
+}
+
+/// 0 to 16 bytes.
+[[nodiscard]] std::uint64_t hash_short(const std::byte* p, std::size_t len, std::uint64_t seed) noexcept {
+    std::uint64_t lo = 0;
+    std::uint64_t hi = 0;
+    if (len >= 8) {
+        lo = read64(p);
+        hi = read64(p + len - 8);
+    } else if (len >= 4) {
+        lo = read32(p);
+        hi = read32(p + len - 4);
+    } else if (len > 0) {
+        lo = std::to_integer<std::uint64_t>(p[0]) |
+             std::to_integer<std::uint64_t>(p[len >> 1]) << 8 |
+             std::to_integer<std::uint64_t>(p[len - 1]) << 16;
+    }
+    return avalanche(mix64(lo ^ (kSecret[0] + seed), hi ^ (kSecret[1] - seed)) + len * kPrime1);
+}
+
+/// 17 to 128 bytes: 16-byte pairs taken from both ends.
+[[nodiscard]] std::uint64_t hash_medium(const std::byte* p, std::size_t len, std::uint64_t seed) noexcept {
+    std::uint64_t acc = len * kPrime1;
+    const std::size_t pairs = (len - 1) / 32 + 1;
+    for (std::size_t i = 0; i < pairs; ++i) {
+        acc += mix16(p + 16 * i, 4 * i, seed);
+        acc += mix16(p + len - 16 * (i + 1), 4 * i + 2, seed);
+    }
+    return avalanche(acc);
+}
+
+inline void accumulate_stripe(std::uint64_t* acc, const std::byte* data, const std::uint64_t* key) noexcept {
+    for (std::size_t i = 0; i < kLanes; ++i) {
+        const std::uint64_t value = read64(data + 8 * i);
+        const std::uint64_t keyed = value ^ key[i];
+        acc[i ^ 1] += value;
+        acc[i] += (keyed & 0xFFFFFFFF) * (keyed >> 32);
+    }
+}
+
+/// Consumes `stripes` consecutive stripes; stripe n is keyed by kSecret[n..n+8).
+void accumulate(std::uint64_t* acc, const std::byte* data, std::size_t stripes) noexcept {
+    for (std::size_t n = 0; n < stripes; ++n) {
+        accumulate_stripe(acc, data + n * kStripeSize, kSecret.data() + n);
+    }
+}
+
+void scramble(std::uint64_t* acc) noexcept {
+    const std::uint64_t* key = kSecret.data() + kLanes;
+    for (std::size_t i = 0; i < kLanes; ++i) {
+        std::uint64_t lane = acc[i];
+        lane ^= lane >> 47;
+        lane ^= key[i];
+        acc[i] = lane * kPrime32;
+    }
+}
+
+/// Runs every stripe of a long input through the lanes in `acc`.
+using LongFn = void (*)(std::uint64_t* acc, const std::byte* p, std::size_t len) noexcept;
+
+void accumulate_long_scalar(std::uint64_t* acc, const std::byte* p, std::size_t len) noexcept {
+    const std::size_t blocks = (len - 1) / kBlockSize;
+    for (std::size_t b = 0; b < blocks; ++b) {
+        accumulate(acc, p + b * kBlockSize, kStripesPerBlock);
+        scramble(acc);
+    }
+    const std::size_t tail = len - blocks * kBlockSize;
+    accumulate(acc, p + blocks * kBlockSize, (tail - 1) / kStripeSize);
+    // The final, possibly overlapping stripe always ends at the last byte.
+    accumulate_stripe(acc, p + len - kStripeSize, kSecret.data() + kLanes - 1);
+}
+
+#if defined(STOCKPILE_HAVE_X86_KERNELS)
+// The vector kernels compute exactly what accumulate_stripe() and scramble()
+// do, a register of lanes at a time: the 32x32->64 product is mul_epu32, the
+// acc[i ^ 1] cross-add swaps adjacent 64-bit lanes, and the multiply by the
+// 32-bit kPrime32 is split into two mul_epu32 halves. Each kernel repeats the
+// block structure of accumulate_long_scalar().
+
+__attribute__((target("sse4.2"))) inline void stripe_sse(__m128i* acc, const std::byte* data,
+                                                          const std::uint64_t* key) noexcept {
+    for (std::size_t j = 0; j < kLanes / 2; ++j) {
+        const __m128i value = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data) + j);
+        const __m128i keyed = _mm_xor_si128(value, _mm_loadu_si128(reinterpret_cast<const __m128i*>(key) + j));
+        const __m128i product = _mm_mul_epu32(keyed, _mm_srli_epi64(keyed, 32));
+        const __m128i swapped = _mm_shuffle_epi32(value, _MM_SHUFFLE(1, 0, 3, 2));
+        acc[j] = _mm_add_epi64(acc[j], _mm_add_epi64(product, swapped));
+    }
+}
+
+__attribute__((target("sse4.2"))) inline void scramble_sse(__m128i* acc) noexcept {
+    const __m128i prime = _mm_set1_epi64x(static_cast<long long>(kPrime32));
+    for (std::size_t j = 0; j < kLanes / 2; ++j) {
+        const __m128i key = _mm_loadu_si128(reinterpret_cast<const __m128i*>(kSecret.data() + kLanes) + j);
+        const __m128i lane = _mm_xor_si128(_mm_xor_si128(acc[j], _mm_srli_epi64(acc[j], 47)), key);
+        const __m128i low = _mm_mul_epu32(lane, prime);
+        const __m128i high = _mm_mul_epu32(_mm_srli_epi64(lane, 32), prime);
+        acc[j] = _mm_add_epi64(low, _mm_slli_epi64(high, 32));
+    }
+}
+
+__attribute__((target("sse4.2"))) void accumulate_long_sse(std::uint64_t* out, const std::byte* p,
+                                                           std::size_t len) noexcept {
+    __m128i acc[kLanes / 2];
+    for (std::size_t j = 0; j < kLanes / 2; ++j) {
+        acc[j] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(out) + j);
+    }
+    const std::size_t blocks = (len - 1) / kBlockSize;
+    for (std::size_t b = 0; b < blocks; ++b) {
+        for (std::size_t n = 0; n < kStripesPerBlock; ++n) {
+            stripe_sse(acc, p + b * kBlockSize + n * kStripeSize, kSecret.data() + n);
+        }
+        scramble_sse(acc);
+    }
+    const std::size_t stripes = (len - blocks * kBlockSize - 1) / kStripeSize;
+    for (std::size_t n = 0; n < stripes; ++n) {
+        stripe_sse(acc, p + blocks * kBlockSize + n * kStripeSize, kSecret.data() + n);
+    }
+    stripe_sse(acc, p + len - kStripeSize, kSecret.data() + kLanes - 1);
+    for (std::size_t j = 0; j < kLanes / 2; ++j) {
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out) + j, acc[j]);
+    }
+}
+
+__attribute__((target("avx2"))) inline void stripe_avx2(__m256i* acc, const std::byte* data,
+                                                         const std::uint64_t* key) noexcept {
+    for (std::size_t j = 0; j < kLanes / 4; ++j) {
+        const __m256i value = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data) + j);
+        const __m256i keyed =
+            _mm256_xor_si256(value, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(key) + j));
+        const __m256i product = _mm256_mul_epu32(keyed, _mm256_srli_epi64(keyed, 32));
+        const __m256i swapped = _mm256_shuffle_epi32(value, _MM_SHUFFLE(1, 0, 3, 2));
+        acc[j] = _mm256_add_epi64(acc[j], _mm256_add_epi64(product, swapped));
+    }
+}
+
+__attribute__((target("avx2"))) inline void scramble_avx2(__m256i* acc) noexcept {
+    const __m256i prime = _mm256_set1_epi64x(static_cast<long long>(kPrime32));
+    for (std::size_t j = 0; j < kLanes / 4; ++j) {
+        const __m256i key = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(kSecret.data() + kLanes) + j);
+        const __m256i lane = _mm256_xor_si256(_mm256_xor_si256(acc[j], _mm256_srli_epi64(acc[j], 47)), key);
+        const __m256i low = _mm256_mul_epu32(lane, prime);
+        const __m256i high = _mm256_mul_epu32(_mm256_srli_epi64(lane, 32), prime);
+        acc[j] = _mm256_add_epi64(low, _mm256_slli_epi64(high, 32));
+    }
+}
+
+__attribute__((target("avx2"))) void accumulate_long_avx2(std::uint64_t* out, const std::byte* p,
+                                                          std::size_t len) noexcept {
+    __m256i acc[kLanes / 4];
+    for (std::size_t j = 0; j < kLanes / 4; ++j) {
+        acc[j] = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(out) + j);
+    }
+    const std::size_t blocks = (len - 1) / kBlockSize;
+    for (std::size_t b = 0; b < blocks; ++b) {
+        for (std::size_t n = 0; n < kStripesPerBlock; ++n) {
+            stripe_avx2(acc, p + b * kBlockSize + n * kStripeSize, kSecret.data() + n);
+        }
+        scramble_avx2(acc);
+    }
+    const std::size_t stripes = (len - blocks * kBlockSize - 1) / kStripeSize;
+    for (std::size_t n = 0; n < stripes; ++n) {
+        stripe_avx2(acc, p + blocks * kBlockSize + n * kStripeSize, kSecret.data() + n);
+    }
+    stripe_avx2(acc, p + len - kStripeSize, kSecret.data() + kLanes - 1);
+    for (std::size_t j = 0; j < kLanes / 4; ++j) {
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out) + j, acc[j]);
+    }
+}
+
+// One 512-bit register holds all eight lanes, so a stripe is a single load.
+// The zero-masking forms with every lane selected compute the same as the
+// plain intrinsics, whose undefined passthrough operand GCC 12 warns about.
+
+constexpr __mmask8 kAllLanes = 0xFF;
+
+__attribute__((target("avx512f"))) inline __m512i stripe_avx512(__m512i acc, const std::byte* data,
+                                                                 const std::uint64_t* key) noexcept {
+    const __m512i value = _mm512_loadu_si512(data);
+    const __m512i keyed = _mm512_xor_si512(value, _mm512_loadu_si512(key));
+    const __m512i product =
+        _mm512_maskz_mul_epu32(kAllLanes, keyed, _mm512_maskz_srli_epi64(kAllLanes, keyed, 32));
+    const __m512i swapped = _mm512_maskz_shuffle_epi32(0xFFFF, value, _MM_PERM_BADC);
+    return _mm512_add_epi64(acc, _mm512_add_epi64(product, swapped));
+}
+
+__attribute__((target("avx512f"))) inline __m512i scramble_avx512(__m512i acc) noexcept {
+    const __m512i prime = _mm512_set1_epi64(static_cast<long long>(kPrime32));
+    const __m512i lane = _mm512_xor_si512(_mm512_xor_si512(acc, _mm512_maskz_srli_epi64(kAllLanes, acc, 47)),
+                                          _mm512_loadu_si512(kSecret.data() + kLanes));
+    const __m512i low = _mm512_maskz_mul_epu32(kAllLanes, lane, prime);
+    const __m512i high = _mm512_maskz_mul_epu32(kAllLanes, _mm512_maskz_srli_epi64(kAllLanes, lane, 32), prime);
+    return _mm512_add_epi64(low, _mm512_maskz_slli_epi64(kAllLanes, high, 32));
+}
+
+__attribute__((target("avx512f"))) void accumulate_long_avx512(std::uint64_t* out, const std::byte* p,
+                                                               std::size_t len) noexcept {
+    __m512i acc = _mm512_loadu_si512(out);
+    const std::size_t blocks = (len - 1) / kBlockSize;
+    for (std::size_t b = 0; b < blocks; ++b) {
+        for (std::size_t n = 0; n < kStripesPerBlock; ++n) {
+            acc = stripe_avx512(acc, p + b * kBlockSize + n * kStripeSize, kSecret.data() + n);
+        }
+        acc = scramble_avx512(acc);
+    }
+    const std::size_t stripes = (len - blocks * kBlockSize - 1) / kStripeSize;
+    for (std::size_t n = 0; n < stripes; ++n) {
+        acc = stripe_avx512(acc, p + blocks * kBlockSize + n * kStripeSize, kSecret.data() + n);
+    }
+    acc = stripe_avx512(acc, p + len - kStripeSize, kSecret.data() + kLanes - 1);
+    _mm512_storeu_si512(out, acc);
+}
+#endif
+
+[[nodiscard]] SimdLevel detect_simd_level() noexcept {
+#if defined(STOCKPILE_HAVE_X86_KERNELS)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f")) {
+        return SimdLevel::avx512;
+    }
+    if (__builtin_cpu_supports("avx2")) {
+        return SimdLevel::avx2;
+    }
+    if (__builtin_cpu_supports("sse4.2")) {
+        return SimdLevel::sse42;
+    }
+#endif
+    return SimdLevel::scalar;
+}
+
+[[nodiscard]] SimdLevel detected_level() noexcept {
+    static const SimdLevel level = detect_simd_level();
+    return level;
+}
+
+std::atomic<SimdLevel>& current_level() noexcept {
+    static std::atomic<SimdLevel> level{detected_level()};
+    return level;
+}
+
+[[nodiscard]] LongFn long_kernel() noexcept {
+    switch (simd_level()) {
+#if defined(STOCKPILE_HAVE_X86_KERNELS)
+    case SimdLevel::avx512:
+        return accumulate_long_avx512;
+    case SimdLevel::avx2:
+        return accumulate_long_avx2;
+    case SimdLevel::sse42:
+        return accumulate_long_sse;
+#endif
+    default:
+        return accumulate_long_scalar;
+    }
+}
+
+/// More than 128 bytes: fills `acc` with the lane state.
+void hash_long(const std::byte* p, std::size_t len, std::uint64_t seed,
+               std::array<std::uint64_t, kLanes>& acc) noexcept {
+    for (std::size_t i = 0; i < kLanes; ++i) {
+        acc[i] = (i % 2 == 0) ? kInitialLanes[i] + seed : kInitialLanes[i] - seed;
+    }
+    long_kernel()(acc.data(), p, len);
+}
+
+[[nodiscard]] std::uint64_t merge(const std::array<std::uint64_t, kLanes>& acc, std::size_t key,
+                                  std::uint64_t start) noexcept {
+    std::uint64_t result = start;
+    for (std::size_t i = 0; i < kLanes; i += 2) {
+        result += mix64(acc[i] ^ kSecret[key + i], acc[i + 1] ^ kSecret[key + i + 1]);
+    }
+    return avalanche(result);
+}
+
+} // namespace
+
+SimdLevel simd_level() noexcept {
+    return current_level().load(std::memory_order_relaxed);
+}
+
+SimdLevel set_simd_level(SimdLevel level) noexcept {
+    level = std::min(level, detected_level());
+    current_level().store(level, std::memory_order_relaxed);
+    return level;
+}
+
+std::uint64_t hash64(std::span<const std::byte> data, std::uint64_t seed) noexcept {
+    const std::byte* p = data.data();
+    const std::size_t len = data.size();
+    if (len <= 16) {
+        return hash_short(p, len, seed);
+    }
+    if (len <= 128) {
+        return hash_medium(p, len, seed);
+    }
+    std::array<std::uint64_t, kLanes> acc;
+    hash_long(p, len, seed, acc);
+    return merge(acc, 0, len * kPrime1);
+}
+
+Hash128 hash128(std::span<const std::byte> data, std::uint64_t seed) noexcept {
+    const std::size_t len = data.size();
+    if (len <= 128) {
+        // Short inputs are cheap enough to hash twice with unrelated seeds.
+        return {hash64(data, seed), hash64(data, seed ^ kPrime5) ^ kPrime2};
+    }
+    std::array<std::uint64_t, kLanes> acc;
+    hash_long(data.data(), len, seed, acc);
+    return {merge(acc, 0, len * kPrime1), merge(acc, kLanes, ~(len * kPrime2))};
+}
+
+} // namespace stockpile
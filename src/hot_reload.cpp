@@ -0,0 +1,409 @@
+#include "stockpile/hot_reload.hpp"
+
+#include "stockpile/archive_set.hpp"
+#include "stockpile/archive_writer.hpp"
+
+#include "posix_file.hpp"
+
+#include <array>
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <set>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#if defined(STOCKPILE_HOT_RELOAD) && defined(__linux__) && __has_include(<sys/inotify.h>)
+#define STOCKPILE_HAVE_INOTIFY 1
+#include <cerrno>
+#include <climits>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#else
+#define STOCKPILE_HAVE_INOTIFY 0
+#endif
+
+namespace stockpile {
+
+namespace detail {
+
+struct HotReloadState {
+    struct Subscription {
+        HotReloader::SubscriptionId id;
+        std::string prefix;
+        ReloadCallback callback;
+    };
+
+    ArchiveSet* set = nullptr;
+    std::filesystem::path root;
+    HotReloadOptions options;
+    /// Whether `options.scratch` was created by start() and is removed again.
+    bool owns_scratch = false;
+
+    std::mutex subscribers_mutex;
+    std::vector<Subscription> subscribers;
+    HotReloader::SubscriptionId next_id = 1;
+    std::atomic<std::uint64_t> reloads = 0;
+
+#if STOCKPILE_HAVE_INOTIFY
+    Fd inotify;
+    /// Written to by the destructor to wake the watcher thread.
+    Fd wake;
+    /// Watch descriptor to directory, relative to `root` ("" for the root).
+    std::unordered_map<int, std::string> watches;
+    /// Files under `root`, relative to it, as of the last scan or reload.
+    std::set<std::string> files;
+    /// Files changed or deleted since the last reload.
+    std::set<std::string> pending;
+    /// Archive paths in the overlay, to whether the path was found below the
+    /// overlay when it was first reloaded, so that deleting its file has to
+    /// leave a tombstone rather than drop the entry.
+    std::map<std::string, bool> overlaid;
+    /// Index in `set` of the overlay holding every reload so far.
+    std::optional<std::uint32_t> overlay;
+    std::thread watcher;
+
+    ~HotReloadState();
+    void scan(const std::string& directory, bool changed);
+    void forget(const std::string& directory);
+    void handle(const inotify_event& event);
+    void reload();
+    void notify(const std::vector<std::string>& paths);
+    void run();
+#endif
+};
+
+} // namespace detail
+
+#if STOCKPILE_HAVE_INOTIFY
+
+namespace detail {
+
+namespace {
+
+constexpr std::uint32_t kWatchMask =
+    IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM | IN_CREATE | IN_DELETE | IN_DONT_FOLLOW | IN_EXCL_UNLINK;
+
+[[nodiscard]] std::error_code last_error() noexcept {
+    return {errno, std::generic_category()};
+}
+
+[[nodiscard]] std::string join(const std::string& directory, std::string_view name) {
+    return directory.empty() ? std::string(name) : directory + '/' + std::string(name);
+}
+
+/// Whether `path` is `directory` or lies below it.
+[[nodiscard]] bool is_under(std::string_view path, std::string_view directory) noexcept {
+    return path.starts_with(directory) && (path.size() == directory.size() || path[directory.size()] == '/');
+}
+
+} // namespace
+
+HotReloadState::~HotReloadState() {
+    if (watcher.joinable()) {
+        const std::uint64_t one = 1;
+        static_cast<void>(write_all(wake.get(), std::as_bytes(std::span(&one, 1))));
+        watcher.join();
+    }
+    if (owns_scratch) {
+        std::error_code ec;
+        std::filesystem::remove_all(options.scratch, ec);
+    }
+}
+
+/// Watches `directory` and everything below it. Files found are recorded as
+/// known, and also as changed if `changed` is set (for a directory that
+/// appeared after start(), whose files the set has not seen).
+void HotReloadState::scan(const std::string& directory, bool changed) {
+    const auto path = directory.empty() ? root : root / directory;
+    const int wd = inotify_add_watch(inotify.get(), path.c_str(), kWatchMask | IN_ONLYDIR);
+    if (wd < 0) {
+        return;
+    }
+    watches[wd] = directory;
+
+    std::error_code ec;
+    for (std::filesystem::directory_iterator it(path, ec), end; !ec && it != end; it.increment(ec)) {
+        const auto name = join(directory, it->path().filename().string());
+        std::error_code status_ec;
+        if (it->is_symlink(status_ec) ? false : it->is_directory(status_ec)) {
+            scan(name, changed);
+        } else if (it->is_regular_file(status_ec)) {
+            files.insert(name);
+            if (changed) {
+                pending.insert(name);
+            }
+        }
+    }
+}
+
+/// Stops watching `directory` and the directories below it, and marks the
+/// files it held as deleted, after it was moved out of or deleted from the
+/// tree. If it was moved within the tree, the IN_MOVED_TO that follows scans
+/// it again under its new name.
+void HotReloadState::forget(const std::string& directory) {
+    for (auto it = watches.begin(); it != watches.end();) {
+        if (is_under(it->second, directory)) {
+            inotify_rm_watch(inotify.get(), it->first);
+            it = watches.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    for (auto it = files.lower_bound(directory); it != files.end() && it->starts_with(directory); ++it) {
+        if (is_under(*it, directory)) {
+            pending.insert(*it);
+        }
+    }
+}
+
+void HotReloadState::handle(const inotify_event& event) {
+    if ((event.mask & IN_Q_OVERFLOW) != 0) {
+        // Events were lost: compare the whole tree with what is known.
+        pending.insert(files.begin(), files.end());
+        for (const auto& [wd, directory] : watches) {
+            inotify_rm_watch(inotify.get(), wd);
+        }
+        watches.clear();
+        scan("", true);
+        return;
+    }
+    if ((event.mask & IN_IGNORED) != 0) {
+        watches.erase(event.wd);
+        return;
+    }
+    const auto watch = watches.find(event.wd);
+    if (watch == watches.end() || event.len == 0) {
+        return;
+    }
+    const auto name = join(watch->second, event.name);
+    if ((event.mask & IN_ISDIR) != 0) {
+        if ((event.mask & (IN_CREATE | IN_MOVED_TO)) != 0) {
+            scan(name, true);
+        } else if ((event.mask & (IN_DELETE | IN_MOVED_FROM)) != 0) {
+            forget(name);
+        }
+    } else if ((event.mask & IN_CREATE) == 0) {
+        // A created file is reloaded once it is closed after writing.
+        pending.insert(name);
+    }
+}
+
+/// Rewrites the overlay with the pending files and swaps it in for the
+/// previous one.
+void HotReloadState::reload() {
+    // New contents of the changed paths; nullopt for files that are gone.
+    std::map<std::string, std::optional<std::vector<std::byte>>> changed;
+    for (const auto& file : std::exchange(pending, {})) {
+        auto path = options.prefix + file;
+        if (!ArchiveWriter::is_valid_path(path)) {
+            continue;
+        }
+        // The file's current state decides, whatever the events said: a file
+        // deleted and written again is reloaded, one that cannot be read is
+        // hidden like a deleted one.
+        auto data = read_whole(root / file);
+        if (data) {
+            files.insert(file);
+        } else {
+            files.erase(file);
+        }
+        changed.emplace(std::move(path), data ? std::optional(std::move(*data)) : std::nullopt);
+    }
+
+    auto previous = overlaid;
+    std::vector<std::string> paths;
+    for (const auto& [path, data] : changed) {
+        if (!overlaid.contains(path)) {
+            const bool below = set->find(path).has_value();
+            if (!data && !below) {
+                continue;
+            }
+            overlaid.emplace(path, below);
+        }
+        paths.push_back(path);
+    }
+    if (paths.empty()) {
+        return;
+    }
+
+    // Paths not changed in this batch keep the entries of the current
+    // overlay, which are stored uncompressed.
+    ArchiveWriter writer;
+    const Archive* current = overlay ? &set->archive(*overlay) : nullptr;
+    for (auto it = overlaid.begin(); it != overlaid.end();) {
+        const auto& [path, below] = *it;
+        Result<void> added;
+        if (const auto change = changed.find(path); change != changed.end()) {
+            if (change->second) {
+                added = writer.add(path, *change->second);
+            } else if (below) {
+                added = writer.add_tombstone(path);
+            } else {
+                it = overlaid.erase(it);
+                continue;
+            }
+        } else if (const auto id = current->find(path); id && !current->is_tombstone(*id)) {
+            added = writer.add(path, current->data(*id));
+        } else {
+            added = writer.add_tombstone(path);
+        }
+        it = added ? std::next(it) : overlaid.erase(it);
+    }
+
+    Result<void> result;
+    if (writer.entry_count() == 0) {
+        // Every file in the overlay is back to what is below it.
+        if (overlay) {
+            result = set->unmount(*overlay);
+            overlay.reset();
+        }
+    } else {
+        const auto patch = options.scratch / ("reload-" + std::to_string(reloads.load() + 1) + ".stk");
+        result = writer.write(patch);
+        if (result) {
+            auto archive = Archive::open(patch);
+            if (!archive) {
+                result = std::unexpected(archive.error());
+            } else if (auto mounted = overlay ? set->replace(*overlay, std::move(*archive))
+                                              : set->mount(std::move(*archive))) {
+                overlay = *mounted;
+            } else {
+                result = std::unexpected(mounted.error());
+            }
+        }
+        // The mounted archive keeps its descriptor, so the file is not needed.
+        std::error_code ec;
+        std::filesystem::remove(patch, ec);
+    }
+    if (!result) {
+        overlaid = std::move(previous);
+        if (options.on_error) {
+            options.on_error(result.error());
+        }
+        return;
+    }
+    reloads.fetch_add(1, std::memory_order_release);
+    notify(paths);
+}
+
+void HotReloadState::notify(const std::vector<std::string>& paths) {
+    const std::lock_guard lock(subscribers_mutex);
+    for (const auto& path : paths) {
+        for (const auto& subscription : subscribers) {
+            if (path.starts_with(subscription.prefix)) {
+                subscription.callback(path);
+            }
+        }
+    }
+}
+
+void HotReloadState::run() {
+    alignas(inotify_event) char buffer[16 * (sizeof(inotify_event) + NAME_MAX + 1)];
+    std::array<pollfd, 2> fds{{{inotify.get(), POLLIN, 0}, {wake.get(), POLLIN, 0}}};
+    for (;;) {
+        // Block until something changes, then keep reading until the tree
+        // has been quiet for the debounce interval.
+        const int timeout = pending.empty() ? -1 : static_cast<int>(options.debounce.count());
+        const int ready = poll(fds.data(), fds.size(), timeout);
+        if (ready < 0 && errno != EINTR) {
+            if (options.on_error) {
+                options.on_error(last_error());
+            }
+            return;
+        }
+        if ((fds[1].revents & POLLIN) != 0) {
+            return;
+        }
+        if (ready == 0) {
+            reload();
+            continue;
+        }
+        if ((fds[0].revents & POLLIN) == 0) {
+            continue;
+        }
+        const auto size = ::read(inotify.get(), buffer, sizeof(buffer));
+        for (ssize_t offset = 0; offset < size;) {
+            const auto* event = reinterpret_cast<const inotify_event*>(buffer + offset);
+            handle(*event);
+            offset += static_cast<ssize_t>(sizeof(inotify_event) + event->len);
+        }
+    }
+}
+
+} // namespace detail
+
+Result<HotReloader> HotReloader::start(ArchiveSet& set, const std::filesystem::path& directory,
+                                       const HotReloadOptions& options) {
+    std::error_code ec;
+    if (!std::filesystem::is_directory(directory, ec)) {
+        return std::unexpected(ec ? ec : std::make_error_code(std::errc::not_a_directory));
+    }
+
+    auto state = std::make_unique<detail::HotReloadState>();
+    state->set = &set;
+    state->root = directory;
+    state->options = options;
+    if (state->options.scratch.empty()) {
+        auto pattern = (std::filesystem::temp_directory_path(ec) / "stockpile-reload-XXXXXX").string();
+        if (ec || mkdtemp(pattern.data()) == nullptr) {
+            return std::unexpected(ec ? ec : detail::last_error());
+        }
+        state->options.scratch = pattern;
+        state->owns_scratch = true;
+    } else if (std::filesystem::create_directories(state->options.scratch, ec); ec) {
+        return std::unexpected(ec);
+    }
+
+    state->inotify = detail::Fd(inotify_init1(IN_NONBLOCK | IN_CLOEXEC));
+    state->wake = detail::Fd(eventfd(0, EFD_CLOEXEC));
+    if (state->inotify.get() < 0 || state->wake.get() < 0) {
+        return std::unexpected(detail::last_error());
+    }
+    state->scan("", false);
+    if (state->watches.empty()) {
+        return std::unexpected(detail::last_error());
+    }
+
+    auto* raw = state.get();
+    state->watcher = std::thread([raw] { raw->run(); });
+    return HotReloader(std::move(state));
+}
+
+#else
+
+Result<HotReloader> HotReloader::start(ArchiveSet&, const std::filesystem::path&, const HotReloadOptions&) {
+    return std::unexpected(std::make_error_code(std::errc::not_supported));
+}
+
+#endif
+
+HotReloader::HotReloader(std::unique_ptr<detail::HotReloadState> state) noexcept : m_state(std::move(state)) {}
+
+HotReloader::HotReloader(HotReloader&&) noexcept = default;
+HotReloader& HotReloader::operator=(HotReloader&&) noexcept = default;
+HotReloader::~HotReloader() = default;
+
+HotReloader::SubscriptionId HotReloader::subscribe(std::string prefix, ReloadCallback callback) {
+    const std::lock_guard lock(m_state->subscribers_mutex);
+    const auto id = m_state->next_id++;
+    m_state->subscribers.push_back({id, std::move(prefix), std::move(callback)});
+    return id;
+}
+
+void HotReloader::unsubscribe(SubscriptionId id) {
+    const std::lock_guard lock(m_state->subscribers_mutex);
+    std::erase_if(m_state->subscribers, [id](const auto& subscription) { return subscription.id == id; });
+}
+
+std::uint64_t HotReloader::reload_count() const noexcept {
+    return m_state->reloads.load(std::memory_order_acquire);
+}
+
+} // namespace stockpile
@@ -0,0 +1,214 @@
+#include "io_uring.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <utility>
+
+#if defined(__linux__) && __has_include(<linux/io_uring.h>)
+#define STOCKPILE_HAVE_IO_URING 1
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#else
+#define STOCKPILE_HAVE_IO_URING 0
+#endif
+
+namespace stockpile::detail {
+
+IoUring::IoUring(IoUring&& other) noexcept {
+    *this = std::move(other);
+}
+
+IoUring& IoUring::operator=(IoUring&& other) noexcept {
+    if (this != &other) {
+        reset();
+        m_fd = std::exchange(other.m_fd, -1);
+        m_sq_entries = std::exchange(other.m_sq_entries, 0);
+        m_pending = std::exchange(other.m_pending, 0);
+        m_sq_ring = std::exchange(other.m_sq_ring, nullptr);
+        m_sq_ring_size = std::exchange(other.m_sq_ring_size, 0);
+        m_cq_ring = std::exchange(other.m_cq_ring, nullptr);
+        m_cq_ring_size = std::exchange(other.m_cq_ring_size, 0);
+        m_sqes = std::exchange(other.m_sqes, nullptr);
+        m_sqes_size = std::exchange(other.m_sqes_size, 0);
+        m_sq_head = std::exchange(other.m_sq_head, nullptr);
+        m_sq_tail = std::exchange(other.m_sq_tail, nullptr);
+        m_sq_mask = std::exchange(other.m_sq_mask, nullptr);
+        m_sq_array = std::exchange(other.m_sq_array, nullptr);
+        m_cq_head = std::exchange(other.m_cq_head, nullptr);
+        m_cq_tail = std::exchange(other.m_cq_tail, nullptr);
+        m_cq_mask = std::exchange(other.m_cq_mask, nullptr);
+        m_cqes = std::exchange(other.m_cqes, nullptr);
+    }
+    return *this;
+}
+
+IoUring::~IoUring() {
+    reset();
+}
+
+#if STOCKPILE_HAVE_IO_URING
+
+namespace {
+
+/// Largest byte count Linux transfers in one read.
+constexpr std::size_t kMaxRead = 0x7ffff000;
+
+[[nodiscard]] unsigned load_acquire(const unsigned* p) noexcept {
+    return std::atomic_ref(*const_cast<unsigned*>(p)).load(std::memory_order_acquire);
+}
+
+void store_release(unsigned* p, unsigned value) noexcept {
+    std::atomic_ref(*p).store(value, std::memory_order_release);
+}
+
+template <typename T>
+[[nodiscard]] T* at(void* base, std::uint32_t offset) noexcept {
+    return reinterpret_cast<T*>(static_cast<char*>(base) + offset);
+}
+
+} // namespace
+
+void IoUring::reset() noexcept {
+    if (m_sqes != nullptr) {
+        ::munmap(m_sqes, m_sqes_size);
+    }
+    if (m_cq_ring != nullptr && m_cq_ring != m_sq_ring) {
+        ::munmap(m_cq_ring, m_cq_ring_size);
+    }
+    if (m_sq_ring != nullptr) {
+        ::munmap(m_sq_ring, m_sq_ring_size);
+    }
+    if (m_fd >= 0) {
+        ::close(m_fd);
+    }
+    m_fd = -1;
+    m_sq_ring = m_cq_ring = nullptr;
+    m_sqes = nullptr;
+}
+
+Result<IoUring> IoUring::create(unsigned entries) {
+    IoUring ring;
+    io_uring_params params{};
+    ring.m_fd = static_cast<int>(::syscall(__NR_io_uring_setup, entries, &params));
+    if (ring.m_fd < 0) {
+        return fail_errno();
+    }
+    ring.m_sq_entries = params.sq_entries;
+
+    ring.m_sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    ring.m_cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    const bool single_mmap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+    if (single_mmap) {
+        ring.m_sq_ring_size = ring.m_cq_ring_size = std::max(ring.m_sq_ring_size, ring.m_cq_ring_size);
+    }
+
+    void* sq = ::mmap(nullptr, ring.m_sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                      ring.m_fd, IORING_OFF_SQ_RING);
+    if (sq == MAP_FAILED) {
+        return fail_errno();
+    }
+    ring.m_sq_ring = sq;
+    if (single_mmap) {
+        ring.m_cq_ring = sq;
+    } else {
+        void* cq = ::mmap(nullptr, ring.m_cq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                          ring.m_fd, IORING_OFF_CQ_RING);
+        if (cq == MAP_FAILED) {
+            return fail_errno();
+        }
+        ring.m_cq_ring = cq;
+    }
+
+    ring.m_sqes_size = params.sq_entries * sizeof(io_uring_sqe);
+    void* sqes = ::mmap(nullptr, ring.m_sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                        ring.m_fd, IORING_OFF_SQES);
+    if (sqes == MAP_FAILED) {
+        return fail_errno();
+    }
+    ring.m_sqes = static_cast<io_uring_sqe*>(sqes);
+
+    ring.m_sq_head = at<unsigned>(ring.m_sq_ring, params.sq_off.head);
+    ring.m_sq_tail = at<unsigned>(ring.m_sq_ring, params.sq_off.tail);
+    ring.m_sq_mask = at<unsigned>(ring.m_sq_ring, params.sq_off.ring_mask);
+    ring.m_sq_array = at<unsigned>(ring.m_sq_ring, params.sq_off.array);
+    ring.m_cq_head = at<unsigned>(ring.m_cq_ring, params.cq_off.head);
+    ring.m_cq_tail = at<unsigned>(ring.m_cq_ring, params.cq_off.tail);
+    ring.m_cq_mask = at<unsigned>(ring.m_cq_ring, params.cq_off.ring_mask);
+    ring.m_cqes = at<io_uring_cqe>(ring.m_cq_ring, params.cq_off.cqes);
+    return ring;
+}
+
+bool IoUring::prepare_read(int fd, std::span<std::byte> buffer, std::uint64_t offset,
+                           std::uint64_t user_data) noexcept {
+    const unsigned tail = *m_sq_tail;
+    if (tail - load_acquire(m_sq_head) >= m_sq_entries) {
+        return false;
+    }
+    const unsigned index = tail & *m_sq_mask;
+    io_uring_sqe& sqe = m_sqes[index];
+    std::memset(&sqe, 0, sizeof(sqe));
+    sqe.opcode = IORING_OP_READ;
+    sqe.fd = fd;
+    sqe.off = offset;
+    sqe.addr = reinterpret_cast<std::uint64_t>(buffer.data());
+    // Longer reads complete short and are finished by the caller.
+    sqe.len = static_cast<std::uint32_t>(std::min<std::size_t>(buffer.size(), kMaxRead));
+    sqe.user_data = user_data;
+    m_sq_array[index] = index;
+    store_release(m_sq_tail, tail + 1);
+    ++m_pending;
+    return true;
+}
+
+Result<void> IoUring::submit(unsigned wait_for) noexcept {
+    const unsigned flags = wait_for > 0 ? IORING_ENTER_GETEVENTS : 0;
+    for (;;) {
+        const long submitted = ::syscall(__NR_io_uring_enter, m_fd, m_pending, wait_for, flags, nullptr, 0);
+        if (submitted >= 0) {
+            m_pending -= static_cast<unsigned>(submitted);
+            return {};
+        }
+        if (errno != EINTR && errno != EAGAIN && errno != EBUSY) {
+            return fail_errno();
+        }
+    }
+}
+
+bool IoUring::pop_completion(std::uint64_t& user_data, std::int32_t& result) noexcept {
+    const unsigned head = *m_cq_head;
+    if (head == load_acquire(m_cq_tail)) {
+        return false;
+    }
+    const io_uring_cqe& cqe = m_cqes[head & *m_cq_mask];
+    user_data = cqe.user_data;
+    result = cqe.res;
+    store_release(m_cq_head, head + 1);
+    return true;
+}
+
+#else
+
+void IoUring::reset() noexcept {}
+
+Result<IoUring> IoUring::create(unsigned) {
+    return std::unexpected(std::make_error_code(std::errc::function_not_supported));
+}
+
+bool IoUring::prepare_read(int, std::span<std::byte>, std::uint64_t, std::uint64_t) noexcept {
+    return false;
+}
+
+Result<void> IoUring::submit(unsigned) noexcept {
+    return std::unexpected(std::make_error_code(std::errc::function_not_supported));
+}
+
+bool IoUring::pop_completion(std::uint64_t&, std::int32_t&) noexcept {
+    return false;
+}
+
+#endif
+
+} // namespace stockpile::detail
@@ -0,0 +1,83 @@
+#pragma once
+
+#include "stockpile/error.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+
+struct io_uring_sqe;
+struct io_uring_cqe;
+
+namespace stockpile::detail {
+
+/// Minimal io_uring submission/completion ring issuing positional reads,
+/// talking to the kernel through raw system calls so no liburing is needed.
+/// Not thread-safe: one thread owns the ring.
+class IoUring {
+public:
+    IoUring() noexcept = default;
+    IoUring(IoUring&& other) noexcept;
+    IoUring& operator=(IoUring&& other) noexcept;
+    IoUring(const IoUring&) = delete;
+    IoUring& operator=(const IoUring&) = delete;
+    ~IoUring();
+
+    /// Fails with ENOSYS/EPERM where io_uring is missing or disabled.
+    [[nodiscard]] static Result<IoUring> create(unsigned entries);
+
+    [[nodiscard]] unsigned capacity() const noexcept { return m_sq_entries; }
+
+    /// Queues a read of `buffer.size()` bytes at `offset`; false if the
+    /// submission queue is full. Nothing is sent until submit().
+    [[nodiscard]] bool prepare_read(int fd, std::span<std::byte> buffer, std::uint64_t offset,
+                                    std::uint64_t user_data) noexcept;
+
+    /// Submits every prepared read and blocks until at least `wait_for`
+    /// completions are available.
+    [[nodiscard]] Result<void> submit(unsigned wait_for) noexcept;
+
+    /// Reads prepared but not yet taken by the kernel: the most recently
+    /// prepared ones, since the submission queue is consumed in order.
+    [[nodiscard]] unsigned pending() const noexcept { return m_pending; }
+
+    /// Calls `fn(user_data, result)` for every available completion, where
+    /// result is the byte count or a negated errno.
+    template <typename Fn>
+    unsigned drain(Fn&& fn) noexcept(noexcept(fn(std::uint64_t{}, std::int32_t{}))) {
+        unsigned count = 0;
+        std::uint64_t user_data;
+        std::int32_t result;
+        while (pop_completion(user_data, result)) {
+            fn(user_data, result);
+            ++count;
+        }
+        return count;
+    }
+
+private:
+    [[nodiscard]] bool pop_completion(std::uint64_t& user_data, std::int32_t& result) noexcept;
+    void reset() noexcept;
+
+    int m_fd = -1;
+    unsigned m_sq_entries = 0;
+    unsigned m_pending = 0;
+
+    void* m_sq_ring = nullptr;
+    std::size_t m_sq_ring_size = 0;
+    void* m_cq_ring = nullptr;
+    std::size_t m_cq_ring_size = 0;
+    io_uring_sqe* m_sqes = nullptr;
+    std::size_t m_sqes_size = 0;
+
+    unsigned* m_sq_head = nullptr;
+    unsigned* m_sq_tail = nullptr;
+    unsigned* m_sq_mask = nullptr;
+    unsigned* m_sq_array = nullptr;
+    unsigned* m_cq_head = nullptr;
+    unsigned* m_cq_tail = nullptr;
+    unsigned* m_cq_mask = nullptr;
+    io_uring_cqe* m_cqes = nullptr;
+};
+
+} // namespace stockpile::detail
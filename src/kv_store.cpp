@@ -0,0 +1,522 @@
+#include "stockpile/kv_store.hpp"
+
+#include "stockpile/arena.hpp"
+#include "stockpile/hash.hpp"
+#include "stockpile/serialize.hpp"
+
+#include "posix_file.hpp"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <condition_variable>
+#include <cstring>
+#include <limits>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <utility>
+
+namespace stockpile {
+
+namespace {
+
+// Log records: u32 body size, u64 hash64 of the body, then the body: a
+// varint op count and per op a kind byte, the key and, for puts, the value.
+// The table: u32 magic, u32 version, u64 log generation, u64 hash64 of the
+// body, then the body: a varint key count and per key the key and value.
+// Strings are varint length-prefixed.
+
+constexpr std::uint32_t kTableMagic = 0x564B5053; // "SPKV"
+constexpr std::uint32_t kTableVersion = 1;
+constexpr std::size_t kRecordHeaderSize = sizeof(std::uint32_t) + sizeof(std::uint64_t);
+constexpr std::size_t kTableHeaderSize = 2 * sizeof(std::uint32_t) + 2 * sizeof(std::uint64_t);
+
+constexpr std::uint8_t kOpPut = 1;
+constexpr std::uint8_t kOpErase = 2;
+
+constexpr std::string_view kTableName = "table";
+constexpr std::string_view kTableTempName = "table.tmp";
+constexpr std::string_view kLogPrefix = "wal-";
+constexpr std::string_view kLogSuffix = ".log";
+
+using Map = std::map<std::string, std::string, std::less<>>;
+using detail::Fd;
+using detail::open_fd;
+using detail::read_whole;
+using detail::sync_directory;
+using detail::write_all;
+
+[[nodiscard]] std::string log_name(std::uint64_t generation) {
+    char digits[16];
+    std::fill(std::begin(digits), std::end(digits), '0');
+    auto [end, ec] = std::to_chars(std::begin(digits), std::end(digits), generation, 16);
+    std::rotate(std::begin(digits), end, std::end(digits));
+    return std::string(kLogPrefix) + std::string(digits, sizeof(digits)) + std::string(kLogSuffix);
+}
+
+[[nodiscard]] std::optional<std::uint64_t> log_generation(std::string_view name) {
+    if (!name.starts_with(kLogPrefix) || !name.ends_with(kLogSuffix)) {
+        return std::nullopt;
+    }
+    name.remove_prefix(kLogPrefix.size());
+    name.remove_suffix(kLogSuffix.size());
+    std::uint64_t generation = 0;
+    const auto [end, ec] = std::from_chars(name.data(), name.data() + name.size(), generation, 16);
+    if (ec != std::errc() || end != name.data() + name.size()) {
+        return std::nullopt;
+    }
+    return generation;
+}
+
+/// Applies the ops of one log record body to `data`.
+[[nodiscard]] Result<void> replay_record(std::span<const std::byte> body, Map& data) {
+    SaveReader reader(body);
+    auto count = reader.read_varint();
+    if (!count) {
+        return std::unexpected(count.error());
+    }
+    for (std::uint64_t i = 0; i < *count; ++i) {
+        auto kind = reader.read<std::uint8_t>();
+        auto key = reader.read_string();
+        if (!kind || !key) {
+            return fail(Errc::malformed_data);
+        }
+        if (*kind == kOpErase) {
+            data.erase(std::string(*key));
+            continue;
+        }
+        auto value = reader.read_string();
+        if (*kind != kOpPut || !value) {
+            return fail(Errc::malformed_data);
+        }
+        data.insert_or_assign(std::string(*key), std::string(*value));
+    }
+    if (!reader.at_end()) {
+        return fail(Errc::malformed_data);
+    }
+    return {};
+}
+
+/// Replays the intact records at the start of `log` and returns where they end.
+[[nodiscard]] Result<std::size_t> replay_log(std::span<const std::byte> log, Map& data) {
+    std::size_t position = 0;
+    while (log.size() - position >= kRecordHeaderSize) {
+        std::uint32_t size;
+        std::uint64_t hash;
+        std::memcpy(&size, log.data() + position, sizeof(size));
+        std::memcpy(&hash, log.data() + position + sizeof(size), sizeof(hash));
+        if (size > log.size() - position - kRecordHeaderSize) {
+            break;
+        }
+        const auto body = log.subspan(position + kRecordHeaderSize, size);
+        if (hash64(body) != hash) {
+            break;
+        }
+        if (auto replayed = replay_record(body, data); !replayed) {
+            return std::unexpected(replayed.error());
+        }
+        position += kRecordHeaderSize + size;
+    }
+    return position;
+}
+
+/// Loads the table, returning the generation of the first log to replay.
+[[nodiscard]] Result<std::uint64_t> load_table(const std::filesystem::path& path, Map& data) {
+    auto file = read_whole(path);
+    if (!file) {
+        return std::unexpected(file.error());
+    }
+    SaveReader reader(*file);
+    const auto magic = reader.read<std::uint32_t>();
+    const auto version = reader.read<std::uint32_t>();
+    const auto generation = reader.read<std::uint64_t>();
+    const auto hash = reader.read<std::uint64_t>();
+    if (!magic || *magic != kTableMagic) {
+        return fail(Errc::bad_magic);
+    }
+    if (!version || *version != kTableVersion) {
+        return fail(Errc::unsupported_version);
+    }
+    if (!generation || !hash || hash64(std::span(*file).subspan(kTableHeaderSize)) != *hash) {
+        return fail(Errc::malformed_data);
+    }
+    auto count = reader.read_varint();
+    if (!count) {
+        return std::unexpected(count.error());
+    }
+    for (std::uint64_t i = 0; i < *count; ++i) {
+        auto key = reader.read_string();
+        auto value = reader.read_string();
+        if (!key || !value) {
+            return fail(Errc::malformed_data);
+        }
+        data.emplace_hint(data.end(), std::string(*key), std::string(*value));
+    }
+    if (!reader.at_end()) {
+        return fail(Errc::malformed_data);
+    }
+    return *generation;
+}
+
+} // namespace
+
+namespace detail {
+
+/// Log records waiting to be written, encoded in place.
+struct KvLog {
+    Arena arena;
+    SaveWriter writer{arena};
+};
+
+struct KvState {
+    std::filesystem::path directory;
+    KvOptions options;
+
+    /// Guards everything up to `io_mutex`.
+    mutable std::mutex mutex;
+    std::condition_variable wake;
+    Map data;
+    /// Writers append to logs[active]; a flush swaps in the other one.
+    std::array<KvLog, 2> logs;
+    std::size_t active = 0;
+    /// First failed flush; the store refuses writes from then on.
+    std::error_code error;
+    bool stopping = false;
+
+    /// Guards the log file. Held by flushes and compactions.
+    std::mutex io_mutex;
+    Fd log;
+    std::uint64_t generation = 0;
+    std::uint64_t log_bytes = 0;
+
+    std::thread flusher;
+
+    [[nodiscard]] Result<void> apply(const WriteBatch& batch);
+    [[nodiscard]] Result<void> flush();
+    [[nodiscard]] Result<void> flush_locked();
+    [[nodiscard]] Result<void> compact_locked();
+    void run();
+    void stop();
+};
+
+Result<void> KvState::apply(const WriteBatch& batch) {
+    std::uint64_t estimate = kRecordHeaderSize + 10;
+    for (const auto& op : batch.m_ops) {
+        estimate += 1 + 20 + op.key.size() + (op.value ? op.value->size() : 0);
+    }
+    if (estimate > std::numeric_limits<std::uint32_t>::max()) {
+        return fail(Errc::too_large);
+    }
+
+    std::lock_guard lock(mutex);
+    if (error) {
+        return std::unexpected(error);
+    }
+    auto& writer = logs[active].writer;
+    const bool was_empty = writer.size() == 0;
+    const std::size_t start = writer.size();
+    writer.write<std::uint32_t>(0);
+    writer.write<std::uint64_t>(0);
+    writer.write_varint(batch.m_ops.size());
+    for (const auto& op : batch.m_ops) {
+        writer.write<std::uint8_t>(op.value ? kOpPut : kOpErase);
+        writer.write_string(op.key);
+        if (op.value) {
+            writer.write_string(*op.value);
+            data.insert_or_assign(op.key, *op.value);
+        } else if (const auto it = data.find(op.key); it != data.end()) {
+            data.erase(it);
+        }
+    }
+    const auto body = writer.bytes().subspan(start + kRecordHeaderSize);
+    writer.overwrite<std::uint32_t>(start, static_cast<std::uint32_t>(body.size()));
+    writer.overwrite<std::uint64_t>(start + sizeof(std::uint32_t), hash64(body));
+    if (was_empty) {
+        wake.notify_one();
+    }
+    return {};
+}
+
+Result<void> KvState::flush() {
+    std::lock_guard io(io_mutex);
+    return flush_locked();
+}
+
+Result<void> KvState::flush_locked() {
+    KvLog* full;
+    {
+        std::lock_guard lock(mutex);
+        if (error) {
+            return std::unexpected(error);
+        }
+        full = &logs[active];
+        if (full->writer.size() == 0) {
+            return {};
+        }
+        active ^= 1;
+    }
+    // Writers only touch the other log now, and only a flush, which holds
+    // io_mutex, can swap this one back in.
+    const auto bytes = full->writer.bytes();
+    auto written = write_all(log.get(), bytes);
+    if (written && ::fdatasync(log.get()) != 0) {
+        written = fail_errno();
+    }
+    full->writer.clear();
+    if (!written) {
+        std::lock_guard lock(mutex);
+        error = written.error();
+        return written;
+    }
+    log_bytes += bytes.size();
+    return {};
+}
+
+Result<void> KvState::compact_locked() {
+    // Records queued but not yet written go to the new log and are also in
+    // the snapshot; replaying them over it is harmless since each op sets
+    // its key's final state.
+    Map snapshot;
+    {
+        std::lock_guard lock(mutex);
+        if (error) {
+            return std::unexpected(error);
+        }
+        snapshot = data;
+    }
+
+    const std::uint64_t next = generation + 1;
+    auto next_log = open_fd(directory / log_name(next), O_WRONLY | O_CREAT | O_TRUNC | O_APPEND);
+    if (!next_log) {
+        return std::unexpected(next_log.error());
+    }
+    if (auto synced = sync_directory(directory); !synced) {
+        return synced;
+    }
+    log = std::move(*next_log);
+    generation = next;
+    log_bytes = 0;
+
+    Arena arena;
+    SaveWriter writer(arena, kTableHeaderSize + 16 * snapshot.size() + 64);
+    writer.write(kTableMagic);
+    writer.write(kTableVersion);
+    writer.write(next);
+    writer.write<std::uint64_t>(0);
+    writer.write_varint(snapshot.size());
+    for (const auto& [key, value] : snapshot) {
+        writer.write_string(key);
+        writer.write_string(value);
+    }
+    writer.overwrite<std::uint64_t>(2 * sizeof(std::uint32_t) + sizeof(std::uint64_t),
+                                    hash64(writer.bytes().subspan(kTableHeaderSize)));
+
+    if (auto replaced = detail::replace_file(directory / kTableName, writer.bytes()); !replaced) {
+        return replaced;
+    }
+
+    // The table now covers every older log.
+    std::error_code ec;
+    for (const auto& file : std::filesystem::directory_iterator(directory, ec)) {
+        const auto old = log_generation(file.path().filename().native());
+        if (old && *old < next) {
+            std::filesystem::remove(file.path(), ec);
+        }
+    }
+    return {};
+}
+
+void KvState::run() {
+    std::unique_lock lock(mutex);
+    for (;;) {
+        wake.wait(lock, [this] { return stopping || (!error && logs[active].writer.size() != 0); });
+        if (stopping) {
+            return;
+        }
+        // Let more writes join this flush.
+        wake.wait_for(lock, options.sync_interval, [this] { return stopping; });
+        lock.unlock();
+        {
+            std::lock_guard io(io_mutex);
+            if (flush_locked() && log_bytes > options.compact_threshold) {
+                // A failed compaction loses nothing and is retried later.
+                static_cast<void>(compact_locked());
+            }
+        }
+        lock.lock();
+    }
+}
+
+void KvState::stop() {
+    {
+        std::lock_guard lock(mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    if (flusher.joinable()) {
+        flusher.join();
+    }
+    static_cast<void>(flush());
+}
+
+} // namespace detail
+
+void WriteBatch::put(std::string_view key, std::string_view value) {
+    m_ops.push_back({std::string(key), std::string(value)});
+}
+
+void WriteBatch::erase(std::string_view key) {
+    m_ops.push_back({std::string(key), std::nullopt});
+}
+
+Result<KvStore> KvStore::open(const std::filesystem::path& directory, const KvOptions& options) {
+    std::error_code ec;
+    std::filesystem::create_directories(directory, ec);
+    if (ec) {
+        return std::unexpected(ec);
+    }
+
+    auto state = std::make_unique<detail::KvState>();
+    state->directory = directory;
+    state->options = options;
+
+    std::uint64_t first_log = 0;
+    if (std::filesystem::exists(directory / kTableName, ec)) {
+        auto loaded = load_table(directory / kTableName, state->data);
+        if (!loaded) {
+            return std::unexpected(loaded.error());
+        }
+        first_log = *loaded;
+    }
+
+    std::vector<std::uint64_t> generations;
+    for (const auto& file : std::filesystem::directory_iterator(directory, ec)) {
+        if (const auto generation = log_generation(file.path().filename().native())) {
+            if (*generation >= first_log) {
+                generations.push_back(*generation);
+            } else {
+                // Left behind by a compaction interrupted after its rename.
+                std::filesystem::remove(file.path(), ec);
+            }
+        }
+    }
+    if (ec) {
+        return std::unexpected(ec);
+    }
+    std::sort(generations.begin(), generations.end());
+
+    std::size_t valid = 0;
+    for (const auto generation : generations) {
+        auto bytes = read_whole(directory / log_name(generation));
+        if (!bytes) {
+            return std::unexpected(bytes.error());
+        }
+        auto replayed = replay_log(*bytes, state->data);
+        if (!replayed) {
+            return std::unexpected(replayed.error());
+        }
+        valid = *replayed;
+    }
+
+    // Append to the newest log, cutting off a record torn by a crash.
+    state->generation = generations.empty() ? first_log : generations.back();
+    auto log = open_fd(directory / log_name(state->generation), O_WRONLY | O_CREAT | O_APPEND);
+    if (!log) {
+        return std::unexpected(log.error());
+    }
+    if (::ftruncate(log->get(), static_cast<off_t>(valid)) != 0 || ::fsync(log->get()) != 0) {
+        return fail_errno();
+    }
+    state->log = std::move(*log);
+    state->log_bytes = valid;
+    if (auto synced = sync_directory(directory); !synced) {
+        return std::unexpected(synced.error());
+    }
+    std::filesystem::remove(directory / kTableTempName, ec);
+
+    auto* raw = state.get();
+    state->flusher = std::thread([raw] { raw->run(); });
+    return KvStore(std::move(state));
+}
+
+KvStore::KvStore(std::unique_ptr<detail::KvState> state) noexcept : m_state(std::move(state)) {}
+
+KvStore::KvStore(KvStore&&) noexcept = default;
+
+KvStore& KvStore::operator=(KvStore&& other) noexcept {
+    if (this != &other) {
+        if (m_state) {
+            m_state->stop();
+        }
+        m_state = std::move(other.m_state);
+    }
+    return *this;
+}
+
+KvStore::~KvStore() {
+    if (m_state) {
+        m_state->stop();
+    }
+}
+
+std::optional<std::string> KvStore::get(std::string_view key) const {
+    std::lock_guard lock(m_state->mutex);
+    const auto it = m_state->data.find(key);
+    if (it == m_state->data.end()) {
+        return std::nullopt;
+    }
+    return it->second;
+}
+
+bool KvStore::contains(std::string_view key) const {
+    std::lock_guard lock(m_state->mutex);
+    return m_state->data.find(key) != m_state->data.end();
+}
+
+std::size_t KvStore::size() const {
+    std::lock_guard lock(m_state->mutex);
+    return m_state->data.size();
+}
+
+void KvStore::scan(std::string_view prefix,
+                   const std::function<void(std::string_view, std::string_view)>& fn) const {
+    std::lock_guard lock(m_state->mutex);
+    for (auto it = m_state->data.lower_bound(prefix); it != m_state->data.end() && it->first.starts_with(prefix);
+         ++it) {
+        fn(it->first, it->second);
+    }
+}
+
+Result<void> KvStore::put(std::string_view key, std::string_view value) {
+    WriteBatch batch;
+    batch.put(key, value);
+    return apply(batch);
+}
+
+Result<void> KvStore::erase(std::string_view key) {
+    WriteBatch batch;
+    batch.erase(key);
+    return apply(batch);
+}
+
+Result<void> KvStore::apply(const WriteBatch& batch) {
+    return m_state->apply(batch);
+}
+
+Result<void> KvStore::sync() {
+    return m_state->flush();
+}
+
+Result<void> KvStore::compact() {
+    std::lock_guard io(m_state->io_mutex);
+    if (auto flushed = m_state->flush_locked(); !flushed) {
+        return flushed;
+    }
+    return m_state->compact_locked();
+}
+
+} // namespace stockpile
@@ -0,0 +1,114 @@
+#include "stockpile/mapped_file.hpp"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <utility>
+
+namespace stockpile {
+
+MappedFile::MappedFile(MappedFile&& other) noexcept
+    : m_data(std::exchange(other.m_data, nullptr)),
+      m_size(std::exchange(other.m_size, 0)),
+      m_fd(std::exchange(other.m_fd, -1)) {}
+
+MappedFile& MappedFile::operator=(MappedFile&& other) noexcept {
+    if (this != &other) {
+        reset();
+        m_data = std::exchange(other.m_data, nullptr);
+        m_size = std::exchange(other.m_size, 0);
+        m_fd = std::exchange(other.m_fd, -1);
+    }
+    return *this;
+}
+
+MappedFile::~MappedFile() {
+    reset();
+}
+
+Result<void> MappedFile::read_at(std::uint64_t offset, std::span<std::byte> out) const noexcept {
+    if (offset > m_size || out.size() > m_size - offset) {
+        return std::unexpected(std::make_error_code(std::errc::invalid_argument));
+    }
+    std::byte* data = out.data();
+    std::size_t size = out.size();
+    while (size > 0) {
+        const ssize_t n = ::pread(m_fd, data, size, static_cast<off_t>(offset));
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return fail_errno();
+        }
+        if (n == 0) {
+            return std::unexpected(std::make_error_code(std::errc::io_error));
+        }
+        data += n;
+        size -= static_cast<std::size_t>(n);
+        offset += static_cast<std::uint64_t>(n);
+    }
+    return {};
+}
+
+void MappedFile::reset() noexcept {
+    if (m_data != nullptr) {
+        ::munmap(const_cast<std::byte*>(m_data), m_size);
+    }
+    if (m_fd >= 0) {
+        ::close(m_fd);
+    }
+    m_data = nullptr;
+    m_size = 0;
+    m_fd = -1;
+}
+
+Result<MappedFile> MappedFile::open(const std::filesystem::path& path) {
+    MappedFile file;
+    file.m_fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (file.m_fd < 0) {
+        return fail_errno();
+    }
+
+    struct stat st {};
+    if (::fstat(file.m_fd, &st) != 0) {
+        return fail_errno();
+    }
+    file.m_size = static_cast<std::size_t>(st.st_size);
+    if (file.m_size == 0) {
+        // mmap() rejects empty ranges; an empty file is an empty span.
+        return file;
+    }
+
+    void* data = ::mmap(nullptr, file.m_size, PROT_READ, MAP_SHARED, file.m_fd, 0);
+    if (data == MAP_FAILED) {
+        const int err = errno;
+        file.m_size = 0;
+        return fail_errno(err);
+    }
+    file.m_data = static_cast<const std::byte*>(data);
+    return file;
+}
+
+void MappedFile::advise(Advice advice, std::size_t offset, std::size_t length) const noexcept {
+    if (m_data == nullptr || offset >= m_size) {
+        return;
+    }
+    static const std::size_t page_size = static_cast<std::size_t>(::sysconf(_SC_PAGESIZE));
+    const std::size_t begin = offset & ~(page_size - 1);
+    const std::size_t end = std::min(offset + length, m_size);
+
+    int native = MADV_NORMAL;
+    switch (advice) {
+    case Advice::normal:     native = MADV_NORMAL; break;
+    case Advice::sequential: native = MADV_SEQUENTIAL; break;
+    case Advice::random:     native = MADV_RANDOM; break;
+    case Advice::will_need:  native = MADV_WILLNEED; break;
+    case Advice::dont_need:  native = MADV_DONTNEED; break;
+    }
+    ::madvise(const_cast<std::byte*>(m_data) + begin, end - begin, native);
+}
+
+} // namespace stockpile
@@ -0,0 +1,57 @@
+#include "stockpile/merged_index.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <utility>
+
+namespace stockpile::detail {
+
+void MergedIndex::reserve(std::size_t count) {
+    const std::size_t needed = std::bit_ceil(std::max<std::size_t>((used + count) * 2, 16));
+    if (needed <= slots.size()) {
+        return;
+    }
+    std::vector<Slot> old(needed, Slot{0, kEmpty, 0});
+    old.swap(slots);
+    for (const auto& slot : old) {
+        if (slot.source != kEmpty) {
+            slots[probe(slot.hash)] = slot;
+        }
+    }
+}
+
+bool MergedIndex::fold(std::shared_ptr<const MergedIndex>& base, MergedIndex& overlay) {
+    if (overlay.used * 4 <= base->used) {
+        return false;
+    }
+    if (base->used == 0) {
+        // Nothing to merge, e.g. on the first mount.
+        base = std::make_shared<const MergedIndex>(std::move(overlay));
+    } else {
+        auto merged = std::make_shared<MergedIndex>(*base);
+        merged->reserve(overlay.used);
+        for (const auto& slot : overlay.slots) {
+            if (slot.source != kEmpty) {
+                auto& target = merged->slots[merged->probe(slot.hash)];
+                merged->used += target.source == kEmpty ? 1 : 0;
+                target = slot;
+            }
+        }
+        base = std::move(merged);
+    }
+    overlay = {};
+    return true;
+}
+
+std::vector<std::uint64_t> entry_hashes(const Archive& archive) {
+    // Archive::open() checked that every entry is in exactly one slot.
+    std::vector<std::uint64_t> hashes(archive.entry_count());
+    for (const auto& slot : archive.path_index()) {
+        if (slot.entry != format::kEmptySlot) {
+            hashes[slot.entry] = slot.hash;
+        }
+    }
+    return hashes;
+}
+
+} // namespace stockpile::detail
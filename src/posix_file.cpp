@@ -0,0 +1,85 @@
+#include "posix_file.hpp"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <fstream>
+
+namespace stockpile::detail {
+
+Fd::~Fd() {
+    if (m_fd >= 0) {
+        ::close(m_fd);
+    }
+}
+
+Result<Fd> open_fd(const std::filesystem::path& path, int flags) {
+    const int fd = ::open(path.c_str(), flags | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        return fail_errno();
+    }
+    return Fd(fd);
+}
+
+Result<void> write_all(int fd, std::span<const std::byte> bytes) noexcept {
+    while (!bytes.empty()) {
+        const ssize_t n = ::write(fd, bytes.data(), bytes.size());
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return fail_errno();
+        }
+        bytes = bytes.subspan(static_cast<std::size_t>(n));
+    }
+    return {};
+}
+
+Result<void> sync_directory(const std::filesystem::path& directory) {
+    auto dir = open_fd(directory.empty() ? std::filesystem::path(".") : directory, O_RDONLY | O_DIRECTORY);
+    if (!dir) {
+        return std::unexpected(dir.error());
+    }
+    if (::fsync(dir->get()) != 0) {
+        return fail_errno();
+    }
+    return {};
+}
+
+Result<std::vector<std::byte>> read_whole(const std::filesystem::path& path) {
+    std::ifstream in(path, std::ios::binary | std::ios::ate);
+    if (!in) {
+        return std::unexpected(std::make_error_code(std::errc::no_such_file_or_directory));
+    }
+    std::vector<std::byte> bytes(static_cast<std::size_t>(in.tellg()));
+    in.seekg(0);
+    if (!in.read(reinterpret_cast<char*>(bytes.data()), static_cast<std::streamsize>(bytes.size()))) {
+        return std::unexpected(std::make_error_code(std::errc::io_error));
+    }
+    return bytes;
+}
+
+Result<void> replace_file(const std::filesystem::path& destination, std::span<const std::byte> bytes) {
+    auto temp = destination;
+    temp += ".tmp";
+    {
+        auto file = open_fd(temp, O_WRONLY | O_CREAT | O_TRUNC);
+        if (!file) {
+            return std::unexpected(file.error());
+        }
+        if (auto written = write_all(file->get(), bytes); !written) {
+            return written;
+        }
+        if (::fsync(file->get()) != 0) {
+            return fail_errno();
+        }
+    }
+    std::error_code ec;
+    std::filesystem::rename(temp, destination, ec);
+    if (ec) {
+        return std::unexpected(ec);
+    }
+    return sync_directory(destination.parent_path());
+}
+
+} // namespace stockpile::detail
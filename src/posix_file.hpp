@@ -0,0 +1,50 @@
+#pragma once
+
+#include "stockpile/error.hpp"
+
+#include <cstddef>
+#include <filesystem>
+#include <span>
+#include <utility>
+#include <vector>
+
+namespace stockpile::detail {
+
+/// Owns a file descriptor.
+class Fd {
+public:
+    Fd() noexcept = default;
+    explicit Fd(int fd) noexcept : m_fd(fd) {}
+    Fd(Fd&& other) noexcept : m_fd(std::exchange(other.m_fd, -1)) {}
+    Fd& operator=(Fd&& other) noexcept {
+        std::swap(m_fd, other.m_fd);
+        return *this;
+    }
+    Fd(const Fd&) = delete;
+    Fd& operator=(const Fd&) = delete;
+    ~Fd();
+
+    [[nodiscard]] int get() const noexcept { return m_fd; }
+
+private:
+    int m_fd = -1;
+};
+
+/// open(2) with O_CLOEXEC added; new files get mode 0644.
+[[nodiscard]] Result<Fd> open_fd(const std::filesystem::path& path, int flags);
+
+/// Writes all of `bytes`, retrying short writes and EINTR.
+[[nodiscard]] Result<void> write_all(int fd, std::span<const std::byte> bytes) noexcept;
+
+/// Makes a rename or file creation in `directory` durable.
+[[nodiscard]] Result<void> sync_directory(const std::filesystem::path& directory);
+
+[[nodiscard]] Result<std::vector<std::byte>> read_whole(const std::filesystem::path& path);
+
+/// Replaces `destination` with `bytes` so that a crash at any point leaves
+/// either the old file or the complete new one: the bytes go to
+/// `destination` + ".tmp", which is fsynced and renamed over `destination`,
+/// then the directory is fsynced.
+[[nodiscard]] Result<void> replace_file(const std::filesystem::path& destination, std::span<const std::byte> bytes);
+
+} // namespace stockpile::detail
@@ -0,0 +1,191 @@
+#include "stockpile/save_slot.hpp"
+
+#include "stockpile/hash.hpp"
+#include "stockpile/thread_pool.hpp"
+
+#include "posix_file.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstring>
+#include <fstream>
+#include <optional>
+
+namespace stockpile {
+
+namespace {
+
+constexpr std::uint32_t kMagic = 0x56535053; // "SPSV"
+constexpr std::uint32_t kVersion = 1;
+constexpr std::uint32_t kBlockShift = 16;
+
+/// Leads every copy, followed by one CRC-32C per block and then the data.
+struct SaveHeader {
+    std::uint32_t magic;
+    std::uint32_t version;
+    std::uint64_t generation;
+    std::uint64_t size;
+    std::uint32_t block_shift;
+    /// CRC-32C of the header up to this field, continued over the block CRCs.
+    std::uint32_t header_crc;
+};
+static_assert(sizeof(SaveHeader) == 32);
+
+[[nodiscard]] std::size_t block_count(std::uint64_t size, std::uint32_t shift) noexcept {
+    return static_cast<std::size_t>((size + (std::uint64_t{1} << shift) - 1) >> shift);
+}
+
+[[nodiscard]] std::uint32_t header_crc(const SaveHeader& header, std::span<const std::uint32_t> crcs) noexcept {
+    const auto bytes = std::as_bytes(std::span(&header, 1)).first(offsetof(SaveHeader, header_crc));
+    return crc32c(std::as_bytes(crcs), crc32c(bytes));
+}
+
+/// CRC-32C of every block of `data`.
+[[nodiscard]] std::vector<std::uint32_t> block_crcs(std::span<const std::byte> data, std::uint32_t shift,
+                                                    ThreadPool* pool) {
+    const std::size_t block_size = std::size_t{1} << shift;
+    std::vector<std::uint32_t> crcs(block_count(data.size(), shift));
+    const auto compute = [&](std::size_t i) {
+        crcs[i] = crc32c(data.subspan(i * block_size, std::min(block_size, data.size() - i * block_size)));
+    };
+    if (pool != nullptr && crcs.size() > 1) {
+        pool->parallel_for(crcs.size(), compute);
+    } else {
+        for (std::size_t i = 0; i < crcs.size(); ++i) {
+            compute(i);
+        }
+    }
+    return crcs;
+}
+
+/// Reads and checks the header and block CRCs at the start of `in`.
+[[nodiscard]] Result<void> read_prefix(std::ifstream& in, SaveHeader& header, std::vector<std::uint32_t>& crcs) {
+    if (!in.read(reinterpret_cast<char*>(&header), sizeof(header))) {
+        return fail(Errc::checksum_mismatch);
+    }
+    if (header.magic != kMagic) {
+        return fail(Errc::bad_magic);
+    }
+    if (header.version != kVersion) {
+        return fail(Errc::unsupported_version);
+    }
+    // Bound the table before allocating it; the CRC check follows.
+    if (header.block_shift < 12 || header.block_shift > 30 || header.size > (std::uint64_t{1} << 48)) {
+        return fail(Errc::checksum_mismatch);
+    }
+    crcs.resize(block_count(header.size, header.block_shift));
+    const auto table = std::as_writable_bytes(std::span(crcs));
+    if (!in.read(reinterpret_cast<char*>(table.data()), static_cast<std::streamsize>(table.size())) ||
+        header_crc(header, crcs) != header.header_crc) {
+        return fail(Errc::checksum_mismatch);
+    }
+    return {};
+}
+
+/// Generation of the copy at `path` if its header is intact.
+[[nodiscard]] std::optional<std::uint64_t> read_generation(const std::filesystem::path& path) {
+    std::ifstream in(path, std::ios::binary);
+    SaveHeader header;
+    std::vector<std::uint32_t> crcs;
+    if (!in || !read_prefix(in, header, crcs)) {
+        return std::nullopt;
+    }
+    return header.generation;
+}
+
+/// Loads and verifies the copy at `path`.
+[[nodiscard]] Result<std::vector<std::byte>> read_copy(const std::filesystem::path& path, ThreadPool* pool) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in) {
+        return std::unexpected(std::make_error_code(std::errc::no_such_file_or_directory));
+    }
+    SaveHeader header;
+    std::vector<std::uint32_t> expected;
+    if (auto prefix = read_prefix(in, header, expected); !prefix) {
+        return std::unexpected(prefix.error());
+    }
+    std::vector<std::byte> data(static_cast<std::size_t>(header.size));
+    if (!in.read(reinterpret_cast<char*>(data.data()), static_cast<std::streamsize>(data.size())) ||
+        in.peek() != std::char_traits<char>::eof()) {
+        return fail(Errc::checksum_mismatch);
+    }
+    if (block_crcs(data, header.block_shift, pool) != expected) {
+        return fail(Errc::checksum_mismatch);
+    }
+    return data;
+}
+
+} // namespace
+
+std::filesystem::path SaveSlot::copy_path(int copy) const {
+    auto path = m_path;
+    path += copy == 0 ? ".0" : ".1";
+    return path;
+}
+
+Result<void> SaveSlot::write(std::span<const std::byte> data, ThreadPool* pool) const {
+    // Replace the older copy, or one that is missing or damaged.
+    const auto first = read_generation(copy_path(0));
+    const auto second = read_generation(copy_path(1));
+    const int target = !first ? 0 : !second ? 1 : *first <= *second ? 0 : 1;
+
+    SaveHeader header{};
+    header.magic = kMagic;
+    header.version = kVersion;
+    header.generation = std::max(first.value_or(0), second.value_or(0)) + 1;
+    header.size = data.size();
+    header.block_shift = kBlockShift;
+    const auto crcs = block_crcs(data, kBlockShift, pool);
+    header.header_crc = header_crc(header, crcs);
+
+    const auto table = std::as_bytes(std::span(crcs));
+    std::vector<std::byte> file(sizeof(header) + table.size() + data.size());
+    std::memcpy(file.data(), &header, sizeof(header));
+    if (!data.empty()) {
+        std::memcpy(file.data() + sizeof(header), table.data(), table.size());
+        std::memcpy(file.data() + sizeof(header) + table.size(), data.data(), data.size());
+    }
+    return detail::replace_file(copy_path(target), file);
+}
+
+Result<std::vector<std::byte>> SaveSlot::read(ThreadPool* pool) const {
+    const std::array<std::optional<std::uint64_t>, 2> generations{read_generation(copy_path(0)),
+                                                                  read_generation(copy_path(1))};
+    // Newest intact header first. A copy whose header is damaged is still
+    // tried last, so its error is reported if nothing else loads.
+    std::array<int, 2> order{0, 1};
+    if (generations[1].value_or(0) > generations[0].value_or(0) || (!generations[0] && generations[1])) {
+        std::swap(order[0], order[1]);
+    }
+
+    std::optional<std::error_code> error;
+    for (const int copy : order) {
+        auto data = read_copy(copy_path(copy), pool);
+        if (data) {
+            return data;
+        }
+        if (!error || *error == std::errc::no_such_file_or_directory) {
+            error = data.error();
+        }
+    }
+    return std::unexpected(*error);
+}
+
+bool SaveSlot::exists() const {
+    std::error_code ec;
+    return std::filesystem::exists(copy_path(0), ec) || std::filesystem::exists(copy_path(1), ec);
+}
+
+Result<void> SaveSlot::remove() const {
+    for (const int copy : {0, 1}) {
+        std::error_code ec;
+        std::filesystem::remove(copy_path(copy), ec);
+        if (ec) {
+            return std::unexpected(ec);
+        }
+    }
+    return {};
+}
+
+} // namespace stockpile
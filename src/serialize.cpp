@@ -0,0 +1,102 @@
+#include "stockpile/serialize.hpp"
+
+#include <algorithm>
+
+namespace stockpile {
+
+SaveWriter::SaveWriter(Arena& arena, std::size_t initial_capacity) : m_arena(&arena) {
+    m_capacity = std::max<std::size_t>(initial_capacity, 64);
+    m_data = static_cast<std::byte*>(m_arena->allocate(m_capacity));
+}
+
+void SaveWriter::write_varint(std::uint64_t value) {
+    std::byte encoded[10];
+    std::size_t length = 0;
+    while (value >= 0x80) {
+        encoded[length++] = static_cast<std::byte>((value & 0x7f) | 0x80);
+        value >>= 7;
+    }
+    encoded[length++] = static_cast<std::byte>(value);
+    std::memcpy(claim(length), encoded, length);
+}
+
+void SaveWriter::write_bytes(std::span<const std::byte> bytes) {
+    if (!bytes.empty()) {
+        std::memcpy(claim(bytes.size()), bytes.data(), bytes.size());
+    }
+}
+
+void SaveWriter::write_string(std::string_view text) {
+    write_varint(text.size());
+    write_bytes(std::as_bytes(std::span(text)));
+}
+
+void SaveWriter::align(std::size_t alignment) {
+    const std::size_t padding = (alignment - m_size % alignment) % alignment;
+    if (padding > 0) {
+        std::memset(claim(padding), 0, padding);
+    }
+}
+
+void SaveWriter::grow(std::size_t count) {
+    const std::size_t capacity = std::max(m_capacity * 2, m_size + count);
+    if (m_arena->try_extend(m_data, m_capacity, capacity)) {
+        m_capacity = capacity;
+        return;
+    }
+    auto* data = static_cast<std::byte*>(m_arena->allocate(capacity));
+    std::memcpy(data, m_data, m_size);
+    m_data = data;
+    m_capacity = capacity;
+}
+
+Result<std::uint64_t> SaveReader::read_varint() noexcept {
+    std::uint64_t value = 0;
+    for (unsigned shift = 0; shift < 64; shift += 7) {
+        if (m_position == m_bytes.size()) {
+            return fail(Errc::malformed_data);
+        }
+        const auto byte = std::to_integer<std::uint64_t>(m_bytes[m_position++]);
+        // The tenth byte may only carry the top bit of a 64-bit value.
+        if (shift == 63 && byte > 1) {
+            return fail(Errc::malformed_data);
+        }
+        value |= (byte & 0x7f) << shift;
+        if ((byte & 0x80) == 0) {
+            return value;
+        }
+    }
+    return fail(Errc::malformed_data);
+}
+
+Result<std::span<const std::byte>> SaveReader::read_bytes(std::size_t count) noexcept {
+    if (count > remaining()) {
+        return fail(Errc::malformed_data);
+    }
+    const auto bytes = m_bytes.subspan(m_position, count);
+    m_position += count;
+    return bytes;
+}
+
+Result<std::string_view> SaveReader::read_string() noexcept {
+    auto length = read_varint();
+    if (!length) {
+        return std::unexpected(length.error());
+    }
+    if (*length > remaining()) {
+        return fail(Errc::malformed_data);
+    }
+    auto bytes = read_bytes(*length);
+    return std::string_view(reinterpret_cast<const char*>(bytes->data()), bytes->size());
+}
+
+Result<void> SaveReader::align(std::size_t alignment) noexcept {
+    const std::size_t padding = (alignment - m_position % alignment) % alignment;
+    if (padding > remaining()) {
+        return fail(Errc::malformed_data);
+    }
+    m_position += padding;
+    return {};
+}
+
+} // namespace stockpile
@@ -0,0 +1,459 @@
+#include "stockpile/stream_loader.hpp"
+
+#include "stockpile/thread_pool.hpp"
+
+#include "io_uring.hpp"
+
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <queue>
+#include <thread>
+#include <tuple>
+#include <vector>
+
+namespace stockpile {
+
+namespace detail {
+
+struct StreamRequest {
+    const Archive* archive = nullptr;
+    EntryId entry = 0;
+    int fd = -1;
+    std::uint64_t offset = 0;
+    std::uint64_t size = 0;
+    std::uint64_t sequence = 0;
+    std::atomic<int> priority{0};
+    std::atomic<RequestStatus> status{RequestStatus::pending};
+    ReadCallback callback;
+
+    // Written by the loader before `status` leaves in_flight.
+    std::shared_ptr<const std::byte[]> storage;
+    std::span<const std::byte> data;
+    std::error_code error;
+};
+
+/// Pending requests whose stored bytes are fetched by one read.
+struct Batch {
+    int fd = -1;
+    std::uint64_t offset = 0;
+    std::uint64_t size = 0;
+    std::vector<std::shared_ptr<StreamRequest>> requests;
+    std::shared_ptr<std::byte[]> buffer;
+};
+
+struct StreamLoaderState {
+    struct QueueNode {
+        int priority;
+        std::uint64_t sequence;
+        std::shared_ptr<StreamRequest> request;
+
+        bool operator<(const QueueNode& other) const noexcept {
+            return priority != other.priority ? priority < other.priority : sequence > other.sequence;
+        }
+    };
+
+    /// (file descriptor, stored offset, sequence): finds neighbours to batch with.
+    using OffsetKey = std::tuple<int, std::uint64_t, std::uint64_t>;
+
+    explicit StreamLoaderState(const StreamLoader::Options& opts) : options(opts) {}
+
+    void enqueue(const std::shared_ptr<StreamRequest>& request);
+    [[nodiscard]] std::optional<Batch> take_batch();
+    void complete(Batch& batch, std::error_code error);
+    void run_pread();
+    void run_io_uring(detail::IoUring ring);
+
+    [[nodiscard]] static OffsetKey key_of(const StreamRequest& request) noexcept {
+        return {request.fd, request.offset, request.sequence};
+    }
+
+    StreamLoader::Options options;
+    /// Set to pread by the io_uring thread if the ring stops working.
+    std::atomic<StreamLoader::Backend> backend = StreamLoader::Backend::pread;
+
+    std::mutex mutex;
+    std::condition_variable wake;
+    // Priority changes push a fresh node; nodes whose priority no longer
+    // matches the request's are skipped when popped.
+    std::priority_queue<QueueNode> queue;
+    std::map<OffsetKey, std::shared_ptr<StreamRequest>> by_offset;
+    std::uint64_t next_sequence = 0;
+    bool stopping = false;
+
+    std::vector<std::thread> threads;
+    std::unique_ptr<ThreadPool> completions;
+};
+
+namespace {
+
+[[nodiscard]] bool try_start(StreamRequest& request) noexcept {
+    auto expected = RequestStatus::pending;
+    return request.status.compare_exchange_strong(expected, RequestStatus::in_flight, std::memory_order_acq_rel);
+}
+
+void finish(StreamRequest& request, RequestStatus status) noexcept {
+    request.status.store(status, std::memory_order_release);
+    request.status.notify_all();
+}
+
+[[nodiscard]] std::error_code read_fully(int fd, std::byte* data, std::uint64_t size, std::uint64_t offset) noexcept {
+    while (size > 0) {
+        const ssize_t n = ::pread(fd, data, size, static_cast<off_t>(offset));
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return {errno, std::generic_category()};
+        }
+        if (n == 0) {
+            return std::make_error_code(std::errc::io_error);
+        }
+        data += n;
+        size -= static_cast<std::uint64_t>(n);
+        offset += static_cast<std::uint64_t>(n);
+    }
+    return {};
+}
+
+} // namespace
+
+void StreamLoaderState::enqueue(const std::shared_ptr<StreamRequest>& request) {
+    request->sequence = next_sequence++;
+    queue.push({request->priority.load(std::memory_order_relaxed), request->sequence, request});
+    by_offset.emplace(key_of(*request), request);
+}
+
+std::optional<Batch> StreamLoaderState::take_batch() {
+    while (!queue.empty()) {
+        auto node = queue.top();
+        queue.pop();
+        auto& first = node.request;
+        if (node.priority != first->priority.load(std::memory_order_relaxed) || !try_start(*first)) {
+            continue;
+        }
+        by_offset.erase(key_of(*first));
+
+        Batch batch;
+        batch.fd = first->fd;
+        batch.offset = first->offset;
+        batch.requests.push_back(first);
+        std::uint64_t end = first->offset + first->size;
+        const std::uint64_t gap = options.max_batch_gap;
+        const std::uint64_t limit = options.max_batch_bytes;
+
+        // Grow forwards, then backwards, over requests for neighbouring bytes.
+        // Whatever is visited is either started here or already cancelled.
+        for (auto it = by_offset.lower_bound({batch.fd, batch.offset, 0}); it != by_offset.end();) {
+            const auto& candidate = it->second;
+            if (candidate->fd != batch.fd || candidate->offset > end + gap) {
+                break;
+            }
+            const std::uint64_t candidate_end = std::max(end, candidate->offset + candidate->size);
+            if (candidate_end - batch.offset > limit) {
+                break;
+            }
+            if (try_start(*candidate)) {
+                batch.requests.push_back(candidate);
+                end = candidate_end;
+            }
+            it = by_offset.erase(it);
+        }
+        for (auto it = by_offset.lower_bound({batch.fd, batch.offset, 0}); it != by_offset.begin();) {
+            const auto previous = std::prev(it);
+            const auto& candidate = previous->second;
+            if (candidate->fd != batch.fd || candidate->offset + candidate->size + gap < batch.offset) {
+                break;
+            }
+            const std::uint64_t candidate_end = std::max(end, candidate->offset + candidate->size);
+            if (candidate_end - candidate->offset > limit) {
+                break;
+            }
+            if (try_start(*candidate)) {
+                batch.requests.push_back(candidate);
+                batch.offset = candidate->offset;
+                end = candidate_end;
+            }
+            it = by_offset.erase(previous);
+        }
+
+        batch.size = end - batch.offset;
+        batch.buffer = std::make_shared_for_overwrite<std::byte[]>(batch.size);
+        return batch;
+    }
+    return std::nullopt;
+}
+
+void StreamLoaderState::complete(Batch& batch, std::error_code error) {
+    for (const auto& request : batch.requests) {
+        if (error) {
+            request->error = error;
+        } else {
+            const std::span stored(batch.buffer.get() + (request->offset - batch.offset), request->size);
+            const auto raw_size = request->archive->size(request->entry);
+            if (request->archive->codec(request->entry) == Codec::none) {
+                // Uncompressed entries are served straight from the batch buffer.
+                request->storage = batch.buffer;
+                request->data = stored;
+            } else {
+                auto decoded = std::make_shared_for_overwrite<std::byte[]>(raw_size);
+                const std::span out(decoded.get(), raw_size);
+                if (auto ok = request->archive->decode(request->entry, stored, out); !ok) {
+                    request->error = ok.error();
+                } else {
+                    request->storage = std::move(decoded);
+                    request->data = out;
+                }
+            }
+        }
+
+        if (request->callback) {
+            if (request->error) {
+                request->callback(ReadResult(std::unexpected(request->error)));
+            } else {
+                request->callback(ReadResult(request->data));
+            }
+        }
+        finish(*request, request->error ? RequestStatus::failed : RequestStatus::completed);
+    }
+}
+
+void StreamLoaderState::run_pread() {
+    for (;;) {
+        std::optional<Batch> batch;
+        {
+            std::unique_lock lock(mutex);
+            wake.wait(lock, [this] { return stopping || !queue.empty(); });
+            if (stopping) {
+                return;
+            }
+            batch = take_batch();
+        }
+        if (batch) {
+            complete(*batch, read_fully(batch->fd, batch->buffer.get(), batch->size, batch->offset));
+        }
+    }
+}
+
+void StreamLoaderState::run_io_uring(detail::IoUring ring) {
+    // One thread owns the ring: it turns queued requests into reads, waits
+    // for completions and hands decoding and callbacks to the pool. While
+    // reads are in flight it blocks in the kernel, so newly queued requests
+    // are picked up as soon as the next read completes.
+    unsigned in_flight = 0;
+    // Batches prepared on the ring, oldest first, that the kernel may not
+    // have taken yet.
+    std::vector<Batch*> prepared;
+    const auto on_completion = [this](std::uint64_t user_data, std::int32_t result) {
+        std::unique_ptr<Batch> batch(reinterpret_cast<Batch*>(static_cast<std::uintptr_t>(user_data)));
+        // Errors and short reads are retried with pread() from where the
+        // kernel stopped; this also covers kernels without IORING_OP_READ.
+        const std::uint64_t done = result < 0 ? 0 : static_cast<std::uint64_t>(result);
+        const auto error = read_fully(batch->fd, batch->buffer.get() + done, batch->size - done,
+                                      batch->offset + done);
+        completions->submit([this, b = std::move(batch), error] { complete(*b, error); });
+    };
+    for (;;) {
+        {
+            std::unique_lock lock(mutex);
+            if (in_flight == 0) {
+                wake.wait(lock, [this] { return stopping || !queue.empty(); });
+            }
+            if (stopping && in_flight == 0) {
+                return;
+            }
+            while (!stopping && in_flight < ring.capacity()) {
+                auto batch = take_batch();
+                if (!batch) {
+                    break;
+                }
+                auto owned = std::make_unique<Batch>(std::move(*batch));
+                const std::span buffer(owned->buffer.get(), owned->size);
+                if (owned->size == 0) {
+                    completions->submit([this, b = std::move(owned)] { complete(*b, {}); });
+                    continue;
+                }
+                const auto user_data = reinterpret_cast<std::uintptr_t>(owned.get());
+                if (!ring.prepare_read(owned->fd, buffer, owned->offset, user_data)) {
+                    // No room in the submission queue: read on the pool instead.
+                    completions->submit([this, b = std::move(owned)] {
+                        complete(*b, read_fully(b->fd, b->buffer.get(), b->size, b->offset));
+                    });
+                    continue;
+                }
+                prepared.push_back(owned.release());
+                ++in_flight;
+            }
+        }
+
+        const auto submitted = ring.submit(in_flight > 0 ? 1 : 0);
+        prepared.erase(prepared.begin(), prepared.end() - ring.pending());
+        if (!submitted) {
+            // Transient failures are retried inside submit(), so the ring is
+            // unusable. Read what the kernel never took with pread(), wait
+            // for the reads it did take, and carry on as a pread loader.
+            for (Batch* batch : prepared) {
+                completions->submit([this, b = std::unique_ptr<Batch>(batch)] {
+                    complete(*b, read_fully(b->fd, b->buffer.get(), b->size, b->offset));
+                });
+            }
+            in_flight -= static_cast<unsigned>(prepared.size());
+            while (in_flight > 0) {
+                if (const unsigned drained = ring.drain(on_completion); drained > 0) {
+                    in_flight -= drained;
+                } else {
+                    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                }
+            }
+            ring = {};
+            backend.store(StreamLoader::Backend::pread, std::memory_order_release);
+            run_pread();
+            return;
+        }
+        in_flight -= ring.drain(on_completion);
+    }
+}
+
+} // namespace detail
+
+ReadHandle::ReadHandle(std::shared_ptr<detail::StreamRequest> request,
+                       std::weak_ptr<detail::StreamLoaderState> loader) noexcept
+    : m_request(std::move(request)), m_loader(std::move(loader)) {}
+
+RequestStatus ReadHandle::status() const noexcept {
+    return m_request ? m_request->status.load(std::memory_order_acquire) : RequestStatus::cancelled;
+}
+
+bool ReadHandle::cancel() noexcept {
+    if (!m_request) {
+        return false;
+    }
+    auto expected = RequestStatus::pending;
+    if (!m_request->status.compare_exchange_strong(expected, RequestStatus::cancelled, std::memory_order_acq_rel)) {
+        return expected == RequestStatus::cancelled;
+    }
+    m_request->status.notify_all();
+    if (auto loader = m_loader.lock()) {
+        std::lock_guard lock(loader->mutex);
+        loader->by_offset.erase(detail::StreamLoaderState::key_of(*m_request));
+    }
+    return true;
+}
+
+void ReadHandle::set_priority(int priority) {
+    auto loader = m_loader.lock();
+    if (!m_request || !loader) {
+        return;
+    }
+    std::lock_guard lock(loader->mutex);
+    if (m_request->status.load(std::memory_order_acquire) != RequestStatus::pending ||
+        m_request->priority.exchange(priority, std::memory_order_relaxed) == priority) {
+        return;
+    }
+    loader->queue.push({priority, m_request->sequence, m_request});
+}
+
+void ReadHandle::wait() const noexcept {
+    if (!m_request) {
+        return;
+    }
+    for (auto status = m_request->status.load(std::memory_order_acquire);
+         status == RequestStatus::pending || status == RequestStatus::in_flight;
+         status = m_request->status.load(std::memory_order_acquire)) {
+        m_request->status.wait(status, std::memory_order_acquire);
+    }
+}
+
+ReadResult ReadHandle::result() const {
+    if (!m_request) {
+        return std::unexpected(std::make_error_code(std::errc::invalid_argument));
+    }
+    wait();
+    switch (m_request->status.load(std::memory_order_acquire)) {
+    case RequestStatus::completed:
+        return m_request->data;
+    case RequestStatus::failed:
+        return std::unexpected(m_request->error);
+    default:
+        return std::unexpected(std::make_error_code(std::errc::operation_canceled));
+    }
+}
+
+StreamLoader::StreamLoader() : StreamLoader(Options{}) {}
+
+StreamLoader::StreamLoader(const Options& options)
+    : m_state(std::make_shared<detail::StreamLoaderState>(options)) {
+    auto& state = *m_state;
+    const std::size_t threads = options.threads != 0 ? options.threads
+                                                     : std::max(1u, std::thread::hardware_concurrency());
+
+    if (options.backend != Backend::pread) {
+        if (auto ring = detail::IoUring::create(std::max(1u, options.queue_depth))) {
+            state.backend = Backend::io_uring;
+            state.completions = std::make_unique<ThreadPool>(threads);
+            state.threads.emplace_back([&state, r = std::move(*ring)]() mutable {
+                state.run_io_uring(std::move(r));
+            });
+            return;
+        }
+    }
+    state.backend = Backend::pread;
+    for (std::size_t i = 0; i < threads; ++i) {
+        state.threads.emplace_back([&state] { state.run_pread(); });
+    }
+}
+
+StreamLoader::~StreamLoader() {
+    auto& state = *m_state;
+    {
+        std::lock_guard lock(state.mutex);
+        state.stopping = true;
+        for (auto& [key, request] : state.by_offset) {
+            auto expected = RequestStatus::pending;
+            if (request->status.compare_exchange_strong(expected, RequestStatus::cancelled)) {
+                request->status.notify_all();
+            }
+        }
+        state.by_offset.clear();
+        state.queue = {};
+    }
+    state.wake.notify_all();
+    for (auto& thread : state.threads) {
+        thread.join();
+    }
+    // Runs the remaining completions before the pool goes away.
+    state.completions.reset();
+}
+
+StreamLoader::Backend StreamLoader::backend() const noexcept {
+    return m_state->backend.load(std::memory_order_acquire);
+}
+
+ReadHandle StreamLoader::submit(const Archive& archive, EntryId entry, int priority, ReadCallback callback) {
+    auto request = std::make_shared<detail::StreamRequest>();
+    request->archive = &archive;
+    request->entry = entry;
+    request->fd = archive.file().native_handle();
+    request->offset = archive.offset(entry);
+    request->size = archive.data(entry).size();
+    request->priority.store(priority, std::memory_order_relaxed);
+    request->callback = std::move(callback);
+    {
+        std::lock_guard lock(m_state->mutex);
+        if (m_state->stopping) {
+            detail::finish(*request, RequestStatus::cancelled);
+            return {request, m_state};
+        }
+        m_state->enqueue(request);
+    }
+    m_state->wake.notify_one();
+    return {request, m_state};
+}
+
+} // namespace stockpile
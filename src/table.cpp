@@ -0,0 +1,431 @@
+#include "stockpile/table.hpp"
+
+#include "stockpile/hash.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <cstring>
+#include <limits>
+#include <numeric>
+#include <utility>
+#include <vector>
+
+namespace stockpile {
+
+std::optional<std::uint32_t> StringColumn::find(std::string_view text) const noexcept {
+    const std::uint32_t code = lower_bound(text);
+    if (code == dictionary_size() || value(code) != text) {
+        return std::nullopt;
+    }
+    return code;
+}
+
+std::uint32_t StringColumn::lower_bound(std::string_view text) const noexcept {
+    std::uint32_t low = 0;
+    auto high = static_cast<std::uint32_t>(dictionary_size());
+    while (low < high) {
+        const std::uint32_t middle = low + (high - low) / 2;
+        if (value(middle) < text) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    return low;
+}
+
+namespace {
+
+template <typename K>
+bool sort_by(std::span<const std::byte> keys, std::vector<std::uint32_t>& rows) {
+    const auto load = [&](std::uint32_t row) {
+        K value;
+        std::memcpy(&value, keys.data() + row * sizeof(K), sizeof(K));
+        return value;
+    };
+    std::ranges::stable_sort(rows,
+                             [&](std::uint32_t a, std::uint32_t b) { return detail::KeyLess{}(load(a), load(b)); });
+    return true;
+}
+
+/// Orders `rows` by the values of `column` in `keys`, as KeyLess would.
+[[nodiscard]] bool sort_rows(const format::ColumnHeader& column, std::span<const std::byte> keys,
+                             std::vector<std::uint32_t>& rows) {
+    switch (column.kind) {
+    case format::ColumnKind::signed_int:
+        switch (column.element_size) {
+        case 1:
+            return sort_by<std::int8_t>(keys, rows);
+        case 2:
+            return sort_by<std::int16_t>(keys, rows);
+        case 4:
+            return sort_by<std::int32_t>(keys, rows);
+        case 8:
+            return sort_by<std::int64_t>(keys, rows);
+        }
+        return false;
+    case format::ColumnKind::unsigned_int:
+    case format::ColumnKind::boolean:
+    case format::ColumnKind::string:
+        switch (column.element_size) {
+        case 1:
+            return sort_by<std::uint8_t>(keys, rows);
+        case 2:
+            return sort_by<std::uint16_t>(keys, rows);
+        case 4:
+            return sort_by<std::uint32_t>(keys, rows);
+        case 8:
+            return sort_by<std::uint64_t>(keys, rows);
+        }
+        return false;
+    case format::ColumnKind::floating:
+        switch (column.element_size) {
+        case 4:
+            return sort_by<float>(keys, rows);
+        case 8:
+            return sort_by<double>(keys, rows);
+        }
+        return false;
+    case format::ColumnKind::flat:
+        return false;
+    }
+    return false;
+}
+
+} // namespace
+
+namespace detail {
+
+TableEncoder::TableEncoder(SaveWriter& writer, std::uint32_t schema_version, std::size_t column_count,
+                           std::size_t index_count, std::uint64_t row_count)
+    : m_writer(&writer), m_column_count(column_count), m_row_count(row_count) {
+    writer.align(format::kAlignment);
+    m_start = writer.size();
+    writer.write(format::kTableMagic);
+    writer.write(format::kTableVersion);
+    writer.write(schema_version);
+    writer.write(static_cast<std::uint32_t>(column_count));
+    writer.write(static_cast<std::uint32_t>(index_count));
+    writer.write<std::uint32_t>(0);
+    writer.write(row_count);
+    writer.write<std::uint64_t>(0);
+    // Column and index headers are filled in as they are written.
+    const format::ColumnHeader empty_column{};
+    for (std::size_t i = 0; i < column_count; ++i) {
+        writer.write_bytes(std::as_bytes(std::span(&empty_column, 1)));
+    }
+    const format::IndexHeader empty_index{};
+    for (std::size_t i = 0; i < index_count; ++i) {
+        writer.write_bytes(std::as_bytes(std::span(&empty_index, 1)));
+    }
+}
+
+std::size_t TableEncoder::next_header(std::uint32_t key, format::ColumnKind kind, std::uint32_t element_size) {
+    const std::size_t header =
+        m_start + sizeof(format::TableHeader) + m_column++ * sizeof(format::ColumnHeader);
+    m_writer->align(format::kAlignment);
+    m_writer->overwrite(header + offsetof(format::ColumnHeader, key), key);
+    m_writer->overwrite(header + offsetof(format::ColumnHeader, kind), kind);
+    m_writer->overwrite(header + offsetof(format::ColumnHeader, element_size), element_size);
+    m_writer->overwrite(header + offsetof(format::ColumnHeader, data_offset),
+                        static_cast<std::uint64_t>(m_writer->size() - m_start));
+    return header;
+}
+
+void TableEncoder::begin_column(std::uint32_t key, format::ColumnKind kind, std::uint32_t element_size) {
+    (void)next_header(key, kind, element_size);
+}
+
+Result<void> TableEncoder::add_strings(std::uint32_t key, std::span<const std::string_view> values) {
+    std::vector<std::string_view> dictionary(values.begin(), values.end());
+    std::ranges::sort(dictionary);
+    dictionary.erase(std::ranges::unique(dictionary).begin(), dictionary.end());
+    std::uint64_t chars = 0;
+    for (const std::string_view text : dictionary) {
+        chars += text.size();
+    }
+    if (dictionary.size() > std::numeric_limits<std::uint32_t>::max() ||
+        chars > std::numeric_limits<std::uint32_t>::max()) {
+        return fail(Errc::too_large);
+    }
+
+    const std::size_t header = next_header(key, format::ColumnKind::string, sizeof(std::uint32_t));
+    for (const std::string_view text : values) {
+        const auto code = std::ranges::lower_bound(dictionary, text) - dictionary.begin();
+        m_writer->write(static_cast<std::uint32_t>(code));
+    }
+    m_writer->align(alignof(std::uint32_t));
+    m_writer->overwrite(header + offsetof(format::ColumnHeader, dictionary_count),
+                        static_cast<std::uint32_t>(dictionary.size()));
+    m_writer->overwrite(header + offsetof(format::ColumnHeader, dictionary_offset),
+                        static_cast<std::uint64_t>(m_writer->size() - m_start));
+    std::uint32_t end = 0;
+    for (const std::string_view text : dictionary) {
+        end += static_cast<std::uint32_t>(text.size());
+        m_writer->write(end);
+    }
+    for (const std::string_view text : dictionary) {
+        m_writer->write_bytes(std::as_bytes(std::span(text.data(), text.size())));
+    }
+    return {};
+}
+
+Result<void> TableEncoder::add_index(std::size_t column, format::IndexKind kind) {
+    if (m_row_count > std::numeric_limits<std::uint32_t>::max()) {
+        return fail(Errc::too_large);
+    }
+    // Copied out first: writing the index may move the writer's buffer.
+    format::ColumnHeader header;
+    std::memcpy(&header, m_writer->bytes().data() + m_start + sizeof(format::TableHeader) +
+                             column * sizeof(format::ColumnHeader),
+                sizeof(header));
+    const std::size_t element_size = header.element_size;
+    const auto values = m_writer->bytes().subspan(m_start + header.data_offset, m_row_count * element_size);
+    const std::vector<std::byte> keys(values.begin(), values.end());
+    const auto key = [&](std::uint32_t row) { return std::span(keys).subspan(row * element_size, element_size); };
+
+    std::vector<std::uint32_t> rows(m_row_count);
+    std::iota(rows.begin(), rows.end(), 0u);
+    std::vector<std::byte> data;
+    std::uint64_t slot_count = 0;
+    if (kind == format::IndexKind::hash) {
+        // Group the rows of each distinct value, then give every group a slot.
+        std::ranges::stable_sort(rows, [&](std::uint32_t a, std::uint32_t b) {
+            return std::memcmp(key(a).data(), key(b).data(), element_size) < 0;
+        });
+        std::vector<std::pair<std::uint32_t, std::uint32_t>> groups;
+        for (std::uint32_t i = 0; i < rows.size(); ++i) {
+            if (i == 0 || std::memcmp(key(rows[i]).data(), key(rows[i - 1]).data(), element_size) != 0) {
+                groups.emplace_back(i, 0);
+            }
+            ++groups.back().second;
+        }
+        slot_count = std::bit_ceil(std::max<std::uint64_t>(1, 2 * groups.size()));
+        std::vector<format::IndexSlot> slots(slot_count);
+        for (const auto& [begin, count] : groups) {
+            const std::uint64_t hash = hash64(key(rows[begin]));
+            std::uint64_t slot = hash & (slot_count - 1);
+            while (slots[slot].count != 0) {
+                slot = (slot + 1) & (slot_count - 1);
+            }
+            slots[slot] = {hash, begin, count};
+        }
+        const auto bytes = std::as_bytes(std::span(slots));
+        data.assign(bytes.begin(), bytes.end());
+    } else {
+        if (!sort_rows(header, keys, rows)) {
+            return std::unexpected(std::make_error_code(std::errc::invalid_argument));
+        }
+        data.reserve(keys.size());
+        for (const std::uint32_t row : rows) {
+            const auto value = key(row);
+            data.insert(data.end(), value.begin(), value.end());
+        }
+    }
+
+    const std::size_t index_header = m_start + sizeof(format::TableHeader) +
+                                     m_column_count * sizeof(format::ColumnHeader) +
+                                     m_index++ * sizeof(format::IndexHeader);
+    m_writer->overwrite(index_header + offsetof(format::IndexHeader, column), static_cast<std::uint32_t>(column));
+    m_writer->overwrite(index_header + offsetof(format::IndexHeader, kind), kind);
+    m_writer->overwrite(index_header + offsetof(format::IndexHeader, slot_count), slot_count);
+    m_writer->align(format::kAlignment);
+    m_writer->overwrite(index_header + offsetof(format::IndexHeader, data_offset),
+                        static_cast<std::uint64_t>(m_writer->size() - m_start));
+    m_writer->write_bytes(data);
+    m_writer->align(format::kAlignment);
+    m_writer->overwrite(index_header + offsetof(format::IndexHeader, rows_offset),
+                        static_cast<std::uint64_t>(m_writer->size() - m_start));
+    m_writer->write_bytes(std::as_bytes(std::span(rows)));
+    return {};
+}
+
+void TableEncoder::finish() {
+    m_writer->overwrite(m_start + offsetof(format::TableHeader, size),
+                        static_cast<std::uint64_t>(m_writer->size() - m_start));
+}
+
+} // namespace detail
+
+namespace {
+
+/// True if `count` elements of `element_size` bytes fit in `bytes` at `offset`.
+[[nodiscard]] bool fits(std::span<const std::byte> bytes, std::uint64_t offset, std::uint64_t count,
+                        std::uint64_t element_size) noexcept {
+    return offset <= bytes.size() && count <= (bytes.size() - offset) / element_size;
+}
+
+[[nodiscard]] bool valid_column(std::span<const std::byte> bytes, const format::ColumnHeader& column,
+                                std::uint64_t rows) noexcept {
+    if (column.element_size == 0 || column.data_offset % format::kAlignment != 0 ||
+        !fits(bytes, column.data_offset, rows, column.element_size)) {
+        return false;
+    }
+    const std::byte* data = bytes.data() + column.data_offset;
+    switch (column.kind) {
+    case format::ColumnKind::signed_int:
+    case format::ColumnKind::unsigned_int:
+    case format::ColumnKind::floating:
+    case format::ColumnKind::flat:
+        return true;
+    case format::ColumnKind::boolean:
+        // Any other byte would be an invalid bool.
+        return column.element_size == 1 &&
+               std::all_of(data, data + rows, [](std::byte b) { return std::to_integer<unsigned>(b) <= 1; });
+    case format::ColumnKind::string: {
+        const std::uint64_t count = column.dictionary_count;
+        if (column.element_size != sizeof(std::uint32_t) || column.dictionary_offset % alignof(std::uint32_t) != 0 ||
+            !fits(bytes, column.dictionary_offset, count, sizeof(std::uint32_t))) {
+            return false;
+        }
+        const auto* codes = reinterpret_cast<const std::uint32_t*>(data);
+        const auto* ends = reinterpret_cast<const std::uint32_t*>(bytes.data() + column.dictionary_offset);
+        const std::uint64_t chars = column.dictionary_offset + count * sizeof(std::uint32_t);
+        return std::all_of(codes, codes + rows, [&](std::uint32_t code) { return code < count; }) &&
+               std::is_sorted(ends, ends + count) && (count == 0 || fits(bytes, chars, ends[count - 1], 1));
+    }
+    }
+    return false;
+}
+
+[[nodiscard]] bool valid_index(std::span<const std::byte> bytes, std::span<const format::ColumnHeader> columns,
+                               const format::IndexHeader& index, std::uint64_t rows) noexcept {
+    if (index.column >= columns.size() || index.rows_offset % alignof(std::uint32_t) != 0 ||
+        !fits(bytes, index.rows_offset, rows, sizeof(std::uint32_t))) {
+        return false;
+    }
+    const format::ColumnHeader& column = columns[index.column];
+    const auto* row_list = reinterpret_cast<const std::uint32_t*>(bytes.data() + index.rows_offset);
+    if (!std::all_of(row_list, row_list + rows, [&](std::uint32_t row) { return row < rows; })) {
+        return false;
+    }
+    switch (index.kind) {
+    case format::IndexKind::hash: {
+        if (column.kind == format::ColumnKind::floating || column.kind == format::ColumnKind::flat ||
+            !std::has_single_bit(index.slot_count) || index.data_offset % alignof(format::IndexSlot) != 0 ||
+            !fits(bytes, index.data_offset, index.slot_count, sizeof(format::IndexSlot))) {
+            return false;
+        }
+        const auto* slots = reinterpret_cast<const format::IndexSlot*>(bytes.data() + index.data_offset);
+        // Every slot in bounds, and one empty so that lookups end.
+        return std::all_of(slots, slots + index.slot_count,
+                           [&](const format::IndexSlot& slot) { return std::uint64_t{slot.begin} + slot.count <= rows; }) &&
+               std::any_of(slots, slots + index.slot_count, [](const format::IndexSlot& slot) { return slot.count == 0; });
+    }
+    case format::IndexKind::sorted:
+        return column.kind != format::ColumnKind::flat && index.data_offset % format::kAlignment == 0 &&
+               fits(bytes, index.data_offset, rows, column.element_size);
+    }
+    return false;
+}
+
+} // namespace
+
+Result<Table> Table::open(std::span<const std::byte> bytes) noexcept {
+    if (reinterpret_cast<std::uintptr_t>(bytes.data()) % format::kAlignment != 0) {
+        return std::unexpected(std::make_error_code(std::errc::invalid_argument));
+    }
+    if (bytes.size() < sizeof(format::TableHeader)) {
+        return fail(Errc::malformed_data);
+    }
+    format::TableHeader header;
+    std::memcpy(&header, bytes.data(), sizeof(header));
+    if (header.magic != format::kTableMagic) {
+        return fail(Errc::bad_magic);
+    }
+    if (header.version != format::kTableVersion) {
+        return fail(Errc::unsupported_version);
+    }
+    const std::uint64_t indexes_at = sizeof(header) + std::uint64_t{header.column_count} * sizeof(format::ColumnHeader);
+    if (header.size < sizeof(header) || header.size > bytes.size() ||
+        !fits(bytes.first(header.size), sizeof(header), header.column_count, sizeof(format::ColumnHeader)) ||
+        !fits(bytes.first(header.size), indexes_at, header.index_count, sizeof(format::IndexHeader))) {
+        return fail(Errc::malformed_data);
+    }
+
+    Table table;
+    table.m_bytes = bytes.first(header.size);
+    table.m_columns = {reinterpret_cast<const format::ColumnHeader*>(bytes.data() + sizeof(header)),
+                       header.column_count};
+    table.m_indexes = {reinterpret_cast<const format::IndexHeader*>(bytes.data() + indexes_at), header.index_count};
+    table.m_rows = header.row_count;
+    table.m_schema_version = header.schema_version;
+    for (const format::ColumnHeader& column : table.m_columns) {
+        if (!valid_column(table.m_bytes, column, table.m_rows)) {
+            return fail(Errc::malformed_data);
+        }
+    }
+    for (const format::IndexHeader& index : table.m_indexes) {
+        if (!valid_index(table.m_bytes, table.m_columns, index, table.m_rows)) {
+            return fail(Errc::malformed_data);
+        }
+    }
+    return table;
+}
+
+std::optional<std::size_t> Table::find(std::uint32_t key, std::size_t hint) const noexcept {
+    if (hint < m_columns.size() && m_columns[hint].key == key) {
+        return hint;
+    }
+    for (std::size_t i = 0; i < m_columns.size(); ++i) {
+        if (m_columns[i].key == key) {
+            return i;
+        }
+    }
+    return std::nullopt;
+}
+
+std::optional<std::size_t> Table::find_index(std::size_t column, format::IndexKind kind) const noexcept {
+    for (std::size_t i = 0; i < m_indexes.size(); ++i) {
+        if (m_indexes[i].column == column && m_indexes[i].kind == kind) {
+            return i;
+        }
+    }
+    return std::nullopt;
+}
+
+std::span<const std::uint32_t> Table::hash_lookup(std::size_t index, std::span<const std::byte> key) const noexcept {
+    const format::IndexHeader& header = m_indexes[index];
+    const format::ColumnHeader& column = m_columns[header.column];
+    const auto* slots = reinterpret_cast<const format::IndexSlot*>(m_bytes.data() + header.data_offset);
+    const std::byte* values = m_bytes.data() + column.data_offset;
+    const auto rows = index_rows(index);
+    const std::uint64_t hash = hash64(key);
+    const std::uint64_t mask = header.slot_count - 1;
+    for (std::uint64_t slot = hash & mask;; slot = (slot + 1) & mask) {
+        const format::IndexSlot& entry = slots[slot];
+        if (entry.count == 0) {
+            return {};
+        }
+        // Distinct values may share a hash, so the group's first row decides.
+        if (entry.hash == hash &&
+            std::memcmp(values + std::size_t{rows[entry.begin]} * column.element_size, key.data(), key.size()) == 0) {
+            return rows.subspan(entry.begin, entry.count);
+        }
+    }
+}
+
+Result<StringColumn> Table::strings(std::string_view name) const noexcept {
+    const auto index = find(field_key(name));
+    if (!index) {
+        return fail(Errc::missing_field);
+    }
+    if (!holds<std::string_view>(*index)) {
+        return fail(Errc::malformed_data);
+    }
+    return strings_at(*index);
+}
+
+StringColumn Table::strings_at(std::size_t index) const noexcept {
+    const format::ColumnHeader& column = m_columns[index];
+    StringColumn strings;
+    strings.m_codes = column_at<std::uint32_t>(index);
+    strings.m_ends = {reinterpret_cast<const std::uint32_t*>(m_bytes.data() + column.dictionary_offset),
+                      column.dictionary_count};
+    strings.m_chars = reinterpret_cast<const char*>(m_bytes.data() + column.dictionary_offset) +
+                      std::uint64_t{column.dictionary_count} * sizeof(std::uint32_t);
+    return strings;
+}
+
+} // namespace stockpile
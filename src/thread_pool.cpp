@@ -0,0 +1,97 @@
+#include "stockpile/thread_pool.hpp"
+
+#include <atomic>
+#include <memory>
+
+namespace stockpile {
+
+ThreadPool::ThreadPool(std::size_t threads) {
+    if (threads == 0) {
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    m_workers.reserve(threads);
+    for (std::size_t i = 0; i < threads; ++i) {
+        m_workers.emplace_back([this] { run(); });
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard lock(m_mutex);
+        m_stopping = true;
+    }
+    m_wake.notify_all();
+    for (auto& worker : m_workers) {
+        worker.join();
+    }
+}
+
+void ThreadPool::submit(std::move_only_function<void()> task) {
+    {
+        std::lock_guard lock(m_mutex);
+        m_tasks.push_back(std::move(task));
+    }
+    m_wake.notify_one();
+}
+
+void ThreadPool::run() {
+    for (;;) {
+        std::move_only_function<void()> task;
+        {
+            std::unique_lock lock(m_mutex);
+            m_wake.wait(lock, [this] { return m_stopping || !m_tasks.empty(); });
+            if (m_tasks.empty()) {
+                return;
+            }
+            task = std::move(m_tasks.front());
+            m_tasks.pop_front();
+        }
+        task();
+    }
+}
+
+void ThreadPool::parallel_for(std::size_t count, const std::function<void(std::size_t)>& fn) {
+    if (count == 0) {
+        return;
+    }
+    if (count == 1) {
+        fn(0);
+        return;
+    }
+
+    // Helpers that start after every index is claimed only touch the shared
+    // state, which they keep alive; `fn` is only called for claimed indices,
+    // all of which finish before this function returns.
+    struct State {
+        std::atomic<std::size_t> next{0};
+        std::size_t finished = 0;
+        std::mutex mutex;
+        std::condition_variable done;
+    };
+    auto state = std::make_shared<State>();
+    const auto drain = [count, &fn](State& s) {
+        std::size_t ran = 0;
+        for (std::size_t i = s.next.fetch_add(1); i < count; i = s.next.fetch_add(1)) {
+            fn(i);
+            ++ran;
+        }
+        if (ran != 0) {
+            std::lock_guard lock(s.mutex);
+            s.finished += ran;
+            if (s.finished == count) {
+                s.done.notify_all();
+            }
+        }
+    };
+
+    const std::size_t helpers = std::min(count - 1, m_workers.size());
+    for (std::size_t i = 0; i < helpers; ++i) {
+        submit([state, drain] { drain(*state); });
+    }
+    drain(*state);
+
+    std::unique_lock lock(state->mutex);
+    state->done.wait(lock, [&] { return state->finished == count; });
+}
+
+} // namespace stockpile
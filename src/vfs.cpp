@@ -0,0 +1,369 @@
+#include "stockpile/vfs.hpp"
+
+#include "stockpile/archive_writer.hpp"
+#include "stockpile/hash.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <utility>
+#include <variant>
+
+namespace stockpile {
+
+namespace detail {
+
+struct VfsLayer {
+    /// Regular files below a directory, sorted by path.
+    struct Directory {
+        std::filesystem::path root;
+        std::vector<std::string> paths;
+        std::vector<std::uint64_t> sizes;
+    };
+
+    /// "" or a directory path ending in '/'.
+    std::string mount_point;
+    int priority = 0;
+    /// Mount order, which breaks ties between equal priorities.
+    std::uint64_t sequence = 0;
+    std::variant<Archive, Directory, std::vector<MemoryFile>> source;
+    /// hash_path() of every entry's path in the Vfs.
+    std::vector<std::uint64_t> hashes;
+
+    [[nodiscard]] std::size_t entry_count() const noexcept {
+        return std::visit(
+            [](const auto& source) -> std::size_t {
+                using Source = std::decay_t<decltype(source)>;
+                if constexpr (std::is_same_v<Source, Archive>) {
+                    return source.entry_count();
+                } else if constexpr (std::is_same_v<Source, Directory>) {
+                    return source.paths.size();
+                } else {
+                    return source.size();
+                }
+            },
+            this->source);
+    }
+
+    [[nodiscard]] bool is_tombstone(std::uint32_t entry) const noexcept {
+        const auto* archive = std::get_if<Archive>(&source);
+        return archive != nullptr && archive->is_tombstone(entry);
+    }
+
+    /// Whether the path of an entry in the Vfs is `path`, without building it.
+    [[nodiscard]] bool has_path(std::uint32_t entry, std::string_view path) const noexcept {
+        if (!path.starts_with(mount_point)) {
+            return false;
+        }
+        path.remove_prefix(mount_point.size());
+        if (const auto* archive = std::get_if<Archive>(&source)) {
+            return archive->has_path(entry, path);
+        }
+        if (const auto* directory = std::get_if<Directory>(&source)) {
+            return directory->paths[entry] == path;
+        }
+        return std::get<std::vector<MemoryFile>>(source)[entry].path == path;
+    }
+
+    /// Appends the path of an entry in the Vfs, mount point included.
+    void append_path(std::uint32_t entry, std::string& out) const {
+        out += mount_point;
+        if (const auto* archive = std::get_if<Archive>(&source)) {
+            archive->append_path(entry, out);
+        } else if (const auto* directory = std::get_if<Directory>(&source)) {
+            out += directory->paths[entry];
+        } else {
+            out += std::get<std::vector<MemoryFile>>(source)[entry].path;
+        }
+    }
+};
+
+} // namespace detail
+
+namespace {
+
+/// Reads a loose file that must still have the size it had when mounted.
+[[nodiscard]] Result<void> read_loose(const std::filesystem::path& path, std::span<std::byte> out) {
+    std::ifstream in(path, std::ios::binary | std::ios::ate);
+    if (!in) {
+        return std::unexpected(std::make_error_code(std::errc::no_such_file_or_directory));
+    }
+    if (static_cast<std::uint64_t>(in.tellg()) != out.size()) {
+        return std::unexpected(std::make_error_code(std::errc::io_error));
+    }
+    in.seekg(0);
+    if (!in.read(reinterpret_cast<char*>(out.data()), static_cast<std::streamsize>(out.size()))) {
+        return std::unexpected(std::make_error_code(std::errc::io_error));
+    }
+    return {};
+}
+
+} // namespace
+
+Vfs::Vfs() {
+    m_tables.push_back(std::make_unique<const Table>());
+    m_table.store(m_tables.back().get(), std::memory_order_release);
+}
+
+Vfs::~Vfs() = default;
+
+Result<void> Vfs::insert(const Table& table, detail::MergedIndex& target, const detail::MergedIndex* below,
+                         std::size_t position, std::size_t& visible, std::string& path) {
+    const LayerId id = table.order[position];
+    const auto& layer = *table.layers[id];
+    return target.insert(
+        below, id, layer.hashes, [&](std::uint32_t entry) { return layer.is_tombstone(entry); },
+        [&](const detail::MergedIndex::Slot& previous, std::uint32_t entry) {
+            path.clear();
+            layer.append_path(entry, path);
+            return table.layers[previous.source & ~detail::MergedIndex::kHidden]->has_path(previous.entry, path);
+        },
+        visible);
+}
+
+Result<void> Vfs::rebuild(Table& table, std::size_t from) {
+    std::string path;
+    if (from < table.base_count) {
+        auto base = std::make_shared<detail::MergedIndex>();
+        std::size_t visible = 0;
+        for (std::size_t position = 0; position < from; ++position) {
+            if (auto inserted = insert(table, *base, nullptr, position, visible, path); !inserted) {
+                return inserted;
+            }
+        }
+        table.base = std::move(base);
+        table.base_count = from;
+        table.base_visible = visible;
+    }
+    table.overlay = {};
+    table.visible = table.base_visible;
+    for (auto position = table.base_count; position < table.order.size(); ++position) {
+        if (auto inserted = insert(table, table.overlay, table.base.get(), position, table.visible, path);
+            !inserted) {
+            return inserted;
+        }
+    }
+    return {};
+}
+
+void Vfs::fold(Table& table) {
+    if (detail::MergedIndex::fold(table.base, table.overlay)) {
+        table.base_count = table.order.size();
+        table.base_visible = table.visible;
+    }
+}
+
+void Vfs::publish(std::unique_ptr<Table> next) {
+    m_tables.push_back(std::move(next));
+    m_table.store(m_tables.back().get(), std::memory_order_release);
+}
+
+Result<LayerId> Vfs::add(std::shared_ptr<detail::VfsLayer> layer, const MountOptions& options) {
+    std::string_view mount_point = options.mount_point;
+    while (mount_point.ends_with('/')) {
+        mount_point.remove_suffix(1);
+    }
+    if (!mount_point.empty()) {
+        if (!ArchiveWriter::is_valid_path(mount_point)) {
+            return fail(Errc::invalid_path);
+        }
+        layer->mount_point = std::string(mount_point) + '/';
+    }
+    layer->priority = options.priority;
+
+    const auto* archive = std::get_if<Archive>(&layer->source);
+    if (archive != nullptr && layer->mount_point.empty()) {
+        // The archive's own path index already holds the hash of every path.
+        layer->hashes = detail::entry_hashes(*archive);
+    } else {
+        const std::size_t count = layer->entry_count();
+        layer->hashes.resize(count);
+        std::string path;
+        for (std::uint32_t entry = 0; entry < count; ++entry) {
+            path.clear();
+            layer->append_path(entry, path);
+            layer->hashes[entry] = hash_path(path);
+        }
+    }
+
+    std::lock_guard lock(m_mount_mutex);
+    const Table& current = table();
+    if (current.layers.size() >= detail::MergedIndex::kHidden) {
+        return fail(Errc::too_large);
+    }
+    const auto id = static_cast<LayerId>(current.layers.size());
+    layer->sequence = m_sequence++;
+
+    // Above every layer of lower or equal priority, all of them mounted
+    // earlier. Only the overlay is copied; the base is shared.
+    auto next = std::make_unique<Table>(current);
+    const auto above = std::ranges::upper_bound(next->order, layer->priority, {},
+                                                [&](LayerId other) { return next->layers[other]->priority; });
+    const auto position = static_cast<std::size_t>(above - next->order.begin());
+    next->layers.push_back(std::move(layer));
+    next->order.insert(above, id);
+    if (position + 1 == next->order.size()) {
+        std::string path;
+        if (auto inserted = insert(*next, next->overlay, next->base.get(), position, next->visible, path);
+            !inserted) {
+            return std::unexpected(inserted.error());
+        }
+    } else if (auto rebuilt = rebuild(*next, position); !rebuilt) {
+        return std::unexpected(rebuilt.error());
+    }
+    fold(*next);
+    publish(std::move(next));
+    return id;
+}
+
+Result<LayerId> Vfs::mount(Archive archive, const MountOptions& options) {
+    auto layer = std::make_shared<detail::VfsLayer>();
+    layer->source = std::move(archive);
+    return add(std::move(layer), options);
+}
+
+Result<LayerId> Vfs::mount(const std::filesystem::path& archive, const MountOptions& options) {
+    auto opened = Archive::open(archive);
+    if (!opened) {
+        return std::unexpected(opened.error());
+    }
+    return mount(std::move(*opened), options);
+}
+
+Result<LayerId> Vfs::mount_directory(const std::filesystem::path& directory, const MountOptions& options) {
+    std::error_code ec;
+    if (!std::filesystem::is_directory(directory, ec)) {
+        return std::unexpected(ec ? ec : std::make_error_code(std::errc::not_a_directory));
+    }
+    std::vector<std::pair<std::string, std::uint64_t>> files;
+    const auto flags = std::filesystem::directory_options::skip_permission_denied;
+    for (std::filesystem::recursive_directory_iterator it(directory, flags, ec), end; !ec && it != end;
+         it.increment(ec)) {
+        std::error_code file_ec;
+        if (!it->is_regular_file(file_ec)) {
+            continue;
+        }
+        auto path = it->path().lexically_relative(directory).generic_string();
+        const auto size = it->file_size(file_ec);
+        if (!file_ec && ArchiveWriter::is_valid_path(path)) {
+            files.emplace_back(std::move(path), size);
+        }
+    }
+    if (ec) {
+        return std::unexpected(ec);
+    }
+    std::sort(files.begin(), files.end());
+
+    detail::VfsLayer::Directory source;
+    source.root = directory;
+    source.paths.reserve(files.size());
+    source.sizes.reserve(files.size());
+    for (auto& [path, size] : files) {
+        source.paths.push_back(std::move(path));
+        source.sizes.push_back(size);
+    }
+    auto layer = std::make_shared<detail::VfsLayer>();
+    layer->source = std::move(source);
+    return add(std::move(layer), options);
+}
+
+Result<LayerId> Vfs::mount_memory(std::vector<MemoryFile> files, const MountOptions& options) {
+    for (const auto& file : files) {
+        if (!ArchiveWriter::is_valid_path(file.path)) {
+            return fail(Errc::invalid_path);
+        }
+    }
+    std::vector<std::string_view> paths(files.size());
+    std::transform(files.begin(), files.end(), paths.begin(),
+                   [](const MemoryFile& file) { return std::string_view(file.path); });
+    std::sort(paths.begin(), paths.end());
+    if (std::adjacent_find(paths.begin(), paths.end()) != paths.end()) {
+        return fail(Errc::duplicate_path);
+    }
+    auto layer = std::make_shared<detail::VfsLayer>();
+    layer->source = std::move(files);
+    return add(std::move(layer), options);
+}
+
+Result<void> Vfs::unmount(LayerId layer) {
+    std::lock_guard lock(m_mount_mutex);
+    const Table& current = table();
+    if (layer >= current.layers.size() || current.layers[layer] == nullptr) {
+        return std::unexpected(std::make_error_code(std::errc::invalid_argument));
+    }
+    auto next = std::make_unique<Table>(current);
+    next->layers[layer] = nullptr;
+    const auto position = std::ranges::find(next->order, layer);
+    const auto from = static_cast<std::size_t>(position - next->order.begin());
+    next->order.erase(position);
+    // Removing a layer cannot make two different paths meet in a slot.
+    static_cast<void>(rebuild(*next, from));
+    publish(std::move(next));
+    return {};
+}
+
+void Vfs::reclaim() {
+    std::lock_guard lock(m_mount_mutex);
+    m_tables.erase(m_tables.begin(), m_tables.end() - 1);
+}
+
+std::optional<VfsRef> Vfs::find(std::string_view path) const noexcept {
+    return find_hash(hash_path(path));
+}
+
+std::optional<VfsRef> Vfs::find_hash(std::uint64_t path_hash) const noexcept {
+    const Table& current = table();
+    const auto* slot = detail::lookup(current.overlay, *current.base, path_hash);
+    if (slot == nullptr || (slot->source & detail::MergedIndex::kHidden) != 0) {
+        return std::nullopt;
+    }
+    return VfsRef{slot->source, slot->entry};
+}
+
+std::string Vfs::path(VfsRef ref) const {
+    std::string path;
+    layer(ref).append_path(ref.entry, path);
+    return path;
+}
+
+std::uint64_t Vfs::size(VfsRef ref) const noexcept {
+    const auto& source = layer(ref).source;
+    if (const auto* archive = std::get_if<Archive>(&source)) {
+        return archive->size(ref.entry);
+    }
+    if (const auto* directory = std::get_if<detail::VfsLayer::Directory>(&source)) {
+        return directory->sizes[ref.entry];
+    }
+    return std::get<std::vector<MemoryFile>>(source)[ref.entry].data.size();
+}
+
+std::span<const std::byte> Vfs::data(VfsRef ref) const noexcept {
+    const auto& source = layer(ref).source;
+    if (const auto* archive = std::get_if<Archive>(&source)) {
+        return archive->data(ref.entry);
+    }
+    if (const auto* files = std::get_if<std::vector<MemoryFile>>(&source)) {
+        return (*files)[ref.entry].data;
+    }
+    return {};
+}
+
+Result<void> Vfs::read(VfsRef ref, std::span<std::byte> out, ThreadPool* pool) const {
+    const auto& source = layer(ref).source;
+    if (const auto* archive = std::get_if<Archive>(&source)) {
+        return archive->read(ref.entry, out, pool);
+    }
+    if (out.size() != size(ref)) {
+        return std::unexpected(std::make_error_code(std::errc::invalid_argument));
+    }
+    if (const auto* directory = std::get_if<detail::VfsLayer::Directory>(&source)) {
+        return read_loose(directory->root / directory->paths[ref.entry], out);
+    }
+    const auto& data = std::get<std::vector<MemoryFile>>(source)[ref.entry].data;
+    if (!data.empty()) {
+        std::memcpy(out.data(), data.data(), data.size());
+    }
+    return {};
+}
+
+} // namespace stockpile
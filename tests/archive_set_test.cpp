@@ -0,0 +1,216 @@
+#include "stockpile/archive_set.hpp"
+
+#include "stockpile/archive_writer.hpp"
+
+#include "test.hpp"
+
+#include <cstdint>
+#include <map>
+#include <optional>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace stockpile::test {
+namespace {
+
+/// Paths of a layer mapped to their entry's size, or to -1 for a tombstone.
+using Layer = std::map<std::string, int>;
+
+[[nodiscard]] std::string numbered(std::string prefix, std::uint64_t n) {
+    prefix += std::to_string(n);
+    return prefix;
+}
+
+[[nodiscard]] std::string path_of(std::uint64_t directory, std::uint64_t file) {
+    std::string path = "d";
+    path += std::to_string(directory);
+    path += "/f";
+    path += std::to_string(file);
+    return path;
+}
+
+/// Writes `layer` to `path` and opens it.
+[[nodiscard]] Archive make_archive(const std::filesystem::path& path, const Layer& layer) {
+    ArchiveWriter writer;
+    for (const auto& [name, size] : layer) {
+        const auto added = size < 0 ? writer.add_tombstone(name)
+                                    : writer.add(name, std::vector<std::byte>(static_cast<std::size_t>(size)));
+        STOCKPILE_CHECK(added);
+    }
+    STOCKPILE_CHECK(writer.write(path));
+    auto archive = Archive::open(path);
+    STOCKPILE_CHECK(archive);
+    return std::move(*archive);
+}
+
+/// Checks every lookup, the entry count and walk() of `set` against the
+/// mounted `layers`, bottom first, where unmounted ones are nullopt.
+void check_model(const ArchiveSet& set, const std::vector<std::optional<Layer>>& layers, std::uint64_t files) {
+    STOCKPILE_CHECK(set.archive_count() == layers.size());
+    std::size_t visible = 0;
+    for (std::uint64_t directory = 0; directory < 4; ++directory) {
+        for (std::uint64_t file = 0; file < files; ++file) {
+            const auto path = path_of(directory, file);
+            std::optional<std::uint32_t> top;
+            for (auto index = layers.size(); index-- > 0;) {
+                if (layers[index] && layers[index]->contains(path)) {
+                    top = static_cast<std::uint32_t>(index);
+                    break;
+                }
+            }
+            const auto ref = set.find(path);
+            if (!top || layers[*top]->at(path) < 0) {
+                STOCKPILE_CHECK(!ref);
+                continue;
+            }
+            ++visible;
+            STOCKPILE_CHECK(ref && ref->archive == *top);
+            STOCKPILE_CHECK(ref && set.size(*ref) == static_cast<std::uint64_t>(layers[*top]->at(path)));
+        }
+    }
+    STOCKPILE_CHECK(set.entry_count() == visible);
+    std::size_t walked = 0;
+    set.walk("", [&](EntryRef) { ++walked; });
+    STOCKPILE_CHECK(walked == visible);
+    for (std::uint32_t index = 0; index < layers.size(); ++index) {
+        STOCKPILE_CHECK(set.is_mounted(index) == layers[index].has_value());
+    }
+}
+
+void patches_shadow_and_hide() {
+    const TempDir dir;
+    ArchiveSet set;
+    STOCKPILE_CHECK(set.mount(make_archive(dir / "base.stk", {{"a", 1}, {"b", 2}, {"c", 3}})) == 0u);
+    STOCKPILE_CHECK(set.mount(make_archive(dir / "patch.stk", {{"b", 20}, {"c", -1}, {"d", 4}})) == 1u);
+    STOCKPILE_CHECK(set.find("a") == EntryRef{0, 0});
+    STOCKPILE_CHECK(set.size(*set.find("b")) == 20);
+    STOCKPILE_CHECK(!set.find("c"));
+    STOCKPILE_CHECK(set.entry_count() == 3);
+
+    // Unmounting the patch uncovers what it shadowed and hid.
+    STOCKPILE_CHECK(set.unmount(1));
+    STOCKPILE_CHECK(set.size(*set.find("b")) == 2);
+    STOCKPILE_CHECK(set.find("c") && !set.find("d"));
+    STOCKPILE_CHECK(set.entry_count() == 3);
+    const auto again = set.unmount(1);
+    STOCKPILE_CHECK(!again && again.error() == std::errc::invalid_argument);
+    STOCKPILE_CHECK(!set.unmount(7));
+    set.reclaim();
+    STOCKPILE_CHECK(set.find("a") == EntryRef{0, 0});
+}
+
+void replace_swaps_one_archive() {
+    const TempDir dir;
+    ArchiveSet set;
+    STOCKPILE_CHECK(set.mount(make_archive(dir / "base.stk", {{"a", 1}, {"b", 2}})));
+    auto overlay = set.mount(make_archive(dir / "overlay-0", {{"a", 10}}));
+    STOCKPILE_CHECK(overlay == 1u);
+    for (int i = 1; i <= 20; ++i) {
+        // Each overlay has a different file, so only the newest one's shows.
+        const auto name = dir / numbered("overlay-", static_cast<std::uint64_t>(i));
+        overlay = set.replace(*overlay, make_archive(name, {{"a", 10 + i}, {"b", -1}}));
+        STOCKPILE_CHECK(overlay == static_cast<std::uint32_t>(i + 1));
+        STOCKPILE_CHECK(set.size(*set.find("a")) == static_cast<std::uint64_t>(10 + i));
+        STOCKPILE_CHECK(!set.find("b") && set.entry_count() == 1);
+        set.reclaim();
+    }
+    std::size_t mounted = 0;
+    for (std::uint32_t index = 0; index < set.archive_count(); ++index) {
+        mounted += set.is_mounted(index) ? 1 : 0;
+    }
+    STOCKPILE_CHECK(mounted == 2);
+    STOCKPILE_CHECK(!set.replace(1, make_archive(dir / "stale", {{"a", 5}})));
+}
+
+/// A reader that found an entry just before a replacement or unmount keeps
+/// reading the old archive until reclaim().
+void stale_refs_stay_readable_until_reclaim() {
+    const TempDir dir;
+    ArchiveSet set;
+    STOCKPILE_CHECK(set.mount(make_archive(dir / "base.stk", {{"a", 1}, {"b", 2}})));
+    const auto overlay = set.mount(make_archive(dir / "overlay-0", {{"a", 10}}));
+    const auto patch = set.mount(make_archive(dir / "patch.stk", {{"b", 30}}));
+    const auto stale = set.find("a");
+    const auto unmounted = set.find("b");
+    STOCKPILE_CHECK(stale == EntryRef{*overlay, 0} && unmounted == EntryRef{*patch, 0});
+
+    const auto replacement = set.replace(*overlay, make_archive(dir / "overlay-1", {{"a", 20}}));
+    STOCKPILE_CHECK(replacement);
+    STOCKPILE_CHECK(set.unmount(*patch));
+    STOCKPILE_CHECK(!set.is_mounted(*overlay) && !set.is_mounted(*patch));
+    STOCKPILE_CHECK(set.find("a") == EntryRef{*replacement, 0});
+    STOCKPILE_CHECK(set.size(*set.find("b")) == 2);
+    STOCKPILE_CHECK(set.size(*stale) == 10 && set.data(*stale).size() == 10 && set.path(*stale) == "a");
+    std::vector<std::byte> out(10);
+    STOCKPILE_CHECK(set.read(*stale, out) && set.read_direct(*stale, out));
+    STOCKPILE_CHECK(set.size(*unmounted) == 30);
+
+    set.reclaim();
+    STOCKPILE_CHECK(!set.is_mounted(*overlay) && set.archive_count() == 4);
+    STOCKPILE_CHECK(set.size(*set.find("a")) == 20 && set.entry_count() == 2);
+    std::size_t walked = 0;
+    set.walk("", [&](EntryRef) { ++walked; });
+    STOCKPILE_CHECK(walked == 2);
+}
+
+/// Random mounts, unmounts and replacements of archives of up to 500
+/// entries, checked against the model after each step. Small patches stay
+/// in the overlay of the set's index, large ones fold it into the base.
+void matches_model_under_random_changes() {
+    const TempDir dir;
+    std::mt19937_64 engine(17);
+    const auto below = [&](std::uint64_t bound) { return engine() % bound; };
+    constexpr std::uint64_t kFiles = 600;
+    ArchiveSet set;
+    std::vector<std::optional<Layer>> layers;
+    for (int step = 0; step < 60; ++step) {
+        std::vector<std::uint32_t> mounted;
+        for (std::uint32_t index = 0; index < layers.size(); ++index) {
+            if (layers[index]) {
+                mounted.push_back(index);
+            }
+        }
+        const auto op = step == 0 ? 0 : below(10);
+        if (op >= 6 && op < 8 && !mounted.empty()) {
+            const auto index = mounted[below(mounted.size())];
+            STOCKPILE_CHECK(set.unmount(index));
+            layers[index].reset();
+        } else {
+            Layer layer;
+            const auto count = step == 0 ? 1500 : below(5) == 0 ? 500 : below(40) + 1;
+            for (std::uint64_t i = 0; i < count; ++i) {
+                const bool tombstone = step > 0 && below(4) == 0;
+                layer.emplace(path_of(below(4), below(kFiles)), tombstone ? -1 : static_cast<int>(below(50)));
+            }
+            auto archive = make_archive(dir / numbered("layer-", static_cast<std::uint64_t>(step)), layer);
+            Result<std::uint32_t> index;
+            if (op >= 8 && !mounted.empty()) {
+                const auto replaced = mounted[below(mounted.size())];
+                index = set.replace(replaced, std::move(archive));
+                layers[replaced].reset();
+            } else {
+                index = set.mount(std::move(archive));
+            }
+            STOCKPILE_CHECK(index == static_cast<std::uint32_t>(layers.size()));
+            layers.push_back(std::move(layer));
+        }
+        check_model(set, layers, kFiles);
+        if (step % 5 == 0) {
+            set.reclaim();
+        }
+    }
+}
+
+} // namespace
+} // namespace stockpile::test
+
+int main() {
+    using namespace stockpile::test;
+    return run({
+        {"patches_shadow_and_hide", patches_shadow_and_hide},
+        {"replace_swaps_one_archive", replace_swaps_one_archive},
+        {"stale_refs_stay_readable_until_reclaim", stale_refs_stay_readable_until_reclaim},
+        {"matches_model_under_random_changes", matches_model_under_random_changes},
+    });
+}
@@ -0,0 +1,547 @@
+#include "stockpile/archive.hpp"
+#include "stockpile/archive_writer.hpp"
+#include "stockpile/thread_pool.hpp"
+
+#include "test.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <optional>
+#include <random>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace stockpile::test {
+namespace {
+
+struct Sample {
+    std::string path;
+    std::vector<std::byte> data;
+    EntryOptions options;
+};
+
+[[nodiscard]] std::vector<Sample> samples() {
+    return {
+        {"readme.txt", {as_bytes("stockpile").begin(), as_bytes("stockpile").end()}, {}},
+        {"empty.bin", {}, {}},
+        {"textures/rock.dds", pattern(100'000, 1), {.codec = Codec::lz4, .block_size = 16 * 1024}},
+        {"textures/sand.dds", pattern(5'000, 2), {}},
+        {"sounds/ambient/wind.ogg", pattern(70'000, 3), {.codec = Codec::lz4}},
+    };
+}
+
+/// Writes samples() to `path`.
+void write_samples(const std::filesystem::path& path) {
+    ArchiveWriter writer;
+    for (const auto& sample : samples()) {
+        STOCKPILE_CHECK(writer.add(sample.path, sample.data, sample.options));
+    }
+    STOCKPILE_CHECK(writer.write(path));
+}
+
+[[nodiscard]] std::error_code open_error(const std::filesystem::path& path) {
+    const auto archive = Archive::open(path);
+    return archive ? std::error_code() : archive.error();
+}
+
+/// Byte offset within `bytes` of the section of `kind` in the section table.
+[[nodiscard]] std::optional<std::size_t> find_section(std::span<const std::byte> bytes, format::SectionKind kind) {
+    format::Header header;
+    std::memcpy(&header, bytes.data(), sizeof(header));
+    for (std::uint32_t i = 0; i < header.section_count; ++i) {
+        const std::size_t at = header.section_table_offset + i * sizeof(format::Section);
+        format::Section section;
+        std::memcpy(&section, bytes.data() + at, sizeof(section));
+        if (section.kind == kind) {
+            return at;
+        }
+    }
+    return std::nullopt;
+}
+
+/// Copies samples() with `edit` applied to the bytes, and returns why the
+/// copy does not open.
+template <typename Edit>
+[[nodiscard]] std::error_code open_edited(const TempDir& dir, Edit edit) {
+    write_samples(dir / "good.stk");
+    auto bytes = read_file(dir / "good.stk");
+    edit(bytes);
+    write_file(dir / "bad.stk", bytes);
+    return open_error(dir / "bad.stk");
+}
+
+template <typename T>
+void patch(std::vector<std::byte>& bytes, std::size_t offset, const T& value) {
+    std::memcpy(bytes.data() + offset, &value, sizeof(value));
+}
+
+template <typename T>
+[[nodiscard]] T peek(const std::vector<std::byte>& bytes, std::size_t offset) {
+    T value;
+    std::memcpy(&value, bytes.data() + offset, sizeof(value));
+    return value;
+}
+
+void round_trip() {
+    const TempDir dir;
+    write_samples(dir / "a.stk");
+    auto archive = Archive::open(dir / "a.stk");
+    STOCKPILE_CHECK(archive);
+    if (!archive) {
+        return;
+    }
+    STOCKPILE_CHECK(archive->entry_count() == samples().size());
+    for (const auto& sample : samples()) {
+        const auto id = archive->find(sample.path);
+        STOCKPILE_CHECK(id);
+        if (!id) {
+            continue;
+        }
+        STOCKPILE_CHECK(archive->path(*id) == sample.path);
+        STOCKPILE_CHECK(archive->has_path(*id, sample.path));
+        STOCKPILE_CHECK(archive->size(*id) == sample.data.size());
+        STOCKPILE_CHECK(archive->codec(*id) == sample.options.codec);
+        STOCKPILE_CHECK(!archive->is_tombstone(*id));
+
+        std::vector<std::byte> out(sample.data.size());
+        STOCKPILE_CHECK(archive->read(*id, out));
+        STOCKPILE_CHECK(out == sample.data);
+        std::ranges::fill(out, std::byte{0});
+        STOCKPILE_CHECK(archive->read_direct(*id, out));
+        STOCKPILE_CHECK(out == sample.data);
+        if (sample.options.codec == Codec::none) {
+            STOCKPILE_CHECK(std::ranges::equal(archive->data(*id), sample.data));
+        }
+    }
+    STOCKPILE_CHECK(!archive->find("textures"));
+    STOCKPILE_CHECK(!archive->find("textures/missing.dds"));
+    STOCKPILE_CHECK(!archive->find("TEXTURES/rock.dds"));
+}
+
+void read_range_of_compressed_entry() {
+    const TempDir dir;
+    write_samples(dir / "a.stk");
+    const auto archive = Archive::open(dir / "a.stk");
+    STOCKPILE_CHECK(archive);
+    if (!archive) {
+        return;
+    }
+    const auto id = archive->find("textures/rock.dds");
+    const auto expected = pattern(100'000, 1);
+    // Straddles the second and third 16 KiB blocks.
+    std::vector<std::byte> out(20'000);
+    STOCKPILE_CHECK(archive->read_range(*id, 20'000, out));
+    STOCKPILE_CHECK(std::ranges::equal(out, std::span(expected).subspan(20'000, out.size())));
+}
+
+void empty_archive() {
+    const TempDir dir;
+    STOCKPILE_CHECK(ArchiveWriter().write(dir / "empty.stk"));
+    const auto archive = Archive::open(dir / "empty.stk");
+    STOCKPILE_CHECK(archive && archive->entry_count() == 0 && !archive->find("a"));
+}
+
+/// Paths of a small tree, for walk() and glob().
+[[nodiscard]] std::vector<std::string> tree_paths() {
+    return {
+        "readme.txt",
+        "a.txt",
+        "b/b/b/b.ogg",
+        "ogg/x.ogg",
+        "sounds/ambient/wind.ogg",
+        "sounds/ambient/rain.ogg",
+        "sounds/ambient/deep/cave.ogg",
+        "sounds/ambient/deep/cave.wav",
+        "sounds/music/theme.ogg",
+        "sounds/ui/click.wav",
+        "textures/rock.dds",
+        "textures/sand.dds",
+        "textures/ui/button.png",
+        "textures/ui/icons/sword.png",
+    };
+}
+
+[[nodiscard]] Archive open_tree(const TempDir& dir) {
+    ArchiveWriter writer;
+    for (const auto& path : tree_paths()) {
+        STOCKPILE_CHECK(writer.add(path, as_bytes(path)));
+    }
+    STOCKPILE_CHECK(writer.write(dir / "tree.stk"));
+    auto archive = Archive::open(dir / "tree.stk");
+    STOCKPILE_CHECK(archive);
+    return std::move(*archive);
+}
+
+/// Paths of the entries walk() visits below `directory`, in its order.
+[[nodiscard]] std::vector<std::string> walked(const Archive& archive, std::string_view directory) {
+    std::vector<std::string> paths;
+    if (const auto id = archive.find_directory(directory)) {
+        archive.walk(*id, [&](EntryId entry) { paths.push_back(archive.path(entry)); });
+    }
+    return paths;
+}
+
+/// Reference for one glob component: '*' any run, '?' any one character.
+[[nodiscard]] bool matches_component(std::string_view pattern, std::string_view name) {
+    if (pattern.empty()) {
+        return name.empty();
+    }
+    if (pattern[0] == '*') {
+        for (std::size_t skip = 0; skip <= name.size(); ++skip) {
+            if (matches_component(pattern.substr(1), name.substr(skip))) {
+                return true;
+            }
+        }
+        return false;
+    }
+    return !name.empty() && (pattern[0] == '?' || pattern[0] == name[0]) &&
+           matches_component(pattern.substr(1), name.substr(1));
+}
+
+/// Reference for a whole pattern, split into components. "**" matches any
+/// number of directories; last, it matches any entry below them, so that
+/// "sounds/**" lists everything under "sounds".
+[[nodiscard]] bool matches(std::span<const std::string> pattern, std::span<const std::string> path) {
+    if (pattern.empty()) {
+        return path.empty();
+    }
+    if (pattern.size() == 1 && pattern[0] == "**") {
+        return !path.empty();
+    }
+    if (pattern[0] == "**") {
+        for (std::size_t skip = 0; skip <= path.size(); ++skip) {
+            if (matches(pattern.subspan(1), path.subspan(skip))) {
+                return true;
+            }
+        }
+        return false;
+    }
+    return !path.empty() && matches_component(pattern[0], path[0]) && matches(pattern.subspan(1), path.subspan(1));
+}
+
+[[nodiscard]] std::vector<std::string> components(std::string_view path) {
+    std::vector<std::string> parts;
+    for (std::size_t begin = 0;;) {
+        const auto end = path.find('/', begin);
+        parts.emplace_back(path.substr(begin, end - begin));
+        if (end == std::string_view::npos) {
+            return parts;
+        }
+        begin = end + 1;
+    }
+}
+
+void walks_directories() {
+    const TempDir dir;
+    const auto archive = open_tree(dir);
+    const auto root = archive.find_directory("");
+    STOCKPILE_CHECK(root && !archive.parent(*root));
+    std::vector<std::string_view> names;
+    for (const auto id : archive.subdirectories(*root)) {
+        names.push_back(archive.directory_name(id));
+        STOCKPILE_CHECK(archive.parent(id) == root);
+    }
+    STOCKPILE_CHECK(names == std::vector<std::string_view>{"b", "ogg", "sounds", "textures"});
+    names.clear();
+    for (const auto id : archive.entries(*root)) {
+        names.push_back(archive.name(id));
+    }
+    STOCKPILE_CHECK(names == std::vector<std::string_view>{"a.txt", "readme.txt"});
+
+    const auto ambient = archive.find_directory("sounds/ambient/");
+    STOCKPILE_CHECK(ambient && ambient == archive.find_directory("sounds/ambient"));
+    std::string path;
+    archive.append_directory_path(*ambient, path);
+    STOCKPILE_CHECK(path == "sounds/ambient" && archive.directory_name(*ambient) == "ambient");
+    STOCKPILE_CHECK(!archive.find_directory("sounds/amb") && !archive.find_directory("readme.txt"));
+    STOCKPILE_CHECK(!archive.find_directory("nope/sounds"));
+
+    // A directory's own entries, then each subdirectory's, in name order.
+    STOCKPILE_CHECK(walked(archive, "sounds") ==
+                    std::vector<std::string>{"sounds/ambient/rain.ogg", "sounds/ambient/wind.ogg",
+                                             "sounds/ambient/deep/cave.ogg", "sounds/ambient/deep/cave.wav",
+                                             "sounds/music/theme.ogg", "sounds/ui/click.wav"});
+    auto all = walked(archive, "");
+    STOCKPILE_CHECK(all.size() == tree_paths().size() && all[0] == "a.txt" && all[1] == "readme.txt");
+    std::ranges::sort(all);
+    auto expected = tree_paths();
+    std::ranges::sort(expected);
+    STOCKPILE_CHECK(all == expected);
+}
+
+void globs_paths() {
+    const TempDir dir;
+    const auto archive = open_tree(dir);
+    const auto all = walked(archive, "");
+    for (const std::string_view pattern :
+         {"**", "*", "*.txt", "?.txt", "??.txt", "readme.txt", "sounds", "sounds/**", "sounds/*/*.ogg",
+          "sounds/ambient/*.ogg", "sounds/**/*.ogg", "**/*.ogg", "**/**/*.ogg", "**/ui/*", "**/deep/**",
+          "*/*/deep/*", "b/**/b/b.ogg", "b/**/b.ogg", "**/b", "s*s/**/c*", "textures/ui/**/*.png",
+          "sounds/ambient/deep/cave.???", "*/**", "ogg/**/*.ogg", "nope/**", "sounds/ambient/deep/**/**"}) {
+        const auto parts = components(pattern);
+        std::vector<std::string> expected;
+        for (const auto& path : all) {
+            if (matches(parts, components(path))) {
+                expected.push_back(path);
+            }
+        }
+        std::vector<std::string> found;
+        archive.glob(pattern, [&](EntryId id) { found.push_back(archive.path(id)); });
+        check(found == expected, std::string(pattern).c_str(), __FILE__, __LINE__);
+    }
+}
+
+/// The pipelined write() must produce the same file with or without a pool,
+/// whatever the pool's size, with duplicate payloads shared by the first
+/// entry that has them and compressed entries that do not shrink stored raw.
+void writes_the_same_bytes_with_any_pool() {
+    const TempDir dir;
+    std::mt19937 engine(5);
+    std::vector<std::byte> noise(300'000);
+    std::ranges::generate(noise, [&] { return static_cast<std::byte>(engine()); });
+    write_file(dir / "loose.bin", pattern(40'000, 9));
+
+    ArchiveWriter writer;
+    for (unsigned i = 0; i < 300; ++i) {
+        std::string path = "dir";
+        path += std::to_string(i % 7);
+        path += "/entry";
+        path += std::to_string(i);
+        const EntryOptions lz4{.codec = Codec::lz4, .block_size = i % 2 == 0 ? 4096u : 64u * 1024};
+        Result<void> added;
+        switch (i % 6) {
+        case 0:
+            // Duplicates of one another, raw and compressed.
+            added = writer.add(path, pattern(30'000, i % 4), i % 12 == 0 ? EntryOptions{} : lz4);
+            break;
+        case 1:
+            added = writer.add(path, pattern(i * 997, i), lz4);
+            break;
+        case 2:
+            // Does not shrink: stored raw.
+            added = writer.add(path, std::span(noise).first(i * 1000), lz4);
+            break;
+        case 3:
+            // The same payload as the loose file.
+            added = i % 4 == 1 ? writer.add_file(path, dir / "loose.bin", lz4)
+                               : writer.add(path, pattern(40'000, 9), lz4);
+            break;
+        case 4:
+            added = writer.add_tombstone(path);
+            break;
+        default:
+            added = writer.add(path, std::span(noise).subspan(i, i % 5 == 0 ? 0 : i));
+            break;
+        }
+        STOCKPILE_CHECK(added);
+    }
+    // Many blocks, compressed in parallel.
+    STOCKPILE_CHECK(writer.add("big.bin", pattern(8 << 20, 3), {.codec = Codec::lz4, .block_size = 64 * 1024}));
+
+    STOCKPILE_CHECK(writer.write(dir / "serial.stk"));
+    const auto expected = read_file(dir / "serial.stk");
+    for (const std::size_t threads : {1, 3, 8}) {
+        ThreadPool pool(threads);
+        STOCKPILE_CHECK(writer.write(dir / "pooled.stk", &pool));
+        STOCKPILE_CHECK(read_file(dir / "pooled.stk") == expected);
+    }
+
+    const auto archive = Archive::open(dir / "serial.stk");
+    STOCKPILE_CHECK(archive);
+    const auto first = archive->find("dir6/entry6");
+    const auto copy = archive->find("dir0/entry42");
+    STOCKPILE_CHECK(first && copy && archive->offset(*first) == archive->offset(*copy));
+    const auto loose = archive->find("dir3/entry3");
+    const auto same = archive->find("dir2/entry9");
+    STOCKPILE_CHECK(loose && same && archive->offset(*loose) == archive->offset(*same));
+    const auto raw = archive->find("dir2/entry2");
+    STOCKPILE_CHECK(raw && archive->data(*raw).size() >= 2000);
+    std::vector<std::byte> out(40'000);
+    STOCKPILE_CHECK(archive->read(*loose, out) && out == pattern(40'000, 9));
+}
+
+void rejects_invalid_and_duplicate_paths() {
+    ArchiveWriter writer;
+    for (const std::string_view path : {"", "/abs", "a//b", "a/./b", "../a", "a/", "a\\b"}) {
+        const auto added = writer.add(path, {});
+        STOCKPILE_CHECK(!added && added.error() == Errc::invalid_path);
+    }
+
+    // Duplicates are found when the directory tree is built.
+    const TempDir dir;
+    STOCKPILE_CHECK(writer.add("a/b", {}));
+    STOCKPILE_CHECK(writer.add("a/b", {}));
+    const auto written = writer.write(dir / "dup.stk");
+    STOCKPILE_CHECK(!written && written.error() == Errc::duplicate_path);
+}
+
+void rejects_missing_and_foreign_files() {
+    const TempDir dir;
+    STOCKPILE_CHECK(open_error(dir / "missing.stk") == std::errc::no_such_file_or_directory);
+    write_file(dir / "short.stk", as_bytes("STKPILE"));
+    STOCKPILE_CHECK(open_error(dir / "short.stk") == Errc::bad_magic);
+    write_file(dir / "text.stk", pattern(4096));
+    STOCKPILE_CHECK(open_error(dir / "text.stk") == Errc::bad_magic);
+}
+
+void rejects_damaged_header() {
+    const TempDir dir;
+    STOCKPILE_CHECK(open_edited(dir, [](auto& bytes) { bytes[0] ^= std::byte{1}; }) == Errc::bad_magic);
+    STOCKPILE_CHECK(open_edited(dir, [](auto& bytes) {
+                        patch(bytes, offsetof(format::Header, version), format::kVersion + 1);
+                    }) == Errc::unsupported_version);
+    STOCKPILE_CHECK(open_edited(dir, [](auto& bytes) {
+                        patch(bytes, offsetof(format::Header, file_size), std::uint64_t{bytes.size() + 1});
+                    }) == Errc::corrupt_archive);
+    STOCKPILE_CHECK(open_edited(dir, [](auto& bytes) {
+                        patch(bytes, offsetof(format::Header, section_table_offset), std::uint64_t{bytes.size()});
+                    }) == Errc::corrupt_archive);
+    STOCKPILE_CHECK(open_edited(dir, [](auto& bytes) {
+                        patch(bytes, offsetof(format::Header, section_count), std::uint32_t{1'000'000});
+                    }) == Errc::corrupt_archive);
+}
+
+void rejects_truncated_files() {
+    const TempDir dir;
+    write_samples(dir / "good.stk");
+    const auto bytes = read_file(dir / "good.stk");
+    for (const std::size_t size : {std::size_t{0}, sizeof(format::Header) - 1, sizeof(format::Header),
+                                   bytes.size() / 2, bytes.size() - 1}) {
+        write_file(dir / "cut.stk", std::span(bytes).first(size));
+        const auto error = open_error(dir / "cut.stk");
+        STOCKPILE_CHECK(error == (size < sizeof(format::Header) ? Errc::bad_magic : Errc::corrupt_archive));
+    }
+}
+
+void rejects_damaged_sections() {
+    const TempDir dir;
+    // A section reaching past the end of the file.
+    STOCKPILE_CHECK(open_edited(dir, [](auto& bytes) {
+                        const auto at = *find_section(bytes, format::SectionKind::names);
+                        patch(bytes, at + offsetof(format::Section, size), std::uint64_t{bytes.size()});
+                    }) == Errc::corrupt_archive);
+    // No entries section at all.
+    STOCKPILE_CHECK(open_edited(dir, [](auto& bytes) {
+                        const auto at = *find_section(bytes, format::SectionKind::entries);
+                        patch(bytes, at + offsetof(format::Section, kind), std::uint32_t{99});
+                    }) == Errc::corrupt_archive);
+    // An entry whose payload runs past the end of the file.
+    STOCKPILE_CHECK(open_edited(dir, [](auto& bytes) {
+                        const auto at = *find_section(bytes, format::SectionKind::entries);
+                        const auto entries = peek<std::uint64_t>(bytes, at + offsetof(format::Section, offset));
+                        patch(bytes, entries + offsetof(format::EntryRecord, size), std::uint64_t{bytes.size()});
+                    }) == Errc::corrupt_archive);
+    // An entry in a directory that does not exist.
+    STOCKPILE_CHECK(open_edited(dir, [](auto& bytes) {
+                        const auto at = *find_section(bytes, format::SectionKind::entries);
+                        const auto entries = peek<std::uint64_t>(bytes, at + offsetof(format::Section, offset));
+                        patch(bytes, entries + offsetof(format::EntryRecord, directory), std::uint32_t{1000});
+                    }) == Errc::corrupt_archive);
+}
+
+/// Calls `fn` with the offset of the entry field of each path index slot,
+/// in order, until it returns false.
+template <typename Fn>
+void for_each_slot(const std::vector<std::byte>& bytes, Fn fn) {
+    const auto at = *find_section(bytes, format::SectionKind::path_index);
+    const auto offset = peek<std::uint64_t>(bytes, at + offsetof(format::Section, offset));
+    const auto size = peek<std::uint64_t>(bytes, at + offsetof(format::Section, size));
+    for (auto slot = offset; slot < offset + size; slot += sizeof(format::HashSlot)) {
+        if (!fn(static_cast<std::size_t>(slot + offsetof(format::HashSlot, entry)))) {
+            return;
+        }
+    }
+}
+
+void rejects_damaged_path_index() {
+    const TempDir dir;
+    // Not a power of two.
+    STOCKPILE_CHECK(open_edited(dir, [](auto& bytes) {
+                        const auto at = *find_section(bytes, format::SectionKind::path_index);
+                        const auto size = peek<std::uint64_t>(bytes, at + offsetof(format::Section, size));
+                        patch(bytes, at + offsetof(format::Section, size), size - sizeof(format::HashSlot));
+                    }) == Errc::corrupt_archive);
+    // A slot naming an entry that does not exist.
+    STOCKPILE_CHECK(open_edited(dir, [](auto& bytes) {
+                        for_each_slot(bytes, [&](std::size_t entry) {
+                            if (peek<std::uint32_t>(bytes, entry) == format::kEmptySlot) {
+                                return true;
+                            }
+                            patch(bytes, entry, std::uint32_t{1000});
+                            return false;
+                        });
+                    }) == Errc::corrupt_archive);
+    // Every slot naming entry 0 leaves none empty to end a probe.
+    STOCKPILE_CHECK(open_edited(dir, [](auto& bytes) {
+                        for_each_slot(bytes, [&](std::size_t entry) {
+                            patch(bytes, entry, std::uint32_t{0});
+                            return true;
+                        });
+                    }) == Errc::corrupt_archive);
+    // An entry in two slots, and one in none.
+    STOCKPILE_CHECK(open_edited(dir, [](auto& bytes) {
+                        std::optional<std::uint32_t> first;
+                        for_each_slot(bytes, [&](std::size_t entry) {
+                            const auto id = peek<std::uint32_t>(bytes, entry);
+                            if (id == format::kEmptySlot) {
+                                return true;
+                            }
+                            if (!first) {
+                                first = id;
+                                return true;
+                            }
+                            patch(bytes, entry, *first);
+                            return false;
+                        });
+                    }) == Errc::corrupt_archive);
+    // An entry missing from the index.
+    STOCKPILE_CHECK(open_edited(dir, [](auto& bytes) {
+                        for_each_slot(bytes, [&](std::size_t entry) {
+                            if (peek<std::uint32_t>(bytes, entry) == format::kEmptySlot) {
+                                return true;
+                            }
+                            patch(bytes, entry, format::kEmptySlot);
+                            return false;
+                        });
+                    }) == Errc::corrupt_archive);
+    // No path index at all.
+    STOCKPILE_CHECK(open_edited(dir, [](auto& bytes) {
+                        const auto at = *find_section(bytes, format::SectionKind::path_index);
+                        patch(bytes, at + offsetof(format::Section, kind), std::uint32_t{99});
+                    }) == Errc::corrupt_archive);
+}
+
+void rejects_damaged_directories() {
+    const TempDir dir;
+    STOCKPILE_CHECK(open_edited(dir, [](auto& bytes) {
+                        const auto at = *find_section(bytes, format::SectionKind::directories);
+                        const auto records = peek<std::uint64_t>(bytes, at + offsetof(format::Section, offset));
+                        // The root's parent must be kNoDirectory.
+                        patch(bytes, records + offsetof(format::DirectoryRecord, parent), std::uint32_t{0});
+                    }) == Errc::corrupt_archive);
+}
+
+} // namespace
+} // namespace stockpile::test
+
+int main() {
+    using namespace stockpile::test;
+    return run({
+        {"round_trip", round_trip},
+        {"read_range_of_compressed_entry", read_range_of_compressed_entry},
+        {"empty_archive", empty_archive},
+        {"writes_the_same_bytes_with_any_pool", writes_the_same_bytes_with_any_pool},
+        {"walks_directories", walks_directories},
+        {"globs_paths", globs_paths},
+        {"rejects_invalid_and_duplicate_paths", rejects_invalid_and_duplicate_paths},
+        {"rejects_missing_and_foreign_files", rejects_missing_and_foreign_files},
+        {"rejects_damaged_header", rejects_damaged_header},
+        {"rejects_truncated_files", rejects_truncated_files},
+        {"rejects_damaged_sections", rejects_damaged_sections},
+        {"rejects_damaged_path_index", rejects_damaged_path_index},
+        {"rejects_damaged_directories", rejects_damaged_directories},
+    });
+}
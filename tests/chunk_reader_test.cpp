@@ -0,0 +1,199 @@
+#include "stockpile/chunk_reader.hpp"
+
+#include "stockpile/archive_set.hpp"
+#include "stockpile/archive_writer.hpp"
+
+#include "test.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <random>
+#include <set>
+#include <span>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace stockpile::test {
+namespace {
+
+constexpr std::uint32_t kBlockSize = 16 * 1024;
+
+/// Compressible runs with blocks of noise between them, which the writer
+/// stores raw.
+[[nodiscard]] std::vector<std::byte> mixed(std::size_t size) {
+    auto bytes = pattern(size, 4);
+    std::mt19937 engine(8);
+    for (std::size_t block = 1; block * kBlockSize < size; block += 3) {
+        const auto begin = block * kBlockSize;
+        const auto noise = std::span(bytes).subspan(begin, std::min<std::size_t>(kBlockSize, size - begin));
+        std::ranges::generate(noise, [&] { return static_cast<std::byte>(engine()); });
+    }
+    return bytes;
+}
+
+/// Writes `data` as entry "raw" and as entry "lz4", compressed in blocks of
+/// kBlockSize, plus an empty entry, and opens the archive.
+[[nodiscard]] Archive make_archive(const std::filesystem::path& path, const std::vector<std::byte>& data) {
+    ArchiveWriter writer;
+    STOCKPILE_CHECK(writer.add("raw", data));
+    STOCKPILE_CHECK(writer.add("lz4", data, {.codec = Codec::lz4, .block_size = kBlockSize}));
+    STOCKPILE_CHECK(writer.add("empty", {}));
+    STOCKPILE_CHECK(writer.write(path));
+    auto archive = Archive::open(path);
+    STOCKPILE_CHECK(archive);
+    return std::move(*archive);
+}
+
+/// Reads every chunk, checking that they follow one another, and returns
+/// their bytes.
+[[nodiscard]] std::vector<std::byte> drain(ChunkReader& reader) {
+    std::vector<std::byte> bytes;
+    for (;;) {
+        const auto chunk = reader.next();
+        STOCKPILE_CHECK(chunk);
+        if (!chunk || !*chunk) {
+            return bytes;
+        }
+        STOCKPILE_CHECK((*chunk)->offset == bytes.size() && !(*chunk)->data.empty());
+        STOCKPILE_CHECK((*chunk)->data.size() == reader.chunk_size() ||
+                        bytes.size() + (*chunk)->data.size() == reader.size());
+        bytes.insert(bytes.end(), (*chunk)->data.begin(), (*chunk)->data.end());
+    }
+}
+
+void reads_entries_in_chunks() {
+    const TempDir dir;
+    const auto data = mixed(1'000'003);
+    const auto archive = make_archive(dir / "a.stk", data);
+    STOCKPILE_CHECK(archive.block_size(*archive.find("lz4")) == kBlockSize);
+    for (const char* path : {"raw", "lz4"}) {
+        for (const std::size_t chunk_size : {std::size_t{1000}, std::size_t{50'000}, std::size_t{1} << 20}) {
+            auto reader = ChunkReader::open(archive, *archive.find(path), {.chunk_size = chunk_size, .depth = 3});
+            STOCKPILE_CHECK(reader && reader->size() == data.size());
+            STOCKPILE_CHECK(drain(*reader) == data);
+            // Stays at the end.
+            STOCKPILE_CHECK(reader->next() && !*reader->next());
+        }
+    }
+
+    // Chunks of a compressed entry hold whole blocks, at least one.
+    const auto lz4 = *archive.find("lz4");
+    STOCKPILE_CHECK(ChunkReader::open(archive, lz4, {.chunk_size = 1000})->chunk_size() == kBlockSize);
+    STOCKPILE_CHECK(ChunkReader::open(archive, lz4, {.chunk_size = 50'000})->chunk_size() == 3 * kBlockSize);
+    STOCKPILE_CHECK(ChunkReader::open(archive, *archive.find("raw"), {.chunk_size = 1000})->chunk_size() == 1000);
+
+    ArchiveSet set;
+    STOCKPILE_CHECK(set.mount(make_archive(dir / "b.stk", data)));
+    auto from_set = ChunkReader::open(set, *set.find("lz4"));
+    STOCKPILE_CHECK(from_set && drain(*from_set) == data);
+}
+
+/// read() copies across chunk boundaries, and next() carries on after it.
+void reads_records_across_chunks() {
+    const TempDir dir;
+    const auto data = mixed(300'000);
+    const auto archive = make_archive(dir / "a.stk", data);
+    for (const char* path : {"raw", "lz4"}) {
+        auto reader = ChunkReader::open(archive, *archive.find(path), {.chunk_size = kBlockSize, .depth = 2});
+        STOCKPILE_CHECK(reader);
+        std::vector<std::byte> header(10);
+        STOCKPILE_CHECK(reader->read(header) == 10 && std::ranges::equal(header, std::span(data).first(10)));
+        const auto rest = reader->next();
+        STOCKPILE_CHECK(rest && *rest && (*rest)->offset == 10 && (*rest)->data.size() == kBlockSize - 10);
+        STOCKPILE_CHECK(std::ranges::equal((*rest)->data, std::span(data).subspan(10, kBlockSize - 10)));
+
+        // Several chunks in one piece.
+        std::vector<std::byte> record(100'000);
+        STOCKPILE_CHECK(reader->read(record) == record.size());
+        STOCKPILE_CHECK(std::ranges::equal(record, std::span(data).subspan(kBlockSize, record.size())));
+
+        // Short at the end of the entry.
+        std::vector<std::byte> tail(data.size());
+        const auto offset = kBlockSize + record.size();
+        STOCKPILE_CHECK(reader->read(tail) == data.size() - offset);
+        STOCKPILE_CHECK(std::ranges::equal(std::span(tail).first(data.size() - offset),
+                                           std::span(data).subspan(offset)));
+        STOCKPILE_CHECK(reader->read(tail) == 0 && !*reader->next());
+    }
+}
+
+/// The reader decodes into `depth` buffers and no more, and waits for the
+/// consumer before reusing one: a chunk held while the reader runs ahead
+/// keeps its bytes.
+void bounds_the_ring() {
+    const TempDir dir;
+    const auto data = mixed(40 * kBlockSize + 5);
+    const auto archive = make_archive(dir / "a.stk", data);
+    for (const std::size_t depth : {1, 2, 4}) {
+        auto reader = ChunkReader::open(archive, *archive.find("lz4"), {.chunk_size = kBlockSize, .depth = depth});
+        STOCKPILE_CHECK(reader);
+        std::set<const std::byte*> buffers;
+        for (;;) {
+            const auto chunk = reader->next();
+            STOCKPILE_CHECK(chunk);
+            if (!chunk || !*chunk) {
+                break;
+            }
+            buffers.insert((*chunk)->data.data());
+            if ((*chunk)->offset % (8 * kBlockSize) == 0) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            }
+            const auto expected = std::span(data).subspan((*chunk)->offset, (*chunk)->data.size());
+            STOCKPILE_CHECK(std::ranges::equal((*chunk)->data, expected));
+        }
+        STOCKPILE_CHECK(buffers.size() == depth);
+    }
+
+    // Dropping a reader mid-entry stops its thread, however far ahead it is.
+    for (const std::size_t depth : {1, 8}) {
+        auto reader = ChunkReader::open(archive, *archive.find("lz4"), {.chunk_size = kBlockSize, .depth = depth});
+        STOCKPILE_CHECK(reader && reader->next());
+        ChunkReader moved = std::move(*reader);
+        STOCKPILE_CHECK(moved.next() && (*moved.next())->offset == 2 * kBlockSize);
+    }
+}
+
+void handles_edge_cases() {
+    const TempDir dir;
+    const auto data = mixed(100'000);
+    const auto archive = make_archive(dir / "a.stk", data);
+    const auto lz4 = *archive.find("lz4");
+    STOCKPILE_CHECK(ChunkReader::open(archive, lz4, {.chunk_size = 0}).error() == std::errc::invalid_argument);
+    STOCKPILE_CHECK(ChunkReader::open(archive, lz4, {.depth = 0}).error() == std::errc::invalid_argument);
+
+    auto empty = ChunkReader::open(archive, *archive.find("empty"));
+    STOCKPILE_CHECK(empty && empty->size() == 0 && empty->next() && !*empty->next());
+    std::vector<std::byte> out(4);
+    STOCKPILE_CHECK(empty->read(out) == 0);
+
+    // A block table pointing past the stored blocks fails the chunk holding
+    // that block, after the chunks before it.
+    auto bytes = read_file(dir / "a.stk");
+    const std::uint64_t end = archive.data(lz4).size() + 1;
+    std::memcpy(bytes.data() + archive.offset(lz4) + 3 * sizeof(std::uint64_t), &end, sizeof(end));
+    write_file(dir / "bad.stk", bytes);
+    const auto bad = Archive::open(dir / "bad.stk");
+    STOCKPILE_CHECK(bad);
+    auto reader = ChunkReader::open(*bad, lz4, {.chunk_size = 2 * kBlockSize});
+    STOCKPILE_CHECK(reader);
+    const auto first = reader->next();
+    STOCKPILE_CHECK(first && *first && std::ranges::equal((*first)->data, std::span(data).first(2 * kBlockSize)));
+    STOCKPILE_CHECK(reader->next().error() == Errc::corrupt_archive);
+}
+
+} // namespace
+} // namespace stockpile::test
+
+int main() {
+    using namespace stockpile::test;
+    return run({
+        {"reads_entries_in_chunks", reads_entries_in_chunks},
+        {"reads_records_across_chunks", reads_records_across_chunks},
+        {"bounds_the_ring", bounds_the_ring},
+        {"handles_edge_cases", handles_edge_cases},
+    });
+}
@@ -0,0 +1,156 @@
+#include "stockpile/entry_cache.hpp"
+
+#include "stockpile/archive_set.hpp"
+#include "stockpile/archive_writer.hpp"
+
+#include "test.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace stockpile::test {
+namespace {
+
+constexpr std::size_t kEntrySize = 1000;
+
+/// Zero-padded, so that entry i of an archive is the one written i-th.
+[[nodiscard]] std::string entry_path(std::uint32_t i) {
+    std::string path = std::to_string(1000 + i);
+    path[0] = 'e';
+    return path;
+}
+
+/// Writes `count` entries of kEntrySize bytes, every other one compressed,
+/// whose contents depend on `seed`, and opens them.
+[[nodiscard]] Archive make_archive(const std::filesystem::path& path, std::uint32_t count, unsigned seed = 0) {
+    ArchiveWriter writer;
+    for (std::uint32_t i = 0; i < count; ++i) {
+        const EntryOptions options{.codec = i % 2 == 0 ? Codec::lz4 : Codec::none};
+        STOCKPILE_CHECK(writer.add(entry_path(i), pattern(kEntrySize, seed + i), options));
+    }
+    STOCKPILE_CHECK(writer.write(path));
+    auto archive = Archive::open(path);
+    STOCKPILE_CHECK(archive);
+    return std::move(*archive);
+}
+
+[[nodiscard]] bool holds(const Result<CacheHandle>& handle, const std::vector<std::byte>& expected) {
+    return handle && std::ranges::equal(handle->bytes(), expected);
+}
+
+void decodes_and_counts() {
+    const TempDir dir;
+    const auto archive = make_archive(dir / "a.stk", 4);
+    EntryCache cache(1 << 20, 4);
+    STOCKPILE_CHECK(!cache.find(archive, 0));
+    for (int pass = 0; pass < 3; ++pass) {
+        for (EntryId id = 0; id < 4; ++id) {
+            STOCKPILE_CHECK(holds(cache.get(archive, id), pattern(kEntrySize, id)));
+        }
+    }
+    // The find() miss, the first pass's misses, then hits.
+    auto stats = cache.stats();
+    STOCKPILE_CHECK(stats.misses == 5 && stats.hits == 8 && stats.evictions == 0);
+    STOCKPILE_CHECK(stats.entries == 4 && stats.bytes == 4 * kEntrySize);
+
+    // Handles outlive the cache's copy.
+    const auto kept = cache.find(archive, 1);
+    cache.erase(archive);
+    STOCKPILE_CHECK(!cache.find(archive, 1) && std::ranges::equal(kept.bytes(), pattern(kEntrySize, 1)));
+    STOCKPILE_CHECK(cache.stats().entries == 0);
+    cache.clear();
+    stats = cache.stats();
+    STOCKPILE_CHECK(stats.hits == 0 && stats.misses == 0 && stats.bytes == 0);
+}
+
+void stays_within_budget() {
+    const TempDir dir;
+    const auto archive = make_archive(dir / "a.stk", 64);
+    EntryCache cache(8 * kEntrySize, 1);
+    for (EntryId id = 0; id < 64; ++id) {
+        STOCKPILE_CHECK(holds(cache.get(archive, id), pattern(kEntrySize, id)));
+        STOCKPILE_CHECK(cache.stats().bytes <= cache.byte_budget());
+    }
+    const auto stats = cache.stats();
+    STOCKPILE_CHECK(stats.entries == 8 && stats.evictions == 56);
+
+    // Larger than the budget: returned, but not kept.
+    EntryCache small(kEntrySize - 1, 1);
+    STOCKPILE_CHECK(holds(small.get(archive, 3), pattern(kEntrySize, 3)));
+    STOCKPILE_CHECK(!small.find(archive, 3) && small.stats().bytes == 0);
+}
+
+void promotes_entries_requested_again() {
+    const TempDir dir;
+    const auto archive = make_archive(dir / "a.stk", 200);
+    EntryCache cache(8 * kEntrySize, 1);
+    // Entry 0 falls out of the FIFO of new entries, and a request for it
+    // while its key is remembered promotes it to the LRU list.
+    for (EntryId id = 0; id < 9; ++id) {
+        STOCKPILE_CHECK(cache.get(archive, id));
+    }
+    STOCKPILE_CHECK(!cache.find(archive, 0));
+    STOCKPILE_CHECK(holds(cache.get(archive, 0), pattern(kEntrySize, 0)));
+
+    // A scan over many entries seen once does not flush it.
+    for (EntryId id = 9; id < 200; ++id) {
+        STOCKPILE_CHECK(cache.get(archive, id));
+    }
+    STOCKPILE_CHECK(holds(cache.get(archive, 0), pattern(kEntrySize, 0)));
+    STOCKPILE_CHECK(cache.find(archive, 0));
+    STOCKPILE_CHECK(!cache.find(archive, 9));
+    STOCKPILE_CHECK(cache.stats().bytes <= cache.byte_budget());
+}
+
+void follows_moved_archives() {
+    const TempDir dir;
+    auto archive = make_archive(dir / "a.stk", 2);
+    EntryCache cache(1 << 20);
+    STOCKPILE_CHECK(cache.get(archive, 1));
+    const Archive moved = std::move(archive);
+    STOCKPILE_CHECK(holds(cache.get(moved, 1), pattern(kEntrySize, 1)) && cache.stats().hits == 1);
+}
+
+/// A hot reload replaces the overlay and reclaim() frees it, so the next
+/// overlay may well be opened at the same address; the cache must not
+/// return the old overlay's bytes for it.
+void never_serves_a_replaced_archive() {
+    const TempDir dir;
+    ArchiveSet set;
+    auto overlay = set.mount(make_archive(dir / "overlay-0", 1, 0));
+    EntryCache cache(1 << 20);
+    for (unsigned reload = 0; reload < 8; ++reload) {
+        const auto ref = set.find(entry_path(0));
+        STOCKPILE_CHECK(holds(cache.get(set, *ref), pattern(kEntrySize, reload * 100)));
+
+        std::string name = "overlay-";
+        name += std::to_string(reload + 1);
+        overlay = set.replace(*overlay, make_archive(dir / name, 1, (reload + 1) * 100));
+        STOCKPILE_CHECK(overlay);
+        set.reclaim();
+    }
+
+    // The same holds for archives opened one after the other.
+    for (unsigned seed = 1; seed <= 4; ++seed) {
+        const auto archive = make_archive(dir / "again.stk", 1, seed);
+        STOCKPILE_CHECK(holds(cache.get(archive, 0), pattern(kEntrySize, seed)));
+    }
+}
+
+} // namespace
+} // namespace stockpile::test
+
+int main() {
+    using namespace stockpile::test;
+    return run({
+        {"decodes_and_counts", decodes_and_counts},
+        {"stays_within_budget", stays_within_budget},
+        {"promotes_entries_requested_again", promotes_entries_requested_again},
+        {"follows_moved_archives", follows_moved_archives},
+        {"never_serves_a_replaced_archive", never_serves_a_replaced_archive},
+    });
+}
@@ -0,0 +1,159 @@
+#include "stockpile/handle_table.hpp"
+
+#include "stockpile/archive_writer.hpp"
+
+#include "test.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace stockpile::test {
+namespace {
+
+struct Texture;
+
+/// Paths mapped to the size of their entry, whose bytes are pattern(size,
+/// size), or to -1 for a tombstone.
+using Files = std::map<std::string, int>;
+
+[[nodiscard]] Archive make_archive(const std::filesystem::path& path, const Files& files) {
+    ArchiveWriter writer;
+    for (const auto& [name, size] : files) {
+        const auto added = size < 0 ? writer.add_tombstone(name)
+                                    : writer.add(name, pattern(static_cast<std::size_t>(size), size));
+        STOCKPILE_CHECK(added);
+    }
+    STOCKPILE_CHECK(writer.write(path));
+    auto archive = Archive::open(path);
+    STOCKPILE_CHECK(archive);
+    return std::move(*archive);
+}
+
+template <typename T>
+[[nodiscard]] bool holds(const HandleTable& handles, Handle<T> handle, int size) {
+    return std::ranges::equal(handles.data(handle), pattern(static_cast<std::size_t>(size), size));
+}
+
+void resolves_each_path_once() {
+    const TempDir dir;
+    ArchiveSet set;
+    STOCKPILE_CHECK(set.mount(make_archive(dir / "base.stk", {{"a", 1}, {"b", 2}})));
+    HandleTable handles(set);
+    const auto a = handles.resolve<Texture>("a");
+    STOCKPILE_CHECK(a && *a && handles.valid(*a) && holds(handles, *a, 1) && handles.path(*a) == "a");
+    STOCKPILE_CHECK(handles.resolve<Texture>("a") == a && handles.resolve_hash<Texture>(hash_path("a")) == a);
+    STOCKPILE_CHECK(handles.get(*a) == set.find("a") && handles.size() == 1);
+    STOCKPILE_CHECK(!handles.resolve("c") && handles.size() == 1);
+
+    const Handle<Texture> null;
+    STOCKPILE_CHECK(!null && !handles.valid(null) && !handles.get(null));
+    STOCKPILE_CHECK(handles.data(null).empty() && handles.path(null).empty());
+}
+
+void reuses_released_slots() {
+    const TempDir dir;
+    ArchiveSet set;
+    STOCKPILE_CHECK(set.mount(make_archive(dir / "base.stk", {{"a", 1}, {"b", 2}, {"c", 3}})));
+    HandleTable handles(set);
+    const auto a = handles.resolve("a");
+    const auto b = handles.resolve("b");
+    STOCKPILE_CHECK(a && b && a->index != b->index);
+
+    handles.release(*a);
+    STOCKPILE_CHECK(!handles.valid(*a) && !handles.get(*a) && handles.data(*a).empty() && handles.size() == 1);
+    handles.release(*a);
+    STOCKPILE_CHECK(handles.size() == 1 && handles.valid(*b));
+
+    // The slot goes to the next path, and the old handle does not name it.
+    const auto c = handles.resolve("c");
+    STOCKPILE_CHECK(c && c->index == a->index && c->generation != a->generation);
+    STOCKPILE_CHECK(!handles.valid(*a) && holds(handles, *c, 3));
+    const auto again = handles.resolve("a");
+    STOCKPILE_CHECK(again && *again != *a && again->index != a->index && holds(handles, *again, 1));
+
+    // Every release invalidates all earlier handles to the slot.
+    std::vector<Handle<>> earlier{*again};
+    for (int cycle = 0; cycle < 1000; ++cycle) {
+        handles.release(earlier.back());
+        const auto next = handles.resolve("a");
+        STOCKPILE_CHECK(next && next->index == again->index);
+        earlier.push_back(*next);
+    }
+    STOCKPILE_CHECK(std::ranges::none_of(earlier.begin(), earlier.end() - 1,
+                                         [&](Handle<> handle) { return handles.valid(handle); }));
+    STOCKPILE_CHECK(handles.valid(earlier.back()) && handles.size() == 3);
+}
+
+/// Generations wrap around past 2^32 - 1 to 1, never to the 0 of null
+/// handles.
+void skips_the_null_generation() {
+    constexpr auto kLast = std::numeric_limits<std::uint32_t>::max();
+    static_assert(detail::next_generation(1) == 2);
+    STOCKPILE_CHECK(detail::next_generation(kLast - 1) == kLast);
+    STOCKPILE_CHECK(detail::next_generation(kLast) == 1);
+}
+
+void refresh_follows_the_set() {
+    const TempDir dir;
+    ArchiveSet set;
+    STOCKPILE_CHECK(set.mount(make_archive(dir / "base.stk", {{"a", 1}, {"b", 2}, {"c", 3}})));
+    HandleTable handles(set);
+    const auto a = handles.resolve("a");
+    const auto b = handles.resolve("b");
+    const auto c = handles.resolve("c");
+    STOCKPILE_CHECK(a && b && c);
+
+    const auto patch = set.mount(make_archive(dir / "patch.stk", {{"b", 20}, {"c", -1}}));
+    STOCKPILE_CHECK(patch && holds(handles, *b, 2));
+    handles.refresh();
+    STOCKPILE_CHECK(holds(handles, *a, 1) && holds(handles, *b, 20) && handles.get(*b)->archive == *patch);
+    STOCKPILE_CHECK(!handles.valid(*c) && handles.size() == 2 && !handles.resolve("c"));
+
+    // Its slot is free again.
+    STOCKPILE_CHECK(set.unmount(*patch));
+    handles.refresh();
+    set.reclaim();
+    const auto restored = handles.resolve("c");
+    STOCKPILE_CHECK(restored && restored->index == c->index && holds(handles, *restored, 3));
+    STOCKPILE_CHECK(holds(handles, *b, 2) && handles.size() == 3);
+}
+
+/// A hot reload replaces the archive a handle names. The handle stays valid
+/// and reads the old entry until refresh() moves it to the new one, which
+/// must happen before the set's reclaim() frees the old archive.
+void stale_handles_read_old_data_until_reclaim() {
+    const TempDir dir;
+    ArchiveSet set;
+    STOCKPILE_CHECK(set.mount(make_archive(dir / "base.stk", {{"a", 1}, {"b", 2}})));
+    const auto overlay = set.mount(make_archive(dir / "overlay-0", {{"a", 10}}));
+    HandleTable handles(set);
+    const auto a = handles.resolve("a");
+    STOCKPILE_CHECK(overlay && a && handles.get(*a)->archive == *overlay);
+
+    const auto replacement = set.replace(*overlay, make_archive(dir / "overlay-1", {{"a", 20}}));
+    STOCKPILE_CHECK(replacement && !set.is_mounted(*overlay));
+    STOCKPILE_CHECK(handles.valid(*a) && holds(handles, *a, 10) && handles.path(*a) == "a");
+
+    handles.refresh();
+    set.reclaim();
+    STOCKPILE_CHECK(handles.valid(*a) && handles.get(*a)->archive == *replacement && holds(handles, *a, 20));
+}
+
+} // namespace
+} // namespace stockpile::test
+
+int main() {
+    using namespace stockpile::test;
+    return run({
+        {"resolves_each_path_once", resolves_each_path_once},
+        {"reuses_released_slots", reuses_released_slots},
+        {"skips_the_null_generation", skips_the_null_generation},
+        {"refresh_follows_the_set", refresh_follows_the_set},
+        {"stale_handles_read_old_data_until_reclaim", stale_handles_read_old_data_until_reclaim},
+    });
+}
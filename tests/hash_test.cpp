@@ -0,0 +1,138 @@
+#include "stockpile/hash.hpp"
+
+#include "test.hpp"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+namespace stockpile::test {
+namespace {
+
+/// Bit-at-a-time CRC-32C, the definition the table and SSE4.2 kernels must
+/// agree with.
+[[nodiscard]] std::uint32_t reference_crc32c(std::span<const std::byte> data) noexcept {
+    std::uint32_t crc = 0xFFFFFFFF;
+    for (const auto byte : data) {
+        crc ^= std::to_integer<std::uint32_t>(byte);
+        for (int bit = 0; bit < 8; ++bit) {
+            crc = (crc >> 1) ^ (0x82F63B78 & (0u - (crc & 1)));
+        }
+    }
+    return ~crc;
+}
+
+/// Runs `fn` once at every SIMD level the CPU supports, scalar first, and
+/// restores the level in use.
+template <typename Fn>
+void at_every_level(Fn fn) {
+    const auto best = simd_level();
+    for (const auto level : {SimdLevel::scalar, SimdLevel::sse42, SimdLevel::avx2, SimdLevel::avx512}) {
+        if (set_simd_level(level) == level) {
+            fn(level);
+        }
+    }
+    set_simd_level(best);
+}
+
+/// Lengths around every path of the kernels: the byte tail, 8-byte words
+/// and the three interleaved 4 KiB streams of the SSE4.2 kernel.
+[[nodiscard]] std::vector<std::size_t> lengths() {
+    std::vector<std::size_t> result;
+    for (std::size_t n = 0; n <= 80; ++n) {
+        result.push_back(n);
+    }
+    for (const std::size_t n : {4095, 4096, 12287, 12288, 12289, 12295, 24576 + 13, 1 << 20, (1 << 20) + 3}) {
+        result.push_back(n);
+    }
+    return result;
+}
+
+void crc32c_known_vectors() {
+    // RFC 3720, appendix B.4, and the usual check value.
+    std::array<std::byte, 32> bytes{};
+    at_every_level([&](SimdLevel) {
+        STOCKPILE_CHECK(crc32c({}) == 0);
+        STOCKPILE_CHECK(crc32c(as_bytes("123456789")) == 0xE3069283);
+        bytes.fill(std::byte{0});
+        STOCKPILE_CHECK(crc32c(bytes) == 0x8A9136AA);
+        bytes.fill(std::byte{0xFF});
+        STOCKPILE_CHECK(crc32c(bytes) == 0x62A8AB43);
+        for (std::size_t i = 0; i < bytes.size(); ++i) {
+            bytes[i] = static_cast<std::byte>(i);
+        }
+        STOCKPILE_CHECK(crc32c(bytes) == 0x46DD794E);
+        for (std::size_t i = 0; i < bytes.size(); ++i) {
+            bytes[i] = static_cast<std::byte>(31 - i);
+        }
+        STOCKPILE_CHECK(crc32c(bytes) == 0x113FDB5C);
+    });
+}
+
+void crc32c_levels_match_reference() {
+    const auto data = pattern((1 << 20) + 16, 7);
+    int levels = 0;
+    at_every_level([&](SimdLevel) {
+        ++levels;
+        for (const auto length : lengths()) {
+            // Every misalignment of the start for short inputs, a few for long ones.
+            for (std::size_t offset = 0; offset < (length < 4096 ? 8u : 3u); ++offset) {
+                const auto bytes = std::span(data).subspan(offset, length);
+                STOCKPILE_CHECK(crc32c(bytes) == reference_crc32c(bytes));
+            }
+        }
+    });
+    if (levels == 1) {
+        std::printf("  (no SSE4.2 on this CPU: only the table kernel was checked)\n");
+    }
+}
+
+void crc32c_continues() {
+    const auto data = pattern(40'000, 3);
+    at_every_level([&](SimdLevel) {
+        const auto whole = crc32c(data);
+        for (const std::size_t split : {0, 1, 7, 8, 4096, 12288, 30'001, 40'000}) {
+            const auto bytes = std::span(data);
+            STOCKPILE_CHECK(crc32c(bytes.subspan(split), crc32c(bytes.first(split))) == whole);
+        }
+    });
+}
+
+void hashes_agree_across_levels() {
+    const auto data = pattern(70'000, 5);
+    std::vector<std::uint64_t> hashes64;
+    std::vector<Hash128> hashes128;
+    for (const auto length : lengths()) {
+        if (length <= data.size()) {
+            const auto bytes = std::span(data).first(length);
+            hashes64.push_back(hash64(bytes, length));
+            hashes128.push_back(hash128(bytes, length));
+        }
+    }
+    at_every_level([&](SimdLevel) {
+        std::size_t i = 0;
+        for (const auto length : lengths()) {
+            if (length <= data.size()) {
+                const auto bytes = std::span(data).first(length);
+                STOCKPILE_CHECK(hash64(bytes, length) == hashes64[i]);
+                STOCKPILE_CHECK(hash128(bytes, length) == hashes128[i]);
+                ++i;
+            }
+        }
+    });
+}
+
+} // namespace
+} // namespace stockpile::test
+
+int main() {
+    using namespace stockpile::test;
+    return run({
+        {"crc32c_known_vectors", crc32c_known_vectors},
+        {"crc32c_levels_match_reference", crc32c_levels_match_reference},
+        {"crc32c_continues", crc32c_continues},
+        {"hashes_agree_across_levels", hashes_agree_across_levels},
+    });
+}
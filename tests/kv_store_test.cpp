@@ -0,0 +1,339 @@
+#include "stockpile/kv_store.hpp"
+
+#include "test.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace stockpile::test {
+namespace {
+
+using namespace std::chrono_literals;
+namespace fs = std::filesystem;
+
+/// Long enough that the background thread never flushes during a test.
+constexpr KvOptions kManualSync{.sync_interval = std::chrono::hours(1)};
+
+constexpr int kRecords = 6;
+
+/// Log files of the store in `directory`, oldest first.
+[[nodiscard]] std::vector<fs::path> logs(const fs::path& directory) {
+    std::vector<fs::path> found;
+    for (const auto& file : fs::directory_iterator(directory)) {
+        const auto name = file.path().filename().string();
+        if (name.starts_with("wal-") && name.ends_with(".log")) {
+            found.push_back(file.path());
+        }
+    }
+    std::ranges::sort(found);
+    return found;
+}
+
+/// What a crash at this moment would leave on disk, as far as the files
+/// written so far go.
+void copy_store(const fs::path& from, const fs::path& to) {
+    fs::remove_all(to);
+    fs::copy(from, to, fs::copy_options::recursive);
+}
+
+/// `prefix` followed by `i` in decimal.
+[[nodiscard]] std::string numbered(std::string prefix, int i) {
+    prefix += std::to_string(i);
+    return prefix;
+}
+
+/// Record `i` puts "k<i>" and sets "last" to i in one batch.
+[[nodiscard]] WriteBatch record(int i) {
+    WriteBatch batch;
+    batch.put(numbered("k", i), numbered("value ", i));
+    batch.put("last", std::to_string(i));
+    return batch;
+}
+
+/// Whether `store` holds exactly the first `count` records.
+[[nodiscard]] bool holds_records(const KvStore& store, int count) {
+    if (store.size() != static_cast<std::size_t>(count == 0 ? 0 : count + 1)) {
+        return false;
+    }
+    for (int i = 0; i < count; ++i) {
+        if (store.get(numbered("k", i)) != numbered("value ", i)) {
+            return false;
+        }
+    }
+    return count == 0 || store.get("last") == std::to_string(count - 1);
+}
+
+/// Writes kRecords records to a store in `directory`, each synced on its
+/// own, and returns the size of the log after each one, starting with 0.
+[[nodiscard]] std::vector<std::uint64_t> write_records(const fs::path& directory) {
+    std::vector<std::uint64_t> ends{0};
+    auto store = KvStore::open(directory, kManualSync);
+    STOCKPILE_CHECK(store);
+    for (int i = 0; i < kRecords; ++i) {
+        STOCKPILE_CHECK(store->apply(record(i)));
+        STOCKPILE_CHECK(store->sync());
+        ends.push_back(fs::file_size(logs(directory).back()));
+    }
+    return ends;
+}
+
+/// Opens the store in `directory`, checks that it holds the first `count`
+/// records, and that a write made after recovery survives reopening.
+void check_recovers(const fs::path& directory, int count) {
+    {
+        auto store = KvStore::open(directory, kManualSync);
+        STOCKPILE_CHECK(store);
+        if (!store) {
+            return;
+        }
+        STOCKPILE_CHECK(holds_records(*store, count));
+        STOCKPILE_CHECK(store->put("after", "crash"));
+    }
+    auto store = KvStore::open(directory, kManualSync);
+    STOCKPILE_CHECK(store && store->get("after") == "crash");
+    if (store) {
+        STOCKPILE_CHECK(store->erase("after"));
+        STOCKPILE_CHECK(holds_records(*store, count));
+    }
+}
+
+void round_trip() {
+    const TempDir dir;
+    {
+        auto store = KvStore::open(dir / "kv");
+        STOCKPILE_CHECK(store);
+        STOCKPILE_CHECK(store->put("profile/name", "ada"));
+        STOCKPILE_CHECK(store->put("profile/level", "3"));
+        STOCKPILE_CHECK(store->put("settings/volume", "7"));
+        STOCKPILE_CHECK(store->put("profile/level", "4"));
+        STOCKPILE_CHECK(store->erase("settings/volume"));
+        STOCKPILE_CHECK(store->get("profile/level") == "4");
+        STOCKPILE_CHECK(!store->contains("settings/volume"));
+    }
+    auto store = KvStore::open(dir / "kv");
+    STOCKPILE_CHECK(store);
+    STOCKPILE_CHECK(store->size() == 2);
+    STOCKPILE_CHECK(store->get("profile/name") == "ada");
+    STOCKPILE_CHECK(store->get("profile/level") == "4");
+    std::vector<std::string> keys;
+    store->scan("profile/", [&](std::string_view key, std::string_view) { keys.emplace_back(key); });
+    STOCKPILE_CHECK(keys == std::vector<std::string>{"profile/level", "profile/name"});
+}
+
+void replays_log_truncated_anywhere() {
+    const TempDir dir;
+    const auto ends = write_records(dir / "kv");
+    const auto log = logs(dir / "kv").back();
+    const auto bytes = read_file(log);
+    STOCKPILE_CHECK(bytes.size() == ends.back());
+
+    // Every cut, at a record boundary or inside a record, keeps exactly the
+    // records that end before it.
+    for (std::size_t cut = 0; cut <= bytes.size(); ++cut) {
+        copy_store(dir / "kv", dir / "crash");
+        write_file(dir / "crash" / log.filename(), std::span(bytes).first(cut));
+        const auto complete = std::ranges::upper_bound(ends, cut) - ends.begin() - 1;
+        check_recovers(dir / "crash", static_cast<int>(complete));
+    }
+}
+
+void discards_damaged_record_and_what_follows() {
+    const TempDir dir;
+    const auto ends = write_records(dir / "kv");
+    const auto log = logs(dir / "kv").back();
+    const auto bytes = read_file(log);
+
+    // Flip one byte of the size, of the hash and of the body of each record.
+    for (int i = 0; i < kRecords; ++i) {
+        for (const std::uint64_t at : {ends[i], ends[i] + 5, ends[i + 1] - 1}) {
+            auto damaged = bytes;
+            damaged[at] ^= std::byte{0x40};
+            copy_store(dir / "kv", dir / "crash");
+            write_file(dir / "crash" / log.filename(), damaged);
+            check_recovers(dir / "crash", i);
+        }
+    }
+}
+
+void appends_after_garbage_tail() {
+    const TempDir dir;
+    const auto ends = write_records(dir / "kv");
+    const auto log = logs(dir / "kv").back();
+    auto bytes = read_file(log);
+    // Zeroes past the last record, as left by a file extended before the
+    // crash but never written.
+    bytes.resize(bytes.size() + 4096);
+    write_file(log, bytes);
+    {
+        auto store = KvStore::open(dir / "kv", kManualSync);
+        STOCKPILE_CHECK(store && holds_records(*store, kRecords));
+    }
+    STOCKPILE_CHECK(fs::file_size(log) == ends.back());
+    check_recovers(dir / "kv", kRecords);
+}
+
+void compaction_keeps_every_write() {
+    const TempDir dir;
+    {
+        auto store = KvStore::open(dir / "kv", kManualSync);
+        STOCKPILE_CHECK(store);
+        for (int i = 0; i < kRecords / 2; ++i) {
+            STOCKPILE_CHECK(store->apply(record(i)));
+        }
+        STOCKPILE_CHECK(store->compact());
+        for (int i = kRecords / 2; i < kRecords; ++i) {
+            STOCKPILE_CHECK(store->apply(record(i)));
+        }
+    }
+    STOCKPILE_CHECK(fs::exists(dir / "kv" / "table"));
+    STOCKPILE_CHECK(logs(dir / "kv").size() == 1);
+    check_recovers(dir / "kv", kRecords);
+}
+
+void compaction_crash_before_table_is_renamed() {
+    const TempDir dir;
+    static_cast<void>(write_records(dir / "kv"));
+    const auto old_log = logs(dir / "kv").back();
+    copy_store(dir / "kv", dir / "before");
+    {
+        auto store = KvStore::open(dir / "kv", kManualSync);
+        STOCKPILE_CHECK(store && store->compact());
+    }
+    const auto new_log = logs(dir / "kv").back();
+    STOCKPILE_CHECK(new_log.filename() != old_log.filename());
+
+    // Crash after the new log was created, with the table not written yet
+    // or still a temporary file: the old table and log hold everything.
+    copy_store(dir / "before", dir / "crash");
+    write_file(dir / "crash" / new_log.filename(), {});
+    check_recovers(dir / "crash", kRecords);
+
+    copy_store(dir / "before", dir / "crash");
+    write_file(dir / "crash" / new_log.filename(), {});
+    fs::copy_file(dir / "kv" / "table", dir / "crash" / "table.tmp");
+    check_recovers(dir / "crash", kRecords);
+    STOCKPILE_CHECK(!fs::exists(dir / "crash" / "table.tmp"));
+
+    copy_store(dir / "before", dir / "crash");
+    write_file(dir / "crash" / "table.tmp", pattern(100));
+    check_recovers(dir / "crash", kRecords);
+}
+
+void compaction_crash_before_old_log_is_removed() {
+    const TempDir dir;
+    {
+        auto store = KvStore::open(dir / "kv", kManualSync);
+        STOCKPILE_CHECK(store);
+        STOCKPILE_CHECK(store->put("key", "old"));
+        STOCKPILE_CHECK(store->put("gone", "soon"));
+        STOCKPILE_CHECK(store->sync());
+    }
+    const auto old_log = logs(dir / "kv").back();
+    const auto old_bytes = read_file(old_log);
+    {
+        auto store = KvStore::open(dir / "kv", kManualSync);
+        STOCKPILE_CHECK(store);
+        STOCKPILE_CHECK(store->put("key", "new"));
+        STOCKPILE_CHECK(store->erase("gone"));
+        STOCKPILE_CHECK(store->compact());
+    }
+    STOCKPILE_CHECK(!fs::exists(old_log));
+
+    // The table covers the old log, which must not be replayed over it.
+    write_file(old_log, old_bytes);
+    {
+        auto store = KvStore::open(dir / "kv", kManualSync);
+        STOCKPILE_CHECK(store);
+        STOCKPILE_CHECK(store->get("key") == "new");
+        STOCKPILE_CHECK(!store->contains("gone"));
+    }
+    STOCKPILE_CHECK(!fs::exists(old_log));
+}
+
+void compacts_past_threshold() {
+    const TempDir dir;
+    auto store = KvStore::open(dir / "kv", {.sync_interval = 1ms, .compact_threshold = 512});
+    STOCKPILE_CHECK(store);
+    for (int i = 0; i < 200; ++i) {
+        STOCKPILE_CHECK(store->put("counter", std::to_string(i)));
+        if (i % 20 == 0) {
+            std::this_thread::sleep_for(5ms);
+        }
+    }
+    STOCKPILE_CHECK(store->sync());
+    // Let the background thread finish a compaction it may have started.
+    std::this_thread::sleep_for(50ms);
+    STOCKPILE_CHECK(fs::exists(dir / "kv" / "table"));
+    copy_store(dir / "kv", dir / "crash");
+    auto copy = KvStore::open(dir / "crash", kManualSync);
+    STOCKPILE_CHECK(copy && copy->get("counter") == "199");
+}
+
+void group_sync_batches_writes() {
+    const TempDir dir;
+    constexpr int kThreads = 4;
+    constexpr int kWrites = 100;
+    {
+        auto store = KvStore::open(dir / "kv", kManualSync);
+        STOCKPILE_CHECK(store);
+        std::vector<std::thread> threads;
+        for (int t = 0; t < kThreads; ++t) {
+            threads.emplace_back([&store, t] {
+                for (int i = 0; i < kWrites; ++i) {
+                    STOCKPILE_CHECK(store->put(numbered(numbered("t", t) + "/", i), "v"));
+                }
+            });
+        }
+        for (auto& thread : threads) {
+            thread.join();
+        }
+        // Writes queue in memory; nothing reaches the log until a flush.
+        STOCKPILE_CHECK(store->size() == kThreads * kWrites);
+        STOCKPILE_CHECK(fs::file_size(logs(dir / "kv").back()) == 0);
+
+        STOCKPILE_CHECK(store->sync());
+        copy_store(dir / "kv", dir / "crash");
+        auto copy = KvStore::open(dir / "crash", kManualSync);
+        STOCKPILE_CHECK(copy && copy->size() == kThreads * kWrites);
+    }
+
+    // Without sync(), the background thread makes writes durable within
+    // about one interval.
+    {
+        auto store = KvStore::open(dir / "timed", {.sync_interval = 5ms});
+        STOCKPILE_CHECK(store);
+        for (int i = 0; i < kWrites; ++i) {
+            STOCKPILE_CHECK(store->put(numbered("key", i), "v"));
+        }
+        for (int tries = 0; tries < 400 && fs::file_size(logs(dir / "timed").back()) == 0; ++tries) {
+            std::this_thread::sleep_for(5ms);
+        }
+        std::this_thread::sleep_for(50ms);
+        copy_store(dir / "timed", dir / "crash");
+        auto copy = KvStore::open(dir / "crash", kManualSync);
+        STOCKPILE_CHECK(copy && copy->size() == kWrites);
+    }
+}
+
+} // namespace
+} // namespace stockpile::test
+
+int main() {
+    using namespace stockpile::test;
+    return run({
+        {"round_trip", round_trip},
+        {"replays_log_truncated_anywhere", replays_log_truncated_anywhere},
+        {"discards_damaged_record_and_what_follows", discards_damaged_record_and_what_follows},
+        {"appends_after_garbage_tail", appends_after_garbage_tail},
+        {"compaction_keeps_every_write", compaction_keeps_every_write},
+        {"compaction_crash_before_table_is_renamed", compaction_crash_before_table_is_renamed},
+        {"compaction_crash_before_old_log_is_removed", compaction_crash_before_old_log_is_removed},
+        {"compacts_past_threshold", compacts_past_threshold},
+        {"group_sync_batches_writes", group_sync_batches_writes},
+    });
+}
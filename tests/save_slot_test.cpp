@@ -0,0 +1,183 @@
+#include "stockpile/save_slot.hpp"
+
+#include "stockpile/thread_pool.hpp"
+
+#include "test.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+namespace stockpile::test {
+namespace {
+
+namespace fs = std::filesystem;
+
+// Layout of a copy: a 32-byte header holding the generation at offset 8,
+// one CRC-32C per 64 KiB block, then the data.
+constexpr std::size_t kHeaderSize = 32;
+constexpr std::size_t kGenerationOffset = 8;
+constexpr std::size_t kBlockSize = 64 * 1024;
+
+/// Larger than three blocks, the last one partial.
+constexpr std::size_t kSaveSize = 3 * kBlockSize + 1000;
+
+[[nodiscard]] std::size_t data_offset(std::size_t size) {
+    return kHeaderSize + (size + kBlockSize - 1) / kBlockSize * sizeof(std::uint32_t);
+}
+
+[[nodiscard]] fs::path copy(const SaveSlot& slot, int index) {
+    auto path = slot.path();
+    path += index == 0 ? ".0" : ".1";
+    return path;
+}
+
+void flip(const fs::path& path, std::size_t at) {
+    auto bytes = read_file(path);
+    bytes[at] ^= std::byte{0x10};
+    write_file(path, bytes);
+}
+
+void truncate(const fs::path& path, std::size_t size) {
+    auto bytes = read_file(path);
+    bytes.resize(size);
+    write_file(path, bytes);
+}
+
+/// Writes two saves to `slot`, the older to copy 0 and the newer to copy 1,
+/// and returns the older one.
+[[nodiscard]] std::vector<std::byte> write_two(const SaveSlot& slot) {
+    const auto older = pattern(kSaveSize, 1);
+    STOCKPILE_CHECK(slot.write(older));
+    STOCKPILE_CHECK(slot.write(pattern(kSaveSize, 2)));
+    STOCKPILE_CHECK(fs::exists(copy(slot, 0)) && fs::exists(copy(slot, 1)));
+    return older;
+}
+
+[[nodiscard]] std::error_code read_error(const SaveSlot& slot) {
+    const auto data = slot.read();
+    return data ? std::error_code() : data.error();
+}
+
+void round_trip() {
+    const TempDir dir;
+    const SaveSlot slot(dir / "profile");
+    STOCKPILE_CHECK(!slot.exists());
+    STOCKPILE_CHECK(read_error(slot) == std::errc::no_such_file_or_directory);
+
+    ThreadPool pool(4);
+    for (unsigned i = 0; i < 5; ++i) {
+        const auto data = pattern(i == 0 ? 0 : kSaveSize + i, i);
+        STOCKPILE_CHECK(slot.write(data, i % 2 == 0 ? &pool : nullptr));
+        const auto read = slot.read(i % 2 == 0 ? nullptr : &pool);
+        STOCKPILE_CHECK(read && *read == data);
+    }
+    STOCKPILE_CHECK(slot.exists());
+    STOCKPILE_CHECK(slot.remove());
+    STOCKPILE_CHECK(!slot.exists());
+}
+
+void falls_back_on_bad_block() {
+    const TempDir dir;
+    const SaveSlot slot(dir / "profile");
+    // The first, a middle and the last, partial, block of the newest copy.
+    for (const std::size_t at : {std::size_t{0}, kBlockSize + 17, kSaveSize - 1}) {
+        const auto older = write_two(slot);
+        flip(copy(slot, 1), data_offset(kSaveSize) + at);
+        const auto read = slot.read();
+        STOCKPILE_CHECK(read && *read == older);
+        STOCKPILE_CHECK(slot.remove());
+    }
+}
+
+void falls_back_on_damaged_header() {
+    const TempDir dir;
+    const SaveSlot slot(dir / "profile");
+    // Magic, generation, size, the header CRC and a block CRC.
+    for (const std::size_t at : {std::size_t{0}, kGenerationOffset, std::size_t{16}, std::size_t{28},
+                                 kHeaderSize + 4}) {
+        const auto older = write_two(slot);
+        flip(copy(slot, 1), at);
+        const auto read = slot.read();
+        STOCKPILE_CHECK(read && *read == older);
+        STOCKPILE_CHECK(slot.remove());
+    }
+}
+
+void falls_back_on_truncated_copy() {
+    const TempDir dir;
+    const SaveSlot slot(dir / "profile");
+    for (const std::size_t size : {std::size_t{0}, kHeaderSize - 1, kHeaderSize + 2, data_offset(kSaveSize) + 5,
+                                   data_offset(kSaveSize) + kSaveSize - 1}) {
+        const auto older = write_two(slot);
+        truncate(copy(slot, 1), size);
+        const auto read = slot.read();
+        STOCKPILE_CHECK(read && *read == older);
+        STOCKPILE_CHECK(slot.remove());
+    }
+}
+
+void falls_back_on_missing_copy() {
+    const TempDir dir;
+    const SaveSlot slot(dir / "profile");
+    const auto older = write_two(slot);
+    fs::remove(copy(slot, 1));
+    const auto read = slot.read();
+    STOCKPILE_CHECK(read && *read == older);
+}
+
+void reports_why_nothing_loads() {
+    const TempDir dir;
+    const SaveSlot slot(dir / "profile");
+    static_cast<void>(write_two(slot));
+    flip(copy(slot, 0), data_offset(kSaveSize));
+    flip(copy(slot, 1), data_offset(kSaveSize));
+    STOCKPILE_CHECK(read_error(slot) == Errc::checksum_mismatch);
+
+    write_file(copy(slot, 0), pattern(1000));
+    fs::remove(copy(slot, 1));
+    STOCKPILE_CHECK(read_error(slot) == Errc::bad_magic);
+
+    static_cast<void>(write_two(slot));
+    for (const int index : {0, 1}) {
+        // The version follows the magic.
+        auto bytes = read_file(copy(slot, index));
+        const std::uint32_t version = 99;
+        std::memcpy(bytes.data() + 4, &version, sizeof(version));
+        write_file(copy(slot, index), bytes);
+    }
+    STOCKPILE_CHECK(read_error(slot) == Errc::unsupported_version);
+}
+
+void write_replaces_damaged_copy() {
+    const TempDir dir;
+    const SaveSlot slot(dir / "profile");
+    const auto older = write_two(slot);
+    flip(copy(slot, 1), kGenerationOffset);
+
+    // The damaged copy is the one to go, so the intact one survives.
+    const auto newest = pattern(kSaveSize, 3);
+    STOCKPILE_CHECK(slot.write(newest));
+    auto read = slot.read();
+    STOCKPILE_CHECK(read && *read == newest);
+    flip(copy(slot, 1), data_offset(kSaveSize));
+    read = slot.read();
+    STOCKPILE_CHECK(read && *read == older);
+}
+
+} // namespace
+} // namespace stockpile::test
+
+int main() {
+    using namespace stockpile::test;
+    return run({
+        {"round_trip", round_trip},
+        {"falls_back_on_bad_block", falls_back_on_bad_block},
+        {"falls_back_on_damaged_header", falls_back_on_damaged_header},
+        {"falls_back_on_truncated_copy", falls_back_on_truncated_copy},
+        {"falls_back_on_missing_copy", falls_back_on_missing_copy},
+        {"reports_why_nothing_loads", reports_why_nothing_loads},
+        {"write_replaces_damaged_copy", write_replaces_damaged_copy},
+    });
+}
@@ -0,0 +1,477 @@
+#include "stockpile/serialize.hpp"
+
+#include "stockpile/arena.hpp"
+#include "stockpile/record.hpp"
+#include "stockpile/schema.hpp"
+
+#include "test.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <span>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace stockpile::test {
+namespace {
+
+[[nodiscard]] bool aligned(const void* p, std::size_t alignment) noexcept {
+    return reinterpret_cast<std::uintptr_t>(p) % alignment == 0;
+}
+
+/// A copy of what a writer produced, at an address aligned as SaveReader
+/// needs for arrays.
+class AlignedCopy {
+public:
+    explicit AlignedCopy(std::span<const std::byte> bytes)
+        : m_storage(bytes.size() / sizeof(std::max_align_t) + 1), m_size(bytes.size()) {
+        std::memcpy(m_storage.data(), bytes.data(), bytes.size());
+    }
+
+    [[nodiscard]] std::span<std::byte> bytes() noexcept {
+        return std::as_writable_bytes(std::span(m_storage)).first(m_size);
+    }
+
+private:
+    std::vector<std::max_align_t> m_storage;
+    std::size_t m_size;
+};
+
+struct Vec3 {
+    float x;
+    float y;
+    float z;
+
+    friend bool operator==(const Vec3&, const Vec3&) = default;
+};
+STOCKPILE_SCHEMA(Vec3, x, y, z)
+
+/// Three bytes of padding after `tag`.
+struct Padded {
+    std::uint8_t tag;
+    std::uint32_t value;
+
+    friend bool operator==(const Padded&, const Padded&) = default;
+};
+STOCKPILE_SCHEMA(Padded, tag, value)
+
+/// `hidden` is not serialized.
+struct Partial {
+    std::uint32_t shown;
+    std::uint32_t hidden;
+};
+STOCKPILE_SCHEMA(Partial, shown)
+
+struct Switch {
+    bool on;
+};
+STOCKPILE_SCHEMA(Switch, on)
+
+struct Entity {
+    std::uint64_t id = 0;
+    std::string name;
+    Vec3 position{};
+    std::array<float, 4> rotation{};
+    std::vector<std::uint32_t> tags;
+    std::vector<std::string> labels;
+    std::vector<Vec3> path;
+    std::vector<Padded> slots;
+    std::int32_t health = 0;
+    bool active = false;
+
+    friend bool operator==(const Entity&, const Entity&) = default;
+};
+STOCKPILE_SCHEMA(Entity, id, name, position, rotation, tags, labels, path, slots, health, active)
+
+/// Decoded as views into the reader's buffer.
+struct Borrowed {
+    std::string_view name;
+    std::span<const Vec3> points;
+};
+STOCKPILE_SCHEMA(Borrowed, name, points)
+
+static_assert(is_flat_v<Vec3> && is_flat_v<std::array<Vec3, 2>> && is_flat_v<std::int16_t>);
+static_assert(!is_flat_v<Padded> && !is_flat_v<Partial> && !is_flat_v<Switch> && !is_flat_v<bool>);
+static_assert(!is_flat_v<Entity> && !is_flat_v<std::string>);
+
+/// Player as schema version 1 stored it, with hit points out of 10000.
+struct PlayerV1 {
+    std::string name;
+    std::uint16_t hp = 0;
+    std::int32_t level = 0;
+};
+STOCKPILE_SCHEMA(PlayerV1, name, hp, level)
+
+/// Version 2 stored health in percent, and its fields in another order.
+struct PlayerV2 {
+    std::int32_t level = 0;
+    float health = 0;
+    std::string name;
+};
+STOCKPILE_SCHEMA(PlayerV2, level, health, name)
+STOCKPILE_SCHEMA_VERSION(PlayerV2, 2)
+
+/// A version 1 record without the field a migration reads.
+struct Nameless {
+    std::string name;
+};
+STOCKPILE_SCHEMA(Nameless, name)
+
+/// Runs of each migration of Player.
+int g_from_hp = 0;
+int g_from_percent = 0;
+
+struct Player {
+    std::string name;
+    float health = 1;
+    std::int32_t level = 0;
+    std::string title = "novice";
+
+    friend bool operator==(const Player&, const Player&) = default;
+};
+STOCKPILE_SCHEMA(Player, name, health, level, title)
+STOCKPILE_SCHEMA_VERSION(Player, 3)
+
+/// Versions before 2 stored hit points out of 10000.
+constexpr auto health_from_hp = [](const auto& old) -> Result<float> {
+    ++g_from_hp;
+    auto hp = old.template read<std::uint16_t>("hp");
+    if (!hp) {
+        return std::unexpected(hp.error());
+    }
+    return *hp / 10000.0f;
+};
+
+/// Version 2 stored health in percent.
+constexpr auto health_from_percent = [](const auto& old) -> Result<float> {
+    ++g_from_percent;
+    auto percent = old.template read<float>("health");
+    if (!percent) {
+        return std::unexpected(percent.error());
+    }
+    return *percent / 100.0f;
+};
+
+STOCKPILE_MIGRATIONS(Player, migrate<&Player::health>(2, health_from_hp),
+                     migrate<&Player::health>(3, health_from_percent))
+
+[[nodiscard]] Entity sample_entity() {
+    return {
+        .id = 0x1234'5678'9ABC,
+        .name = "guard",
+        .position = {1, 2, 3},
+        .rotation = {0, 0, 0, 1},
+        .tags = {4, 8, 15},
+        .labels = {"", "npc", "a label long enough to live on the heap"},
+        .path = {{0, 0, 0}, {1, 0, 0}, {1, 1, 0}},
+        .slots = {{1, 100}, {2, 200}},
+        .health = -20,
+        .active = true,
+    };
+}
+
+void arena_allocates_aligned() {
+    Arena arena(256);
+    for (const std::size_t alignment : {1, 2, 8, 16, 64, 128}) {
+        static_cast<void>(arena.allocate(3, 1));
+        STOCKPILE_CHECK(aligned(arena.allocate(5, alignment), alignment));
+    }
+    // Larger than a chunk.
+    const auto big = arena.allocate_array<std::uint64_t>(1000);
+    STOCKPILE_CHECK(aligned(big.data(), alignof(std::uint64_t)) && big.size() == 1000);
+    std::ranges::fill(big, 7);
+    STOCKPILE_CHECK(arena.copy("hello") == "hello");
+}
+
+void arena_extends_last_allocation() {
+    Arena arena(1024);
+    auto* first = arena.allocate(16);
+    auto* second = arena.allocate(16);
+    STOCKPILE_CHECK(!arena.try_extend(first, 16, 32));
+    STOCKPILE_CHECK(arena.try_extend(second, 16, 64));
+    STOCKPILE_CHECK(!arena.try_extend(second, 64, 4096));
+    STOCKPILE_CHECK(static_cast<std::byte*>(arena.allocate(1, 1)) == static_cast<std::byte*>(second) + 64);
+}
+
+void arena_reset_keeps_memory() {
+    Arena arena(256);
+    for (int i = 0; i < 100; ++i) {
+        static_cast<void>(arena.allocate(100));
+    }
+    const auto capacity = arena.capacity();
+    STOCKPILE_CHECK(arena.used() >= 100 * 100 && capacity >= arena.used());
+    arena.reset();
+    STOCKPILE_CHECK(arena.used() == 0 && arena.capacity() == capacity);
+    // The same workload fits in the merged chunk without growing.
+    for (int i = 0; i < 100; ++i) {
+        static_cast<void>(arena.allocate(100));
+    }
+    STOCKPILE_CHECK(arena.capacity() == capacity);
+}
+
+void arena_move_leaves_source_empty() {
+    Arena source(256);
+    auto text = source.copy("kept across the move");
+    const auto capacity = source.capacity();
+    const auto used = source.used();
+
+    Arena target(std::move(source));
+    STOCKPILE_CHECK(text == "kept across the move");
+    STOCKPILE_CHECK(target.capacity() == capacity && target.used() == used);
+    STOCKPILE_CHECK(source.capacity() == 0 && source.used() == 0);
+    // Both stay usable, and neither hands out the other's memory.
+    auto* fresh = static_cast<std::byte*>(source.allocate(64));
+    auto* more = static_cast<std::byte*>(target.allocate(64));
+    STOCKPILE_CHECK(fresh != more);
+    STOCKPILE_CHECK(text == "kept across the move");
+
+    Arena assigned;
+    static_cast<void>(assigned.allocate(10));
+    assigned = std::move(target);
+    STOCKPILE_CHECK(assigned.capacity() == capacity && target.capacity() == 0 && target.used() == 0);
+    STOCKPILE_CHECK(text == "kept across the move");
+}
+
+void save_round_trip() {
+    struct Point {
+        float x;
+        float y;
+        std::uint16_t id;
+    };
+    const std::array<Point, 3> points{{{1, 2, 3}, {4, 5, 6}, {7, 8, 9}}};
+    const std::array<std::uint64_t, 5> varints{0, 127, 128, 300, std::numeric_limits<std::uint64_t>::max()};
+
+    Arena arena;
+    SaveWriter writer(arena, 8);
+    writer.write<std::uint8_t>(0xAB);
+    writer.write<std::int32_t>(-5);
+    writer.write<double>(2.5);
+    for (const auto value : varints) {
+        writer.write_varint(value);
+    }
+    writer.write_string("");
+    writer.write_string("a longer string than the initial capacity");
+    writer.write_array(points);
+    // Another allocation makes the writer move its buffer when it grows.
+    static_cast<void>(arena.allocate(32));
+    writer.write_array(std::vector<std::uint32_t>(1000, 42));
+
+    // SaveReader needs arrays at aligned addresses; so does a copy.
+    std::vector<std::max_align_t> storage(writer.size() / sizeof(std::max_align_t) + 1);
+    std::memcpy(storage.data(), writer.bytes().data(), writer.size());
+    SaveReader reader(std::as_bytes(std::span(storage)).first(writer.size()));
+    STOCKPILE_CHECK(reader.read<std::uint8_t>() == 0xAB);
+    STOCKPILE_CHECK(reader.read<std::int32_t>() == -5);
+    STOCKPILE_CHECK(reader.read<double>() == 2.5);
+    for (const auto value : varints) {
+        STOCKPILE_CHECK(reader.read_varint() == value);
+    }
+    STOCKPILE_CHECK(reader.read_string() == std::string_view());
+    STOCKPILE_CHECK(reader.read_string() == "a longer string than the initial capacity");
+    const auto read_points = reader.read_array<Point>();
+    STOCKPILE_CHECK(read_points && read_points->size() == 3 && (*read_points)[2].id == 9 &&
+                    aligned(read_points->data(), alignof(Point)));
+    const auto numbers = reader.read_array<std::uint32_t>();
+    STOCKPILE_CHECK(numbers && numbers->size() == 1000 && std::ranges::count(*numbers, 42u) == 1000);
+    STOCKPILE_CHECK(reader.at_end());
+}
+
+void reader_rejects_truncated_data() {
+    Arena arena;
+    SaveWriter writer(arena);
+    writer.write_string("twelve bytes");
+    writer.write_varint(std::uint64_t{1} << 40);
+    const auto bytes = writer.bytes();
+    for (std::size_t size = 0; size < bytes.size(); ++size) {
+        SaveReader reader(bytes.first(size));
+        const auto text = reader.read_string();
+        const auto number = text ? reader.read_varint() : Result<std::uint64_t>(std::unexpected(text.error()));
+        STOCKPILE_CHECK(!number && number.error() == Errc::malformed_data);
+    }
+    SaveReader reader(bytes);
+    STOCKPILE_CHECK(reader.read_string() == "twelve bytes");
+    STOCKPILE_CHECK(reader.read_varint() == std::uint64_t{1} << 40);
+    STOCKPILE_CHECK(!reader.read<std::uint8_t>());
+
+    // Eleven continuation bytes overflow 64 bits.
+    const std::array<std::byte, 11> overlong{std::byte{0xFF}, std::byte{0xFF}, std::byte{0xFF}, std::byte{0xFF},
+                                             std::byte{0xFF}, std::byte{0xFF}, std::byte{0xFF}, std::byte{0xFF},
+                                             std::byte{0xFF}, std::byte{0xFF}, std::byte{0x01}};
+    SaveReader overflow(overlong);
+    STOCKPILE_CHECK(!overflow.read_varint());
+}
+
+void schema_round_trip() {
+    Arena arena;
+    SaveWriter writer(arena);
+    const Entity entity = sample_entity();
+    encode(writer, entity);
+    encode(writer, Entity{});
+    AlignedCopy copy(writer.bytes());
+    SaveReader reader(copy.bytes());
+    Entity decoded;
+    STOCKPILE_CHECK(decode(reader, decoded) && decoded == entity);
+    STOCKPILE_CHECK(decode(reader, decoded) && decoded == Entity{} && reader.at_end());
+
+    // Flat structs are their object representation; others are written
+    // field by field, without padding or unlisted members.
+    SaveWriter flat(arena);
+    const Vec3 point{1.5f, -2, 4};
+    encode(flat, point);
+    STOCKPILE_CHECK(std::ranges::equal(flat.bytes(), std::as_bytes(std::span(&point, 1))));
+    encode(flat, Padded{7, 9});
+    encode(flat, Partial{5, 6});
+    STOCKPILE_CHECK(flat.size() == sizeof(Vec3) + 5 + 4);
+}
+
+void schema_decodes_views_in_place() {
+    const std::array<Vec3, 3> points{{{1, 2, 3}, {4, 5, 6}, {7, 8, 9}}};
+    Arena arena;
+    SaveWriter writer(arena);
+    encode(writer, Borrowed{"borrowed", points});
+    AlignedCopy copy(writer.bytes());
+    SaveReader reader(copy.bytes());
+    Borrowed decoded{};
+    STOCKPILE_CHECK(decode(reader, decoded) && decoded.name == "borrowed");
+    STOCKPILE_CHECK(std::ranges::equal(decoded.points, points));
+    const auto inside = [&](const void* p) {
+        const auto* byte = static_cast<const std::byte*>(p);
+        return byte >= copy.bytes().data() && byte < copy.bytes().data() + copy.bytes().size();
+    };
+    STOCKPILE_CHECK(inside(decoded.name.data()) && inside(decoded.points.data()));
+    STOCKPILE_CHECK(aligned(decoded.points.data(), alignof(Vec3)));
+}
+
+void schema_rejects_malformed_data() {
+    Arena arena;
+    SaveWriter writer(arena);
+    encode(writer, sample_entity());
+    AlignedCopy copy(writer.bytes());
+    for (std::size_t size = 0; size < copy.bytes().size(); ++size) {
+        SaveReader reader(copy.bytes().first(size));
+        Entity decoded;
+        const auto result = decode(reader, decoded);
+        STOCKPILE_CHECK(!result && result.error() == Errc::malformed_data);
+    }
+
+    // A bool that is neither 0 nor 1.
+    SaveReader reader(copy.bytes());
+    Entity decoded;
+    copy.bytes().back() = std::byte{2};
+    STOCKPILE_CHECK(decode(reader, decoded).error() == Errc::malformed_data);
+
+    // A count far beyond the input fails without reserving for it.
+    SaveWriter huge(arena);
+    huge.write_varint(std::uint64_t{1} << 60);
+    huge.write_string("one");
+    SaveReader counted(huge.bytes());
+    std::vector<std::string> labels;
+    STOCKPILE_CHECK(decode(counted, labels).error() == Errc::malformed_data && labels.capacity() < 1024);
+}
+
+void records_round_trip() {
+    Arena arena;
+    SaveWriter writer(arena);
+    const Player first{"ada", 0.75f, 12, "captain"};
+    const Player second{"bo", 0.5f, 3, ""};
+    STOCKPILE_CHECK(encode_record(writer, first) && encode_record(writer, second));
+
+    AlignedCopy copy(writer.bytes());
+    SaveReader reader(copy.bytes());
+    const auto record = RecordView<Player>::open(reader);
+    STOCKPILE_CHECK(record && record->version() == 3 && record->has("title") && !record->has("hp"));
+    STOCKPILE_CHECK(record->get<&Player::name>() == "ada" && record->get<&Player::health>() == 0.75f);
+    STOCKPILE_CHECK(record->get<&Player::title>() == "captain" && record->read<std::int32_t>("level") == 12);
+    STOCKPILE_CHECK(record->read<float>("hp").error() == Errc::missing_field);
+    // open() moved the reader past the first record.
+    Player decoded;
+    STOCKPILE_CHECK(decode_record(reader, decoded) && decoded == second && reader.at_end());
+    STOCKPILE_CHECK(g_from_hp == 0 && g_from_percent == 0);
+}
+
+void records_migrate_fields_when_read() {
+    g_from_hp = 0;
+    g_from_percent = 0;
+    Arena arena;
+    SaveWriter writer(arena);
+    STOCKPILE_CHECK(encode_record(writer, PlayerV1{"old", 2500, 7}));
+    STOCKPILE_CHECK(encode_record(writer, PlayerV2{9, 40, "newer"}));
+    AlignedCopy copy(writer.bytes());
+    SaveReader reader(copy.bytes());
+
+    // Fields without a migration are read as stored, or take T's default.
+    const auto v1 = RecordView<Player>::open(reader);
+    STOCKPILE_CHECK(v1 && v1->version() == 1);
+    STOCKPILE_CHECK(v1->get<&Player::name>() == "old" && v1->get<&Player::level>() == 7);
+    STOCKPILE_CHECK(v1->get<&Player::title>() == "novice" && g_from_hp == 0);
+    STOCKPILE_CHECK(v1->get<&Player::health>() == 0.25f && g_from_hp == 1 && g_from_percent == 0);
+
+    // The first migration newer than the record applies.
+    const auto v2 = RecordView<Player>::open(reader);
+    STOCKPILE_CHECK(v2 && v2->version() == 2 && v2->get<&Player::level>() == 9 && g_from_percent == 0);
+    STOCKPILE_CHECK(v2->get<&Player::health>() == 0.4f && g_from_hp == 1 && g_from_percent == 1);
+
+    SaveReader again(copy.bytes());
+    Player decoded;
+    STOCKPILE_CHECK(decode_record(again, decoded) && decoded == Player{"old", 0.25f, 7, "novice"});
+    STOCKPILE_CHECK(decode_record(again, decoded) && decoded == Player{"newer", 0.4f, 9, "novice"});
+}
+
+void records_reject_malformed_data() {
+    Arena arena;
+    SaveWriter writer(arena);
+    STOCKPILE_CHECK(encode_record(writer, Player{"ada", 0.75f, 12, "captain"}));
+    AlignedCopy copy(writer.bytes());
+    for (std::size_t size = 0; size < copy.bytes().size(); ++size) {
+        SaveReader reader(copy.bytes().first(size));
+        const auto record = RecordView<Player>::open(reader);
+        STOCKPILE_CHECK(!record && record.error() == Errc::malformed_data);
+    }
+
+    // More fields than the input could list.
+    SaveWriter counted(arena);
+    counted.write_varint(3);
+    counted.write_varint(std::uint64_t{1} << 40);
+    counted.align(alignof(std::uint32_t));
+    counted.write<std::uint32_t>(0);
+    SaveReader reader(counted.bytes());
+    STOCKPILE_CHECK(RecordView<Player>::open(reader).error() == Errc::malformed_data);
+
+    // A migration's failure is the field's.
+    SaveWriter old(arena);
+    STOCKPILE_CHECK(encode_record(old, Nameless{"nameless"}));
+    SaveReader nameless(old.bytes());
+    const auto record = RecordView<Player>::open(nameless);
+    STOCKPILE_CHECK(record && record->get<&Player::name>() == "nameless");
+    STOCKPILE_CHECK(record->get<&Player::health>().error() == Errc::missing_field);
+    SaveReader again(old.bytes());
+    Player decoded;
+    STOCKPILE_CHECK(decode_record(again, decoded).error() == Errc::missing_field);
+}
+
+} // namespace
+} // namespace stockpile::test
+
+int main() {
+    using namespace stockpile::test;
+    return run({
+        {"arena_allocates_aligned", arena_allocates_aligned},
+        {"arena_extends_last_allocation", arena_extends_last_allocation},
+        {"arena_reset_keeps_memory", arena_reset_keeps_memory},
+        {"arena_move_leaves_source_empty", arena_move_leaves_source_empty},
+        {"save_round_trip", save_round_trip},
+        {"reader_rejects_truncated_data", reader_rejects_truncated_data},
+        {"schema_round_trip", schema_round_trip},
+        {"schema_decodes_views_in_place", schema_decodes_views_in_place},
+        {"schema_rejects_malformed_data", schema_rejects_malformed_data},
+        {"records_round_trip", records_round_trip},
+        {"records_migrate_fields_when_read", records_migrate_fields_when_read},
+        {"records_reject_malformed_data", records_reject_malformed_data},
+    });
+}
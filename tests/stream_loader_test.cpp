@@ -0,0 +1,175 @@
+#include "stockpile/stream_loader.hpp"
+
+#include "stockpile/archive.hpp"
+#include "stockpile/archive_writer.hpp"
+
+#include "test.hpp"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace stockpile::test {
+namespace {
+
+constexpr EntryId kEntries = 300;
+
+[[nodiscard]] std::string entry_path(EntryId i) {
+    std::string path = "chunks/c";
+    path += std::to_string(1000 + i);
+    return path;
+}
+
+/// Contents of entry `i`: empty for every 50th, up to 40 KiB otherwise.
+[[nodiscard]] std::vector<std::byte> contents(EntryId i) {
+    return pattern(i % 50 == 0 ? 0 : 1 + i * 137 % 40'000, i);
+}
+
+/// Writes kEntries entries, every third LZ4-compressed, and opens them.
+[[nodiscard]] Archive make_archive(const TempDir& dir) {
+    ArchiveWriter writer;
+    for (EntryId i = 0; i < kEntries; ++i) {
+        const EntryOptions options{.codec = i % 3 == 0 ? Codec::lz4 : Codec::none, .block_size = 4096};
+        STOCKPILE_CHECK(writer.add(entry_path(i), contents(i), options));
+    }
+    STOCKPILE_CHECK(writer.write(dir / "stream.stk"));
+    auto archive = Archive::open(dir / "stream.stk");
+    STOCKPILE_CHECK(archive);
+    return std::move(*archive);
+}
+
+void reads_every_entry(StreamLoader::Backend backend) {
+    const TempDir dir;
+    const auto archive = make_archive(dir);
+    StreamLoader loader({.backend = backend, .threads = 3});
+    if (backend != StreamLoader::Backend::pread && loader.backend() != StreamLoader::Backend::io_uring) {
+        std::printf("  (io_uring unavailable: ran with pread)\n");
+    }
+
+    std::atomic<int> callbacks = 0;
+    std::vector<ReadHandle> handles;
+    for (EntryId i = 0; i < kEntries; ++i) {
+        // Scattered priorities, so batches are built from the middle out.
+        const auto id = *archive.find(entry_path(i * 7 % kEntries));
+        handles.push_back(loader.submit(archive, id, static_cast<int>(i % 5), [&](const ReadResult& result) {
+            STOCKPILE_CHECK(result);
+            ++callbacks;
+        }));
+    }
+    for (EntryId i = 0; i < kEntries; ++i) {
+        const auto result = handles[i].result();
+        STOCKPILE_CHECK(handles[i].status() == RequestStatus::completed);
+        STOCKPILE_CHECK(result && std::ranges::equal(*result, contents(i * 7 % kEntries)));
+    }
+    STOCKPILE_CHECK(callbacks == static_cast<int>(kEntries));
+}
+
+void reads_with_pread() {
+    reads_every_entry(StreamLoader::Backend::pread);
+}
+
+void reads_with_io_uring() {
+    reads_every_entry(StreamLoader::Backend::automatic);
+}
+
+/// A pread loader with one thread whose first callback blocks until
+/// release(), so requests submitted meanwhile stay pending.
+class BlockedLoader {
+public:
+    explicit BlockedLoader(const Archive& archive)
+        : m_loader({.backend = StreamLoader::Backend::pread, .threads = 1, .max_batch_bytes = 1}) {
+        m_blocker = m_loader.submit(archive, *archive.find(entry_path(1)), 0, [this](const ReadResult&) {
+            std::unique_lock lock(m_mutex);
+            m_blocked = true;
+            m_changed.notify_all();
+            m_changed.wait(lock, [this] { return !m_blocked; });
+        });
+        std::unique_lock lock(m_mutex);
+        m_changed.wait(lock, [this] { return m_blocked; });
+    }
+
+    [[nodiscard]] StreamLoader& loader() noexcept { return m_loader; }
+
+    void release() {
+        {
+            std::lock_guard lock(m_mutex);
+            m_blocked = false;
+        }
+        m_changed.notify_all();
+        m_blocker.wait();
+    }
+
+private:
+    std::mutex m_mutex;
+    std::condition_variable m_changed;
+    bool m_blocked = false;
+    StreamLoader m_loader;
+    ReadHandle m_blocker;
+};
+
+void serves_higher_priority_first() {
+    const TempDir dir;
+    const auto archive = make_archive(dir);
+    BlockedLoader blocked(archive);
+
+    std::mutex mutex;
+    std::vector<int> order;
+    std::vector<ReadHandle> handles;
+    for (const int priority : {1, 5, -2, 3, 0}) {
+        const auto id = *archive.find(entry_path(static_cast<EntryId>(10 + priority * 20 + 40)));
+        handles.push_back(blocked.loader().submit(archive, id, priority, [&, priority](const ReadResult&) {
+            std::lock_guard lock(mutex);
+            order.push_back(priority);
+        }));
+    }
+    // Raised above everything else.
+    handles.back().set_priority(9);
+    blocked.release();
+    for (auto& handle : handles) {
+        handle.wait();
+    }
+    STOCKPILE_CHECK(order == std::vector<int>{0, 5, 3, 1, -2});
+}
+
+void cancels_pending_requests() {
+    const TempDir dir;
+    const auto archive = make_archive(dir);
+    BlockedLoader blocked(archive);
+
+    std::atomic<int> callbacks = 0;
+    auto cancelled = blocked.loader().submit(archive, *archive.find(entry_path(2)), 0,
+                                             [&](const ReadResult&) { ++callbacks; });
+    auto kept = blocked.loader().submit(archive, *archive.find(entry_path(3)), 0,
+                                        [&](const ReadResult&) { ++callbacks; });
+    STOCKPILE_CHECK(cancelled.status() == RequestStatus::pending);
+    STOCKPILE_CHECK(cancelled.cancel());
+    STOCKPILE_CHECK(cancelled.cancel());
+    STOCKPILE_CHECK(cancelled.status() == RequestStatus::cancelled);
+    cancelled.set_priority(100);
+    blocked.release();
+
+    const auto result = kept.result();
+    STOCKPILE_CHECK(result && std::ranges::equal(*result, contents(3)));
+    const auto withdrawn = cancelled.result();
+    STOCKPILE_CHECK(!withdrawn && withdrawn.error() == std::errc::operation_canceled);
+    STOCKPILE_CHECK(callbacks == 1);
+    // Too late once it has run.
+    STOCKPILE_CHECK(!kept.cancel());
+    STOCKPILE_CHECK(!ReadHandle().cancel());
+}
+
+} // namespace
+} // namespace stockpile::test
+
+int main() {
+    using namespace stockpile::test;
+    return run({
+        {"reads_with_pread", reads_with_pread},
+        {"reads_with_io_uring", reads_with_io_uring},
+        {"serves_higher_priority_first", serves_higher_priority_first},
+        {"cancels_pending_requests", cancels_pending_requests},
+    });
+}
@@ -0,0 +1,477 @@
+#include "stockpile/table.hpp"
+
+#include "stockpile/arena.hpp"
+#include "stockpile/hash.hpp"
+
+#include "test.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <numeric>
+#include <random>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace stockpile::test {
+namespace {
+
+enum class Rarity : std::uint8_t { common, rare, epic, legendary };
+
+struct Vec2 {
+    float x;
+    float y;
+
+    friend bool operator==(const Vec2&, const Vec2&) = default;
+};
+STOCKPILE_SCHEMA(Vec2, x, y)
+
+struct Item {
+    std::uint32_t id = 0;
+    std::string name;
+    std::string slot;
+    float damage = 0;
+    std::int32_t level = 0;
+    Rarity rarity = Rarity::common;
+    bool tradable = false;
+    Vec2 offset{};
+
+    friend bool operator==(const Item&, const Item&) = default;
+};
+STOCKPILE_SCHEMA(Item, id, name, slot, damage, level, rarity, tradable, offset)
+STOCKPILE_SCHEMA_VERSION(Item, 3)
+STOCKPILE_TABLE_INDEXES(Item, hash_index<&Item::id>, hash_index<&Item::name>, sorted_index<&Item::slot>,
+                        sorted_index<&Item::damage>, sorted_index<&Item::level>, sorted_index<&Item::rarity>)
+
+/// Reads some of Item's columns.
+struct Summary {
+    std::uint32_t id = 0;
+    std::int32_t level = 0;
+};
+STOCKPILE_SCHEMA(Summary, id, level)
+
+/// Has a field that Item tables lack.
+struct Renamed {
+    std::uint32_t id = 0;
+    float power = 0;
+};
+STOCKPILE_SCHEMA(Renamed, id, power)
+
+/// Has Item's damage column with another type.
+struct Retyped {
+    std::uint32_t id = 0;
+    double damage = 0;
+};
+STOCKPILE_SCHEMA(Retyped, id, damage)
+
+/// Declares an index that Item tables do not have.
+struct Reindexed {
+    std::uint32_t id = 0;
+    std::int32_t level = 0;
+};
+STOCKPILE_SCHEMA(Reindexed, id, level)
+STOCKPILE_TABLE_INDEXES(Reindexed, hash_index<&Reindexed::level>)
+
+static_assert(alignof(std::max_align_t) % format::kAlignment == 0);
+
+/// An encoded table, on the 16-byte boundary that Table::open() needs.
+class TableBytes {
+public:
+    explicit TableBytes(std::span<const std::byte> bytes)
+        : m_storage(bytes.size() / sizeof(std::max_align_t) + 1), m_size(bytes.size()) {
+        std::memcpy(m_storage.data(), bytes.data(), bytes.size());
+    }
+
+    [[nodiscard]] std::span<std::byte> bytes() noexcept {
+        return std::as_writable_bytes(std::span(m_storage)).first(m_size);
+    }
+
+private:
+    std::vector<std::max_align_t> m_storage;
+    std::size_t m_size;
+};
+
+template <typename T>
+void patch(std::span<std::byte> bytes, std::size_t offset, const T& value) {
+    std::memcpy(bytes.data() + offset, &value, sizeof(value));
+}
+
+template <typename T>
+[[nodiscard]] T peek(std::span<const std::byte> bytes, std::size_t offset) {
+    T value;
+    std::memcpy(&value, bytes.data() + offset, sizeof(value));
+    return value;
+}
+
+[[nodiscard]] std::string numbered(std::string prefix, std::uint64_t n) {
+    prefix += std::to_string(n);
+    return prefix;
+}
+
+/// `count` rows in which ids, names, slots and levels repeat.
+[[nodiscard]] std::vector<Item> make_items(std::size_t count) {
+    static constexpr std::array<std::string_view, 6> kSlots{"body", "feet", "hands", "head", "ring", "weapon"};
+    std::mt19937_64 engine(41);
+    const auto below = [&](std::uint64_t bound) { return engine() % bound; };
+    std::vector<Item> items(count);
+    for (std::size_t i = 0; i < count; ++i) {
+        auto& item = items[i];
+        item.id = static_cast<std::uint32_t>(below(count / 3 + 1) * 7919);
+        item.name = numbered("item-", below(count / 2 + 1));
+        item.slot = kSlots[below(kSlots.size())];
+        item.damage = static_cast<float>(below(1000)) / 10.0f;
+        item.level = static_cast<std::int32_t>(below(60)) - 5;
+        item.rarity = static_cast<Rarity>(below(4));
+        item.tradable = below(2) == 0;
+        item.offset = {static_cast<float>(i), -static_cast<float>(i)};
+    }
+    return items;
+}
+
+[[nodiscard]] TableBytes encode_items(std::span<const Item> items) {
+    Arena arena;
+    SaveWriter writer(arena);
+    STOCKPILE_CHECK(encode_table(writer, items));
+    return TableBytes(writer.bytes());
+}
+
+/// Rows of `items` whose key passes `keep`: in row order, or ordered by key
+/// with equal keys in row order, as a sorted index returns them.
+template <typename Key, typename Keep>
+[[nodiscard]] std::vector<std::uint32_t> expected_rows(std::span<const Item> items, Key key, Keep keep,
+                                                       bool by_key) {
+    std::vector<std::uint32_t> rows(items.size());
+    std::iota(rows.begin(), rows.end(), 0u);
+    if (by_key) {
+        std::ranges::stable_sort(rows, [&](std::uint32_t a, std::uint32_t b) {
+            return detail::KeyLess{}(key(items[a]), key(items[b]));
+        });
+    }
+    std::erase_if(rows, [&](std::uint32_t row) { return !keep(key(items[row])); });
+    return rows;
+}
+
+[[nodiscard]] bool same_rows(std::span<const std::uint32_t> rows, const std::vector<std::uint32_t>& expected) {
+    return std::ranges::equal(rows, expected);
+}
+
+/// Offset of the header of the column `name` of the table in `bytes`.
+[[nodiscard]] std::size_t column_header(std::span<const std::byte> bytes, std::string_view name) {
+    const auto columns = peek<std::uint32_t>(bytes, offsetof(format::TableHeader, column_count));
+    for (std::size_t i = 0; i < columns; ++i) {
+        const std::size_t at = sizeof(format::TableHeader) + i * sizeof(format::ColumnHeader);
+        if (peek<std::uint32_t>(bytes, at + offsetof(format::ColumnHeader, key)) == field_key(name)) {
+            return at;
+        }
+    }
+    STOCKPILE_CHECK(!"no such column");
+    return 0;
+}
+
+/// Offset of the header of the index of `kind` on the column `name`.
+[[nodiscard]] std::size_t index_header(std::span<const std::byte> bytes, std::string_view name,
+                                       format::IndexKind kind) {
+    const auto columns = peek<std::uint32_t>(bytes, offsetof(format::TableHeader, column_count));
+    const auto indexes = peek<std::uint32_t>(bytes, offsetof(format::TableHeader, index_count));
+    const auto column = (column_header(bytes, name) - sizeof(format::TableHeader)) / sizeof(format::ColumnHeader);
+    for (std::size_t i = 0; i < indexes; ++i) {
+        const std::size_t at =
+            sizeof(format::TableHeader) + columns * sizeof(format::ColumnHeader) + i * sizeof(format::IndexHeader);
+        if (peek<std::uint32_t>(bytes, at + offsetof(format::IndexHeader, column)) == column &&
+            peek<format::IndexKind>(bytes, at + offsetof(format::IndexHeader, kind)) == kind) {
+            return at;
+        }
+    }
+    STOCKPILE_CHECK(!"no such index");
+    return 0;
+}
+
+/// The slots of the hash index on `name`.
+[[nodiscard]] std::span<format::IndexSlot> hash_slots(std::span<std::byte> bytes, std::string_view name) {
+    const auto at = index_header(bytes, name, format::IndexKind::hash);
+    const auto offset = peek<std::uint64_t>(bytes, at + offsetof(format::IndexHeader, data_offset));
+    const auto count = peek<std::uint64_t>(bytes, at + offsetof(format::IndexHeader, slot_count));
+    return {reinterpret_cast<format::IndexSlot*>(bytes.data() + offset), static_cast<std::size_t>(count)};
+}
+
+/// Encodes sample items, applies `edit` to the bytes and returns why
+/// Table::open() rejects them, or no error.
+template <typename Edit>
+[[nodiscard]] std::error_code open_edited(Edit edit) {
+    const auto items = make_items(100);
+    auto table = encode_items(items);
+    edit(table.bytes());
+    const auto opened = Table::open(table.bytes());
+    return opened ? std::error_code() : opened.error();
+}
+
+void round_trips_columns_and_rows() {
+    const auto items = make_items(500);
+    auto bytes = encode_items(items);
+    const auto table = Table::open(bytes.bytes());
+    STOCKPILE_CHECK(table && table->row_count() == items.size() && table->column_count() == 8);
+    STOCKPILE_CHECK(table->schema_version() == 3 && table->has("damage") && !table->has("power"));
+
+    const auto damage = table->column<float>("damage");
+    STOCKPILE_CHECK(damage && std::ranges::equal(*damage, items, {}, {}, &Item::damage));
+    STOCKPILE_CHECK(table->column<Rarity>("rarity") && table->column<bool>("tradable"));
+    STOCKPILE_CHECK(table->column<std::int32_t>("damage").error() == Errc::malformed_data);
+    STOCKPILE_CHECK(table->column<double>("damage").error() == Errc::malformed_data);
+    STOCKPILE_CHECK(table->column<float>("power").error() == Errc::missing_field);
+    STOCKPILE_CHECK(table->strings("id").error() == Errc::malformed_data);
+    STOCKPILE_CHECK(table->strings("power").error() == Errc::missing_field);
+
+    // The dictionary holds each distinct string once, in order.
+    const auto slots = table->strings("slot");
+    STOCKPILE_CHECK(slots && slots->size() == items.size() && slots->dictionary_size() == 6);
+    for (std::uint32_t code = 1; code < slots->dictionary_size(); ++code) {
+        STOCKPILE_CHECK(slots->value(code - 1) < slots->value(code));
+    }
+    for (std::size_t row = 0; row < items.size(); ++row) {
+        STOCKPILE_CHECK((*slots)[row] == items[row].slot);
+    }
+    STOCKPILE_CHECK(slots->find("ring") && slots->value(*slots->find("ring")) == "ring");
+    STOCKPILE_CHECK(!slots->find("hat") && slots->lower_bound("hat") == *slots->find("head"));
+    STOCKPILE_CHECK(slots->lower_bound("") == 0 && slots->lower_bound("zz") == slots->dictionary_size());
+
+    const auto view = TableView<Item>::open(bytes.bytes());
+    STOCKPILE_CHECK(view && view->size() == items.size());
+    STOCKPILE_CHECK(std::ranges::equal(view->column<&Item::level>(), items, {}, {}, &Item::level));
+    STOCKPILE_CHECK(std::ranges::equal(view->column<&Item::offset>(), items, {}, {}, &Item::offset));
+    STOCKPILE_CHECK(view->column<&Item::name>().dictionary_size() < items.size());
+    for (std::size_t row = 0; row < items.size(); ++row) {
+        STOCKPILE_CHECK(view->row(row) == items[row]);
+    }
+
+    const auto summary = TableView<Summary>::open(bytes.bytes());
+    STOCKPILE_CHECK(summary && summary->row(7).id == items[7].id && summary->row(7).level == items[7].level);
+
+    // No rows at all.
+    auto empty = encode_items({});
+    const auto none = TableView<Item>::open(empty.bytes());
+    STOCKPILE_CHECK(none && none->size() == 0 && none->column<&Item::slot>().dictionary_size() == 0);
+    STOCKPILE_CHECK(none->equal<&Item::id>(0).empty() && none->equal<&Item::name>("item-0").empty());
+    STOCKPILE_CHECK(none->at_least<&Item::level>(0).empty() && none->below<&Item::slot>("z").empty());
+}
+
+void answers_index_queries() {
+    const auto items = make_items(2000);
+    auto bytes = encode_items(items);
+    const auto view = TableView<Item>::open(bytes.bytes());
+    STOCKPILE_CHECK(view);
+    const auto id = [](const Item& item) { return item.id; };
+    const auto name = [](const Item& item) { return std::string_view(item.name); };
+    const auto slot = [](const Item& item) { return std::string_view(item.slot); };
+    const auto level = [](const Item& item) { return item.level; };
+    const auto rarity = [](const Item& item) { return item.rarity; };
+
+    // Hash indexes: every group, and values in no row.
+    for (std::uint32_t value = 0; value <= 700; ++value) {
+        const auto expected = expected_rows(items, id, [&](std::uint32_t key) { return key == value * 7919; }, false);
+        STOCKPILE_CHECK(same_rows(view->equal<&Item::id>(value * 7919), expected));
+        STOCKPILE_CHECK(view->equal<&Item::id>(value * 7919 + 1).empty());
+    }
+    for (std::uint64_t n = 0; n <= 1001; ++n) {
+        const auto text = numbered("item-", n);
+        const auto expected = expected_rows(items, name, [&](std::string_view key) { return key == text; }, false);
+        STOCKPILE_CHECK(same_rows(view->equal<&Item::name>(text), expected));
+    }
+
+    // Sorted indexes, including bounds between and beyond the stored values.
+    for (std::int32_t low = -7; low <= 56; low += 3) {
+        for (std::int32_t high = low; high <= 57; high += 5) {
+            const auto in = [&](std::int32_t key) { return key >= low && key < high; };
+            STOCKPILE_CHECK(same_rows(view->range<&Item::level>(low, high), expected_rows(items, level, in, true)));
+        }
+        const auto at_least = [&](std::int32_t key) { return key >= low; };
+        const auto below = [&](std::int32_t key) { return key < low; };
+        const auto equal = [&](std::int32_t key) { return key == low; };
+        STOCKPILE_CHECK(same_rows(view->at_least<&Item::level>(low), expected_rows(items, level, at_least, true)));
+        STOCKPILE_CHECK(same_rows(view->below<&Item::level>(low), expected_rows(items, level, below, true)));
+        STOCKPILE_CHECK(same_rows(view->equal<&Item::level>(low), expected_rows(items, level, equal, true)));
+    }
+    STOCKPILE_CHECK(view->range<&Item::level>(10, 5).empty());
+    const auto epic = [](Rarity key) { return key >= Rarity::epic; };
+    STOCKPILE_CHECK(same_rows(view->at_least<&Item::rarity>(Rarity::epic), expected_rows(items, rarity, epic, true)));
+
+    // String bounds become dictionary codes; a bound that is a stored value
+    // must keep or drop exactly that value's rows.
+    for (const std::string_view low : {"", "body", "c", "hands", "head", "heap", "weapon", "zz"}) {
+        for (const std::string_view high : {"", "body", "feet", "ha", "head", "ring", "weapon", "zz"}) {
+            const auto in = [&](std::string_view key) { return key >= low && key < high; };
+            STOCKPILE_CHECK(same_rows(view->range<&Item::slot>(low, high), expected_rows(items, slot, in, true)));
+        }
+        const auto at_least = [&](std::string_view key) { return key >= low; };
+        const auto below = [&](std::string_view key) { return key < low; };
+        const auto equal = [&](std::string_view key) { return key == low; };
+        STOCKPILE_CHECK(same_rows(view->at_least<&Item::slot>(low), expected_rows(items, slot, at_least, true)));
+        STOCKPILE_CHECK(same_rows(view->below<&Item::slot>(low), expected_rows(items, slot, below, true)));
+        STOCKPILE_CHECK(same_rows(view->equal<&Item::slot>(low), expected_rows(items, slot, equal, true)));
+    }
+}
+
+/// Sorted float keys follow std::strong_order: -0 sorts below +0 and NaNs
+/// have a place, so no query is left with an unordered key.
+void orders_float_keys_strongly() {
+    constexpr float kInf = std::numeric_limits<float>::infinity();
+    constexpr float kNaN = std::numeric_limits<float>::quiet_NaN();
+    const std::array<float, 9> values{1.5f, kNaN, -0.0f, kInf, 0.0f, -kInf, -2.0f, 0.0f, -kNaN};
+    std::vector<Item> items(values.size());
+    for (std::size_t i = 0; i < values.size(); ++i) {
+        items[i].damage = values[i];
+    }
+    auto bytes = encode_items(items);
+    const auto view = TableView<Item>::open(bytes.bytes());
+    STOCKPILE_CHECK(view);
+    const auto as_rows = [](std::initializer_list<std::uint32_t> rows) { return std::vector<std::uint32_t>(rows); };
+    STOCKPILE_CHECK(same_rows(view->at_least<&Item::damage>(-kInf), as_rows({5, 6, 2, 4, 7, 0, 3, 1})));
+    STOCKPILE_CHECK(same_rows(view->below<&Item::damage>(-kInf), as_rows({8})));
+    STOCKPILE_CHECK(same_rows(view->equal<&Item::damage>(0.0f), as_rows({4, 7})));
+    STOCKPILE_CHECK(same_rows(view->equal<&Item::damage>(-0.0f), as_rows({2})));
+    STOCKPILE_CHECK(same_rows(view->range<&Item::damage>(-0.0f, 0.0f), as_rows({2})));
+    STOCKPILE_CHECK(same_rows(view->at_least<&Item::damage>(kInf), as_rows({3, 1})));
+    STOCKPILE_CHECK(same_rows(view->equal<&Item::damage>(kNaN), as_rows({1})));
+}
+
+/// Two values whose hashes are equal share a probe sequence, and only the
+/// value stored in the table tells their slots apart.
+void tells_colliding_hashes_apart() {
+    const auto items = make_items(300);
+    auto table = encode_items(items);
+    const auto slots = hash_slots(table.bytes(), "id");
+    const std::uint32_t first = items[0].id;
+    const std::uint32_t second = std::ranges::find_if(items, [&](const Item& item) { return item.id != first; })->id;
+    const auto hash = [](std::uint32_t value) { return hash64(std::as_bytes(std::span(&value, 1))); };
+    const auto slot_of = [&](std::uint32_t value) {
+        return *std::ranges::find(slots, hash(value), &format::IndexSlot::hash);
+    };
+
+    // Rebuild the slots with the second value's group given the first one's
+    // hash and placed where a lookup of the first value probes first.
+    const format::IndexSlot wanted = slot_of(first);
+    format::IndexSlot impostor = slot_of(second);
+    impostor.hash = wanted.hash;
+    std::vector<format::IndexSlot> groups;
+    for (const auto& slot : slots) {
+        if (slot.count != 0 && slot.hash != wanted.hash && slot.hash != hash(second)) {
+            groups.push_back(slot);
+        }
+    }
+    groups.insert(groups.begin(), {impostor, wanted});
+    std::ranges::fill(slots, format::IndexSlot{});
+    const std::size_t mask = slots.size() - 1;
+    for (const auto& group : groups) {
+        std::size_t at = group.hash & mask;
+        while (slots[at].count != 0) {
+            at = (at + 1) & mask;
+        }
+        slots[at] = group;
+    }
+
+    const auto view = TableView<Item>::open(table.bytes());
+    STOCKPILE_CHECK(view);
+    const auto id = [](const Item& item) { return item.id; };
+    for (const auto& item : items) {
+        if (item.id == second) {
+            continue;
+        }
+        const auto expected = expected_rows(items, id, [&](std::uint32_t key) { return key == item.id; }, false);
+        STOCKPILE_CHECK(same_rows(view->equal<&Item::id>(item.id), expected));
+    }
+}
+
+void rejects_damaged_tables() {
+    // Not on a 16-byte boundary.
+    const auto items = make_items(100);
+    auto table = encode_items(items);
+    STOCKPILE_CHECK(Table::open(table.bytes().subspan(8)).error() == std::errc::invalid_argument);
+    STOCKPILE_CHECK(Table::open(table.bytes().first(sizeof(format::TableHeader) - 1)).error() == Errc::malformed_data);
+    STOCKPILE_CHECK(Table::open(table.bytes().first(table.bytes().size() - 1)).error() == Errc::malformed_data);
+
+    STOCKPILE_CHECK(open_edited([](auto bytes) { bytes[0] ^= std::byte{1}; }) == Errc::bad_magic);
+    STOCKPILE_CHECK(open_edited([](auto bytes) {
+                        patch(bytes, offsetof(format::TableHeader, version), format::kTableVersion + 1);
+                    }) == Errc::unsupported_version);
+    STOCKPILE_CHECK(open_edited([](auto bytes) {
+                        patch(bytes, offsetof(format::TableHeader, column_count), std::uint32_t{1'000'000});
+                    }) == Errc::malformed_data);
+    STOCKPILE_CHECK(open_edited([](auto bytes) {
+                        patch(bytes, offsetof(format::TableHeader, row_count), std::uint64_t{1'000'000});
+                    }) == Errc::malformed_data);
+
+    // Columns: misaligned data, a code past the dictionary, dictionary ends
+    // out of order, and a byte that is no bool.
+    STOCKPILE_CHECK(open_edited([](auto bytes) {
+                        const auto at = column_header(bytes, "level") + offsetof(format::ColumnHeader, data_offset);
+                        patch(bytes, at, peek<std::uint64_t>(bytes, at) + 4);
+                    }) == Errc::malformed_data);
+    STOCKPILE_CHECK(open_edited([](auto bytes) {
+                        const auto at = column_header(bytes, "slot");
+                        const auto data = peek<std::uint64_t>(bytes, at + offsetof(format::ColumnHeader, data_offset));
+                        patch(bytes, data,
+                              peek<std::uint32_t>(bytes, at + offsetof(format::ColumnHeader, dictionary_count)));
+                    }) == Errc::malformed_data);
+    STOCKPILE_CHECK(open_edited([](auto bytes) {
+                        const auto at = column_header(bytes, "slot");
+                        const auto ends =
+                            peek<std::uint64_t>(bytes, at + offsetof(format::ColumnHeader, dictionary_offset));
+                        patch(bytes, ends, std::uint32_t{1'000});
+                    }) == Errc::malformed_data);
+    STOCKPILE_CHECK(open_edited([](auto bytes) {
+                        const auto at = column_header(bytes, "tradable");
+                        const auto data = peek<std::uint64_t>(bytes, at + offsetof(format::ColumnHeader, data_offset));
+                        patch(bytes, data, std::uint8_t{2});
+                    }) == Errc::malformed_data);
+
+    // Indexes: a row past the end, a hash group past the end, no empty slot
+    // to end a probe, and a hash index on floats.
+    STOCKPILE_CHECK(open_edited([](auto bytes) {
+                        const auto at = index_header(bytes, "level", format::IndexKind::sorted);
+                        const auto rows = peek<std::uint64_t>(bytes, at + offsetof(format::IndexHeader, rows_offset));
+                        patch(bytes, rows, std::uint32_t{100});
+                    }) == Errc::malformed_data);
+    STOCKPILE_CHECK(open_edited([](auto bytes) {
+                        auto slots = hash_slots(bytes, "id");
+                        std::ranges::find_if(slots, [](const auto& slot) { return slot.count != 0; })->begin = 100;
+                    }) == Errc::malformed_data);
+    STOCKPILE_CHECK(open_edited([](auto bytes) {
+                        for (auto& slot : hash_slots(bytes, "id")) {
+                            slot.count = slot.count == 0 ? 1 : slot.count;
+                        }
+                    }) == Errc::malformed_data);
+    STOCKPILE_CHECK(open_edited([](auto bytes) {
+                        const auto at = index_header(bytes, "id", format::IndexKind::hash);
+                        const auto damage = (column_header(bytes, "damage") - sizeof(format::TableHeader)) /
+                                            sizeof(format::ColumnHeader);
+                        patch(bytes, at + offsetof(format::IndexHeader, column), static_cast<std::uint32_t>(damage));
+                    }) == Errc::malformed_data);
+    STOCKPILE_CHECK(open_edited([](auto bytes) {
+                        const auto at = index_header(bytes, "id", format::IndexKind::hash);
+                        patch(bytes, at + offsetof(format::IndexHeader, column), std::uint32_t{8});
+                    }) == Errc::malformed_data);
+    STOCKPILE_CHECK(!open_edited([](auto) {}));
+
+    // Views check the columns and indexes of their row type.
+    STOCKPILE_CHECK(TableView<Renamed>::open(table.bytes()).error() == Errc::missing_field);
+    STOCKPILE_CHECK(TableView<Retyped>::open(table.bytes()).error() == Errc::malformed_data);
+    STOCKPILE_CHECK(TableView<Reindexed>::open(table.bytes()).error() == Errc::missing_field);
+    STOCKPILE_CHECK(TableView<Item>::open(table.bytes().subspan(8)).error() == std::errc::invalid_argument);
+}
+
+} // namespace
+} // namespace stockpile::test
+
+int main() {
+    using namespace stockpile::test;
+    return run({
+        {"round_trips_columns_and_rows", round_trips_columns_and_rows},
+        {"answers_index_queries", answers_index_queries},
+        {"orders_float_keys_strongly", orders_float_keys_strongly},
+        {"tells_colliding_hashes_apart", tells_colliding_hashes_apart},
+        {"rejects_damaged_tables", rejects_damaged_tables},
+    });
+}
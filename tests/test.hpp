@@ -0,0 +1,101 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <initializer_list>
+#include <iterator>
+#include <span>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <vector>
+
+/// Records a failed check, with the expression and where it is, and lets the
+/// test case carry on.
+#define STOCKPILE_CHECK(...) ::stockpile::test::check(static_cast<bool>(__VA_ARGS__), #__VA_ARGS__, __FILE__, __LINE__)
+
+namespace stockpile::test {
+
+/// Failed checks in the current process.
+inline int g_failures = 0;
+
+inline void check(bool ok, const char* expression, const char* file, int line) {
+    if (!ok) {
+        std::fprintf(stderr, "%s:%d: check failed: %s\n", file, line, expression);
+        ++g_failures;
+    }
+}
+
+struct Case {
+    std::string_view name;
+    void (*run)();
+};
+
+/// Runs every case in order and returns the process exit status: 0 if no
+/// check failed.
+[[nodiscard]] inline int run(std::initializer_list<Case> cases) {
+    for (const auto& test : cases) {
+        const int before = g_failures;
+        test.run();
+        std::printf("%-48.*s %s\n", static_cast<int>(test.name.size()), test.name.data(),
+                    g_failures == before ? "ok" : "FAILED");
+    }
+    return g_failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/// A fresh directory under the system temporary directory, removed with
+/// everything in it when the TempDir goes away.
+class TempDir {
+public:
+    TempDir() {
+        auto pattern = (std::filesystem::temp_directory_path() / "stockpile-test-XXXXXX").string();
+        if (mkdtemp(pattern.data()) == nullptr) {
+            std::perror("mkdtemp");
+            std::exit(EXIT_FAILURE);
+        }
+        m_path = pattern;
+    }
+    TempDir(const TempDir&) = delete;
+    TempDir& operator=(const TempDir&) = delete;
+    ~TempDir() {
+        std::error_code ec;
+        std::filesystem::remove_all(m_path, ec);
+    }
+
+    [[nodiscard]] const std::filesystem::path& path() const noexcept { return m_path; }
+    [[nodiscard]] std::filesystem::path operator/(std::string_view name) const { return m_path / name; }
+
+private:
+    std::filesystem::path m_path;
+};
+
+[[nodiscard]] inline std::vector<std::byte> read_file(const std::filesystem::path& path) {
+    std::ifstream in(path, std::ios::binary);
+    const std::vector<char> chars{std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>()};
+    const auto bytes = std::as_bytes(std::span(chars));
+    return {bytes.begin(), bytes.end()};
+}
+
+inline void write_file(const std::filesystem::path& path, std::span<const std::byte> bytes) {
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    out.write(reinterpret_cast<const char*>(bytes.data()), static_cast<std::streamsize>(bytes.size()));
+}
+
+[[nodiscard]] inline std::span<const std::byte> as_bytes(std::string_view text) noexcept {
+    return std::as_bytes(std::span(text.data(), text.size()));
+}
+
+/// `size` bytes of a deterministic pattern that depends on `seed`, with
+/// runs long enough for LZ4 to find matches.
+[[nodiscard]] inline std::vector<std::byte> pattern(std::size_t size, unsigned seed = 0) {
+    std::vector<std::byte> bytes(size);
+    for (std::size_t i = 0; i < size; ++i) {
+        bytes[i] = static_cast<std::byte>((i / 7 + seed) * 31 % 251);
+    }
+    return bytes;
+}
+
+} // namespace stockpile::test
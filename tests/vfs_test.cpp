@@ -0,0 +1,174 @@
+#include "stockpile/vfs.hpp"
+
+#include "stockpile/archive_writer.hpp"
+
+#include "test.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <map>
+#include <optional>
+#include <random>
+#include <string>
+#include <tuple>
+#include <vector>
+
+namespace stockpile::test {
+namespace {
+
+/// Paths of a layer, below its mount point, mapped to their size, or to -1
+/// for a tombstone.
+using Files = std::map<std::string, int>;
+
+[[nodiscard]] std::string numbered(std::string prefix, std::uint64_t n) {
+    prefix += std::to_string(n);
+    return prefix;
+}
+
+[[nodiscard]] Archive make_archive(const std::filesystem::path& path, const Files& files) {
+    ArchiveWriter writer;
+    for (const auto& [name, size] : files) {
+        const auto added = size < 0 ? writer.add_tombstone(name)
+                                    : writer.add(name, pattern(static_cast<std::size_t>(size), size));
+        STOCKPILE_CHECK(added);
+    }
+    STOCKPILE_CHECK(writer.write(path));
+    auto archive = Archive::open(path);
+    STOCKPILE_CHECK(archive);
+    return std::move(*archive);
+}
+
+[[nodiscard]] std::vector<MemoryFile> memory_files(const Files& files) {
+    std::vector<MemoryFile> result;
+    for (const auto& [name, size] : files) {
+        result.push_back({name, pattern(static_cast<std::size_t>(size), size)});
+    }
+    return result;
+}
+
+[[nodiscard]] bool reads(const Vfs& vfs, std::string_view path, int size) {
+    const auto ref = vfs.find(path);
+    if (!ref || vfs.size(*ref) != static_cast<std::uint64_t>(size) || vfs.path(*ref) != path) {
+        return false;
+    }
+    std::vector<std::byte> out(static_cast<std::size_t>(size));
+    return vfs.read(*ref, out) && std::ranges::equal(out, pattern(out.size(), size));
+}
+
+void layers_override_by_priority() {
+    const TempDir dir;
+    Vfs vfs;
+    const auto base = vfs.mount(make_archive(dir / "base.stk", {{"a", 1}, {"b", 2}, {"maps/town", 3}}));
+    const auto mods = vfs.mount_memory(memory_files({{"a", 10}, {"c", 11}}), {.mount_point = "", .priority = 1});
+    // Mounted later, but below the memory layer.
+    const auto patch = vfs.mount(make_archive(dir / "patch.stk", {{"a", 20}, {"b", -1}, {"d", 21}}));
+    STOCKPILE_CHECK(base && mods && patch);
+    STOCKPILE_CHECK(reads(vfs, "a", 10) && reads(vfs, "c", 11) && reads(vfs, "d", 21));
+    STOCKPILE_CHECK(!vfs.find("b") && reads(vfs, "maps/town", 3));
+    STOCKPILE_CHECK(vfs.entry_count() == 4);
+
+    std::filesystem::create_directories(dir / "loose" / "maps");
+    write_file(dir / "loose" / "maps" / "town", pattern(30, 30));
+    write_file(dir / "loose" / "b", pattern(31, 31));
+    const auto loose = vfs.mount_directory(dir / "loose", {.mount_point = "dlc/"});
+    STOCKPILE_CHECK(loose && reads(vfs, "dlc/maps/town", 30) && reads(vfs, "dlc/b", 31));
+    STOCKPILE_CHECK(reads(vfs, "maps/town", 3) && vfs.data(*vfs.find("dlc/b")).empty());
+
+    STOCKPILE_CHECK(vfs.unmount(*mods));
+    STOCKPILE_CHECK(reads(vfs, "a", 20) && !vfs.find("c"));
+    STOCKPILE_CHECK(vfs.unmount(*patch));
+    STOCKPILE_CHECK(reads(vfs, "a", 1) && reads(vfs, "b", 2) && !vfs.find("d"));
+    STOCKPILE_CHECK(vfs.entry_count() == 5);
+    vfs.reclaim();
+    STOCKPILE_CHECK(vfs.unmount(*patch).error() == std::errc::invalid_argument);
+}
+
+void rejects_bad_mounts() {
+    Vfs vfs;
+    STOCKPILE_CHECK(vfs.mount_memory(memory_files({{"a", 1}}), {.mount_point = "../up"}).error() ==
+                    Errc::invalid_path);
+    STOCKPILE_CHECK(vfs.mount_memory({{"a", {}}, {"a", {}}}).error() == Errc::duplicate_path);
+    STOCKPILE_CHECK(vfs.mount_memory({{"/a", {}}}).error() == Errc::invalid_path);
+    STOCKPILE_CHECK(!vfs.mount_directory("/nonexistent/stockpile"));
+    STOCKPILE_CHECK(vfs.entry_count() == 0 && !vfs.find("a"));
+}
+
+/// Random mounts and unmounts of archives and memory layers, at the root or
+/// under "dlc", with random priorities, checked against a model after each
+/// step. Large layers fold the index's overlay into its base, and layers
+/// mounted below others rebuild part of it.
+void matches_model_under_random_changes() {
+    struct Layer {
+        Files files;
+        std::string mount_point;
+        int priority;
+        int sequence;
+    };
+    const TempDir dir;
+    std::mt19937_64 engine(29);
+    const auto below = [&](std::uint64_t bound) { return engine() % bound; };
+    constexpr std::uint64_t kFiles = 300;
+    Vfs vfs;
+    std::map<LayerId, Layer> layers;
+    for (int step = 0; step < 80; ++step) {
+        if (below(4) == 0 && !layers.empty()) {
+            auto it = layers.begin();
+            std::advance(it, below(layers.size()));
+            STOCKPILE_CHECK(vfs.unmount(it->first));
+            layers.erase(it);
+        } else {
+            Layer layer{{}, below(3) == 0 ? "dlc/" : "", static_cast<int>(below(3)) - 1, step};
+            const bool archive = below(2) == 0;
+            const auto count = step == 0 ? 1000 : below(6) == 0 ? 300 : below(30) + 1;
+            for (std::uint64_t i = 0; i < count; ++i) {
+                const bool tombstone = archive && step > 0 && below(4) == 0;
+                layer.files.emplace(numbered("f", below(kFiles)), tombstone ? -1 : static_cast<int>(below(40)));
+            }
+            const MountOptions options{layer.mount_point, layer.priority};
+            const auto id = archive ? vfs.mount(make_archive(dir / numbered("layer-", step), layer.files), options)
+                                    : vfs.mount_memory(memory_files(layer.files), options);
+            STOCKPILE_CHECK(id);
+            layers.emplace(*id, std::move(layer));
+        }
+
+        std::size_t visible = 0;
+        for (const std::string mount_point : {"", "dlc/"}) {
+            for (std::uint64_t file = 0; file < kFiles; ++file) {
+                const auto name = numbered("f", file);
+                const Layer* top = nullptr;
+                for (const auto& [id, layer] : layers) {
+                    if (layer.mount_point == mount_point && layer.files.contains(name) &&
+                        (top == nullptr ||
+                         std::tie(layer.priority, layer.sequence) > std::tie(top->priority, top->sequence))) {
+                        top = &layer;
+                    }
+                }
+                const auto path = mount_point + name;
+                if (top == nullptr || top->files.at(name) < 0) {
+                    STOCKPILE_CHECK(!vfs.find(path));
+                    continue;
+                }
+                ++visible;
+                const auto ref = vfs.find(path);
+                STOCKPILE_CHECK(ref && &layers.at(ref->layer) == top);
+                STOCKPILE_CHECK(ref && vfs.size(*ref) == static_cast<std::uint64_t>(top->files.at(name)));
+            }
+        }
+        STOCKPILE_CHECK(vfs.entry_count() == visible);
+        if (step % 7 == 0) {
+            vfs.reclaim();
+        }
+    }
+}
+
+} // namespace
+} // namespace stockpile::test
+
+int main() {
+    using namespace stockpile::test;
+    return run({
+        {"layers_override_by_priority", layers_override_by_priority},
+        {"rejects_bad_mounts", rejects_bad_mounts},
+        {"matches_model_under_random_changes", matches_model_under_random_changes},
+    });
+}
@@ -0,0 +1,171 @@
+// stockpile-pack: packs directory trees into a stockpile archive.
+//
+// Files are added in order of their archive path, after the ones named in
+// access traces, so the archive depends only on the contents of the inputs
+// and the options, never on directory iteration order or the number of
+// threads.
+
+#include "stockpile/access_trace.hpp"
+#include "stockpile/archive_writer.hpp"
+#include "stockpile/thread_pool.hpp"
+
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+struct Options {
+    fs::path output;
+    std::vector<fs::path> inputs;
+    std::vector<fs::path> traces;
+    stockpile::EntryOptions entry;
+    /// 0 means one per hardware thread.
+    std::size_t threads = 0;
+};
+
+[[noreturn]] void die(const char* what, const std::error_code& error) {
+    std::fprintf(stderr, "stockpile-pack: %s: %s\n", what, error.message().c_str());
+    std::exit(1);
+}
+
+[[noreturn]] void usage(int status) {
+    std::fprintf(status == 0 ? stdout : stderr,
+                 "usage: stockpile-pack [-j THREADS] [--codec none|lz4] [--block-size BYTES]\n"
+                 "                      [--trace FILE]... OUTPUT INPUT_DIR...\n"
+                 "\n"
+                 "Packs every regular file under each INPUT_DIR into the archive OUTPUT, keyed\n"
+                 "by its '/'-separated path relative to that directory. -j 0 (the default)\n"
+                 "uses one thread per core; the output does not depend on it. Files named in\n"
+                 "the access traces are stored first, in the order they were first loaded.\n");
+    std::exit(status);
+}
+
+[[nodiscard]] std::size_t parse_number(std::string_view value, const char* what) {
+    std::size_t number = 0;
+    const auto parsed = std::from_chars(value.data(), value.data() + value.size(), number);
+    if (parsed.ec != std::errc() || parsed.ptr != value.data() + value.size()) {
+        std::fprintf(stderr, "stockpile-pack: bad %s '%.*s'\n", what, static_cast<int>(value.size()), value.data());
+        std::exit(2);
+    }
+    return number;
+}
+
+[[nodiscard]] Options parse_options(int argc, char** argv) {
+    Options options;
+    std::vector<std::string_view> positional;
+    for (int i = 1; i < argc; ++i) {
+        const std::string_view arg = argv[i];
+        if (arg == "--help" || arg == "-h") {
+            usage(0);
+        }
+        if ((arg == "-j" || arg == "--threads" || arg == "--codec" || arg == "--block-size" || arg == "--trace") &&
+            i + 1 < argc) {
+            const std::string_view value = argv[++i];
+            if (arg == "--trace") {
+                options.traces.emplace_back(value);
+            } else if (arg == "--codec") {
+                if (value == "none") {
+                    options.entry.codec = stockpile::Codec::none;
+                } else if (value == "lz4") {
+                    options.entry.codec = stockpile::Codec::lz4;
+                } else {
+                    std::fprintf(stderr, "stockpile-pack: unknown codec '%s'\n", argv[i]);
+                    std::exit(2);
+                }
+            } else if (arg == "--block-size") {
+                options.entry.block_size = static_cast<std::uint32_t>(
+                    std::min<std::size_t>(parse_number(value, "block size"), 0xFFFFFFFF));
+            } else {
+                options.threads = parse_number(value, "thread count");
+            }
+        } else if (arg.starts_with('-') && arg.size() > 1) {
+            usage(2);
+        } else {
+            positional.push_back(arg);
+        }
+    }
+    if (positional.size() < 2) {
+        usage(2);
+    }
+    options.output = positional.front();
+    options.inputs.assign(positional.begin() + 1, positional.end());
+    return options;
+}
+
+/// Every regular file under `root` as (archive path, file path).
+void collect(const fs::path& root, std::vector<std::pair<std::string, fs::path>>& files) {
+    std::error_code error;
+    fs::recursive_directory_iterator it(root, error);
+    if (error) {
+        die(root.string().c_str(), error);
+    }
+    for (const fs::recursive_directory_iterator end; it != end; it.increment(error)) {
+        if (error) {
+            die(root.string().c_str(), error);
+        }
+        if (it->is_regular_file(error)) {
+            files.emplace_back(it->path().lexically_relative(root).generic_string(), it->path());
+        }
+    }
+    if (error) {
+        die(root.string().c_str(), error);
+    }
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    const Options options = parse_options(argc, argv);
+    const auto start = std::chrono::steady_clock::now();
+
+    std::vector<std::pair<std::string, fs::path>> files;
+    for (const auto& input : options.inputs) {
+        collect(input, files);
+    }
+    std::sort(files.begin(), files.end());
+
+    stockpile::ArchiveWriter writer;
+    std::uintmax_t input_bytes = 0;
+    for (const auto& [path, source] : files) {
+        if (auto added = writer.add_file(path, source, options.entry); !added) {
+            std::fprintf(stderr, "stockpile-pack: %s: %s\n", path.c_str(), added.error().message().c_str());
+            return 1;
+        }
+        std::error_code error;
+        input_bytes += fs::file_size(source, error);
+    }
+
+    if (!options.traces.empty()) {
+        stockpile::AccessTrace trace;
+        for (const auto& file : options.traces) {
+            if (auto loaded = trace.load(file); !loaded) {
+                die(file.string().c_str(), loaded.error());
+            }
+        }
+        writer.apply_trace(trace);
+    }
+
+    stockpile::ThreadPool pool(options.threads);
+    if (auto written = writer.write(options.output, &pool); !written) {
+        die(options.output.string().c_str(), written.error());
+    }
+
+    std::error_code error;
+    const auto output_bytes = fs::file_size(options.output, error);
+    const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    std::printf("%zu files, %ju bytes -> %ju bytes in %.2f s (%zu threads)\n", files.size(), input_bytes,
+                static_cast<std::uintmax_t>(output_bytes), elapsed.count(), pool.size());
+    return 0;
+}